@@ -9,8 +9,11 @@
 #include "Lamp/Core/Graphics/GraphicsDevice.h"
 #include "Lamp/Core/Graphics/Swapchain.h"
 #include "Lamp/Core/Layer/Layer.h"
+#include "Lamp/Core/Jobs/JobSystem.h"
 
+#include "Lamp/Rendering/GPUProfiler.h"
 #include "Lamp/Rendering/Renderer.h"
+#include "Lamp/Rendering/Shader/ShaderRegistry.h"
 
 #include "Lamp/ImGui/ImGuiImplementation.h"
 
@@ -27,6 +30,7 @@ namespace Lamp
 		m_applicationInfo = info;
 
 		Log::Initialize();
+		JobSystem::Initialize();
 
 		WindowProperties windowProperties{};
 		windowProperties.width = info.width;
@@ -53,6 +57,8 @@ namespace Lamp
 		m_imguiImplementation = nullptr;
 
 		Renderer::Shutdowm();
+		JobSystem::Shutdown();
+
 		m_window = nullptr;
 		s_instance = nullptr;
 	}
@@ -68,6 +74,9 @@ namespace Lamp
 			LP_PROFILE_FRAME("Frame");
 
 			m_window->BeginFrame();
+			GPUProfiler::BeginFrame(m_window->GetSwapchain().GetCurrentFrame());
+			JobSystem::ExecuteMainThreadJobs();
+			ShaderRegistry::Update();
 
 			float time = (float)glfwGetTime();
 			m_currentFrameTime = time - m_lastFrameTime;
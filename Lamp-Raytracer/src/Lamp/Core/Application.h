@@ -16,8 +16,8 @@ namespace Lamp
 {
 	struct ApplicationInfo
 	{
-		ApplicationInfo(const std::string& aTitle = "Lamp", uint32_t aWidth = 1280, uint32_t aHeight = 720, bool aUseVSync = true, bool aEnableImGui = true)
-			: title(aTitle), width(aWidth), height(aHeight), useVSync(aUseVSync), enableImGui(aEnableImGui)
+		ApplicationInfo(const std::string& aTitle = "Lamp", uint32_t aWidth = 1280, uint32_t aHeight = 720, bool aUseVSync = true, bool aEnableImGui = true, bool aEnableBindless = false)
+			: title(aTitle), width(aWidth), height(aHeight), useVSync(aUseVSync), enableImGui(aEnableImGui), enableBindless(aEnableBindless)
 		{ }
 
 		std::string title;
@@ -25,6 +25,7 @@ namespace Lamp
 		uint32_t height;
 		bool useVSync;
 		bool enableImGui;
+		bool enableBindless;
 	};
 
 	class Window;
@@ -43,6 +44,7 @@ namespace Lamp
 		void PushLayer(Layer* layer);
 		
 		inline const Ref<Window> GetWindow() const { return m_window; }
+		inline const ApplicationInfo& GetInfo() const { return m_applicationInfo; }
 		inline static Application& Get() { return *s_instance; }
 
 	private:
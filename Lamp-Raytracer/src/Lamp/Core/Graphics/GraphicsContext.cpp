@@ -101,6 +101,20 @@ namespace Lamp
 		vk12Features.pNext = &vulkan11Features;
 		vk12Features.drawIndirectCount = VK_TRUE;
 		vk12Features.samplerFilterMinmax = VK_TRUE;
+		vk12Features.timelineSemaphore = VK_TRUE;
+		vk12Features.hostQueryReset = m_physicalDevice->GetCapabilities().supportsHostQueryReset;
+
+		if (m_physicalDevice->GetCapabilities().supportsBindless)
+		{
+			vk12Features.descriptorIndexing = VK_TRUE;
+			vk12Features.runtimeDescriptorArray = VK_TRUE;
+			vk12Features.descriptorBindingPartiallyBound = VK_TRUE;
+			vk12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			vk12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+			vk12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			vk12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+			vk12Features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+		}
 
 		VkPhysicalDeviceFeatures2 enabledFeatures{};
 		enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
@@ -3,6 +3,9 @@
 
 #include "Lamp/Log/Log.h"
 #include "Lamp/Core/Base.h"
+#include "Lamp/Core/Graphics/PipelineCache.h"
+
+#include "Lamp/Utility/FileSystem.h"
 
 namespace Lamp
 {
@@ -21,31 +24,82 @@ namespace Lamp
 
 		for (const auto& device : devices)
 		{
-			vkGetPhysicalDeviceProperties(device, &m_physicalDeviceProperties);
-			if (m_physicalDeviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+			VkPhysicalDeviceProperties properties{};
+			vkGetPhysicalDeviceProperties(device, &properties);
+			if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
 			{
 				m_physicalDevice = device;
 			}
 		}
 
+		// Fall back to integrated or software devices (e.g. lavapipe) when no discrete GPU exists
+		if (!m_physicalDevice)
+		{
+			m_physicalDevice = devices.front();
+		}
+
+		vkGetPhysicalDeviceProperties(m_physicalDevice, &m_physicalDeviceProperties);
+		LP_CORE_INFO("Using physical device {0}", m_physicalDeviceProperties.deviceName);
+
 		m_capabilities.minUBOOffsetAlignment = m_physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
 		m_capabilities.minSSBOOffsetAlignment = m_physicalDeviceProperties.limits.minStorageBufferOffsetAlignment;
 
-		if (!m_physicalDevice)
 		{
-			throw std::runtime_error("Failed to find a supported device!");
+			uint32_t extensionCount = 0;
+			vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+
+			std::vector<VkExtensionProperties> extensions(extensionCount);
+			vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, extensions.data());
+
+			for (const auto& extension : extensions)
+			{
+				if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+				{
+					m_capabilities.supportsMemoryBudget = true;
+				}
+			}
+		}
+
+		// Bindless needs runtime sized, partially bound arrays that can be updated after binding
+		{
+			VkPhysicalDeviceVulkan12Features vk12Features{};
+			vk12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+			VkPhysicalDeviceFeatures2 features{};
+			features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features.pNext = &vk12Features;
+
+			vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features);
+
+			VkPhysicalDeviceVulkan12Properties vk12Properties{};
+			vk12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+			VkPhysicalDeviceProperties2 properties{};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties.pNext = &vk12Properties;
+
+			vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties);
+
+			m_capabilities.supportsBindless = vk12Features.descriptorIndexing && vk12Features.runtimeDescriptorArray && vk12Features.descriptorBindingPartiallyBound &&
+				vk12Features.descriptorBindingSampledImageUpdateAfterBind && vk12Features.descriptorBindingStorageBufferUpdateAfterBind &&
+				vk12Features.descriptorBindingUpdateUnusedWhilePending && vk12Features.shaderSampledImageArrayNonUniformIndexing && vk12Features.shaderStorageBufferArrayNonUniformIndexing;
+
+			m_capabilities.maxBindlessSampledImages = std::min(vk12Properties.maxDescriptorSetUpdateAfterBindSampledImages, vk12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+			m_capabilities.maxBindlessStorageBuffers = std::min(vk12Properties.maxDescriptorSetUpdateAfterBindStorageBuffers, vk12Properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+
+			m_capabilities.supportsHostQueryReset = vk12Features.hostQueryReset;
 		}
 
 		uint32_t queueFamilyCount = 0;
 		vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
 		LP_CORE_ASSERT(queueFamilyCount > 0, "No queue families supported!");
 
-		std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
-		vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+		m_queueFamilyProperties.resize(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, m_queueFamilyProperties.data());
 
 		int32_t i = 0;
 		bool foundQueues = false;
-		for (const auto& prop : queueFamilyProperties)
+		for (const auto& prop : m_queueFamilyProperties)
 		{
 			if (prop.queueFlags & VK_QUEUE_GRAPHICS_BIT)
 			{
@@ -73,7 +127,30 @@ namespace Lamp
 			i++;
 		}
 
+		// Devices without dedicated compute or transfer families share the graphics family
+		if (!foundQueues && m_queueIndices.graphicsQueueIndex != -1)
+		{
+			if (m_queueIndices.computeQueueIndex == -1)
+			{
+				m_queueIndices.computeQueueIndex = m_queueIndices.graphicsQueueIndex;
+			}
+
+			if (m_queueIndices.transferQueueIndex == -1)
+			{
+				m_queueIndices.transferQueueIndex = m_queueIndices.graphicsQueueIndex;
+			}
+
+			foundQueues = m_queueIndices.IsComplete();
+		}
+
 		LP_CORE_ASSERT(foundQueues, "No fitting queue found!");
+
+		if (foundQueues)
+		{
+			m_capabilities.timestampPeriod = m_physicalDeviceProperties.limits.timestampPeriod;
+			m_capabilities.timestampValidBits = m_queueFamilyProperties.at(m_queueIndices.graphicsQueueIndex).timestampValidBits;
+			m_capabilities.supportsTimestamps = m_capabilities.timestampValidBits > 0 && m_capabilities.timestampPeriod > 0.f;
+		}
 	}
 
 	PhysicalGraphicsDevice::~PhysicalGraphicsDevice()
@@ -93,6 +170,9 @@ namespace Lamp
 
 		float queuePriority[2] = { 1.f, 1.f };
 
+		// The thread safe queue is a second graphics queue when the family exposes one
+		const uint32_t graphicsQueueCount = std::min(2u, physicalDevice->GetQueueFamilyProperties().at(queueIndices.graphicsQueueIndex).queueCount);
+
 		std::vector<VkDeviceQueueCreateInfo> deviceQueueInfos;
 
 		for (uint32_t queue : uniqueQueues)
@@ -102,9 +182,9 @@ namespace Lamp
 			queueInfo.pQueuePriorities = queuePriority;
 			queueInfo.queueCount = 1;
 
-			if (queue == 0)
+			if (queue == (uint32_t)queueIndices.graphicsQueueIndex)
 			{
-				queueInfo.queueCount++;
+				queueInfo.queueCount = graphicsQueueCount;
 			}
 
 			queueInfo.queueFamilyIndex = queue;
@@ -118,6 +198,11 @@ namespace Lamp
 		createInfo.pEnabledFeatures = nullptr;
 
 		std::vector<const char*> enabledExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		if (physicalDevice->GetCapabilities().supportsMemoryBudget)
+		{
+			enabledExtensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+
 		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
 		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
@@ -129,10 +214,12 @@ namespace Lamp
 		LP_VK_CHECK(vkCreateDevice(physicalDevice->GetHandle(), &createInfo, nullptr, &m_device));
 
 		vkGetDeviceQueue(m_device, queueIndices.graphicsQueueIndex, 0, &m_graphicsQueue);
-		vkGetDeviceQueue(m_device, queueIndices.graphicsQueueIndex, 1, &m_threadSafeGraphicsQueue);
+		vkGetDeviceQueue(m_device, queueIndices.graphicsQueueIndex, graphicsQueueCount - 1, &m_threadSafeGraphicsQueue);
 		vkGetDeviceQueue(m_device, queueIndices.computeQueueIndex, 0, &m_computeQueue);
 		vkGetDeviceQueue(m_device, queueIndices.transferQueueIndex, 0, &m_transferQueue);
 
+		m_pipelineCache = PipelineCache::Create(m_device, m_physicalDevice, FileSystem::GetEnginePath() / "Cache" / "pipelines.cache");
+
 		// Create main thread (faster to use) command pool
 		{
 			VkCommandPoolCreateInfo commandPoolInfo{};
@@ -142,16 +229,6 @@ namespace Lamp
 
 			LP_VK_CHECK(vkCreateCommandPool(m_device, &commandPoolInfo, nullptr, &m_graphicsCommandPool));
 		}
-
-		// Optick GPU
-#ifdef LP_ENABLE_PROFILING
-		{
-			VkPhysicalDevice physDevice = m_physicalDevice->GetHandle();
-			uint32_t graphicsQueueIndex = (uint32_t)queueIndices.graphicsQueueIndex;
-
-			OPTICK_GPU_INIT_VULKAN(&m_device, &physDevice, &m_graphicsQueue, &graphicsQueueIndex, 1, nullptr);
-		}
-#endif
 	}
 
 	GraphicsDevice::~GraphicsDevice()
@@ -163,6 +240,10 @@ namespace Lamp
 		m_commandPoolMap.clear();
 
 		vkDestroyCommandPool(m_device, m_graphicsCommandPool, nullptr);
+
+		// Written back to disk before the device goes away
+		m_pipelineCache = nullptr;
+
 		vkDestroyDevice(m_device, nullptr);
 	}
 
@@ -314,6 +395,11 @@ namespace Lamp
 		vkFreeCommandBuffers(m_device, m_graphicsCommandPool, 1, &cmdBuffer);
 	}
 
+	VkPipelineCache GraphicsDevice::GetPipelineCache() const
+	{
+		return m_pipelineCache->GetHandle();
+	}
+
 	Ref<GraphicsDevice> GraphicsDevice::Create(Ref<PhysicalGraphicsDevice> physicalDevice, VkPhysicalDeviceFeatures2 enabledFeatures)
 	{
 		return CreateRef<GraphicsDevice>(physicalDevice, enabledFeatures);
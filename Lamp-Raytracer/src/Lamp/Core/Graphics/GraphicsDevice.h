@@ -9,6 +9,8 @@
 
 namespace Lamp
 {
+	class PipelineCache;
+
 	class PhysicalGraphicsDevice
 	{
 	public:
@@ -29,6 +31,16 @@ namespace Lamp
 		{
 			uint64_t minUBOOffsetAlignment;
 			uint64_t minSSBOOffsetAlignment;
+
+			bool supportsBindless = false;
+			bool supportsMemoryBudget = false;
+			bool supportsTimestamps = false;
+			bool supportsHostQueryReset = false;
+			uint32_t maxBindlessSampledImages = 0;
+			uint32_t maxBindlessStorageBuffers = 0;
+
+			float timestampPeriod = 0.f; // Nanoseconds per tick
+			uint32_t timestampValidBits = 0;
 		};
 
 		PhysicalGraphicsDevice(VkInstance instance);
@@ -37,12 +49,15 @@ namespace Lamp
 		inline VkPhysicalDevice GetHandle() const { return m_physicalDevice; }
 		inline const QueueIndices& GetQueueIndices() const { return m_queueIndices; }
 		inline const Capabilities& GetCapabilities() const { return m_capabilities; }
+		inline const VkPhysicalDeviceProperties& GetProperties() const { return m_physicalDeviceProperties; }
+		inline const std::vector<VkQueueFamilyProperties>& GetQueueFamilyProperties() const { return m_queueFamilyProperties; }
 
 		static Ref<PhysicalGraphicsDevice> Create(VkInstance instance);
 
 	private:
 		QueueIndices m_queueIndices;
 		Capabilities m_capabilities;
+		std::vector<VkQueueFamilyProperties> m_queueFamilyProperties;
 
 		VkPhysicalDevice m_physicalDevice = nullptr;
 		VkPhysicalDeviceProperties m_physicalDeviceProperties;
@@ -70,6 +85,7 @@ namespace Lamp
 		inline VkQueue GetGraphicsQueue() const { return m_graphicsQueue; }
 		inline VkQueue GetComputeQueue() const { return m_computeQueue; }
 		inline VkQueue GetTransferQueue() const { return m_transferQueue; }
+		VkPipelineCache GetPipelineCache() const;
 		
 		inline Ref<PhysicalGraphicsDevice> GetPhysicalDevice() const { return m_physicalDevice; }
 		static Ref<GraphicsDevice> Create(Ref<PhysicalGraphicsDevice> physicalDevice, VkPhysicalDeviceFeatures2 enabledFeatures);
@@ -78,6 +94,7 @@ namespace Lamp
 		const std::vector<const char*> m_validationLayers = { "VK_LAYER_KHRONOS_validation" };
 		std::mutex m_commandBufferFlushMutex;
 		Ref<PhysicalGraphicsDevice> m_physicalDevice;
+		Ref<PipelineCache> m_pipelineCache;
 	
 		std::unordered_map<VkCommandBuffer, VkCommandPool> m_commandPoolMap;
 		VkCommandPool m_graphicsCommandPool;
@@ -0,0 +1,193 @@
+#include "lppch.h"
+#include "PipelineCache.h"
+
+#include "Lamp/Log/Log.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+
+#include "Lamp/Utility/FileSystem.h"
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		uint64_t HashPipelineCacheData(const std::vector<uint8_t>& data)
+		{
+			// FNV-1a
+			uint64_t hash = 14695981039346656037ull;
+			for (const uint8_t byte : data)
+			{
+				hash ^= byte;
+				hash *= 1099511628211ull;
+			}
+
+			return hash;
+		}
+	}
+
+	PipelineCache::PipelineCache(VkDevice device, Ref<PhysicalGraphicsDevice> physicalDevice, const std::filesystem::path& path)
+		: m_device(device), m_path(path)
+	{
+		LP_PROFILE_FUNCTION();
+
+		m_deviceProperties = physicalDevice->GetProperties();
+
+		std::vector<uint8_t> initialData;
+		if (ReadValidatedData(initialData, m_loadedHash))
+		{
+			LP_CORE_INFO("Loaded pipeline cache {0} ({1} bytes)", m_path.string().c_str(), initialData.size());
+		}
+		else
+		{
+			initialData.clear();
+			m_loadedHash = 0;
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = initialData.size();
+		cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+		// The driver may still reject the data, in which case it silently starts empty
+		LP_VK_CHECK(vkCreatePipelineCache(m_device, &cacheInfo, nullptr, &m_pipelineCache));
+	}
+
+	PipelineCache::~PipelineCache()
+	{
+		Save();
+		vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+	}
+
+	void PipelineCache::Save()
+	{
+		LP_PROFILE_FUNCTION();
+
+		// Another instance may have written the file since it was loaded, keep its pipelines as well
+		std::vector<uint8_t> diskData;
+		uint64_t diskHash = 0;
+
+		if (ReadValidatedData(diskData, diskHash) && diskHash != m_loadedHash)
+		{
+			VkPipelineCacheCreateInfo cacheInfo{};
+			cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+			cacheInfo.initialDataSize = diskData.size();
+			cacheInfo.pInitialData = diskData.data();
+
+			VkPipelineCache diskCache = nullptr;
+			if (vkCreatePipelineCache(m_device, &cacheInfo, nullptr, &diskCache) == VK_SUCCESS)
+			{
+				vkMergePipelineCaches(m_device, m_pipelineCache, 1, &diskCache);
+				vkDestroyPipelineCache(m_device, diskCache, nullptr);
+			}
+		}
+
+		size_t dataSize = 0;
+		LP_VK_CHECK(vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr));
+
+		std::vector<uint8_t> data(dataSize);
+		LP_VK_CHECK(vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, data.data()));
+		data.resize(dataSize);
+
+		const uint64_t dataHash = Utility::HashPipelineCacheData(data);
+		if (data.empty() || dataHash == diskHash)
+		{
+			m_loadedHash = dataHash;
+			return;
+		}
+
+		FileHeader header{};
+		header.magic = s_magic;
+		header.version = s_version;
+		header.vendorID = m_deviceProperties.vendorID;
+		header.deviceID = m_deviceProperties.deviceID;
+		header.driverVersion = m_deviceProperties.driverVersion;
+		memcpy_s(header.pipelineCacheUUID, VK_UUID_SIZE, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+		header.dataSize = data.size();
+		header.dataHash = dataHash;
+
+		std::vector<uint8_t> fileData(sizeof(FileHeader) + data.size());
+		memcpy_s(fileData.data(), fileData.size(), &header, sizeof(FileHeader));
+		memcpy_s(fileData.data() + sizeof(FileHeader), data.size(), data.data(), data.size());
+
+		std::filesystem::create_directories(m_path.parent_path());
+
+		if (!FileSystem::WriteFileAtomic(m_path, fileData.data(), fileData.size()))
+		{
+			LP_CORE_ERROR("Failed to write pipeline cache {0}!", m_path.string().c_str());
+			return;
+		}
+
+		m_loadedHash = dataHash;
+	}
+
+	Ref<PipelineCache> PipelineCache::Create(VkDevice device, Ref<PhysicalGraphicsDevice> physicalDevice, const std::filesystem::path& path)
+	{
+		return CreateRef<PipelineCache>(device, physicalDevice, path);
+	}
+
+	bool PipelineCache::ReadValidatedData(std::vector<uint8_t>& outData, uint64_t& outHash) const
+	{
+		std::ifstream file(m_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		FileHeader header{};
+		file.read((char*)&header, sizeof(FileHeader));
+
+		if (!file.good() || header.magic != s_magic || header.version != s_version)
+		{
+			return false;
+		}
+
+		// A truncated or damaged header must not decide how much is allocated and read
+		std::error_code error;
+		const uint64_t fileSize = (uint64_t)std::filesystem::file_size(m_path, error);
+		if (error || fileSize < sizeof(FileHeader) || header.dataSize > fileSize - sizeof(FileHeader))
+		{
+			LP_CORE_ERROR("Pipeline cache {0} is truncated, ignoring it!", m_path.string().c_str());
+			return false;
+		}
+
+		outData.resize(header.dataSize);
+		file.read((char*)outData.data(), header.dataSize);
+
+		if (!file.good() || Utility::HashPipelineCacheData(outData) != header.dataHash)
+		{
+			LP_CORE_ERROR("Pipeline cache {0} is corrupt, ignoring it!", m_path.string().c_str());
+			return false;
+		}
+
+		if (!IsCompatible(header, outData))
+		{
+			LP_CORE_INFO("Pipeline cache {0} was written by a different device or driver, ignoring it", m_path.string().c_str());
+			return false;
+		}
+
+		outHash = header.dataHash;
+		return true;
+	}
+
+	const bool PipelineCache::IsCompatible(const FileHeader& header, const std::vector<uint8_t>& data) const
+	{
+		if (header.vendorID != m_deviceProperties.vendorID || header.deviceID != m_deviceProperties.deviceID || header.driverVersion != m_deviceProperties.driverVersion ||
+			memcmp(header.pipelineCacheUUID, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+		{
+			return false;
+		}
+
+		// Some drivers do not validate the data they are given, check the Vulkan header as well
+		if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne))
+		{
+			return false;
+		}
+
+		VkPipelineCacheHeaderVersionOne vulkanHeader{};
+		memcpy_s(&vulkanHeader, sizeof(VkPipelineCacheHeaderVersionOne), data.data(), sizeof(VkPipelineCacheHeaderVersionOne));
+
+		return vulkanHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			vulkanHeader.vendorID == m_deviceProperties.vendorID &&
+			vulkanHeader.deviceID == m_deviceProperties.deviceID &&
+			memcmp(vulkanHeader.pipelineCacheUUID, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <vulkan/vulkan.h>
+
+#include <filesystem>
+#include <vector>
+
+namespace Lamp
+{
+	class PhysicalGraphicsDevice;
+
+	// VkPipelineCache persisted between runs. The file is only used if it was written by the same device and driver.
+	class PipelineCache
+	{
+	public:
+		PipelineCache(VkDevice device, Ref<PhysicalGraphicsDevice> physicalDevice, const std::filesystem::path& path);
+		~PipelineCache();
+
+		// Merges with whatever was written to disk since loading and writes the result back
+		void Save();
+
+		inline VkPipelineCache GetHandle() const { return m_pipelineCache; }
+
+		static Ref<PipelineCache> Create(VkDevice device, Ref<PhysicalGraphicsDevice> physicalDevice, const std::filesystem::path& path);
+
+	private:
+		struct FileHeader
+		{
+			uint32_t magic = 0;
+			uint32_t version = 0;
+
+			uint32_t vendorID = 0;
+			uint32_t deviceID = 0;
+			uint32_t driverVersion = 0;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE]{};
+
+			uint64_t dataSize = 0;
+			uint64_t dataHash = 0;
+		};
+
+		bool ReadValidatedData(std::vector<uint8_t>& outData, uint64_t& outHash) const;
+		const bool IsCompatible(const FileHeader& header, const std::vector<uint8_t>& data) const;
+
+		VkDevice m_device = nullptr;
+		VkPipelineCache m_pipelineCache = nullptr;
+		VkPhysicalDeviceProperties m_deviceProperties{};
+
+		std::filesystem::path m_path;
+		uint64_t m_loadedHash = 0;
+
+		inline static constexpr uint32_t s_magic = 0x4350504c; // LPPC
+		inline static constexpr uint32_t s_version = 1;
+	};
+}
@@ -6,18 +6,37 @@
 
 #include "Lamp/Log/Log.h"
 
+#include <array>
+#include <atomic>
+#include <mutex>
+
 namespace Lamp
 {
 	struct VulkanAllocatorData
 	{
+		struct TagCounters
+		{
+			std::atomic<uint64_t> liveBytes = 0;
+			std::atomic<uint64_t> peakBytes = 0;
+			std::atomic<uint64_t> liveAllocations = 0;
+			std::atomic<uint64_t> totalAllocations = 0;
+			std::atomic<uint64_t> budget = 0;
+		};
+
 		VmaAllocator allocator;
-		uint64_t totalFreedBytes = 0;
-		uint64_t totalAllocatedBytes = 0;
+		std::atomic<uint64_t> totalFreedBytes = 0;
+		std::atomic<uint64_t> totalAllocatedBytes = 0;
+
+		std::array<TagCounters, (size_t)MemoryTag::Count> tagCounters;
+
+		std::mutex callbackMutex;
+		std::vector<std::pair<uint32_t, VulkanAllocator::BudgetCallback>> budgetCallbacks;
+		uint32_t nextCallbackId = 0;
 	};
 
 	static VulkanAllocatorData* s_allocatorData = nullptr;
 
-	VulkanAllocator::VulkanAllocator(const std::string& tag)
+	VulkanAllocator::VulkanAllocator(MemoryTag tag)
 		: m_tag(tag)
 	{
 	}
@@ -27,35 +46,34 @@ namespace Lamp
 #ifdef LP_ENABLE_DEBUG_ALLOCATIONS
 		if (m_allocatedBytes != 0 || m_freedBytes != 0)
 		{
-			if (m_tag.empty()) [[likely]]
+			if (m_tag == MemoryTag::Untagged) [[likely]]
 			{
 				LP_CORE_INFO("Anonymous VulkanAllocator {0} {1} bytes!", m_allocatedBytes == 0 ? "freed" : "allocated", m_allocatedBytes == 0 ? m_freedBytes : m_allocatedBytes);
 			}
 			else
 			{
-				LP_CORE_INFO("VulkanAllocator {0} {1} {2} bytes!", m_tag.c_str(), m_allocatedBytes == 0 ? "freed" : "allocated", m_allocatedBytes == 0 ? m_freedBytes : m_allocatedBytes);
+				LP_CORE_INFO("VulkanAllocator {0} {1} {2} bytes!", Utility::MemoryTagToString(m_tag), m_allocatedBytes == 0 ? "freed" : "allocated", m_allocatedBytes == 0 ? m_freedBytes : m_allocatedBytes);
 			}
 		}
 #endif
 	}
 
 	VmaAllocation VulkanAllocator::AllocateBuffer(VkBufferCreateInfo bufferCreateInfo, VmaMemoryUsage memoryUsage, VkBuffer& outBuffer)
+	{
+		return AllocateBuffer(bufferCreateInfo, memoryUsage, 0, outBuffer);
+	}
+
+	VmaAllocation VulkanAllocator::AllocateBuffer(VkBufferCreateInfo bufferCreateInfo, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags, VkBuffer& outBuffer)
 	{
 		VmaAllocationCreateInfo allocCreateInfo{};
 		allocCreateInfo.usage = memoryUsage;
+		allocCreateInfo.flags = flags;
+		allocCreateInfo.pUserData = reinterpret_cast<void*>((uintptr_t)m_tag);
 
 		VmaAllocation allocation;
 		vmaCreateBuffer(s_allocatorData->allocator, &bufferCreateInfo, &allocCreateInfo, &outBuffer, &allocation, nullptr);
 
-		VmaAllocationInfo allocInfo{};
-		vmaGetAllocationInfo(s_allocatorData->allocator, allocation, &allocInfo);
-
-		s_allocatorData->totalAllocatedBytes += allocInfo.size;
-
-#ifdef LP_ENABLE_DEBUG_ALLOCATIONS
-		m_allocatedBytes += (uint64_t)allocInfo.size;
-#endif
-
+		OnAllocated(allocation);
 		return allocation;
 	}
 
@@ -63,33 +81,38 @@ namespace Lamp
 	{
 		VmaAllocationCreateInfo allocCreateInfo{};
 		allocCreateInfo.usage = memoryUsage;
+		allocCreateInfo.pUserData = reinterpret_cast<void*>((uintptr_t)m_tag);
 
 		VmaAllocation allocation;
 		vmaCreateImage(s_allocatorData->allocator, &bufferCreateInfo, &allocCreateInfo, &outImage, &allocation, nullptr);
 
-		VmaAllocationInfo allocInfo{};
-		vmaGetAllocationInfo(s_allocatorData->allocator, allocation, &allocInfo);
+		OnAllocated(allocation);
+		return allocation;
+	}
 
-		s_allocatorData->totalAllocatedBytes += allocInfo.size;
+	VmaAllocation VulkanAllocator::AllocateMemory(const VkMemoryRequirements& requirements, VmaMemoryUsage memoryUsage)
+	{
+		VmaAllocationCreateInfo allocCreateInfo{};
+		allocCreateInfo.usage = memoryUsage;
+		allocCreateInfo.pUserData = reinterpret_cast<void*>((uintptr_t)m_tag);
 
-#ifdef LP_ENABLE_DEBUG_ALLOCATIONS
-		m_allocatedBytes += (uint64_t)allocInfo.size;
-#endif
+		VmaAllocation allocation;
+		LP_VK_CHECK(vmaAllocateMemory(s_allocatorData->allocator, &requirements, &allocCreateInfo, &allocation, nullptr));
 
+		OnAllocated(allocation);
 		return allocation;
 	}
 
+	void VulkanAllocator::BindImageMemory(VmaAllocation allocation, VkImage image)
+	{
+		LP_VK_CHECK(vmaBindImageMemory(s_allocatorData->allocator, allocation, image));
+	}
+
 	void VulkanAllocator::Free(VmaAllocation allocation)
 	{
 		LP_CORE_ASSERT(allocation, "Unable to free null allocation!");
 
-		VmaAllocationInfo allocInfo{};
-		vmaGetAllocationInfo(s_allocatorData->allocator, allocation, &allocInfo);
-		s_allocatorData->totalFreedBytes += allocInfo.size;
-
-#ifdef LP_ENABLE_DEBUG_ALLOCATIONS
-		m_freedBytes += (uint64_t)allocInfo.size;
-#endif
+		OnFreed(allocation);
 		vmaFreeMemory(s_allocatorData->allocator, allocation);
 	}
 
@@ -98,14 +121,7 @@ namespace Lamp
 		LP_CORE_ASSERT(buffer, "Unable to destroy null buffer!");
 		LP_CORE_ASSERT(allocation, "Unable to free null allocation!");
 
-		VmaAllocationInfo allocInfo{};
-		vmaGetAllocationInfo(s_allocatorData->allocator, allocation, &allocInfo);
-		s_allocatorData->totalFreedBytes += allocInfo.size;
-
-#ifdef LP_ENABLE_DEBUG_ALLOCATIONS
-		m_freedBytes += (uint64_t)allocInfo.size;
-#endif
-
+		OnFreed(allocation);
 		vmaDestroyBuffer(s_allocatorData->allocator, buffer, allocation);
 	}
 
@@ -114,14 +130,7 @@ namespace Lamp
 		LP_CORE_ASSERT(image, "Unable to destroy null image!");
 		LP_CORE_ASSERT(allocation, "Unable to free null allocation!");
 
-		VmaAllocationInfo allocInfo{};
-		vmaGetAllocationInfo(s_allocatorData->allocator, allocation, &allocInfo);
-		s_allocatorData->totalFreedBytes += allocInfo.size;
-
-#ifdef LP_ENABLE_DEBUG_ALLOCATIONS
-		m_freedBytes += (uint64_t)allocInfo.size;
-#endif
-
+		OnFreed(allocation);
 		vmaDestroyImage(s_allocatorData->allocator, image, allocation);
 	}
 
@@ -130,6 +139,14 @@ namespace Lamp
 		vmaUnmapMemory(s_allocatorData->allocator, allocation);
 	}
 
+	void* VulkanAllocator::GetMappedData(VmaAllocation allocation)
+	{
+		VmaAllocationInfo allocInfo{};
+		vmaGetAllocationInfo(s_allocatorData->allocator, allocation, &allocInfo);
+
+		return allocInfo.pMappedData;
+	}
+
 	void VulkanAllocator::Initialize(Ref<GraphicsDevice> graphicsDevice)
 	{
 		s_allocatorData = new VulkanAllocatorData();
@@ -140,6 +157,12 @@ namespace Lamp
 		info.device = graphicsDevice->GetHandle();
 		info.instance = GraphicsContext::Get().GetInstance();
 
+		// Without the extension VMA estimates the budget from the heap sizes
+		if (graphicsDevice->GetPhysicalDevice()->GetCapabilities().supportsMemoryBudget)
+		{
+			info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+		}
+
 		LP_VK_CHECK(vmaCreateAllocator(&info, &s_allocatorData->allocator));
 	}
 
@@ -148,6 +171,15 @@ namespace Lamp
 		LP_CORE_ASSERT(s_allocatorData->totalAllocatedBytes == s_allocatorData->totalFreedBytes, "Some data has not been freed! This will cause a memory leak!");
 		LP_CORE_ASSERT(s_allocatorData->allocator, "Unable to delete allocator as it does not exist!");
 
+		for (uint32_t i = 0; i < (uint32_t)MemoryTag::Count; i++)
+		{
+			const auto& counters = s_allocatorData->tagCounters[i];
+			if (counters.totalAllocations > 0)
+			{
+				LP_CORE_INFO("VulkanAllocator {0}: peak {1} bytes over {2} allocations, {3} bytes still live", Utility::MemoryTagToString((MemoryTag)i), counters.peakBytes.load(), counters.totalAllocations.load(), counters.liveBytes.load());
+			}
+		}
+
 		vmaDestroyAllocator(s_allocatorData->allocator);
 		s_allocatorData->allocator = nullptr;
 
@@ -157,8 +189,168 @@ namespace Lamp
 		s_allocatorData = nullptr;
 	}
 
+	void VulkanAllocator::UpdateBudgets(uint32_t frameIndex)
+	{
+		LP_PROFILE_FUNCTION();
+
+		vmaSetCurrentFrameIndex(s_allocatorData->allocator, frameIndex);
+
+		std::vector<MemoryBudgetEvent> events;
+
+		const auto heapBudgets = GetHeapBudgets();
+		for (uint32_t i = 0; i < (uint32_t)heapBudgets.size(); i++)
+		{
+			if (heapBudgets[i].budget > 0 && heapBudgets[i].usage > heapBudgets[i].budget)
+			{
+				MemoryBudgetEvent& event = events.emplace_back();
+				event.type = MemoryBudgetEvent::Type::Heap;
+				event.heapIndex = i;
+				event.usage = heapBudgets[i].usage;
+				event.budget = heapBudgets[i].budget;
+			}
+		}
+
+		for (uint32_t i = 0; i < (uint32_t)MemoryTag::Count; i++)
+		{
+			const auto& counters = s_allocatorData->tagCounters[i];
+
+			const uint64_t budget = counters.budget.load(std::memory_order_relaxed);
+			const uint64_t liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+
+			if (budget > 0 && liveBytes > budget)
+			{
+				MemoryBudgetEvent& event = events.emplace_back();
+				event.type = MemoryBudgetEvent::Type::Tag;
+				event.tag = (MemoryTag)i;
+				event.usage = liveBytes;
+				event.budget = budget;
+			}
+		}
+
+		if (events.empty()) [[likely]]
+		{
+			return;
+		}
+
+		// Copied so callbacks are free to evict, and thereby free, without holding the lock
+		std::vector<BudgetCallback> callbacks;
+		{
+			std::scoped_lock lock(s_allocatorData->callbackMutex);
+			for (const auto& [id, callback] : s_allocatorData->budgetCallbacks)
+			{
+				callbacks.emplace_back(callback);
+			}
+		}
+
+		for (const auto& event : events)
+		{
+			for (const auto& callback : callbacks)
+			{
+				callback(event);
+			}
+		}
+	}
+
+	void VulkanAllocator::SetTagBudget(MemoryTag tag, uint64_t budget)
+	{
+		s_allocatorData->tagCounters[(size_t)tag].budget = budget;
+	}
+
+	uint32_t VulkanAllocator::AddBudgetCallback(BudgetCallback&& callback)
+	{
+		std::scoped_lock lock(s_allocatorData->callbackMutex);
+
+		const uint32_t id = s_allocatorData->nextCallbackId++;
+		s_allocatorData->budgetCallbacks.emplace_back(id, std::move(callback));
+
+		return id;
+	}
+
+	void VulkanAllocator::RemoveBudgetCallback(uint32_t id)
+	{
+		std::scoped_lock lock(s_allocatorData->callbackMutex);
+
+		auto& callbacks = s_allocatorData->budgetCallbacks;
+		callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(), [id](const auto& pair) { return pair.first == id; }), callbacks.end());
+	}
+
+	const MemoryTagStats VulkanAllocator::GetTagStats(MemoryTag tag)
+	{
+		const auto& counters = s_allocatorData->tagCounters[(size_t)tag];
+
+		MemoryTagStats stats{};
+		stats.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+		stats.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+		stats.liveAllocations = counters.liveAllocations.load(std::memory_order_relaxed);
+		stats.totalAllocations = counters.totalAllocations.load(std::memory_order_relaxed);
+		stats.budget = counters.budget.load(std::memory_order_relaxed);
+
+		return stats;
+	}
+
+	const std::vector<MemoryHeapBudget> VulkanAllocator::GetHeapBudgets()
+	{
+		const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+		vmaGetMemoryProperties(s_allocatorData->allocator, &memoryProperties);
+
+		std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+		vmaGetHeapBudgets(s_allocatorData->allocator, budgets.data());
+
+		std::vector<MemoryHeapBudget> result(memoryProperties->memoryHeapCount);
+		for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++)
+		{
+			result[i].usage = budgets[i].usage;
+			result[i].budget = budgets[i].budget;
+			result[i].isDeviceLocal = memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+		}
+
+		return result;
+	}
+
 	VmaAllocator& VulkanAllocator::GetAllocator()
 	{
 		return s_allocatorData->allocator;
 	}
-}
\ No newline at end of file
+
+	void VulkanAllocator::OnAllocated(VmaAllocation allocation)
+	{
+		VmaAllocationInfo allocInfo{};
+		vmaGetAllocationInfo(s_allocatorData->allocator, allocation, &allocInfo);
+
+		s_allocatorData->totalAllocatedBytes += allocInfo.size;
+
+		auto& counters = s_allocatorData->tagCounters[(size_t)m_tag];
+		const uint64_t liveBytes = counters.liveBytes.fetch_add(allocInfo.size, std::memory_order_relaxed) + allocInfo.size;
+
+		counters.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+		counters.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+		while (liveBytes > peakBytes && !counters.peakBytes.compare_exchange_weak(peakBytes, liveBytes, std::memory_order_relaxed))
+		{
+		}
+
+#ifdef LP_ENABLE_DEBUG_ALLOCATIONS
+		m_allocatedBytes += (uint64_t)allocInfo.size;
+#endif
+	}
+
+	void VulkanAllocator::OnFreed(VmaAllocation allocation)
+	{
+		VmaAllocationInfo allocInfo{};
+		vmaGetAllocationInfo(s_allocatorData->allocator, allocation, &allocInfo);
+
+		s_allocatorData->totalFreedBytes += allocInfo.size;
+
+		// Attributed to the tag the allocation was made with, not the one freeing it
+		const MemoryTag tag = (MemoryTag)reinterpret_cast<uintptr_t>(allocInfo.pUserData);
+		auto& counters = s_allocatorData->tagCounters[(size_t)tag];
+
+		counters.liveBytes.fetch_sub(allocInfo.size, std::memory_order_relaxed);
+		counters.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+
+#ifdef LP_ENABLE_DEBUG_ALLOCATIONS
+		m_freedBytes += (uint64_t)allocInfo.size;
+#endif
+	}
+}
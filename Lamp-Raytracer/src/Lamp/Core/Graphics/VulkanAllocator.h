@@ -4,20 +4,79 @@
 
 #include <vma/VulkanMemoryAllocator.h>
 
+#include <functional>
+#include <vector>
+
 namespace Lamp
 {
 	class GraphicsDevice;
+
+	// Who owns an allocation. Stored in the VMA user data, so frees are attributed to the tag that allocated.
+	enum class MemoryTag : uint32_t
+	{
+		Untagged = 0,
+		Image2D,
+		Image2DStaging,
+		StagingBufferRing,
+		RenderGraph,
+		UploadStaging,
+		GPUCulling,
+		FrameCapture,
+		GBufferPass,
+
+		Count
+	};
+
+	struct MemoryTagStats
+	{
+		uint64_t liveBytes = 0;
+		uint64_t peakBytes = 0;
+		uint64_t liveAllocations = 0;
+		uint64_t totalAllocations = 0;
+		uint64_t budget = 0; // 0 means unlimited
+	};
+
+	struct MemoryHeapBudget
+	{
+		uint64_t usage = 0;
+		uint64_t budget = 0;
+		bool isDeviceLocal = false;
+	};
+
+	struct MemoryBudgetEvent
+	{
+		enum class Type
+		{
+			Heap,
+			Tag
+		};
+
+		Type type = Type::Heap;
+		uint32_t heapIndex = 0;
+		MemoryTag tag = MemoryTag::Untagged;
+
+		uint64_t usage = 0;
+		uint64_t budget = 0;
+	};
+
 	class VulkanAllocator
 	{
 	public:
+		using BudgetCallback = std::function<void(const MemoryBudgetEvent&)>;
+
 		VulkanAllocator() = default;
-		VulkanAllocator(const std::string& tag);
+		VulkanAllocator(MemoryTag tag);
 
 		~VulkanAllocator();
-		
+
 		VmaAllocation AllocateBuffer(VkBufferCreateInfo bufferCreateInfo, VmaMemoryUsage memoryUsage, VkBuffer& outBuffer);
+		VmaAllocation AllocateBuffer(VkBufferCreateInfo bufferCreateInfo, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags, VkBuffer& outBuffer);
 		VmaAllocation AllocateImage(VkImageCreateInfo bufferCreateInfo, VmaMemoryUsage memoryUsage, VkImage& outImage);
-	
+
+		// Raw memory that several resources can be bound to, used for aliasing
+		VmaAllocation AllocateMemory(const VkMemoryRequirements& requirements, VmaMemoryUsage memoryUsage);
+		void BindImageMemory(VmaAllocation allocation, VkImage image);
+
 		void Free(VmaAllocation allocation);
 		void DestroyBuffer(VkBuffer buffer, VmaAllocation allocation);
 		void DestroyImage(VkImage image, VmaAllocation allocation);
@@ -29,19 +88,54 @@ namespace Lamp
 			vmaMapMemory(VulkanAllocator::GetAllocator(), allocation, (void**)&data);
 			return data;
 		}
-		
+
 		void UnmapMemory(VmaAllocation allocation);
+		void* GetMappedData(VmaAllocation allocation);
 
 		static void Initialize(Ref<GraphicsDevice> graphicsDevice);
 		static void Shutdown();
 
+		// Queries the heap budgets and runs the budget callbacks for every heap or tag that is over budget. Call once per frame.
+		static void UpdateBudgets(uint32_t frameIndex);
+
+		static void SetTagBudget(MemoryTag tag, uint64_t budget);
+		static uint32_t AddBudgetCallback(BudgetCallback&& callback);
+		static void RemoveBudgetCallback(uint32_t id);
+
+		static const MemoryTagStats GetTagStats(MemoryTag tag);
+		static const std::vector<MemoryHeapBudget> GetHeapBudgets();
+
 		static VmaAllocator& GetAllocator();
+
 	private:
-		
+		void OnAllocated(VmaAllocation allocation);
+		void OnFreed(VmaAllocation allocation);
+
 	#ifdef LP_ENABLE_DEBUG_ALLOCATIONS
 		uint64_t m_allocatedBytes = 0;
 		uint64_t m_freedBytes = 0;
 	#endif
-		std::string m_tag;
+		MemoryTag m_tag = MemoryTag::Untagged;
 	};
-}
\ No newline at end of file
+
+	namespace Utility
+	{
+		inline const char* MemoryTagToString(MemoryTag tag)
+		{
+			switch (tag)
+			{
+				case MemoryTag::Untagged: return "Untagged";
+				case MemoryTag::Image2D: return "Image2D";
+				case MemoryTag::Image2DStaging: return "Image2D Staging";
+				case MemoryTag::StagingBufferRing: return "StagingBufferRing";
+				case MemoryTag::RenderGraph: return "RenderGraph";
+				case MemoryTag::UploadStaging: return "Upload Staging";
+				case MemoryTag::GPUCulling: return "GPU Culling";
+				case MemoryTag::FrameCapture: return "Frame Capture";
+				case MemoryTag::GBufferPass: return "GBuffer Pass";
+			}
+
+			return "Unknown";
+		}
+	}
+}
@@ -0,0 +1,282 @@
+#include "lppch.h"
+#include "JobSystem.h"
+
+#include "Lamp/Log/Log.h"
+
+namespace Lamp
+{
+	struct Job
+	{
+		std::function<void()> function;
+		JobCounter* counter = nullptr;
+	};
+
+	static thread_local int32_t s_workerIndex = -1;
+
+	void JobSystem::Initialize(uint32_t workerCount)
+	{
+		LP_CORE_ASSERT(!s_jobSystemData, "JobSystem has already been initialized!");
+
+		if (workerCount == 0)
+		{
+			workerCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+		}
+
+		s_jobSystemData = CreateScope<JobSystemData>();
+		s_jobSystemData->mainThreadId = std::this_thread::get_id();
+
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			s_jobSystemData->workerQueues.emplace_back(CreateScope<WorkStealingQueue>());
+		}
+
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			s_jobSystemData->workers.emplace_back(&JobSystem::WorkerLoop, i);
+		}
+
+		LP_CORE_INFO("JobSystem started with {0} workers", workerCount);
+	}
+
+	void JobSystem::Shutdown()
+	{
+		if (!s_jobSystemData)
+		{
+			return;
+		}
+
+		s_jobSystemData->running = false;
+		s_jobSystemData->pendingJobs.fetch_add(1);
+		s_jobSystemData->pendingJobs.notify_all();
+
+		for (auto& worker : s_jobSystemData->workers)
+		{
+			worker.join();
+		}
+
+		// Jobs left in the queues are run instead of dropped, so their counters reach zero and threads waiting on them can return.
+		// Finished jobs may enqueue their continuations, so this keeps going until nothing is left.
+		while (Job* job = FindJob())
+		{
+			Execute(job);
+		}
+
+		ExecuteMainThreadJobs();
+		s_jobSystemData = nullptr;
+	}
+
+	void JobSystem::Schedule(std::function<void()>&& function, JobCounter* counter, JobCounter* dependency)
+	{
+		if (!s_jobSystemData) [[unlikely]]
+		{
+			if (dependency)
+			{
+				Wait(*dependency);
+			}
+
+			function();
+			return;
+		}
+
+		if (counter)
+		{
+			counter->m_value.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Job* job = new Job{ std::move(function), counter };
+
+		if (dependency)
+		{
+			std::scoped_lock lock(dependency->m_mutex);
+			if (!dependency->IsDone())
+			{
+				dependency->m_continuations.emplace_back(job);
+				return;
+			}
+		}
+
+		Enqueue(job);
+	}
+
+	void JobSystem::ScheduleOnMainThread(std::function<void()>&& function)
+	{
+		if (!s_jobSystemData) [[unlikely]]
+		{
+			function();
+			return;
+		}
+
+		s_jobSystemData->mainThreadQueue.Push(std::move(function));
+	}
+
+	void JobSystem::ExecuteMainThreadJobs()
+	{
+		LP_PROFILE_FUNCTION();
+		LP_CORE_ASSERT(IsMainThread(), "Main thread jobs executed from another thread!");
+
+		std::function<void()> function;
+		while (s_jobSystemData->mainThreadQueue.TryPop(function))
+		{
+			function();
+		}
+	}
+
+	void JobSystem::Wait(JobCounter& counter)
+	{
+		LP_PROFILE_FUNCTION();
+
+		while (!counter.IsDone())
+		{
+			if (!s_jobSystemData)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			if (Job* job = FindJob())
+			{
+				Execute(job);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		// The finishing job may still hold the lock, make sure it is done with the counter before it can be destroyed
+		std::scoped_lock lock(counter.m_mutex);
+	}
+
+	void JobSystem::ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& function)
+	{
+		LP_PROFILE_FUNCTION();
+
+		batchSize = std::max(batchSize, 1u);
+
+		JobCounter counter;
+		for (uint32_t begin = 0; begin < count; begin += batchSize)
+		{
+			const uint32_t end = std::min(begin + batchSize, count);
+			Schedule([&function, begin, end]() { function(begin, end); }, &counter);
+		}
+
+		Wait(counter);
+	}
+
+	const uint32_t JobSystem::GetWorkerCount()
+	{
+		return s_jobSystemData ? (uint32_t)s_jobSystemData->workers.size() : 0;
+	}
+
+	const int32_t JobSystem::GetWorkerIndex()
+	{
+		return s_workerIndex;
+	}
+
+	const bool JobSystem::IsMainThread()
+	{
+		return s_jobSystemData && s_jobSystemData->mainThreadId == std::this_thread::get_id();
+	}
+
+	void JobSystem::WorkerLoop(uint32_t workerIndex)
+	{
+		LP_PROFILE_THREAD("Job Worker");
+
+		s_workerIndex = (int32_t)workerIndex;
+
+		while (s_jobSystemData->running.load(std::memory_order_acquire))
+		{
+			if (Job* job = FindJob())
+			{
+				Execute(job);
+				continue;
+			}
+
+			// Sleep while nothing is queued, spin politely while a job is queued but not yet visible to this worker
+			if (s_jobSystemData->pendingJobs.load(std::memory_order_acquire) == 0)
+			{
+				s_jobSystemData->pendingJobs.wait(0, std::memory_order_acquire);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		s_workerIndex = -1;
+	}
+
+	void JobSystem::Enqueue(Job* job)
+	{
+		s_jobSystemData->pendingJobs.fetch_add(1, std::memory_order_release);
+
+		if (s_workerIndex < 0 || !s_jobSystemData->workerQueues[s_workerIndex]->Push(job))
+		{
+			s_jobSystemData->globalQueue.Push(job);
+		}
+
+		s_jobSystemData->pendingJobs.notify_one();
+	}
+
+	Job* JobSystem::FindJob()
+	{
+		Job* job = nullptr;
+
+		if (s_workerIndex >= 0)
+		{
+			job = s_jobSystemData->workerQueues[s_workerIndex]->Pop();
+		}
+
+		if (!job)
+		{
+			s_jobSystemData->globalQueue.TryPop(job);
+		}
+
+		if (!job)
+		{
+			const uint32_t queueCount = (uint32_t)s_jobSystemData->workerQueues.size();
+			const uint32_t startIndex = s_workerIndex >= 0 ? (uint32_t)s_workerIndex + 1 : 0;
+
+			for (uint32_t i = 0; i < queueCount && !job; i++)
+			{
+				const uint32_t victim = (startIndex + i) % queueCount;
+				if ((int32_t)victim != s_workerIndex)
+				{
+					job = s_jobSystemData->workerQueues[victim]->Steal();
+				}
+			}
+		}
+
+		if (job)
+		{
+			s_jobSystemData->pendingJobs.fetch_sub(1, std::memory_order_acq_rel);
+		}
+
+		return job;
+	}
+
+	void JobSystem::Execute(Job* job)
+	{
+		job->function();
+
+		if (JobCounter* counter = job->counter)
+		{
+			std::vector<Job*> continuations;
+
+			{
+				std::scoped_lock lock(counter->m_mutex);
+				if (counter->m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					continuations.swap(counter->m_continuations);
+				}
+			}
+
+			for (Job* continuation : continuations)
+			{
+				Enqueue(continuation);
+			}
+		}
+
+		delete job;
+	}
+}
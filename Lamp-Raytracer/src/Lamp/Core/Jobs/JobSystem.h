@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+#include "Lamp/Core/Jobs/WorkStealingQueue.h"
+
+#include "Lamp/Utility/ThreadSafeQueue.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Lamp
+{
+	struct Job;
+
+	// Counts outstanding jobs. Jobs can be scheduled to run once a counter reaches zero.
+	class JobCounter
+	{
+	public:
+		JobCounter() = default;
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		inline const bool IsDone() const { return m_value.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<uint32_t> m_value = 0;
+		std::mutex m_mutex;
+		std::vector<Job*> m_continuations;
+	};
+
+	class JobSystem
+	{
+	public:
+		static void Initialize(uint32_t workerCount = 0);
+		static void Shutdown();
+
+		// Counter is incremented now and decremented when the job has finished.
+		// If dependency is set the job is not started before the dependency counter reaches zero.
+		static void Schedule(std::function<void()>&& function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+		static void ScheduleOnMainThread(std::function<void()>&& function);
+		static void ExecuteMainThreadJobs();
+
+		// Runs other jobs while waiting. Waiting is required before a counter goes out of scope.
+		static void Wait(JobCounter& counter);
+		static void ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+		static const uint32_t GetWorkerCount();
+		// -1 on threads that aren't workers
+		static const int32_t GetWorkerIndex();
+		static const bool IsMainThread();
+
+	private:
+		JobSystem() = delete;
+
+		static void WorkerLoop(uint32_t workerIndex);
+		static void Enqueue(Job* job);
+		static Job* FindJob();
+		static void Execute(Job* job);
+
+		struct JobSystemData
+		{
+			std::vector<Scope<WorkStealingQueue>> workerQueues;
+			std::vector<std::thread> workers;
+
+			ThreadSafeQueue<Job*> globalQueue;
+			ThreadSafeQueue<std::function<void()>> mainThreadQueue;
+
+			std::atomic<uint32_t> pendingJobs = 0;
+			std::atomic<bool> running = true;
+
+			std::thread::id mainThreadId;
+		};
+
+		inline static Scope<JobSystemData> s_jobSystemData;
+	};
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+namespace Lamp
+{
+	struct Job;
+
+	// Fixed size Chase-Lev deque. The owning worker pushes and pops at the bottom, other workers steal from the top.
+	class WorkStealingQueue
+	{
+	public:
+		bool Push(Job* job)
+		{
+			const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+			const int64_t top = m_top.load(std::memory_order_acquire);
+
+			if (bottom - top >= (int64_t)s_capacity)
+			{
+				return false;
+			}
+
+			m_jobs[bottom & s_mask].store(job, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+
+			return true;
+		}
+
+		Job* Pop()
+		{
+			const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+			m_bottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			int64_t top = m_top.load(std::memory_order_relaxed);
+			if (top > bottom)
+			{
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			Job* job = m_jobs[bottom & s_mask].load(std::memory_order_relaxed);
+			if (top == bottom)
+			{
+				// Last job, race against stealers for it
+				if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					job = nullptr;
+				}
+
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+
+			return job;
+		}
+
+		Job* Steal()
+		{
+			int64_t top = m_top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+			if (top >= bottom)
+			{
+				return nullptr;
+			}
+
+			Job* job = m_jobs[top & s_mask].load(std::memory_order_relaxed);
+			if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				return nullptr;
+			}
+
+			return job;
+		}
+
+	private:
+		inline static constexpr uint32_t s_capacity = 4096;
+		inline static constexpr int64_t s_mask = s_capacity - 1;
+
+		alignas(64) std::atomic<int64_t> m_top = 0;
+		alignas(64) std::atomic<int64_t> m_bottom = 0;
+		std::array<std::atomic<Job*>, s_capacity> m_jobs{};
+	};
+}
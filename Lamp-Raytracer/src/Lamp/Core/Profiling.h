@@ -8,7 +8,10 @@
 #define LP_PROFILE_TAG(NAME, ...) OPTICK_TAG(NAME, __VA_ARGS__)
 #define LP_PROFILE_SCOPE(NAME) OPTICK_EVENT_DYNAMIC(NAME)
 #define LP_PROFILE_THREAD(...) OPTICK_THREAD(__VA_ARGS__)
-#define LP_PROFILE_GPU_EVENT(...) //OPTICK_GPU_EVENT(__VA_ARGS__)
+// Needs Lamp/Rendering/GPUProfiler.h, NAME has to outlive the frame
+#define LP_PROFILE_GPU_CONCAT_INNER(a, b) a##b
+#define LP_PROFILE_GPU_CONCAT(a, b) LP_PROFILE_GPU_CONCAT_INNER(a, b)
+#define LP_PROFILE_GPU_EVENT(COMMAND_BUFFER, NAME) ::Lamp::GPUProfileScope LP_PROFILE_GPU_CONCAT(gpuScope, __LINE__)(COMMAND_BUFFER, NAME)
 #else
 #define LP_PROFILE_FRAME(...)
 #define LP_PROFILE_FUNCTION(...)
@@ -1,5 +1,6 @@
 #include "lppch.h"
 #include "ImGuiImplementation.h"
+#include "ImGuiTextureCache.h"
 
 #include "Lamp/Core/Graphics/GraphicsDevice.h"
 #include "Lamp/Core/Graphics/GraphicsContext.h"
@@ -8,6 +9,7 @@
 #include "Lamp/Core/Window.h"
 
 #include "Lamp/Log/Log.h"
+#include "Lamp/Rendering/GPUProfiler.h"
 #include "Lamp/Utility/FileSystem.h"
 
 #include <backends/imgui_impl_glfw.h>
@@ -173,6 +175,7 @@ namespace Lamp
 		poolInfo.pPoolSizes = poolSizes;
 
 		LP_VK_CHECK(vkCreateDescriptorPool(device->GetHandle(), &poolInfo, nullptr, &m_descriptorPool));
+		ImGuiTextureCache::Initialize(m_descriptorPool);
 
 		Application& app = Application::Get();
 		GLFWwindow* pWindow = static_cast<GLFWwindow*>(app.GetWindow()->GetNativeWindow());
@@ -212,6 +215,7 @@ namespace Lamp
 	ImGuiImplementation::~ImGuiImplementation()
 	{
 		vkDeviceWaitIdle(GraphicsContext::GetDevice()->GetHandle());
+		ImGuiTextureCache::Shutdown();
 		vkDestroyDescriptorPool(GraphicsContext::GetDevice()->GetHandle(), m_descriptorPool, nullptr);
 		ImGui_ImplVulkan_Shutdown();
 	}
@@ -251,6 +255,9 @@ namespace Lamp
 			LP_VK_CHECK(vkBeginCommandBuffer(drawCmdBuffer, &beginInfo));
 		}
 
+		// Written outside the render pass so the scope covers the clear as well as the draws
+		const uint32_t imguiScope = GPUProfiler::BeginScope(drawCmdBuffer, "ImGui");
+
 		// Begin render pass
 		{
 			VkClearValue clearValues[2];
@@ -318,6 +325,7 @@ namespace Lamp
 
 		vkCmdExecuteCommands(drawCmdBuffer, 1, &secondaryCmdBuffer);
 		vkCmdEndRenderPass(drawCmdBuffer);
+		GPUProfiler::EndScope(drawCmdBuffer, imguiScope);
 
 		LP_VK_CHECK(vkEndCommandBuffer(drawCmdBuffer));
 
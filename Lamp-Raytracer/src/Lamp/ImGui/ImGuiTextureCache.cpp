@@ -0,0 +1,82 @@
+#include "lppch.h"
+#include "ImGuiTextureCache.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+
+#include "Lamp/Rendering/Renderer.h"
+
+#include <backends/imgui_impl_vulkan.h>
+
+namespace Lamp
+{
+	void ImGuiTextureCache::Initialize(VkDescriptorPool descriptorPool)
+	{
+		std::scoped_lock lock(s_mutex);
+		s_descriptorPool = descriptorPool;
+	}
+
+	void ImGuiTextureCache::Shutdown()
+	{
+		// The sets are freed together with the pool
+		std::scoped_lock lock(s_mutex);
+
+		s_textures.clear();
+		s_textureCount = 0;
+		s_descriptorPool = nullptr;
+	}
+
+	VkDescriptorSet ImGuiTextureCache::Get(VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+	{
+		std::scoped_lock lock(s_mutex);
+
+		const TextureKey key{ sampler, layout };
+		auto& textures = s_textures[imageView];
+
+		for (const auto& texture : textures)
+		{
+			if (texture.key == key)
+			{
+				return texture.descriptorSet;
+			}
+		}
+
+		VkDescriptorSet descriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(sampler, imageView, layout);
+		textures.emplace_back(CachedTexture{ key, descriptorSet });
+		s_textureCount++;
+
+		return descriptorSet;
+	}
+
+	void ImGuiTextureCache::Invalidate(VkImageView imageView)
+	{
+		std::scoped_lock lock(s_mutex);
+
+		auto it = s_textures.find(imageView);
+		if (it == s_textures.end())
+		{
+			return;
+		}
+
+		std::vector<VkDescriptorSet> descriptorSets;
+		for (const auto& texture : it->second)
+		{
+			descriptorSets.emplace_back(texture.descriptorSet);
+		}
+
+		s_textureCount -= it->second.size();
+		s_textures.erase(it);
+
+		// Frames in flight may still sample through the sets
+		Renderer::SubmitResourceFree([descriptorSets, descriptorPool = s_descriptorPool]()
+			{
+				std::scoped_lock lock(s_mutex);
+				if (s_descriptorPool != descriptorPool)
+				{
+					return;
+				}
+
+				vkFreeDescriptorSets(GraphicsContext::GetDevice()->GetHandle(), descriptorPool, (uint32_t)descriptorSets.size(), descriptorSets.data());
+			});
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace Lamp
+{
+	// ImGui texture IDs are descriptor sets allocated from the ImGui pool. They are created once per
+	// image view, sampler and layout and freed when the view is released.
+	class ImGuiTextureCache
+	{
+	public:
+		static void Initialize(VkDescriptorPool descriptorPool);
+		static void Shutdown();
+
+		static VkDescriptorSet Get(VkImageView imageView, VkSampler sampler, VkImageLayout layout);
+		static void Invalidate(VkImageView imageView);
+
+		inline static const size_t GetAllocatedCount() { return s_textureCount; }
+
+	private:
+		ImGuiTextureCache() = delete;
+
+		struct TextureKey
+		{
+			VkSampler sampler = nullptr;
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			bool operator==(const TextureKey& other) const = default;
+		};
+
+		struct CachedTexture
+		{
+			TextureKey key;
+			VkDescriptorSet descriptorSet = nullptr;
+		};
+
+		inline static VkDescriptorPool s_descriptorPool = nullptr;
+		inline static std::unordered_map<VkImageView, std::vector<CachedTexture>> s_textures; // View -> Textures
+		inline static size_t s_textureCount = 0;
+		inline static std::mutex s_mutex;
+	};
+}
@@ -0,0 +1,245 @@
+#include "lppch.h"
+#include "BindlessRegistry.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+
+#include "Lamp/Rendering/Renderer.h"
+#include "Lamp/Rendering/Shader/Shader.h"
+
+namespace Lamp
+{
+	uint32_t BindlessRegistry::IndexAllocator::Allocate()
+	{
+		if (!freeIndices.empty())
+		{
+			const uint32_t index = freeIndices.back();
+			freeIndices.pop_back();
+
+			return index;
+		}
+
+		if (nextIndex >= capacity)
+		{
+			return InvalidIndex;
+		}
+
+		return nextIndex++;
+	}
+
+	void BindlessRegistry::IndexAllocator::Free(uint32_t index)
+	{
+		freeIndices.emplace_back(index);
+	}
+
+	void BindlessRegistry::Initialize()
+	{
+		auto device = GraphicsContext::GetDevice();
+		const auto& capabilities = device->GetPhysicalDevice()->GetCapabilities();
+
+		if (!capabilities.supportsBindless)
+		{
+			LP_CORE_ERROR("Bindless mode was requested but the device does not support descriptor indexing!");
+			return;
+		}
+
+		s_textureIndices = {};
+		s_textureIndices.capacity = std::min(s_maxTextures, capabilities.maxBindlessSampledImages);
+
+		s_storageBufferIndices = {};
+		s_storageBufferIndices.capacity = std::min(s_maxStorageBuffers, capabilities.maxBindlessStorageBuffers);
+
+		VkDescriptorPoolSize poolSizes[] =
+		{
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, s_textureIndices.capacity },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, s_storageBufferIndices.capacity }
+		};
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = (uint32_t)ARRAYSIZE(poolSizes);
+		poolInfo.pPoolSizes = poolSizes;
+
+		LP_VK_CHECK(vkCreateDescriptorPool(device->GetHandle(), &poolInfo, nullptr, &s_descriptorPool));
+
+		VkDescriptorSetLayoutBinding bindings[2]{};
+		bindings[0].binding = TextureBinding;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = s_textureIndices.capacity;
+		bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+
+		bindings[1].binding = StorageBufferBinding;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].descriptorCount = s_storageBufferIndices.capacity;
+		bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+		// Unused slots may hold stale or no descriptors, shaders only read slots they were given
+		const VkDescriptorBindingFlags bindingFlags[2] =
+		{
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+		};
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = (uint32_t)ARRAYSIZE(bindingFlags);
+		bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutInfo.bindingCount = (uint32_t)ARRAYSIZE(bindings);
+		layoutInfo.pBindings = bindings;
+
+		LP_VK_CHECK(vkCreateDescriptorSetLayout(device->GetHandle(), &layoutInfo, nullptr, &s_descriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = s_descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &s_descriptorSetLayout;
+
+		LP_VK_CHECK(vkAllocateDescriptorSets(device->GetHandle(), &allocInfo, &s_descriptorSet));
+
+		s_enabled = true;
+		LP_CORE_INFO("Bindless mode enabled with {0} textures and {1} storage buffers", s_textureIndices.capacity, s_storageBufferIndices.capacity);
+	}
+
+	void BindlessRegistry::Shutdown()
+	{
+		if (!s_enabled)
+		{
+			return;
+		}
+
+		auto device = GraphicsContext::GetDevice();
+
+		vkDestroyDescriptorSetLayout(device->GetHandle(), s_descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device->GetHandle(), s_descriptorPool, nullptr);
+
+		s_descriptorSetLayout = nullptr;
+		s_descriptorPool = nullptr;
+		s_descriptorSet = nullptr;
+
+		s_enabled = false;
+	}
+
+	uint32_t BindlessRegistry::RegisterImage(VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+	{
+		if (!s_enabled)
+		{
+			return InvalidIndex;
+		}
+
+		std::scoped_lock lock(s_mutex);
+
+		const uint32_t index = s_textureIndices.Allocate();
+		if (index == InvalidIndex)
+		{
+			LP_CORE_ERROR("Bindless texture array is full!");
+			return InvalidIndex;
+		}
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageView = imageView;
+		imageInfo.sampler = sampler;
+		imageInfo.imageLayout = layout;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = s_descriptorSet;
+		write.dstBinding = TextureBinding;
+		write.dstArrayElement = index;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(GraphicsContext::GetDevice()->GetHandle(), 1, &write, 0, nullptr);
+
+		return index;
+	}
+
+	uint32_t BindlessRegistry::RegisterStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		if (!s_enabled)
+		{
+			return InvalidIndex;
+		}
+
+		std::scoped_lock lock(s_mutex);
+
+		const uint32_t index = s_storageBufferIndices.Allocate();
+		if (index == InvalidIndex)
+		{
+			LP_CORE_ERROR("Bindless storage buffer array is full!");
+			return InvalidIndex;
+		}
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = buffer;
+		bufferInfo.offset = offset;
+		bufferInfo.range = range;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = s_descriptorSet;
+		write.dstBinding = StorageBufferBinding;
+		write.dstArrayElement = index;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets(GraphicsContext::GetDevice()->GetHandle(), 1, &write, 0, nullptr);
+
+		return index;
+	}
+
+	void BindlessRegistry::UnregisterImage(uint32_t index)
+	{
+		if (!s_enabled || index == InvalidIndex)
+		{
+			return;
+		}
+
+		Renderer::SubmitResourceFree([index]()
+			{
+				std::scoped_lock lock(s_mutex);
+				if (s_enabled)
+				{
+					s_textureIndices.Free(index);
+				}
+			});
+	}
+
+	void BindlessRegistry::UnregisterStorageBuffer(uint32_t index)
+	{
+		if (!s_enabled || index == InvalidIndex)
+		{
+			return;
+		}
+
+		Renderer::SubmitResourceFree([index]()
+			{
+				std::scoped_lock lock(s_mutex);
+				if (s_enabled)
+				{
+					s_storageBufferIndices.Free(index);
+				}
+			});
+	}
+
+	void BindlessRegistry::Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout)
+	{
+		if (!s_enabled)
+		{
+			return;
+		}
+
+		vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, (uint32_t)DescriptorSetType::Bindless, 1, &s_descriptorSet, 0, nullptr);
+	}
+}
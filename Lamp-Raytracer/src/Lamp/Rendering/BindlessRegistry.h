@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <vector>
+
+namespace Lamp
+{
+	// One update after bind descriptor set holding every registered sampled image and storage buffer.
+	// Shaders index into it with the indices handed out here, see BINDLESS_SET in Common.h.
+	class BindlessRegistry
+	{
+	public:
+		static void Initialize();
+		static void Shutdown();
+
+		static uint32_t RegisterImage(VkImageView imageView, VkSampler sampler, VkImageLayout layout);
+		static uint32_t RegisterStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+		// Indices are only reused once the frames in flight are done with them
+		static void UnregisterImage(uint32_t index);
+		static void UnregisterStorageBuffer(uint32_t index);
+
+		static void Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout);
+
+		inline static const bool IsEnabled() { return s_enabled; }
+		inline static VkDescriptorSetLayout GetDescriptorSetLayout() { return s_descriptorSetLayout; }
+		inline static VkDescriptorSet GetDescriptorSet() { return s_descriptorSet; }
+
+		inline static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+		inline static constexpr uint32_t TextureBinding = 0;
+		inline static constexpr uint32_t StorageBufferBinding = 1;
+
+	private:
+		BindlessRegistry() = delete;
+
+		struct IndexAllocator
+		{
+			uint32_t Allocate();
+			void Free(uint32_t index);
+
+			std::vector<uint32_t> freeIndices;
+			uint32_t nextIndex = 0;
+			uint32_t capacity = 0;
+		};
+
+		inline static constexpr uint32_t s_maxTextures = 16384;
+		inline static constexpr uint32_t s_maxStorageBuffers = 4096;
+
+		inline static bool s_enabled = false;
+
+		inline static VkDescriptorPool s_descriptorPool = nullptr;
+		inline static VkDescriptorSetLayout s_descriptorSetLayout = nullptr;
+		inline static VkDescriptorSet s_descriptorSet = nullptr;
+
+		inline static IndexAllocator s_textureIndices;
+		inline static IndexAllocator s_storageBufferIndices;
+
+		inline static std::mutex s_mutex;
+	};
+}
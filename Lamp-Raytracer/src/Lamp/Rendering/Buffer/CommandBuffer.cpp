@@ -102,9 +102,6 @@ namespace Lamp
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 		LP_VK_CHECK(vkBeginCommandBuffer(m_commandBuffers[index], &beginInfo));
-	
-		OPTICK_GPU_CONTEXT(m_commandBuffers[index]);
-		OPTICK_GPU_EVENT("Test");
 	}
 
 	void CommandBuffer::End()
@@ -116,18 +113,40 @@ namespace Lamp
 
 		if (!m_swapchainTarget)
 		{
+			VkTimelineSemaphoreSubmitInfo timelineInfo{};
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			timelineInfo.waitSemaphoreValueCount = (uint32_t)m_waitValues.size();
+			timelineInfo.pWaitSemaphoreValues = m_waitValues.data();
+
 			VkSubmitInfo submitInfo{};
 			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.pNext = m_waitSemaphores.empty() ? nullptr : &timelineInfo;
 			submitInfo.commandBufferCount = 1;
 			submitInfo.pCommandBuffers = &m_commandBuffers[index];
+			submitInfo.waitSemaphoreCount = (uint32_t)m_waitSemaphores.size();
+			submitInfo.pWaitSemaphores = m_waitSemaphores.data();
+			submitInfo.pWaitDstStageMask = m_waitStages.data();
 
 			vkResetFences(device->GetHandle(), 1, &m_submitFences[index]);
 			LP_VK_CHECK(vkQueueSubmit(device->GetGraphicsQueue(), 1, &submitInfo, m_submitFences[index]));
+
+			m_waitSemaphores.clear();
+			m_waitValues.clear();
+			m_waitStages.clear();
 		}
 
 		m_currentCommandPool = (m_currentCommandPool + 1) % m_count;
 	}
 
+	void CommandBuffer::AddTimelineWait(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages)
+	{
+		LP_CORE_ASSERT(!m_swapchainTarget, "Swapchain command buffers are submitted by the swapchain!");
+
+		m_waitSemaphores.emplace_back(semaphore);
+		m_waitValues.emplace_back(value);
+		m_waitStages.emplace_back(stages);
+	}
+
 	VkCommandBuffer CommandBuffer::GetCurrentCommandBuffer()
 	{
 		const uint32_t index = m_swapchainTarget ? Application::Get().GetWindow()->GetSwapchain().GetCurrentFrame() : m_currentCommandPool;
@@ -140,6 +159,12 @@ namespace Lamp
 		return index;
 	}
 
+	VkFence CommandBuffer::GetSubmitFence(uint32_t index)
+	{
+		LP_CORE_ASSERT(!m_swapchainTarget, "Swapchain command buffers are submitted by the swapchain!");
+		return m_submitFences[index];
+	}
+
 	Ref<CommandBuffer> CommandBuffer::Create(uint32_t count, bool swapchainTarget)
 	{
 		return CreateRef<CommandBuffer>(count, swapchainTarget);
@@ -15,8 +15,14 @@ namespace Lamp
 		void Begin();
 		void End();
 
+		// Waited on by the next submit, only supported when not targeting the swapchain
+		void AddTimelineWait(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages);
+
 		VkCommandBuffer GetCurrentCommandBuffer();
 		uint32_t GetCurrentIndex();
+
+		// Signaled once the last submit of the index is done, only available when not targeting the swapchain
+		VkFence GetSubmitFence(uint32_t index);
 		
 		static Ref<CommandBuffer> Create(uint32_t count, bool swapchainTarget = false);
 
@@ -25,6 +31,10 @@ namespace Lamp
 		std::vector<VkCommandBuffer> m_commandBuffers;
 		std::vector<VkFence> m_submitFences;
 
+		std::vector<VkSemaphore> m_waitSemaphores;
+		std::vector<uint64_t> m_waitValues;
+		std::vector<VkPipelineStageFlags> m_waitStages;
+
 		bool m_swapchainTarget = false;
 		uint32_t m_currentCommandPool = 0;
 		uint32_t m_count = 0;
@@ -0,0 +1,189 @@
+#include "lppch.h"
+#include "SecondaryCommandRecorder.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+#include "Lamp/Core/Jobs/JobSystem.h"
+
+#include "Lamp/Log/Log.h"
+
+namespace Lamp
+{
+	SecondaryCommandRecorder::SecondaryCommandRecorder(uint32_t count)
+		: m_count(count)
+	{
+		m_threadSlotCount = JobSystem::GetWorkerCount() + 1;
+
+		m_pools.resize(count);
+		for (uint32_t threadSlot = 0; threadSlot < m_threadSlotCount; threadSlot++)
+		{
+			const auto pools = CreatePools();
+			for (uint32_t index = 0; index < count; index++)
+			{
+				m_pools[index].emplace_back(pools[index]);
+			}
+		}
+	}
+
+	SecondaryCommandRecorder::~SecondaryCommandRecorder()
+	{
+		auto device = GraphicsContext::GetDevice();
+
+		for (auto& framePools : m_pools)
+		{
+			for (auto& pool : framePools)
+			{
+				vkDestroyCommandPool(device->GetHandle(), pool.commandPool, nullptr);
+			}
+		}
+
+		for (auto& [threadId, pools] : m_otherThreadPools)
+		{
+			for (auto& pool : pools)
+			{
+				vkDestroyCommandPool(device->GetHandle(), pool.commandPool, nullptr);
+			}
+		}
+
+		m_pools.clear();
+		m_otherThreadPools.clear();
+	}
+
+	void SecondaryCommandRecorder::Begin(uint32_t index)
+	{
+		LP_PROFILE_FUNCTION();
+
+		auto device = GraphicsContext::GetDevice();
+		m_currentIndex = index;
+
+		for (auto& pool : m_pools[index])
+		{
+			if (pool.usedCount > 0)
+			{
+				LP_VK_CHECK(vkResetCommandPool(device->GetHandle(), pool.commandPool, 0));
+				pool.usedCount = 0;
+			}
+		}
+
+		std::scoped_lock lock(m_otherThreadPoolsMutex);
+		for (auto& [threadId, pools] : m_otherThreadPools)
+		{
+			auto& pool = pools[index];
+			if (pool.usedCount > 0)
+			{
+				LP_VK_CHECK(vkResetCommandPool(device->GetHandle(), pool.commandPool, 0));
+				pool.usedCount = 0;
+			}
+		}
+	}
+
+	void SecondaryCommandRecorder::Record(VkCommandBuffer primaryCommandBuffer, uint32_t taskCount, const VkCommandBufferInheritanceInfo& inheritanceInfo, const RecordFunction& function)
+	{
+		LP_PROFILE_FUNCTION();
+		LP_CORE_ASSERT(JobSystem::IsMainThread(), "Secondary command buffers must be recorded from the main thread!");
+
+		if (taskCount == 0)
+		{
+			return;
+		}
+
+		m_recordedCommandBuffers.assign(taskCount, nullptr);
+
+		VkCommandBufferInheritanceInfo inheritance = inheritanceInfo;
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+		const bool insidePass = inheritance.renderPass != nullptr || inheritance.pNext != nullptr;
+
+		JobSystem::ParallelFor(taskCount, 1, [&](uint32_t begin, uint32_t end)
+			{
+				auto& pool = GetThreadPool();
+
+				for (uint32_t taskIndex = begin; taskIndex < end; taskIndex++)
+				{
+					VkCommandBuffer commandBuffer = GetCommandBuffer(pool);
+
+					VkCommandBufferBeginInfo beginInfo{};
+					beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+					beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | (insidePass ? VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : 0);
+					beginInfo.pInheritanceInfo = &inheritance;
+
+					LP_VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+					function(commandBuffer, taskIndex);
+					LP_VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+					m_recordedCommandBuffers[taskIndex] = commandBuffer;
+				}
+			});
+
+		// Task order, not completion order, so the result is the same every frame
+		vkCmdExecuteCommands(primaryCommandBuffer, taskCount, m_recordedCommandBuffers.data());
+	}
+
+	Ref<SecondaryCommandRecorder> SecondaryCommandRecorder::Create(uint32_t count)
+	{
+		return CreateRef<SecondaryCommandRecorder>(count);
+	}
+
+	std::vector<SecondaryCommandRecorder::ThreadPool> SecondaryCommandRecorder::CreatePools() const
+	{
+		auto device = GraphicsContext::GetDevice();
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = GraphicsContext::GetPhysicalDevice()->GetQueueIndices().graphicsQueueIndex;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		// One per frame in flight
+		std::vector<ThreadPool> pools(m_count);
+		for (auto& pool : pools)
+		{
+			LP_VK_CHECK(vkCreateCommandPool(device->GetHandle(), &poolInfo, nullptr, &pool.commandPool));
+		}
+
+		return pools;
+	}
+
+	VkCommandBuffer SecondaryCommandRecorder::GetCommandBuffer(ThreadPool& pool)
+	{
+		if (pool.usedCount == pool.commandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = pool.commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer = nullptr;
+			LP_VK_CHECK(vkAllocateCommandBuffers(GraphicsContext::GetDevice()->GetHandle(), &allocInfo, &commandBuffer));
+			pool.commandBuffers.emplace_back(commandBuffer);
+		}
+
+		return pool.commandBuffers[pool.usedCount++];
+	}
+
+	SecondaryCommandRecorder::ThreadPool& SecondaryCommandRecorder::GetThreadPool()
+	{
+		const int32_t workerIndex = JobSystem::GetWorkerIndex();
+		if (workerIndex >= 0)
+		{
+			LP_CORE_ASSERT((uint32_t)workerIndex + 1 < m_threadSlotCount, "Job system has more workers than when the recorder was created!");
+			return m_pools[m_currentIndex][workerIndex + 1];
+		}
+
+		if (JobSystem::IsMainThread())
+		{
+			return m_pools[m_currentIndex][0];
+		}
+
+		// Every other thread waiting in ParallelFor runs jobs too. Map nodes don't move, so the pool stays valid after unlocking.
+		std::scoped_lock lock(m_otherThreadPoolsMutex);
+
+		auto it = m_otherThreadPools.find(std::this_thread::get_id());
+		if (it == m_otherThreadPools.end())
+		{
+			it = m_otherThreadPools.emplace(std::this_thread::get_id(), CreatePools()).first;
+		}
+
+		return it->second[m_currentIndex];
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Lamp
+{
+	// Records secondary command buffers on the job workers. Every thread that runs tasks gets its own command pool per frame in flight,
+	// so recording needs no locks, and the secondaries are executed in task order regardless of which thread recorded them.
+	class SecondaryCommandRecorder
+	{
+	public:
+		using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t taskIndex)>;
+
+		SecondaryCommandRecorder(uint32_t count);
+		~SecondaryCommandRecorder();
+
+		// Resets the pools of the index, the GPU has to be done with the commands recorded the last time it was used
+		void Begin(uint32_t index);
+
+		// The primary has to be inside the render pass (or dynamic rendering) described by the inheritance info, begun with secondary contents.
+		// A null render pass and no pNext records the tasks outside of any pass.
+		void Record(VkCommandBuffer primaryCommandBuffer, uint32_t taskCount, const VkCommandBufferInheritanceInfo& inheritanceInfo, const RecordFunction& function);
+
+		static Ref<SecondaryCommandRecorder> Create(uint32_t count);
+
+	private:
+		struct ThreadPool
+		{
+			VkCommandPool commandPool = nullptr;
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t usedCount = 0;
+		};
+
+		std::vector<ThreadPool> CreatePools() const;
+		VkCommandBuffer GetCommandBuffer(ThreadPool& pool);
+		ThreadPool& GetThreadPool();
+
+		// Indexed by frame, then by thread slot. Slot zero is the main thread, then one per job worker.
+		std::vector<std::vector<ThreadPool>> m_pools;
+		std::vector<VkCommandBuffer> m_recordedCommandBuffers;
+
+		// Threads outside the job system (e.g. the render thread) run tasks they steal while waiting on their own jobs.
+		// Each gets its own pools the first time, the mutex only guards the lookup. Indexed by frame.
+		std::unordered_map<std::thread::id, std::vector<ThreadPool>> m_otherThreadPools;
+		std::mutex m_otherThreadPoolsMutex;
+
+		uint32_t m_count = 0;
+		uint32_t m_currentIndex = 0;
+		uint32_t m_threadSlotCount = 0;
+	};
+}
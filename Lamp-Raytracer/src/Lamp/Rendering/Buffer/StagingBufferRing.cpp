@@ -0,0 +1,93 @@
+#include "lppch.h"
+#include "StagingBufferRing.h"
+
+#include "Lamp/Core/Graphics/VulkanAllocator.h"
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Rendering/Renderer.h"
+
+namespace Lamp
+{
+	StagingBufferRing::StagingBufferRing(uint32_t count, VkDeviceSize initialSize)
+	{
+		m_segments.resize(count);
+
+		for (auto& segment : m_segments)
+		{
+			CreateSegmentBuffer(segment, initialSize);
+		}
+	}
+
+	StagingBufferRing::~StagingBufferRing()
+	{
+		VulkanAllocator allocator{ MemoryTag::StagingBufferRing };
+
+		for (auto& segment : m_segments)
+		{
+			if (segment.buffer)
+			{
+				allocator.DestroyBuffer(segment.buffer, segment.allocation);
+			}
+		}
+
+		m_segments.clear();
+	}
+
+	void StagingBufferRing::Begin(uint32_t index)
+	{
+		LP_CORE_ASSERT(index < (uint32_t)m_segments.size(), "Staging ring index out of range!");
+
+		// The caller has waited on the fence guarding this index, so its memory is free to reuse
+		m_currentIndex = index;
+		m_segments[m_currentIndex].offset = 0;
+	}
+
+	StagingAllocation StagingBufferRing::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		Segment& segment = m_segments[m_currentIndex];
+
+		VkDeviceSize offset = (segment.offset + alignment - 1) & ~(alignment - 1);
+		if (offset + size > segment.size)
+		{
+			// Commands recorded this frame may still reference the old buffer, so defer its destruction
+			Renderer::SubmitResourceFree({ (uint64_t)segment.buffer }, [buffer = segment.buffer, allocation = segment.allocation]()
+				{
+					VulkanAllocator allocator{ MemoryTag::StagingBufferRing };
+					allocator.DestroyBuffer(buffer, allocation);
+				});
+
+			CreateSegmentBuffer(segment, std::max(segment.size * 2, size));
+			offset = 0;
+		}
+
+		segment.offset = offset + size;
+
+		StagingAllocation result{};
+		result.buffer = segment.buffer;
+		result.offset = offset;
+		result.mappedData = static_cast<uint8_t*>(segment.mappedData) + offset;
+
+		return result;
+	}
+
+	Ref<StagingBufferRing> StagingBufferRing::Create(uint32_t count, VkDeviceSize initialSize)
+	{
+		return CreateRef<StagingBufferRing>(count, initialSize);
+	}
+
+	void StagingBufferRing::CreateSegmentBuffer(Segment& segment, VkDeviceSize size)
+	{
+		VulkanAllocator allocator{ MemoryTag::StagingBufferRing };
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		segment.allocation = allocator.AllocateBuffer(bufferInfo, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT, segment.buffer);
+		segment.mappedData = allocator.GetMappedData(segment.allocation);
+		segment.size = size;
+		segment.offset = 0;
+	}
+}
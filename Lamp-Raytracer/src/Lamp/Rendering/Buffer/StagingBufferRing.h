@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <vulkan/vulkan.h>
+#include <vma/VulkanMemoryAllocator.h>
+
+namespace Lamp
+{
+	struct StagingAllocation
+	{
+		VkBuffer buffer = nullptr;
+		VkDeviceSize offset = 0;
+		void* mappedData = nullptr;
+	};
+
+	class StagingBufferRing
+	{
+	public:
+		StagingBufferRing(uint32_t count, VkDeviceSize initialSize);
+		~StagingBufferRing();
+
+		void Begin(uint32_t index);
+		StagingAllocation Allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+		inline const VkDeviceSize GetUsedSize() const { return m_segments[m_currentIndex].offset; }
+
+		static Ref<StagingBufferRing> Create(uint32_t count, VkDeviceSize initialSize);
+
+	private:
+		struct Segment
+		{
+			VkBuffer buffer = nullptr;
+			VmaAllocation allocation = nullptr;
+			void* mappedData = nullptr;
+
+			VkDeviceSize size = 0;
+			VkDeviceSize offset = 0;
+		};
+
+		void CreateSegmentBuffer(Segment& segment, VkDeviceSize size);
+
+		std::vector<Segment> m_segments;
+		uint32_t m_currentIndex = 0;
+	};
+}
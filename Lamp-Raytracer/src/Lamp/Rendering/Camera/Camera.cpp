@@ -34,19 +34,24 @@ namespace Lamp
 
 	void Camera::GenerateRayDirections(uint32_t width, uint32_t height)
 	{
+		LP_PROFILE_FUNCTION();
+
 		m_rayDirections.clear();
 		m_rayDirections.resize(width * height);
-		
-		for (uint32_t x = 0; x < width; x++)
+
+		// Inverted once for the whole image, path rendering regenerates the directions every frame
+		const glm::mat4 inverseViewProjection = glm::inverse(m_projectionMatrix * m_viewMatrix);
+
+		for (uint32_t y = 0; y < height; y++)
 		{
-			for (uint32_t y = 0; y < height; y++)
+			for (uint32_t x = 0; x < width; x++)
 			{
-				m_rayDirections[x + y * width] = ScreenToWorldRay({ x, y }, { width, height });
+				m_rayDirections[x + y * width] = UnprojectRay({ x, y }, { width, height }, inverseViewProjection);
 			}
 		}
 	}
 
-	const glm::vec3& Camera::GetRayDirectionAt(uint32_t index)
+	const glm::vec3& Camera::GetRayDirectionAt(uint32_t index) const
 	{
 		return m_rayDirections.at(index);
 	}
@@ -55,11 +60,14 @@ namespace Lamp
 	{
 		LP_PROFILE_FUNCTION();
 
+		return UnprojectRay(someCoords, aSize, glm::inverse(m_projectionMatrix * m_viewMatrix));
+	}
+
+	const glm::vec3 Camera::UnprojectRay(const glm::vec2& someCoords, const glm::vec2& aSize, const glm::mat4& matInv)
+	{
 		float x = (someCoords.x / aSize.x) * 2.f - 1.f;
 		float y = (someCoords.y / aSize.y) * 2.f - 1.f;
 
-		const glm::mat4 matInv = glm::inverse(m_projectionMatrix * m_viewMatrix);
-
 		glm::vec4 rayOrigin = matInv * glm::vec4(x, -y, 0, 1);
 		glm::vec4 rayEnd = matInv * glm::vec4(x, -y, 1, 1);
 
@@ -35,7 +35,7 @@ namespace Lamp
 		inline const float GetFarPlane() const { return m_farPlane; }
 
 		void GenerateRayDirections(uint32_t width, uint32_t height);
-		const glm::vec3& GetRayDirectionAt(uint32_t index);
+		const glm::vec3& GetRayDirectionAt(uint32_t index) const;
 		const glm::vec3 ScreenToWorldRay(const glm::vec2& someCoords, const glm::vec2& aSize);
 
 		glm::vec3 GetUp() const;
@@ -46,6 +46,7 @@ namespace Lamp
 
 	private:
 		void RecalculateViewMatrix();
+		static const glm::vec3 UnprojectRay(const glm::vec2& someCoords, const glm::vec2& aSize, const glm::mat4& matInv);
 
 		std::vector<glm::vec3> m_rayDirections;
 
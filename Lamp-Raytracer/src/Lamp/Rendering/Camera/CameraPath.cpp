@@ -0,0 +1,173 @@
+#include "lppch.h"
+#include "CameraPath.h"
+
+#include "Lamp/Log/Log.h"
+#include "Lamp/Rendering/Camera/Camera.h"
+
+#include <glm/gtx/spline.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		inline bool ReadVec3(const YAML::Node& node, glm::vec3& outValue)
+		{
+			if (!node || !node.IsSequence() || node.size() != 3)
+			{
+				return false;
+			}
+
+			outValue = { node[0].as<float>(), node[1].as<float>(), node[2].as<float>() };
+			return true;
+		}
+	}
+
+	void CameraPath::AddKeyframe(const CameraKeyframe& keyframe)
+	{
+		auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), keyframe.time, [](float value, const CameraKeyframe& other)
+			{
+				return value < other.time;
+			});
+
+		m_keyframes.insert(it, keyframe);
+	}
+
+	CameraKeyframe CameraPath::Evaluate(float time) const
+	{
+		if (m_keyframes.empty())
+		{
+			return CameraKeyframe{ time };
+		}
+
+		if (m_keyframes.size() == 1 || time <= m_keyframes.front().time)
+		{
+			CameraKeyframe result = m_keyframes.front();
+			result.time = time;
+			return result;
+		}
+
+		if (time >= m_keyframes.back().time)
+		{
+			CameraKeyframe result = m_keyframes.back();
+			result.time = time;
+			return result;
+		}
+
+		// Segment [i, i + 1] contains the time, the end keyframes are repeated as the outer control points
+		const size_t next = std::distance(m_keyframes.begin(), std::upper_bound(m_keyframes.begin(), m_keyframes.end(), time, [](float value, const CameraKeyframe& other)
+			{
+				return value < other.time;
+			}));
+
+		const size_t current = next - 1;
+		const size_t previous = current > 0 ? current - 1 : current;
+		const size_t after = std::min(next + 1, m_keyframes.size() - 1);
+
+		const CameraKeyframe& k0 = m_keyframes[previous];
+		const CameraKeyframe& k1 = m_keyframes[current];
+		const CameraKeyframe& k2 = m_keyframes[next];
+		const CameraKeyframe& k3 = m_keyframes[after];
+
+		const float segmentLength = k2.time - k1.time;
+		const float t = segmentLength > 0.f ? (time - k1.time) / segmentLength : 0.f;
+
+		CameraKeyframe result{};
+		result.time = time;
+		result.position = glm::catmullRom(k0.position, k1.position, k2.position, k3.position, t);
+		result.rotation = glm::catmullRom(k0.rotation, k1.rotation, k2.rotation, k3.rotation, t);
+		result.fieldOfView = glm::mix(k1.fieldOfView, k2.fieldOfView, t);
+
+		return result;
+	}
+
+	void CameraPath::Apply(Camera& camera, float time) const
+	{
+		const CameraKeyframe keyframe = Evaluate(time);
+
+		camera.SetPerspectiveProjection(keyframe.fieldOfView, camera.GetAspectRatio(), camera.GetNearPlane(), camera.GetFarPlane());
+		camera.SetPosition(keyframe.position);
+		camera.SetRotation(keyframe.rotation);
+	}
+
+	const float CameraPath::GetStartTime() const
+	{
+		return m_keyframes.empty() ? 0.f : m_keyframes.front().time;
+	}
+
+	const float CameraPath::GetEndTime() const
+	{
+		return m_keyframes.empty() ? 0.f : m_keyframes.back().time;
+	}
+
+	bool CameraPath::Load(const std::filesystem::path& path, CameraPath& outPath)
+	{
+		YAML::Node root;
+
+		try
+		{
+			root = YAML::LoadFile(path.string());
+		}
+		catch (const YAML::Exception& e)
+		{
+			LP_CORE_ERROR("Failed to parse camera path {0}: {1}", path.string().c_str(), e.what());
+			return false;
+		}
+
+		if (!root["keyframes"] || !root["keyframes"].IsSequence())
+		{
+			LP_CORE_ERROR("Camera path {0} has no keyframes!", path.string().c_str());
+			return false;
+		}
+
+		outPath = CameraPath{};
+
+		for (const auto& node : root["keyframes"])
+		{
+			CameraKeyframe keyframe{};
+
+			if (!node["time"] || !Utility::ReadVec3(node["position"], keyframe.position))
+			{
+				LP_CORE_ERROR("Camera path {0} has a keyframe without a time or position!", path.string().c_str());
+				return false;
+			}
+
+			keyframe.time = node["time"].as<float>();
+			Utility::ReadVec3(node["rotation"], keyframe.rotation);
+
+			if (node["fov"])
+			{
+				keyframe.fieldOfView = node["fov"].as<float>();
+			}
+
+			outPath.AddKeyframe(keyframe);
+		}
+
+		return true;
+	}
+
+	CameraPath CameraPath::CreateTurntable(const glm::vec3& target, float radius, float height, float duration, float fieldOfView)
+	{
+		CameraPath path{};
+
+		// Pitch is constant, so the camera keeps looking at the target from every angle
+		const float pitch = glm::degrees(std::atan2(height, radius));
+
+		for (uint32_t i = 0; i <= s_turntableKeyframes; i++)
+		{
+			const float fraction = (float)i / (float)s_turntableKeyframes;
+			const float angle = fraction * 360.f;
+
+			CameraKeyframe keyframe{};
+			keyframe.time = fraction * duration;
+			keyframe.position = target + glm::vec3{ radius * std::sin(glm::radians(angle)), height, radius * std::cos(glm::radians(angle)) };
+			keyframe.rotation = { -angle, pitch, 0.f };
+			keyframe.fieldOfView = fieldOfView;
+
+			path.AddKeyframe(keyframe);
+		}
+
+		return path;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <glm/glm.hpp>
+
+#include <filesystem>
+#include <vector>
+
+namespace Lamp
+{
+	class Camera;
+
+	struct CameraKeyframe
+	{
+		float time = 0.f;
+
+		glm::vec3 position = { 0.f, 0.f, 0.f };
+		glm::vec3 rotation = { 0.f, 0.f, 0.f }; // Degrees, same convention as Camera
+		float fieldOfView = 60.f;
+	};
+
+	// Keyframed camera motion. Position and rotation follow a Catmull-Rom spline through the keyframes, the field of view is linear.
+	// Rotations are interpolated as angles, so a path can keep turning past 360 degrees.
+	class CameraPath
+	{
+	public:
+		CameraPath() = default;
+
+		// Keyframes are kept sorted by time
+		void AddKeyframe(const CameraKeyframe& keyframe);
+
+		CameraKeyframe Evaluate(float time) const;
+
+		// Keeps the camera's aspect ratio and planes, the ray directions have to be regenerated afterwards
+		void Apply(Camera& camera, float time) const;
+
+		inline const std::vector<CameraKeyframe>& GetKeyframes() const { return m_keyframes; }
+		inline const bool IsEmpty() const { return m_keyframes.empty(); }
+
+		const float GetStartTime() const;
+		const float GetEndTime() const;
+		inline const float GetDuration() const { return GetEndTime() - GetStartTime(); }
+
+		static bool Load(const std::filesystem::path& path, CameraPath& outPath);
+
+		// One full orbit around the target, looking at it from the given height
+		static CameraPath CreateTurntable(const glm::vec3& target, float radius, float height, float duration, float fieldOfView = 60.f);
+
+	private:
+		std::vector<CameraKeyframe> m_keyframes;
+
+		inline static constexpr uint32_t s_turntableKeyframes = 24;
+	};
+}
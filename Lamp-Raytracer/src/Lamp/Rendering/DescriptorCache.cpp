@@ -0,0 +1,434 @@
+#include "lppch.h"
+#include "DescriptorCache.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Rendering/Shader/ShaderUtility.h"
+
+namespace Lamp
+{
+	void DescriptorSetLayoutCache::Shutdown()
+	{
+		std::scoped_lock lock(s_mutex);
+		auto device = GraphicsContext::GetDevice();
+
+		for (const auto& [hash, layouts] : s_layouts)
+		{
+			for (const auto& cachedLayout : layouts)
+			{
+				vkDestroyDescriptorSetLayout(device->GetHandle(), cachedLayout.layout, nullptr);
+			}
+		}
+
+		s_layouts.clear();
+		s_stats = {};
+	}
+
+	VkDescriptorSetLayout DescriptorSetLayoutCache::Get(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+	{
+		std::vector<uint64_t> key;
+		GetKeyFromBindings(bindings, key);
+
+		const uint64_t hash = Utility::HashData(key.data(), key.size() * sizeof(uint64_t));
+
+		// Shaders are loaded from several threads at once
+		std::scoped_lock lock(s_mutex);
+
+		// Layouts with the same hash are compared in full, a collision must not hand out a layout with other bindings
+		auto& layouts = s_layouts[hash];
+		for (const auto& cachedLayout : layouts)
+		{
+			if (cachedLayout.key == key)
+			{
+				s_stats.hits++;
+				return cachedLayout.layout;
+			}
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = nullptr;
+		layoutInfo.bindingCount = (uint32_t)bindings.size();
+		layoutInfo.pBindings = bindings.empty() ? nullptr : bindings.data();
+
+		VkDescriptorSetLayout layout = nullptr;
+		LP_VK_CHECK(vkCreateDescriptorSetLayout(GraphicsContext::GetDevice()->GetHandle(), &layoutInfo, nullptr, &layout));
+
+		s_stats.misses++;
+		layouts.emplace_back(CachedLayout{ std::move(key), layout });
+
+		return layout;
+	}
+
+	const DescriptorCacheStats DescriptorSetLayoutCache::GetStats()
+	{
+		std::scoped_lock lock(s_mutex);
+		return s_stats;
+	}
+
+	void DescriptorSetLayoutCache::GetKeyFromBindings(const std::vector<VkDescriptorSetLayoutBinding>& bindings, std::vector<uint64_t>& outKey)
+	{
+		// Binding order does not change the layout
+		std::vector<VkDescriptorSetLayoutBinding> sortedBindings = bindings;
+		std::sort(sortedBindings.begin(), sortedBindings.end(), [](const VkDescriptorSetLayoutBinding& lhs, const VkDescriptorSetLayoutBinding& rhs)
+			{
+				return lhs.binding < rhs.binding;
+			});
+
+		outKey.clear();
+		outKey.emplace_back(sortedBindings.size());
+
+		for (const auto& binding : sortedBindings)
+		{
+			outKey.emplace_back(binding.binding);
+			outKey.emplace_back(binding.descriptorType);
+			outKey.emplace_back(binding.descriptorCount);
+			outKey.emplace_back(binding.stageFlags);
+			outKey.emplace_back(binding.pImmutableSamplers ? 1 : 0);
+
+			if (binding.pImmutableSamplers)
+			{
+				for (uint32_t i = 0; i < binding.descriptorCount; i++)
+				{
+					outKey.emplace_back((uint64_t)binding.pImmutableSamplers[i]);
+				}
+			}
+		}
+	}
+
+	DescriptorSetCache::DescriptorSetCache()
+	{
+		m_transientPool = CreatePool(s_transientSetsPerPool, false);
+		m_pools.emplace_back(CreatePool(s_setsPerPool, true));
+
+		std::scoped_lock lock(s_cachesMutex);
+		s_caches.emplace_back(this);
+	}
+
+	DescriptorSetCache::~DescriptorSetCache()
+	{
+		{
+			std::scoped_lock lock(s_cachesMutex);
+			s_caches.erase(std::find(s_caches.begin(), s_caches.end(), this));
+		}
+
+		auto device = GraphicsContext::GetDevice();
+
+		vkDestroyDescriptorPool(device->GetHandle(), m_transientPool, nullptr);
+		for (const auto& pool : m_pools)
+		{
+			vkDestroyDescriptorPool(device->GetHandle(), pool, nullptr);
+		}
+	}
+
+	void DescriptorSetCache::BeginFrame()
+	{
+		LP_PROFILE_FUNCTION();
+
+		LP_VK_CHECK(vkResetDescriptorPool(GraphicsContext::GetDevice()->GetHandle(), m_transientPool, 0));
+
+		m_frameIndex++;
+		m_frameStats = {};
+
+		ApplyInvalidations();
+		EvictUnused();
+	}
+
+	VkDescriptorSet DescriptorSetCache::Get(VkDescriptorSetLayout layout, std::vector<VkWriteDescriptorSet>& writes)
+	{
+		LP_PROFILE_FUNCTION();
+
+		GetResourcesFromWrites(writes, m_scratchResources, m_scratchHandles);
+
+		uint64_t hash = Utility::HashData(&layout, sizeof(VkDescriptorSetLayout));
+		hash = Utility::HashData(m_scratchResources.data(), m_scratchResources.size() * sizeof(uint64_t), hash);
+
+		// Sets with the same hash are compared in full, a collision must not bind the wrong resources
+		auto& sets = m_descriptorSets[hash];
+		for (auto& cachedSet : sets)
+		{
+			if (cachedSet.layout != layout || cachedSet.resources != m_scratchResources)
+			{
+				continue;
+			}
+
+			m_frameStats.hits++;
+			m_totalStats.hits++;
+			cachedSet.lastUsedFrame = m_frameIndex;
+
+			for (auto& write : writes)
+			{
+				write.dstSet = cachedSet.descriptorSet;
+			}
+
+			return cachedSet.descriptorSet;
+		}
+
+		CachedSet& cachedSet = sets.emplace_back();
+		cachedSet.layout = layout;
+		cachedSet.resources = m_scratchResources;
+		cachedSet.handles = m_scratchHandles;
+		cachedSet.descriptorSet = AllocateCached(layout, cachedSet.pool);
+		cachedSet.lastUsedFrame = m_frameIndex;
+
+		for (const auto& handle : cachedSet.handles)
+		{
+			m_setsByHandle[handle].emplace_back(hash);
+		}
+
+		for (auto& write : writes)
+		{
+			write.dstSet = cachedSet.descriptorSet;
+		}
+
+		vkUpdateDescriptorSets(GraphicsContext::GetDevice()->GetHandle(), (uint32_t)writes.size(), writes.data(), 0, nullptr);
+
+		m_frameStats.misses++;
+		m_totalStats.misses++;
+
+		return cachedSet.descriptorSet;
+	}
+
+	VkDescriptorSet DescriptorSetCache::Allocate(VkDescriptorSetAllocateInfo& allocInfo)
+	{
+		LP_CORE_ASSERT(allocInfo.descriptorSetCount == 1, "Only one descriptor set can be allocated at a time!");
+
+		allocInfo.descriptorPool = m_transientPool;
+
+		VkDescriptorSet descriptorSet = nullptr;
+		LP_VK_CHECK(vkAllocateDescriptorSets(GraphicsContext::GetDevice()->GetHandle(), &allocInfo, &descriptorSet));
+
+		return descriptorSet;
+	}
+
+	void DescriptorSetCache::InvalidateResources(const std::vector<uint64_t>& handles)
+	{
+		std::scoped_lock lock(s_cachesMutex);
+		for (auto* cache : s_caches)
+		{
+			cache->m_invalidatedHandles.insert(cache->m_invalidatedHandles.end(), handles.begin(), handles.end());
+		}
+	}
+
+	Ref<DescriptorSetCache> DescriptorSetCache::Create()
+	{
+		return CreateRef<DescriptorSetCache>();
+	}
+
+	void DescriptorSetCache::GetResourcesFromWrites(const std::vector<VkWriteDescriptorSet>& writes, std::vector<uint64_t>& outResources, std::vector<uint64_t>& outHandles)
+	{
+		outResources.clear();
+		outHandles.clear();
+
+		for (const auto& write : writes)
+		{
+			outResources.emplace_back(write.dstBinding);
+			outResources.emplace_back(write.dstArrayElement);
+			outResources.emplace_back(write.descriptorType);
+			outResources.emplace_back(write.descriptorCount);
+
+			// Copied field by field, the structs may contain padding
+			if (write.pBufferInfo)
+			{
+				for (uint32_t i = 0; i < write.descriptorCount; i++)
+				{
+					const VkDescriptorBufferInfo& info = write.pBufferInfo[i];
+					outResources.emplace_back((uint64_t)info.buffer);
+					outResources.emplace_back(info.offset);
+					outResources.emplace_back(info.range);
+
+					outHandles.emplace_back((uint64_t)info.buffer);
+				}
+			}
+
+			if (write.pImageInfo)
+			{
+				for (uint32_t i = 0; i < write.descriptorCount; i++)
+				{
+					const VkDescriptorImageInfo& info = write.pImageInfo[i];
+					outResources.emplace_back((uint64_t)info.sampler);
+					outResources.emplace_back((uint64_t)info.imageView);
+					outResources.emplace_back(info.imageLayout);
+
+					outHandles.emplace_back((uint64_t)info.sampler);
+					outHandles.emplace_back((uint64_t)info.imageView);
+				}
+			}
+
+			if (write.pTexelBufferView)
+			{
+				for (uint32_t i = 0; i < write.descriptorCount; i++)
+				{
+					outResources.emplace_back((uint64_t)write.pTexelBufferView[i]);
+					outHandles.emplace_back((uint64_t)write.pTexelBufferView[i]);
+				}
+			}
+		}
+
+		// Storage images have no sampler
+		outHandles.erase(std::remove(outHandles.begin(), outHandles.end(), 0), outHandles.end());
+		std::sort(outHandles.begin(), outHandles.end());
+		outHandles.erase(std::unique(outHandles.begin(), outHandles.end()), outHandles.end());
+	}
+
+	VkDescriptorPool DescriptorSetCache::CreatePool(uint32_t maxSets, bool freeable)
+	{
+		// Sized for the bindings the shaders actually use, another pool is created when one runs out
+		VkDescriptorPoolSize poolSizes[] =
+		{
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxSets * 2 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxSets * 2 },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxSets },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxSets },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, maxSets },
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, maxSets / 4 },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, maxSets / 8 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, maxSets / 8 },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, maxSets / 8 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, maxSets / 8 },
+			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, maxSets / 8 }
+		};
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = freeable ? VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0;
+		poolInfo.maxSets = maxSets;
+		poolInfo.poolSizeCount = (uint32_t)ARRAYSIZE(poolSizes);
+		poolInfo.pPoolSizes = poolSizes;
+
+		VkDescriptorPool pool = nullptr;
+		LP_VK_CHECK(vkCreateDescriptorPool(GraphicsContext::GetDevice()->GetHandle(), &poolInfo, nullptr, &pool));
+
+		return pool;
+	}
+
+	VkDescriptorSet DescriptorSetCache::AllocateCached(VkDescriptorSetLayout layout, VkDescriptorPool& outPool)
+	{
+		auto device = GraphicsContext::GetDevice();
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_pools.back();
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet descriptorSet = nullptr;
+		VkResult result = vkAllocateDescriptorSets(device->GetHandle(), &allocInfo, &descriptorSet);
+
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			m_pools.emplace_back(CreatePool(s_setsPerPool, true));
+			allocInfo.descriptorPool = m_pools.back();
+
+			result = vkAllocateDescriptorSets(device->GetHandle(), &allocInfo, &descriptorSet);
+		}
+
+		LP_VK_CHECK(result);
+
+		outPool = allocInfo.descriptorPool;
+		return descriptorSet;
+	}
+
+	void DescriptorSetCache::ReleaseSet(uint64_t hash, const CachedSet& cachedSet)
+	{
+		LP_VK_CHECK(vkFreeDescriptorSets(GraphicsContext::GetDevice()->GetHandle(), cachedSet.pool, 1, &cachedSet.descriptorSet));
+
+		for (const auto& handle : cachedSet.handles)
+		{
+			auto it = m_setsByHandle.find(handle);
+			if (it == m_setsByHandle.end())
+			{
+				continue;
+			}
+
+			auto& hashes = it->second;
+			if (auto hashIt = std::find(hashes.begin(), hashes.end(), hash); hashIt != hashes.end())
+			{
+				*hashIt = hashes.back();
+				hashes.pop_back();
+			}
+
+			if (hashes.empty())
+			{
+				m_setsByHandle.erase(it);
+			}
+		}
+	}
+
+	void DescriptorSetCache::ApplyInvalidations()
+	{
+		std::vector<uint64_t> handles;
+		{
+			std::scoped_lock lock(s_cachesMutex);
+			handles.swap(m_invalidatedHandles);
+		}
+
+		for (const auto& handle : handles)
+		{
+			auto it = m_setsByHandle.find(handle);
+			if (it == m_setsByHandle.end())
+			{
+				continue;
+			}
+
+			// Taken out first, releasing the sets unlinks them from the index
+			const std::vector<uint64_t> hashes = std::move(it->second);
+			m_setsByHandle.erase(it);
+
+			for (const auto& hash : hashes)
+			{
+				auto setsIt = m_descriptorSets.find(hash);
+				if (setsIt == m_descriptorSets.end())
+				{
+					continue;
+				}
+
+				auto& sets = setsIt->second;
+				for (size_t i = 0; i < sets.size();)
+				{
+					if (!std::binary_search(sets[i].handles.begin(), sets[i].handles.end(), handle))
+					{
+						i++;
+						continue;
+					}
+
+					ReleaseSet(hash, sets[i]);
+
+					sets[i] = std::move(sets.back());
+					sets.pop_back();
+				}
+
+				if (sets.empty())
+				{
+					m_descriptorSets.erase(setsIt);
+				}
+			}
+		}
+	}
+
+	void DescriptorSetCache::EvictUnused()
+	{
+		for (auto it = m_descriptorSets.begin(); it != m_descriptorSets.end();)
+		{
+			auto& sets = it->second;
+			for (size_t i = 0; i < sets.size();)
+			{
+				if (m_frameIndex - sets[i].lastUsedFrame <= s_maxUnusedFrames)
+				{
+					i++;
+					continue;
+				}
+
+				ReleaseSet(it->first, sets[i]);
+
+				sets[i] = std::move(sets.back());
+				sets.pop_back();
+			}
+
+			it = sets.empty() ? m_descriptorSets.erase(it) : std::next(it);
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Lamp
+{
+	struct DescriptorCacheStats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+
+		inline const float GetHitRate() const { return (hits + misses) > 0 ? (float)hits / (float)(hits + misses) : 0.f; }
+	};
+
+	// Deduplicates descriptor set layouts with identical bindings across shaders. Layouts live until shutdown.
+	class DescriptorSetLayoutCache
+	{
+	public:
+		static void Shutdown();
+
+		static VkDescriptorSetLayout Get(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		static const DescriptorCacheStats GetStats();
+
+	private:
+		DescriptorSetLayoutCache() = delete;
+
+		struct CachedLayout
+		{
+			std::vector<uint64_t> key; // Every field of the sorted bindings
+			VkDescriptorSetLayout layout = nullptr;
+		};
+
+		static void GetKeyFromBindings(const std::vector<VkDescriptorSetLayoutBinding>& bindings, std::vector<uint64_t>& outKey);
+
+		inline static std::unordered_map<uint64_t, std::vector<CachedLayout>> s_layouts; // Hash -> Layouts with that hash
+		inline static DescriptorCacheStats s_stats;
+		inline static std::mutex s_mutex;
+	};
+
+	// Owns the descriptor sets of one frame in flight. Sets with the same layout and bound resources are written once and handed
+	// out again in later frames using the same slot, sets that have not been requested for a while are freed.
+	class DescriptorSetCache
+	{
+	public:
+		DescriptorSetCache();
+		~DescriptorSetCache();
+
+		// Must only be called once the frame using this cache has finished on the GPU
+		void BeginFrame();
+
+		// The writes are updated to point at the returned set
+		VkDescriptorSet Get(VkDescriptorSetLayout layout, std::vector<VkWriteDescriptorSet>& writes);
+
+		// Not cached, the set is freed when this cache begins its next frame
+		VkDescriptorSet Allocate(VkDescriptorSetAllocateInfo& allocInfo);
+
+		inline const DescriptorCacheStats& GetFrameStats() const { return m_frameStats; }
+		inline const DescriptorCacheStats& GetTotalStats() const { return m_totalStats; }
+
+		// Buffers, image views and samplers queued for destruction. Every cache drops the sets pointing at them
+		// when it begins its next frame, before the handles can be reused.
+		static void InvalidateResources(const std::vector<uint64_t>& handles);
+
+		static Ref<DescriptorSetCache> Create();
+
+	private:
+		struct CachedSet
+		{
+			VkDescriptorSetLayout layout = nullptr;
+			std::vector<uint64_t> resources; // Every field of the writes that decides the contents of the set
+			std::vector<uint64_t> handles; // Unique buffers, views and samplers the set points at
+
+			VkDescriptorSet descriptorSet = nullptr;
+			VkDescriptorPool pool = nullptr;
+			uint64_t lastUsedFrame = 0;
+		};
+
+		static void GetResourcesFromWrites(const std::vector<VkWriteDescriptorSet>& writes, std::vector<uint64_t>& outResources, std::vector<uint64_t>& outHandles);
+		static VkDescriptorPool CreatePool(uint32_t maxSets, bool freeable);
+
+		VkDescriptorSet AllocateCached(VkDescriptorSetLayout layout, VkDescriptorPool& outPool);
+		void ReleaseSet(uint64_t hash, const CachedSet& cachedSet);
+		void ApplyInvalidations();
+		void EvictUnused();
+
+		VkDescriptorPool m_transientPool = nullptr;
+		std::vector<VkDescriptorPool> m_pools; // A new pool is added once the last one is full
+
+		std::unordered_map<uint64_t, std::vector<CachedSet>> m_descriptorSets; // Hash -> Sets with that hash
+		std::unordered_map<uint64_t, std::vector<uint64_t>> m_setsByHandle; // Handle -> Hash of every set pointing at it
+		std::vector<uint64_t> m_scratchResources;
+		std::vector<uint64_t> m_scratchHandles;
+
+		std::vector<uint64_t> m_invalidatedHandles; // Guarded by s_cachesMutex
+
+		uint64_t m_frameIndex = 0;
+
+		DescriptorCacheStats m_frameStats;
+		DescriptorCacheStats m_totalStats;
+
+		inline static std::vector<DescriptorSetCache*> s_caches;
+		inline static std::mutex s_cachesMutex;
+
+		inline static constexpr uint64_t s_maxUnusedFrames = 120;
+		inline static constexpr uint32_t s_setsPerPool = 256;
+		inline static constexpr uint32_t s_transientSetsPerPool = 64;
+	};
+}
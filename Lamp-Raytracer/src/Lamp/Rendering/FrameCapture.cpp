@@ -0,0 +1,423 @@
+#include "lppch.h"
+#include "FrameCapture.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+#include "Lamp/Core/Graphics/VulkanAllocator.h"
+
+#include "Lamp/Rendering/Texture/Image2D.h"
+#include "Lamp/Rendering/Texture/ImageTransitionBatcher.h"
+
+#include "Lamp/Utility/ImageUtility.h"
+#include "Lamp/Utility/ImageWriter.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		inline bool IsCapturableFormat(ImageFormat format)
+		{
+			return format == ImageFormat::RGBA || format == ImageFormat::SRGB || format == ImageFormat::RGBA16F || format == ImageFormat::RGBA32F;
+		}
+
+		inline glm::vec4 ReadCapturedPixel(const void* data, ImageFormat format, size_t index)
+		{
+			switch (format)
+			{
+				case ImageFormat::RGBA:
+				case ImageFormat::SRGB:
+				{
+					const uint8_t* pixel = (const uint8_t*)data + index * 4;
+					return glm::vec4{ pixel[0], pixel[1], pixel[2], pixel[3] } / 255.f;
+				}
+
+				case ImageFormat::RGBA16F:
+				{
+					uint64_t packed = 0;
+					memcpy(&packed, (const uint8_t*)data + index * sizeof(uint64_t), sizeof(uint64_t));
+					return glm::unpackHalf4x16(packed);
+				}
+
+				case ImageFormat::RGBA32F:
+				{
+					const float* pixel = (const float*)data + index * 4;
+					return glm::vec4{ pixel[0], pixel[1], pixel[2], pixel[3] };
+				}
+			}
+
+			return glm::vec4{ 0.f };
+		}
+	}
+
+	void FrameCapture::Initialize()
+	{
+		s_encoderThread = std::thread(&FrameCapture::RunEncoder);
+	}
+
+	void FrameCapture::Shutdown()
+	{
+		Flush();
+
+		s_encodeQueue.Push(s_stopEncoder);
+		if (s_encoderThread.joinable())
+		{
+			s_encoderThread.join();
+		}
+
+		for (auto& slot : s_slots)
+		{
+			ReleaseBuffer(slot);
+		}
+
+		const auto stats = GetStats();
+		LP_CORE_INFO("Frame captures: {0} requested, {1} written, {2} failed, {3} dropped", stats.requested, stats.written, stats.failed, stats.dropped);
+	}
+
+	void FrameCapture::Update()
+	{
+		LP_PROFILE_FUNCTION();
+
+		auto device = GraphicsContext::GetDevice();
+
+		for (uint32_t i = 0; i < s_slotCount; i++)
+		{
+			if (s_slots[i].state.load() != SlotState::InFlight)
+			{
+				continue;
+			}
+
+			if (vkGetFenceStatus(device->GetHandle(), s_slots[i].submitFence) == VK_SUCCESS)
+			{
+				BeginEncode(i);
+			}
+		}
+	}
+
+	bool FrameCapture::Capture(VkCommandBuffer commandBuffer, VkFence submitFence, Ref<Image2D> image, const std::filesystem::path& path, CaptureFormat format, CaptureCallback callback)
+	{
+		LP_PROFILE_FUNCTION();
+
+		const auto& specification = image->GetSpecification();
+		if (!Utility::IsCapturableFormat(specification.format) || (!specification.copyable && specification.usage != ImageUsage::Texture))
+		{
+			LP_CORE_ERROR("Unable to capture {0}, the image has to be copyable and RGBA, SRGB, RGBA16F or RGBA32F!", path.string());
+			return false;
+		}
+
+		if (image->GetLayout() == VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			LP_CORE_WARN("Unable to capture {0}, the image has no contents yet", path.string());
+			return false;
+		}
+
+		s_requestedCount++;
+
+		const uint32_t slotIndex = RecordCopy(commandBuffer, submitFence, image);
+		if (slotIndex == s_slotCount)
+		{
+			s_droppedCount++;
+			LP_CORE_WARN("Dropped capture {0}, every readback buffer is busy", path.string());
+			return false;
+		}
+
+		auto& slot = s_slots[slotIndex];
+		slot.path = path;
+		slot.format = format;
+		slot.callback = callback;
+		slot.readbackCallback = nullptr;
+
+		s_pendingCount++;
+		slot.state.store(SlotState::InFlight);
+
+		return true;
+	}
+
+	bool FrameCapture::Readback(VkCommandBuffer commandBuffer, VkFence submitFence, Ref<Image2D> image, ReadbackCallback callback)
+	{
+		LP_PROFILE_FUNCTION();
+
+		const auto& specification = image->GetSpecification();
+		if (!Utility::IsCapturableFormat(specification.format) || (!specification.copyable && specification.usage != ImageUsage::Texture) || image->GetLayout() == VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			return false;
+		}
+
+		// Readbacks are retried by their owners, so a busy ring isn't worth a warning
+		const uint32_t slotIndex = RecordCopy(commandBuffer, submitFence, image);
+		if (slotIndex == s_slotCount)
+		{
+			return false;
+		}
+
+		auto& slot = s_slots[slotIndex];
+		slot.path.clear();
+		slot.callback = nullptr;
+		slot.readbackCallback = callback;
+
+		s_pendingCount++;
+		slot.state.store(SlotState::InFlight);
+
+		return true;
+	}
+
+	void FrameCapture::Flush()
+	{
+		LP_PROFILE_FUNCTION();
+
+		auto device = GraphicsContext::GetDevice();
+
+		for (uint32_t i = 0; i < s_slotCount; i++)
+		{
+			if (s_slots[i].state.load() == SlotState::InFlight)
+			{
+				LP_VK_CHECK(vkWaitForFences(device->GetHandle(), 1, &s_slots[i].submitFence, VK_TRUE, UINT64_MAX));
+				BeginEncode(i);
+			}
+		}
+
+		uint32_t pendingCount = s_pendingCount.load();
+		while (pendingCount > 0)
+		{
+			s_pendingCount.wait(pendingCount);
+			pendingCount = s_pendingCount.load();
+		}
+	}
+
+	const FrameCaptureStats FrameCapture::GetStats()
+	{
+		FrameCaptureStats stats{};
+		stats.requested = s_requestedCount.load();
+		stats.written = s_writtenCount.load();
+		stats.failed = s_failedCount.load();
+		stats.dropped = s_droppedCount.load();
+
+		return stats;
+	}
+
+	uint32_t FrameCapture::RecordCopy(VkCommandBuffer commandBuffer, VkFence submitFence, Ref<Image2D> image)
+	{
+		const auto& specification = image->GetSpecification();
+
+		// Round robin, so the oldest capture has had the most time to finish encoding
+		uint32_t slotIndex = s_slotCount;
+		for (uint32_t i = 0; i < s_slotCount; i++)
+		{
+			const uint32_t index = (s_nextSlot + i) % s_slotCount;
+			if (s_slots[index].state.load() == SlotState::Free)
+			{
+				slotIndex = index;
+				break;
+			}
+		}
+
+		if (slotIndex == s_slotCount)
+		{
+			return s_slotCount;
+		}
+
+		s_nextSlot = (slotIndex + 1) % s_slotCount;
+
+		auto& slot = s_slots[slotIndex];
+		EnsureBuffer(slot, (VkDeviceSize)specification.width * specification.height * Utility::PerPixelSizeFromFormat(specification.format));
+
+		slot.submitFence = submitFence;
+		slot.imageFormat = specification.format;
+		slot.width = specification.width;
+		slot.height = specification.height;
+
+		// Deferred transitions have to land before the copy reads the image
+		ImageTransitionBatcher::Record(commandBuffer);
+
+		const VkImageLayout layout = image->GetLayout();
+		const VkImageSubresourceRange subresource{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		// The image goes back to its tracked layout afterwards, so nothing else has to know about the copy
+		Utility::InsertImageMemoryBarrier(commandBuffer, image->GetHandle(), VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresource);
+
+		VkBufferImageCopy region{};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { specification.width, specification.height, 1 };
+
+		vkCmdCopyImageToBuffer(commandBuffer, image->GetHandle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+		VkBufferMemoryBarrier hostBarrier{};
+		hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		hostBarrier.buffer = slot.buffer;
+		hostBarrier.offset = 0;
+		hostBarrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+		Utility::InsertImageMemoryBarrier(commandBuffer, image->GetHandle(), VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresource);
+
+		return slotIndex;
+	}
+
+	void FrameCapture::EnsureBuffer(ReadbackSlot& slot, VkDeviceSize size)
+	{
+		if (slot.buffer && slot.size >= size)
+		{
+			return;
+		}
+
+		// Free slots aren't used by the GPU or the encoder anymore
+		ReleaseBuffer(slot);
+
+		VulkanAllocator allocator{ MemoryTag::FrameCapture };
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		slot.allocation = allocator.AllocateBuffer(bufferInfo, VMA_MEMORY_USAGE_GPU_TO_CPU, VMA_ALLOCATION_CREATE_MAPPED_BIT, slot.buffer);
+		slot.mappedData = allocator.GetMappedData(slot.allocation);
+		slot.size = size;
+	}
+
+	void FrameCapture::ReleaseBuffer(ReadbackSlot& slot)
+	{
+		if (!slot.buffer)
+		{
+			return;
+		}
+
+		VulkanAllocator allocator{ MemoryTag::FrameCapture };
+		allocator.DestroyBuffer(slot.buffer, slot.allocation);
+
+		slot.buffer = nullptr;
+		slot.allocation = nullptr;
+		slot.mappedData = nullptr;
+		slot.size = 0;
+	}
+
+	void FrameCapture::BeginEncode(uint32_t slotIndex)
+	{
+		auto& slot = s_slots[slotIndex];
+
+		// Readback memory isn't guaranteed to be host coherent
+		vmaInvalidateAllocation(VulkanAllocator::GetAllocator(), slot.allocation, 0, VK_WHOLE_SIZE);
+
+		slot.state.store(SlotState::Encoding);
+		s_encodeQueue.Push(slotIndex);
+	}
+
+	bool FrameCapture::Encode(const ReadbackSlot& slot)
+	{
+		LP_PROFILE_FUNCTION();
+
+		if (slot.path.has_parent_path())
+		{
+			std::error_code error;
+			std::filesystem::create_directories(slot.path.parent_path(), error);
+		}
+
+		const size_t pixelCount = (size_t)slot.width * slot.height;
+
+		if (slot.format == CaptureFormat::PNG)
+		{
+			// 8 bit targets already hold display encoded values
+			if (slot.imageFormat == ImageFormat::RGBA || slot.imageFormat == ImageFormat::SRGB)
+			{
+				return ImageWriter::WritePNG(slot.path, slot.width, slot.height, (const uint8_t*)slot.mappedData);
+			}
+
+			// Float targets are linear, PNGs are expected to be sRGB encoded
+			std::vector<uint8_t> pixels(pixelCount * 4);
+			for (size_t i = 0; i < pixelCount; i++)
+			{
+				const glm::vec4 color = Utility::ReadCapturedPixel(slot.mappedData, slot.imageFormat, i);
+
+				pixels[i * 4 + 0] = (uint8_t)std::lround(ImageWriter::LinearToSRGB(color.r) * 255.f);
+				pixels[i * 4 + 1] = (uint8_t)std::lround(ImageWriter::LinearToSRGB(color.g) * 255.f);
+				pixels[i * 4 + 2] = (uint8_t)std::lround(ImageWriter::LinearToSRGB(color.b) * 255.f);
+				pixels[i * 4 + 3] = (uint8_t)std::lround(glm::clamp(color.a, 0.f, 1.f) * 255.f);
+			}
+
+			return ImageWriter::WritePNG(slot.path, slot.width, slot.height, pixels.data());
+		}
+
+		if (slot.imageFormat == ImageFormat::RGBA32F)
+		{
+			return ImageWriter::WriteEXR(slot.path, slot.width, slot.height, (const float*)slot.mappedData);
+		}
+
+		std::vector<float> pixels(pixelCount * 4);
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			glm::vec4 color = Utility::ReadCapturedPixel(slot.mappedData, slot.imageFormat, i);
+			if (slot.imageFormat == ImageFormat::RGBA || slot.imageFormat == ImageFormat::SRGB)
+			{
+				color = { ImageWriter::SRGBToLinear(color.r), ImageWriter::SRGBToLinear(color.g), ImageWriter::SRGBToLinear(color.b), color.a };
+			}
+
+			memcpy(&pixels[i * 4], &color, sizeof(glm::vec4));
+		}
+
+		return ImageWriter::WriteEXR(slot.path, slot.width, slot.height, pixels.data());
+	}
+
+	void FrameCapture::RunEncoder()
+	{
+		LP_PROFILE_THREAD("Capture Encoder");
+
+		while (true)
+		{
+			const uint32_t slotIndex = s_encodeQueue.WaitAndPop();
+			if (slotIndex == s_stopEncoder)
+			{
+				break;
+			}
+
+			auto& slot = s_slots[slotIndex];
+
+			if (slot.readbackCallback)
+			{
+				slot.readbackCallback(slot.mappedData, slot.width, slot.height);
+				slot.readbackCallback = nullptr;
+				slot.state.store(SlotState::Free);
+
+				s_pendingCount--;
+				s_pendingCount.notify_all();
+				continue;
+			}
+
+			const bool succeeded = Encode(slot);
+			if (succeeded)
+			{
+				s_writtenCount++;
+			}
+			else
+			{
+				s_failedCount++;
+				LP_CORE_ERROR("Failed to write capture {0}!", slot.path.string());
+			}
+
+			if (slot.callback)
+			{
+				slot.callback(slot.path, succeeded);
+				slot.callback = nullptr;
+			}
+
+			slot.state.store(SlotState::Free);
+
+			s_pendingCount--;
+			s_pendingCount.notify_all();
+		}
+	}
+}
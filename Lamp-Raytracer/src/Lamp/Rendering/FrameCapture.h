@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include "Lamp/Rendering/Texture/ImageCommon.h"
+#include "Lamp/Utility/ThreadSafeQueue.h"
+
+#include <vulkan/vulkan.h>
+#include <vma/VulkanMemoryAllocator.h>
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+namespace Lamp
+{
+	class Image2D;
+
+	enum class CaptureFormat : uint32_t
+	{
+		PNG = 0,
+		EXR
+	};
+
+	// Called from the encoder thread once the file has been written, or failed to
+	using CaptureCallback = std::function<void(const std::filesystem::path& path, bool succeeded)>;
+
+	// Called from the encoder thread with the copied pixels, the data is only valid during the call
+	using ReadbackCallback = std::function<void(const void* data, uint32_t width, uint32_t height)>;
+
+	struct FrameCaptureStats
+	{
+		uint64_t requested = 0;
+		uint64_t written = 0;
+		uint64_t failed = 0;
+		uint64_t dropped = 0;
+	};
+
+	// Copies images into a ring of host visible readback buffers. The submit fences of the copies are polled once per frame without waiting,
+	// finished copies are handed to a background thread that encodes them straight from the mapped memory.
+	class FrameCapture
+	{
+	public:
+		static void Initialize();
+		static void Shutdown();
+
+		// Hands every copy whose fence is signaled to the encoder. Must be called outside of the recording of the command buffers the copies are in,
+		// their fences are only reset when they are submitted.
+		static void Update();
+
+		// Records the copy, the image has to be outside of a render pass. The fence is the one the command buffer is submitted with.
+		// Returns false if the image can't be read back or every readback buffer is still busy.
+		static bool Capture(VkCommandBuffer commandBuffer, VkFence submitFence, Ref<Image2D> image, const std::filesystem::path& path, CaptureFormat format = CaptureFormat::PNG, CaptureCallback callback = nullptr);
+
+		// Same as Capture, but the pixels are handed to the callback instead of being written to a file. Doesn't count towards the capture stats.
+		static bool Readback(VkCommandBuffer commandBuffer, VkFence submitFence, Ref<Image2D> image, ReadbackCallback callback);
+
+		// Blocks until every capture has been written, same restrictions as Update
+		static void Flush();
+
+		inline static const uint32_t GetPendingCount() { return s_pendingCount.load(); }
+		static const FrameCaptureStats GetStats();
+
+	private:
+		FrameCapture() = delete;
+
+		enum class SlotState : uint32_t
+		{
+			Free = 0,
+			InFlight,
+			Encoding
+		};
+
+		struct ReadbackSlot
+		{
+			VkBuffer buffer = nullptr;
+			VmaAllocation allocation = nullptr;
+			void* mappedData = nullptr;
+			VkDeviceSize size = 0;
+
+			// Free slots belong to the main thread, encoding slots to the encoder thread
+			std::atomic<SlotState> state = SlotState::Free;
+			VkFence submitFence = nullptr;
+
+			std::filesystem::path path;
+			CaptureFormat format = CaptureFormat::PNG;
+			CaptureCallback callback;
+			ReadbackCallback readbackCallback; // Set for readbacks, which skip the encoding
+
+			ImageFormat imageFormat = ImageFormat::RGBA;
+			uint32_t width = 0;
+			uint32_t height = 0;
+		};
+
+		// Returns the slot the copy was recorded into, or s_slotCount if every slot is busy
+		static uint32_t RecordCopy(VkCommandBuffer commandBuffer, VkFence submitFence, Ref<Image2D> image);
+
+		static void EnsureBuffer(ReadbackSlot& slot, VkDeviceSize size);
+		static void ReleaseBuffer(ReadbackSlot& slot);
+
+		static void BeginEncode(uint32_t slotIndex);
+		static bool Encode(const ReadbackSlot& slot);
+		static void RunEncoder();
+
+		inline static constexpr uint32_t s_slotCount = 8;
+		inline static constexpr uint32_t s_stopEncoder = UINT32_MAX;
+
+		inline static std::array<ReadbackSlot, s_slotCount> s_slots;
+		inline static uint32_t s_nextSlot = 0;
+
+		inline static std::thread s_encoderThread;
+		inline static ThreadSafeQueue<uint32_t> s_encodeQueue;
+		inline static std::atomic<uint32_t> s_pendingCount = 0;
+
+		inline static std::atomic<uint64_t> s_requestedCount = 0;
+		inline static std::atomic<uint64_t> s_writtenCount = 0;
+		inline static std::atomic<uint64_t> s_failedCount = 0;
+		inline static std::atomic<uint64_t> s_droppedCount = 0;
+	};
+}
@@ -0,0 +1,431 @@
+#include "lppch.h"
+#include "GBufferPass.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Core/Graphics/VulkanAllocator.h"
+
+#include "Lamp/Rendering/Camera/Camera.h"
+#include "Lamp/Rendering/RenderPipeline/RenderPipelineGraphics.h"
+#include "Lamp/Rendering/Texture/Image2D.h"
+
+#include "Lamp/Rendering/FrameCapture.h"
+#include "Lamp/Rendering/GPUCulling.h"
+#include "Lamp/Rendering/RenderGraph.h"
+#include "Lamp/Rendering/RenderThread.h"
+#include "Lamp/Rendering/Renderer.h"
+
+#include "Lamp/Scene/Hittable.h"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <atomic>
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		// Position and normal are copied into separate readback slots, the frame is submitted once both have landed
+		struct GBufferReadback
+		{
+			Ref<GBufferFrame> frame;
+			std::atomic<uint32_t> remainingCopies = 2;
+		};
+
+		inline void CompleteGBufferReadback(GBufferReadback& readback)
+		{
+			if (readback.remainingCopies.fetch_sub(1) != 1)
+			{
+				return;
+			}
+
+			// The position alpha holds the metallic of the material, hits are told apart by their normal instead, misses keep the cleared zero
+			auto& frame = *readback.frame;
+			for (size_t i = 0; i < frame.positions.size(); i++)
+			{
+				const bool hasHit = glm::dot(glm::vec3(frame.normals[i]), glm::vec3(frame.normals[i])) > 0.f;
+
+				frame.positions[i].w = hasHit ? 1.f : 0.f;
+				frame.normals[i].w = 0.f;
+			}
+
+			Renderer::SubmitGBuffer(readback.frame);
+		}
+	}
+
+	GBufferPass::GBufferPass(uint32_t framesInFlight)
+	{
+		m_culling = GPUCulling::Create();
+
+		RenderPipelineGraphicsSpecification pipelineSpecification{};
+		pipelineSpecification.shaderName = "GBuffer";
+		pipelineSpecification.colorFormats = { ImageFormat::RGBA32F, ImageFormat::RGBA, ImageFormat::RGBA32F };
+		pipelineSpecification.depthFormat = ImageFormat::DEPTH32F;
+		pipelineSpecification.vertexAttributes = { VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32_SFLOAT };
+
+		// Depth testing already hides the back faces, and the camera may be inside a sphere
+		pipelineSpecification.cullMode = VK_CULL_MODE_NONE;
+
+		m_pipeline = RenderPipelineGraphics::Create(pipelineSpecification);
+
+		// White albedo, and a flat normal with metallic 0 and roughness 1
+		const uint32_t albedo = 0xffffffff;
+		const glm::vec4 materialNormal = { 0.f, 0.5f, 0.5f, 1.f };
+
+		ImageSpecification textureSpecification{};
+		textureSpecification.format = ImageFormat::RGBA;
+		m_albedoTexture = Image2D::Create(textureSpecification, &albedo);
+
+		textureSpecification.format = ImageFormat::RGBA32F;
+		m_materialNormalTexture = Image2D::Create(textureSpecification, &materialNormal);
+
+		m_passBuffer = CreateBuffer(sizeof(glm::uvec4), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, true);
+		memset(m_passBuffer.mappedData, 0, sizeof(glm::uvec4));
+		vmaFlushAllocation(VulkanAllocator::GetAllocator(), m_passBuffer.allocation, 0, VK_WHOLE_SIZE);
+
+		for (uint32_t i = 0; i < framesInFlight; i++)
+		{
+			m_cameraBuffers.emplace_back(CreateBuffer(sizeof(CameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, true));
+		}
+
+		CreateSphereMesh();
+	}
+
+	GBufferPass::~GBufferPass()
+	{
+		ReleaseBuffer(m_vertexBuffer);
+		ReleaseBuffer(m_indexBuffer);
+		ReleaseBuffer(m_passBuffer);
+
+		for (auto& buffer : m_cameraBuffers)
+		{
+			ReleaseBuffer(buffer);
+		}
+	}
+
+	bool GBufferPass::SetObjects(const std::vector<Ref<Hittable>>& objects)
+	{
+		LP_PROFILE_FUNCTION();
+
+		std::vector<glm::vec4> spheres(objects.size());
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (!objects[i]->GetRasterSphere(spheres[i]))
+			{
+				return false;
+			}
+		}
+
+		if (spheres == m_spheres)
+		{
+			return true;
+		}
+
+		m_spheres = std::move(spheres);
+		m_version++;
+
+		std::vector<CullObject> cullObjects;
+		cullObjects.reserve(m_spheres.size());
+
+		// Every draw task gets a batch of the same mesh, so the parallel passes split the spheres between the workers
+		for (size_t i = 0; i < m_spheres.size(); i++)
+		{
+			const auto& sphere = m_spheres[i];
+
+			CullObject& object = cullObjects.emplace_back();
+			object.transform = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(sphere)), glm::vec3(sphere.w));
+			object.sphereBounds = sphere;
+			object.batch = (uint32_t)(i * s_drawTaskCount / m_spheres.size());
+		}
+
+		m_culling->SetObjects(std::vector<CullBatch>(s_drawTaskCount, CullBatch{ m_indexCount, 0, 0 }), cullObjects);
+		return true;
+	}
+
+	void GBufferPass::Record(VkCommandBuffer commandBuffer, VkFence submitFence, uint32_t frameIndex, const Camera& camera, uint32_t width, uint32_t height)
+	{
+		LP_PROFILE_FUNCTION();
+
+		if (width != m_width || height != m_height)
+		{
+			CreateTargets(width, height);
+			m_version++;
+		}
+
+		// Vulkan clip space has y pointing down and depth from 0 to 1. The half pixel shift moves the pixel centers the rasterizer samples
+		// onto the pixel corners the CPU rays go through, so both find the same first hit.
+		glm::mat4 clipCorrection{ 1.f };
+		clipCorrection[1][1] = -1.f;
+		clipCorrection[2][2] = 0.5f;
+		clipCorrection[3] = { 1.f / (float)width, 1.f / (float)height, 0.5f, 1.f };
+
+		const glm::mat4 projection = clipCorrection * camera.GetProjection();
+		const glm::mat4 viewProjection = projection * camera.GetView();
+
+		if (viewProjection != m_viewProjection)
+		{
+			m_viewProjection = viewProjection;
+			m_version++;
+		}
+
+		// The last read back G-buffer is still current
+		if (m_readbackVersion == m_version || m_spheres.empty())
+		{
+			return;
+		}
+
+		if (!UploadService::IsReady(m_meshUploadToken) || !m_albedoTexture->IsUploadReady() || !m_materialNormalTexture->IsUploadReady())
+		{
+			return;
+		}
+
+		LP_PROFILE_GPU_EVENT(commandBuffer, "GBuffer");
+
+		CameraData cameraData{};
+		cameraData.view = camera.GetView();
+		cameraData.projection = projection;
+		cameraData.viewProjection = viewProjection;
+		cameraData.position = { camera.GetPosition(), 1.f };
+
+		auto& cameraBuffer = m_cameraBuffers[frameIndex];
+		memcpy(cameraBuffer.mappedData, &cameraData, sizeof(CameraData));
+		vmaFlushAllocation(VulkanAllocator::GetAllocator(), cameraBuffer.allocation, 0, VK_WHOLE_SIZE);
+
+		// Occlusion is tested against the depth of the last pass first, the graph tests what that held back against this pass' depth
+		if (!m_culling->Cull(commandBuffer, camera))
+		{
+			return;
+		}
+
+		m_pipeline->SetUniformBuffer(1, 0, cameraBuffer.buffer);
+		m_pipeline->SetUniformBuffer(1, 2, m_passBuffer.buffer);
+		m_pipeline->SetImage(3, 0, m_albedoTexture->GetView(), m_albedoTexture->GetSampler(), m_albedoTexture->GetLayout());
+		m_pipeline->SetImage(3, 1, m_materialNormalTexture->GetView(), m_materialNormalTexture->GetSampler(), m_materialNormalTexture->GetLayout());
+		m_pipeline->SetStorageBuffer(4, 0, m_culling->GetObjectBuffer());
+		m_pipeline->SetStorageBuffer(4, 1, m_culling->GetObjectMapBuffer());
+
+		// Nothing would be drawn while the shader is loading, reading back the cleared targets would look like an empty scene.
+		// The descriptor sets are fetched here, the draw tasks on the job workers only record them.
+		if (!m_pipeline->Prepare())
+		{
+			return;
+		}
+
+		m_hasCulledLate = false;
+		m_graph->Execute(commandBuffer);
+
+		// Spheres the early occlusion test held back are missing until the late cull ran
+		if (!m_hasCulledLate)
+		{
+			return;
+		}
+
+		auto readback = CreateRef<Utility::GBufferReadback>();
+		readback->frame = CreateRef<GBufferFrame>();
+		readback->frame->width = width;
+		readback->frame->height = height;
+		readback->frame->version = m_version;
+
+		const bool positionsQueued = FrameCapture::Readback(commandBuffer, submitFence, m_positionImage, [readback](const void* data, uint32_t imageWidth, uint32_t imageHeight)
+			{
+				const glm::vec4* pixels = (const glm::vec4*)data;
+				readback->frame->positions.assign(pixels, pixels + (size_t)imageWidth * imageHeight);
+				Utility::CompleteGBufferReadback(*readback);
+			});
+
+		const bool normalsQueued = positionsQueued && FrameCapture::Readback(commandBuffer, submitFence, m_normalImage, [readback](const void* data, uint32_t imageWidth, uint32_t imageHeight)
+			{
+				const glm::vec4* pixels = (const glm::vec4*)data;
+				readback->frame->normals.assign(pixels, pixels + (size_t)imageWidth * imageHeight);
+				Utility::CompleteGBufferReadback(*readback);
+			});
+
+		// A half queued readback never completes, the pass is simply recorded again next frame
+		if (normalsQueued)
+		{
+			m_readbackVersion = m_version;
+		}
+	}
+
+	Ref<GBufferPass> GBufferPass::Create(uint32_t framesInFlight)
+	{
+		return CreateRef<GBufferPass>(framesInFlight);
+	}
+
+	void GBufferPass::CreateSphereMesh()
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+
+		vertices.reserve((size_t)(s_sphereRings + 1) * (s_sphereSegments + 1));
+		indices.reserve((size_t)s_sphereRings * s_sphereSegments * 6);
+
+		// Unit sphere, objects scale and place it with their transform
+		for (uint32_t ring = 0; ring <= s_sphereRings; ring++)
+		{
+			const float theta = glm::pi<float>() * (float)ring / (float)s_sphereRings;
+
+			for (uint32_t segment = 0; segment <= s_sphereSegments; segment++)
+			{
+				const float phi = 2.f * glm::pi<float>() * (float)segment / (float)s_sphereSegments;
+
+				Vertex& vertex = vertices.emplace_back();
+				vertex.normal = { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+				vertex.position = vertex.normal;
+				vertex.tangent = { -std::sin(phi), 0.f, std::cos(phi) };
+				vertex.bitangent = glm::cross(vertex.normal, vertex.tangent);
+				vertex.texCoords = { (float)segment / (float)s_sphereSegments, (float)ring / (float)s_sphereRings };
+			}
+		}
+
+		for (uint32_t ring = 0; ring < s_sphereRings; ring++)
+		{
+			for (uint32_t segment = 0; segment < s_sphereSegments; segment++)
+			{
+				const uint32_t current = ring * (s_sphereSegments + 1) + segment;
+				const uint32_t next = current + s_sphereSegments + 1;
+
+				indices.insert(indices.end(), { current, next, current + 1 });
+				indices.insert(indices.end(), { current + 1, next, next + 1 });
+			}
+		}
+
+		m_indexCount = (uint32_t)indices.size();
+
+		const VkDeviceSize vertexBufferSize = vertices.size() * sizeof(Vertex);
+		const VkDeviceSize indexBufferSize = indices.size() * sizeof(uint32_t);
+
+		m_vertexBuffer = CreateBuffer(vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+		m_indexBuffer = CreateBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+
+		UploadService::UploadBuffer(m_vertexBuffer.buffer, 0, vertices.data(), vertexBufferSize);
+		m_meshUploadToken = UploadService::UploadBuffer(m_indexBuffer.buffer, 0, indices.data(), indexBufferSize);
+	}
+
+	void GBufferPass::CreateTargets(uint32_t width, uint32_t height)
+	{
+		m_width = width;
+		m_height = height;
+
+		// Position and normal are read back as they are, albedo and depth only live inside the graph
+		ImageSpecification specification{};
+		specification.format = ImageFormat::RGBA32F;
+		specification.usage = ImageUsage::Attachment;
+		specification.filter = TextureFilter::Nearest;
+		specification.width = width;
+		specification.height = height;
+		specification.copyable = true;
+
+		m_positionImage = Image2D::Create(specification);
+		m_normalImage = Image2D::Create(specification);
+
+		m_graph = RenderGraph::Create();
+
+		const RenderGraphImageHandle position = m_graph->ImportImage(m_positionImage);
+		const RenderGraphImageHandle normal = m_graph->ImportImage(m_normalImage);
+		const RenderGraphImageHandle albedo = m_graph->CreateTransientImage({ ImageFormat::RGBA, width, height, "GBuffer Albedo" });
+		const RenderGraphImageHandle depth = m_graph->CreateTransientImage({ ImageFormat::DEPTH32F, width, height, "GBuffer Depth" });
+
+		m_graph->AddParallelPass("GBuffer", s_drawTaskCount,
+			[=](RenderGraph::PassBuilder& builder)
+			{
+				// Same order as the outputs of GBuffer_fs
+				builder.WriteColorAttachment(position);
+				builder.WriteColorAttachment(albedo);
+				builder.WriteColorAttachment(normal);
+				builder.WriteDepthAttachment(depth);
+			},
+			[this, width, height](VkCommandBuffer commandBuffer, uint32_t taskIndex, const RenderGraph&)
+			{
+				Draw(commandBuffer, width, height, taskIndex);
+			});
+
+		m_graph->AddPass("GBuffer Occlusion",
+			[=](RenderGraph::PassBuilder& builder)
+			{
+				builder.Read(depth, RenderGraphResourceUsage::DepthRead);
+			},
+			[this, depth, width, height](VkCommandBuffer commandBuffer, const RenderGraph& graph)
+			{
+				m_culling->BuildDepthPyramid(commandBuffer, graph.GetView(depth), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, width, height);
+				m_hasCulledLate = m_culling->CullLate(commandBuffer);
+			});
+
+		// Only the spheres the late cull found are drawn, on top of the early ones
+		m_graph->AddParallelPass("GBuffer Late", s_drawTaskCount,
+			[=](RenderGraph::PassBuilder& builder)
+			{
+				builder.WriteColorAttachment(position, ClearMode::Load);
+				builder.WriteColorAttachment(albedo, ClearMode::Load);
+				builder.WriteColorAttachment(normal, ClearMode::Load);
+				builder.WriteDepthAttachment(depth, ClearMode::Load);
+			},
+			[this, width, height](VkCommandBuffer commandBuffer, uint32_t taskIndex, const RenderGraph&)
+			{
+				Draw(commandBuffer, width, height, taskIndex);
+			});
+
+		m_graph->SetFinalUsage(position, RenderGraphResourceUsage::TransferSrc);
+		m_graph->SetFinalUsage(normal, RenderGraphResourceUsage::TransferSrc);
+		m_graph->Compile();
+	}
+
+	void GBufferPass::Draw(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height, uint32_t taskIndex) const
+	{
+		// Secondaries inherit no state, every task binds everything again
+		m_pipeline->BindPrepared(commandBuffer);
+
+		const VkViewport viewport{ 0.f, 0.f, (float)width, (float)height, 0.f, 1.f };
+		const VkRect2D scissor{ { 0, 0 }, { width, height } };
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		const VkDeviceSize vertexOffset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBuffer.buffer, &vertexOffset);
+		vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+		m_culling->Draw(commandBuffer, taskIndex, 1);
+	}
+
+	GBufferPass::GPUBuffer GBufferPass::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, bool hostVisible)
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		GPUBuffer buffer{};
+		VulkanAllocator allocator{ MemoryTag::GBufferPass };
+
+		if (hostVisible)
+		{
+			buffer.allocation = allocator.AllocateBuffer(bufferInfo, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT, buffer.buffer);
+			buffer.mappedData = allocator.GetMappedData(buffer.allocation);
+		}
+		else
+		{
+			buffer.allocation = allocator.AllocateBuffer(bufferInfo, VMA_MEMORY_USAGE_GPU_ONLY, buffer.buffer);
+		}
+
+		return buffer;
+	}
+
+	void GBufferPass::ReleaseBuffer(GPUBuffer& buffer)
+	{
+		if (!buffer.buffer)
+		{
+			return;
+		}
+
+		Renderer::SubmitResourceFree({ (uint64_t)buffer.buffer }, [buffer = buffer.buffer, allocation = buffer.allocation]()
+			{
+				VulkanAllocator allocator{ MemoryTag::GBufferPass };
+				allocator.DestroyBuffer(buffer, allocation);
+			});
+
+		buffer = {};
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include "Lamp/Rendering/UploadService.h"
+
+#include <vma/VulkanMemoryAllocator.h>
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace Lamp
+{
+	class Camera;
+	class GPUCulling;
+	class Hittable;
+	class Image2D;
+	class RenderGraph;
+	class RenderPipelineGraphics;
+
+	// Rasterizes the first hits of the camera rays for the hybrid tracer with Deferred/GBuffer_vs/fs. Objects are drawn as tessellated spheres
+	// through GPUCulling, position and normal are read back through the FrameCapture ring and submitted to the Renderer once the copies land.
+	// A pass is only recorded when the camera, the spheres or the size changed since the last pass that was read back.
+	class GBufferPass
+	{
+	public:
+		GBufferPass(uint32_t framesInFlight);
+		~GBufferPass();
+
+		// Returns false if an object can't be rasterized, the CPU has to trace the primary rays then
+		bool SetObjects(const std::vector<Ref<Hittable>>& objects);
+
+		// Has to be recorded outside of a render pass. The fence is the one the command buffer is submitted with.
+		void Record(VkCommandBuffer commandBuffer, VkFence submitFence, uint32_t frameIndex, const Camera& camera, uint32_t width, uint32_t height);
+
+		// Read back G-buffers are tagged with the version of the inputs they were rasterized from, only the current one matches the scene
+		inline const uint64_t GetVersion() const { return m_version; }
+
+		static Ref<GBufferPass> Create(uint32_t framesInFlight);
+
+	private:
+		// Matches the vertex inputs of GBuffer_vs
+		struct Vertex
+		{
+			glm::vec3 position;
+			glm::vec3 normal;
+			glm::vec3 tangent;
+			glm::vec3 bitangent;
+			glm::vec2 texCoords;
+		};
+
+		// Matches CameraData in Common.glslh
+		struct CameraData
+		{
+			glm::mat4 view;
+			glm::mat4 projection;
+			glm::mat4 viewProjection;
+			glm::vec4 position;
+		};
+
+		struct GPUBuffer
+		{
+			VkBuffer buffer = nullptr;
+			VmaAllocation allocation = nullptr;
+			void* mappedData = nullptr;
+		};
+
+		void CreateSphereMesh();
+		void CreateTargets(uint32_t width, uint32_t height);
+		void Draw(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height, uint32_t taskIndex) const;
+
+		GPUBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, bool hostVisible);
+		void ReleaseBuffer(GPUBuffer& buffer);
+
+		Ref<GPUCulling> m_culling;
+		Ref<RenderPipelineGraphics> m_pipeline;
+		Ref<RenderGraph> m_graph;
+
+		Ref<Image2D> m_positionImage;
+		Ref<Image2D> m_normalImage;
+		Ref<Image2D> m_albedoTexture;
+		Ref<Image2D> m_materialNormalTexture;
+
+		GPUBuffer m_vertexBuffer;
+		GPUBuffer m_indexBuffer;
+		GPUBuffer m_passBuffer;
+		std::vector<GPUBuffer> m_cameraBuffers;
+
+		uint32_t m_indexCount = 0;
+		UploadToken m_meshUploadToken;
+
+		std::vector<glm::vec4> m_spheres;
+		glm::mat4 m_viewProjection = glm::mat4(0.f);
+		uint32_t m_width = 0;
+		uint32_t m_height = 0;
+
+		uint64_t m_version = 1;
+		uint64_t m_readbackVersion = 0;
+		bool m_hasCulledLate = false;
+
+		inline static constexpr uint32_t s_drawTaskCount = 4;
+
+		// The chord error of the tessellation is about 0.0003 of the radius, below the tracer's ray offset for radii up to a few units
+		inline static constexpr uint32_t s_sphereRings = 64;
+		inline static constexpr uint32_t s_sphereSegments = 128;
+	};
+}
@@ -0,0 +1,471 @@
+#include "lppch.h"
+#include "GPUCulling.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+#include "Lamp/Core/Graphics/VulkanAllocator.h"
+
+#include "Lamp/Rendering/Renderer.h"
+#include "Lamp/Rendering/Camera/Camera.h"
+#include "Lamp/Rendering/RenderPipeline/RenderPipelineCompute.h"
+
+#include "Lamp/Utility/ImageUtility.h"
+#include "Lamp/Utility/Math.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		inline uint32_t NextPowerOfTwo(uint32_t value)
+		{
+			uint32_t result = 1;
+			while (result < value)
+			{
+				result *= 2;
+			}
+
+			return result;
+		}
+
+		inline void InsertMemoryBarrier(VkCommandBuffer commandBuffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages)
+		{
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dstAccess;
+
+			vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+	}
+
+	GPUCulling::GPUCulling()
+	{
+		m_cullPipeline = RenderPipelineCompute::Create("Cull");
+		m_depthReducePipeline = RenderPipelineCompute::Create("HiZ");
+
+		// One bilinear tap returns the farthest depth of the footprint
+		VkSamplerReductionModeCreateInfo reductionInfo{};
+		reductionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO;
+		reductionInfo.reductionMode = VK_SAMPLER_REDUCTION_MODE_MAX;
+
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.pNext = &reductionInfo;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.f;
+		samplerInfo.maxLod = 16.f;
+
+		LP_VK_CHECK(vkCreateSampler(GraphicsContext::GetDevice()->GetHandle(), &samplerInfo, nullptr, &m_reductionSampler));
+
+		// Bound even when occlusion culling is off, so the cull shader always has a valid pyramid
+		CreateDepthPyramid(1, 1);
+
+		EnsureBuffer(m_cullDataBuffer, sizeof(DrawCullData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	}
+
+	GPUCulling::~GPUCulling()
+	{
+		ReleaseBuffer(m_objectBuffer);
+		ReleaseBuffer(m_drawBuffer);
+		ReleaseBuffer(m_countBuffer);
+		ReleaseBuffer(m_objectMapBuffer);
+		ReleaseBuffer(m_occludedBuffer);
+		ReleaseBuffer(m_cullDataBuffer);
+
+		ReleaseDepthPyramid();
+
+		Renderer::SubmitResourceFree({ (uint64_t)m_reductionSampler }, [sampler = m_reductionSampler]()
+			{
+				vkDestroySampler(GraphicsContext::GetDevice()->GetHandle(), sampler, nullptr);
+			});
+	}
+
+	void GPUCulling::SetObjects(const std::vector<CullBatch>& batches, const std::vector<CullObject>& objects)
+	{
+		LP_PROFILE_FUNCTION();
+
+		m_hasCulled = false;
+		m_drawCount = (uint32_t)objects.size();
+		m_batchRanges.assign(batches.size(), BatchRange{});
+
+		if (objects.empty() || batches.empty())
+		{
+			m_drawCount = 0;
+			return;
+		}
+
+		// Draws of a batch are contiguous, the cull shader compacts the visible ones to the front of the range
+		for (const auto& object : objects)
+		{
+			LP_CORE_ASSERT(object.batch < batches.size(), "Object references a batch that doesn't exist!");
+			m_batchRanges[object.batch].drawCount++;
+		}
+
+		uint32_t firstDraw = 0;
+		for (auto& range : m_batchRanges)
+		{
+			range.firstDraw = firstDraw;
+			firstDraw += range.drawCount;
+		}
+
+		std::vector<ObjectData> objectData(objects.size());
+		std::vector<DrawCommand> drawCommands(objects.size());
+		std::vector<uint32_t> batchCursors(batches.size(), 0);
+
+		for (uint32_t objectId = 0; objectId < (uint32_t)objects.size(); objectId++)
+		{
+			const auto& object = objects[objectId];
+			const auto& batch = batches[object.batch];
+			const auto& range = m_batchRanges[object.batch];
+
+			objectData[objectId].transform = object.transform;
+			objectData[objectId].sphereBounds = object.sphereBounds;
+
+			DrawCommand& command = drawCommands[range.firstDraw + batchCursors[object.batch]++];
+			command.indexCount = batch.indexCount;
+			command.instanceCount = 1;
+			command.firstIndex = batch.firstIndex;
+			command.vertexOffset = batch.vertexOffset;
+			command.firstInstance = range.firstDraw;
+			command.objectId = objectId;
+			command.batchId = object.batch;
+			command.padding = 0;
+		}
+
+		const VkDeviceSize objectBufferSize = objectData.size() * sizeof(ObjectData);
+		const VkDeviceSize drawBufferSize = drawCommands.size() * sizeof(DrawCommand);
+
+		const bool objectBufferKept = EnsureBuffer(m_objectBuffer, objectBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+		const bool drawBufferKept = EnsureBuffer(m_drawBuffer, drawBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+		EnsureBuffer(m_countBuffer, batches.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+		EnsureBuffer(m_objectMapBuffer, objects.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		EnsureBuffer(m_occludedBuffer, objects.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+		// Kept buffers may still be read by frames in flight, their copies wait for the graphics queue. Nothing culls before the upload is ready.
+		UploadService::UploadBuffer(m_objectBuffer.buffer, 0, objectData.data(), objectBufferSize, objectBufferKept);
+		m_uploadToken = UploadService::UploadBuffer(m_drawBuffer.buffer, 0, drawCommands.data(), drawBufferSize, drawBufferKept);
+	}
+
+	bool GPUCulling::Cull(VkCommandBuffer commandBuffer, const Camera& camera, const CullSettings& settings)
+	{
+		LP_PROFILE_FUNCTION();
+
+		m_hasCulled = false;
+
+		if (m_drawCount == 0 || !UploadService::IsReady(m_uploadToken))
+		{
+			return false;
+		}
+
+		if (!m_depthPyramidInitialized)
+		{
+			Utility::InsertImageMemoryBarrier(commandBuffer, m_depthPyramid, 0, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 });
+
+			m_depthPyramidInitialized = true;
+		}
+
+		// The shader works in a view space looking down +Z
+		const glm::mat4& projection = camera.GetProjection();
+		const glm::vec4 frustumX = Math::NormalizePlane({ projection[0][0], 0.f, 1.f, 0.f });
+		const glm::vec4 frustumY = Math::NormalizePlane({ std::abs(projection[1][1]), 0.f, 1.f, 0.f });
+
+		m_cullData = {};
+		m_cullData.view = glm::scale(glm::mat4(1.f), { 1.f, 1.f, -1.f }) * camera.GetView();
+		m_cullData.P00 = projection[0][0];
+		m_cullData.P11 = projection[1][1];
+		m_cullData.zNear = camera.GetNearPlane();
+		m_cullData.zFar = camera.GetFarPlane();
+		m_cullData.frustum = { frustumX.x, frustumX.z, frustumY.x, frustumY.z };
+		m_cullData.pyramidWidth = (float)m_depthPyramidWidth;
+		m_cullData.pyramidHeight = (float)m_depthPyramidHeight;
+		m_cullData.drawCount = m_drawCount;
+		m_cullData.cullingEnabled = settings.frustumCulling ? 1 : 0;
+		m_cullData.distCull = settings.distanceCulling ? 1 : 0;
+		m_cullData.occlusionEnabled = settings.occlusionCulling && m_hasDepthPyramid ? 1 : 0;
+		m_cullData.latePass = 0;
+
+		if (!DispatchCull(commandBuffer))
+		{
+			return false;
+		}
+
+		m_hasCulled = true;
+		return true;
+	}
+
+	void GPUCulling::BuildDepthPyramid(VkCommandBuffer commandBuffer, VkImageView depthView, VkImageLayout depthLayout, uint32_t width, uint32_t height)
+	{
+		LP_PROFILE_FUNCTION();
+
+		// Rounded up, so a pyramid texel never covers more than the depth texels one max reduced tap reads
+		const uint32_t pyramidWidth = Utility::NextPowerOfTwo(width);
+		const uint32_t pyramidHeight = Utility::NextPowerOfTwo(height);
+
+		if (pyramidWidth != m_depthPyramidWidth || pyramidHeight != m_depthPyramidHeight)
+		{
+			CreateDepthPyramid(pyramidWidth, pyramidHeight);
+		}
+
+		m_hasDepthPyramid = false;
+
+		// The early cull has to be done reading the pyramid before it is overwritten
+		Utility::InsertMemoryBarrier(commandBuffer, 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		if (!m_depthPyramidInitialized)
+		{
+			Utility::InsertImageMemoryBarrier(commandBuffer, m_depthPyramid, 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 });
+
+			m_depthPyramidInitialized = true;
+		}
+
+		for (uint32_t level = 0; level < (uint32_t)m_depthPyramidMipViews.size(); level++)
+		{
+			const VkImageView inputView = level == 0 ? depthView : m_depthPyramidMipViews[level - 1];
+			const VkImageLayout inputLayout = level == 0 ? depthLayout : VK_IMAGE_LAYOUT_GENERAL;
+
+			m_depthReducePipeline->SetStorageImage(0, 0, m_depthPyramidMipViews[level], VK_IMAGE_LAYOUT_GENERAL);
+			m_depthReducePipeline->SetImage(0, 1, inputView, m_reductionSampler, inputLayout);
+
+			if (!m_depthReducePipeline->Bind(commandBuffer))
+			{
+				return;
+			}
+
+			const uint32_t levelWidth = std::max(pyramidWidth >> level, 1u);
+			const uint32_t levelHeight = std::max(pyramidHeight >> level, 1u);
+
+			const glm::vec2 outputSize = { (float)levelWidth, (float)levelHeight };
+			m_depthReducePipeline->PushConstants(commandBuffer, &outputSize, sizeof(glm::vec2));
+			m_depthReducePipeline->Dispatch(commandBuffer, (levelWidth + s_reduceGroupSize - 1) / s_reduceGroupSize, (levelHeight + s_reduceGroupSize - 1) / s_reduceGroupSize, 1);
+
+			Utility::InsertMemoryBarrier(commandBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		}
+
+		m_hasDepthPyramid = true;
+	}
+
+	bool GPUCulling::CullLate(VkCommandBuffer commandBuffer)
+	{
+		LP_PROFILE_FUNCTION();
+
+		if (!m_hasCulled)
+		{
+			return true;
+		}
+
+		// Nothing was held back, drawing the counts again would only repeat the early draws
+		if (m_cullData.occlusionEnabled == 0)
+		{
+			m_hasCulled = false;
+			return true;
+		}
+
+		// Without a fresh pyramid every held back draw is drawn
+		m_cullData.pyramidWidth = (float)m_depthPyramidWidth;
+		m_cullData.pyramidHeight = (float)m_depthPyramidHeight;
+		m_cullData.occlusionEnabled = m_hasDepthPyramid ? 1 : 0;
+		m_cullData.latePass = 1;
+
+		if (!DispatchCull(commandBuffer))
+		{
+			m_hasCulled = false;
+			return false;
+		}
+
+		return true;
+	}
+
+	void GPUCulling::Draw(VkCommandBuffer commandBuffer, uint32_t firstBatch, uint32_t batchCount) const
+	{
+		LP_PROFILE_FUNCTION();
+
+		if (!m_hasCulled || firstBatch >= (uint32_t)m_batchRanges.size())
+		{
+			return;
+		}
+
+		const uint32_t lastBatch = firstBatch + std::min(batchCount, (uint32_t)m_batchRanges.size() - firstBatch);
+		for (uint32_t batchIndex = firstBatch; batchIndex < lastBatch; batchIndex++)
+		{
+			const auto& range = m_batchRanges[batchIndex];
+			if (range.drawCount == 0)
+			{
+				continue;
+			}
+
+			vkCmdDrawIndexedIndirectCount(commandBuffer, m_drawBuffer.buffer, range.firstDraw * sizeof(DrawCommand), m_countBuffer.buffer, batchIndex * sizeof(uint32_t), range.drawCount, sizeof(DrawCommand));
+		}
+	}
+
+	Ref<GPUCulling> GPUCulling::Create()
+	{
+		return CreateRef<GPUCulling>();
+	}
+
+	bool GPUCulling::EnsureBuffer(GPUBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage)
+	{
+		if (buffer.buffer && buffer.size >= size)
+		{
+			return true;
+		}
+
+		ReleaseBuffer(buffer);
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VulkanAllocator allocator{ MemoryTag::GPUCulling };
+		buffer.allocation = allocator.AllocateBuffer(bufferInfo, VMA_MEMORY_USAGE_GPU_ONLY, buffer.buffer);
+		buffer.size = size;
+
+		return false;
+	}
+
+	void GPUCulling::ReleaseBuffer(GPUBuffer& buffer)
+	{
+		if (!buffer.buffer)
+		{
+			return;
+		}
+
+		Renderer::SubmitResourceFree({ (uint64_t)buffer.buffer }, [buffer = buffer.buffer, allocation = buffer.allocation]()
+			{
+				VulkanAllocator allocator{ MemoryTag::GPUCulling };
+				allocator.DestroyBuffer(buffer, allocation);
+			});
+
+		buffer = {};
+	}
+
+	void GPUCulling::CreateDepthPyramid(uint32_t width, uint32_t height)
+	{
+		ReleaseDepthPyramid();
+
+		auto device = GraphicsContext::GetDevice();
+
+		m_depthPyramidWidth = width;
+		m_depthPyramidHeight = height;
+
+		const uint32_t mipCount = (uint32_t)std::floor(std::log2(std::max(width, height))) + 1;
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.extent = { width, height, 1 };
+		imageInfo.mipLevels = mipCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VulkanAllocator allocator{ MemoryTag::GPUCulling };
+		m_depthPyramidAllocation = allocator.AllocateImage(imageInfo, VMA_MEMORY_USAGE_GPU_ONLY, m_depthPyramid);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = m_depthPyramid;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1 };
+
+		LP_VK_CHECK(vkCreateImageView(device->GetHandle(), &viewInfo, nullptr, &m_depthPyramidView));
+
+		m_depthPyramidMipViews.resize(mipCount);
+		for (uint32_t mip = 0; mip < mipCount; mip++)
+		{
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 1 };
+			LP_VK_CHECK(vkCreateImageView(device->GetHandle(), &viewInfo, nullptr, &m_depthPyramidMipViews[mip]));
+		}
+
+		m_depthPyramidInitialized = false;
+		m_hasDepthPyramid = false;
+	}
+
+	void GPUCulling::ReleaseDepthPyramid()
+	{
+		if (!m_depthPyramid)
+		{
+			return;
+		}
+
+		std::vector<uint64_t> viewHandles = { (uint64_t)m_depthPyramidView };
+		for (const auto& mipView : m_depthPyramidMipViews)
+		{
+			viewHandles.emplace_back((uint64_t)mipView);
+		}
+
+		Renderer::SubmitResourceFree(viewHandles, [image = m_depthPyramid, allocation = m_depthPyramidAllocation, view = m_depthPyramidView, mipViews = m_depthPyramidMipViews]()
+			{
+				auto device = GraphicsContext::GetDevice();
+
+				for (const auto& mipView : mipViews)
+				{
+					vkDestroyImageView(device->GetHandle(), mipView, nullptr);
+				}
+
+				vkDestroyImageView(device->GetHandle(), view, nullptr);
+
+				VulkanAllocator allocator{ MemoryTag::GPUCulling };
+				allocator.DestroyImage(image, allocation);
+			});
+
+		m_depthPyramid = nullptr;
+		m_depthPyramidAllocation = nullptr;
+		m_depthPyramidView = nullptr;
+		m_depthPyramidMipViews.clear();
+	}
+
+	bool GPUCulling::DispatchCull(VkCommandBuffer commandBuffer)
+	{
+		m_cullPipeline->SetUniformBuffer(0, 0, m_cullDataBuffer.buffer);
+		m_cullPipeline->SetStorageBuffer(0, 1, m_drawBuffer.buffer);
+		m_cullPipeline->SetStorageBuffer(0, 2, m_countBuffer.buffer);
+		m_cullPipeline->SetStorageBuffer(0, 3, m_objectMapBuffer.buffer);
+		m_cullPipeline->SetStorageBuffer(0, 4, m_objectBuffer.buffer);
+		m_cullPipeline->SetImage(0, 5, m_depthPyramidView, m_reductionSampler, VK_IMAGE_LAYOUT_GENERAL);
+		m_cullPipeline->SetStorageBuffer(0, 6, m_occludedBuffer.buffer);
+
+		if (!m_cullPipeline->Bind(commandBuffer))
+		{
+			return false;
+		}
+
+		// The last draws have to be done with the counts and the object map, the last dispatch with the cull data and the occluded flags
+		Utility::InsertMemoryBarrier(commandBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		vkCmdFillBuffer(commandBuffer, m_countBuffer.buffer, 0, m_countBuffer.size, 0);
+
+		// The cull data is bigger than the 128 bytes of push constants every device has to support
+		vkCmdUpdateBuffer(commandBuffer, m_cullDataBuffer.buffer, 0, sizeof(DrawCullData), &m_cullData);
+
+		Utility::InsertMemoryBarrier(commandBuffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		m_cullPipeline->Dispatch(commandBuffer, (m_drawCount + s_cullGroupSize - 1) / s_cullGroupSize, 1, 1);
+
+		Utility::InsertMemoryBarrier(commandBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+
+		return true;
+	}
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include "Lamp/Rendering/UploadService.h"
+
+#include <vma/VulkanMemoryAllocator.h>
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace Lamp
+{
+	class Camera;
+	class RenderPipelineCompute;
+
+	// One mesh, every object referencing it is drawn by the same indirect count draw
+	struct CullBatch
+	{
+		uint32_t indexCount = 0;
+		uint32_t firstIndex = 0;
+		int32_t vertexOffset = 0;
+	};
+
+	struct CullObject
+	{
+		glm::mat4 transform = glm::mat4(1.f);
+		glm::vec4 sphereBounds = { 0.f, 0.f, 0.f, 1.f }; // World space center and radius
+		uint32_t batch = 0;
+	};
+
+	struct CullSettings
+	{
+		bool frustumCulling = true;
+		bool distanceCulling = true;
+		bool occlusionCulling = true;
+	};
+
+	// GPU driven submission: objects and draws live in device buffers, cull_cs compacts the visible objects of every batch
+	// and the batches are drawn with vkCmdDrawIndexedIndirectCount. Occlusion culling takes two passes: Cull tests against the pyramid
+	// of the last depth buffer, CullLate tests the draws it held back against a pyramid of the depth the early draws produced.
+	class GPUCulling
+	{
+	public:
+		GPUCulling();
+		~GPUCulling();
+
+		// Rebuilds the object and draw buffers, the upload goes through the transfer queue
+		void SetObjects(const std::vector<CullBatch>& batches, const std::vector<CullObject>& objects);
+
+		// Returns false if nothing was culled (no objects, uploads in flight or shaders loading), Draw does nothing then
+		bool Cull(VkCommandBuffer commandBuffer, const Camera& camera, const CullSettings& settings = {});
+
+		// The depth has to be in a read only layout with its writes visible to compute, the pyramid is rebuilt from it every call
+		void BuildDepthPyramid(VkCommandBuffer commandBuffer, VkImageView depthView, VkImageLayout depthLayout, uint32_t width, uint32_t height);
+
+		// Has to follow the early Draw and BuildDepthPyramid, the next Draw only draws what the early one missed.
+		// Returns false if held back draws couldn't be tested again, they are missing from the depth then.
+		bool CullLate(VkCommandBuffer commandBuffer);
+
+		// The bound pipeline reads the object buffer and object map through gl_BaseInstance + gl_DrawID.
+		// Only reads the culling state, so ranges of batches can be drawn from several threads at once.
+		void Draw(VkCommandBuffer commandBuffer, uint32_t firstBatch = 0, uint32_t batchCount = UINT32_MAX) const;
+
+		inline VkBuffer GetObjectBuffer() const { return m_objectBuffer.buffer; }
+		inline VkBuffer GetObjectMapBuffer() const { return m_objectMapBuffer.buffer; }
+		inline const uint32_t GetDrawCount() const { return m_drawCount; }
+		inline const uint32_t GetBatchCount() const { return (uint32_t)m_batchRanges.size(); }
+
+		static Ref<GPUCulling> Create();
+
+	private:
+		// Matches the shader side structs, see Common.glslh and cull_cs.glsl
+		struct ObjectData
+		{
+			glm::mat4 transform;
+			glm::vec4 sphereBounds;
+		};
+
+		struct DrawCommand
+		{
+			uint32_t indexCount;
+			uint32_t instanceCount;
+			uint32_t firstIndex;
+			int32_t vertexOffset;
+			uint32_t firstInstance;
+
+			uint32_t objectId;
+			uint32_t batchId;
+			uint32_t padding;
+		};
+
+		// Matches the std140 uniform block of cull_cs.glsl
+		struct DrawCullData
+		{
+			glm::mat4 view;
+			float P00, P11, zNear, zFar;
+			glm::vec4 frustum;
+			float lodBase, lodStep;
+			float pyramidWidth, pyramidHeight;
+
+			uint32_t drawCount;
+
+			int32_t cullingEnabled;
+			int32_t lodEnabled;
+			int32_t occlusionEnabled;
+			int32_t distCull;
+			int32_t AABBcheck;
+
+			float aabbMinX, aabbMinY, aabbMinZ;
+			float aabbMaxX, aabbMaxY, aabbMaxZ;
+
+			int32_t latePass;
+		};
+
+		struct GPUBuffer
+		{
+			VkBuffer buffer = nullptr;
+			VmaAllocation allocation = nullptr;
+			VkDeviceSize size = 0;
+		};
+
+		struct BatchRange
+		{
+			uint32_t firstDraw = 0;
+			uint32_t drawCount = 0;
+		};
+
+		// Returns true if the current buffer is big enough and was kept
+		bool EnsureBuffer(GPUBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage);
+		void ReleaseBuffer(GPUBuffer& buffer);
+
+		void CreateDepthPyramid(uint32_t width, uint32_t height);
+		void ReleaseDepthPyramid();
+
+		bool DispatchCull(VkCommandBuffer commandBuffer);
+
+		Ref<RenderPipelineCompute> m_cullPipeline;
+		Ref<RenderPipelineCompute> m_depthReducePipeline;
+
+		GPUBuffer m_objectBuffer;
+		GPUBuffer m_drawBuffer;
+		GPUBuffer m_countBuffer;
+		GPUBuffer m_objectMapBuffer;
+		GPUBuffer m_occludedBuffer;
+		GPUBuffer m_cullDataBuffer;
+
+		std::vector<BatchRange> m_batchRanges;
+		DrawCullData m_cullData{};
+		uint32_t m_drawCount = 0;
+		UploadToken m_uploadToken;
+		bool m_hasCulled = false;
+
+		VkImage m_depthPyramid = nullptr;
+		VmaAllocation m_depthPyramidAllocation = nullptr;
+		VkImageView m_depthPyramidView = nullptr;
+		std::vector<VkImageView> m_depthPyramidMipViews;
+		VkSampler m_reductionSampler = nullptr;
+
+		uint32_t m_depthPyramidWidth = 0;
+		uint32_t m_depthPyramidHeight = 0;
+		bool m_depthPyramidInitialized = false;
+		bool m_hasDepthPyramid = false;
+
+		inline static constexpr uint32_t s_cullGroupSize = 256;
+		inline static constexpr uint32_t s_reduceGroupSize = 16;
+	};
+}
@@ -0,0 +1,229 @@
+#include "lppch.h"
+#include "GPUProfiler.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+
+namespace Lamp
+{
+	static thread_local uint32_t s_scopeDepth = 0;
+
+	void GPUProfiler::Initialize(uint32_t framesInFlight)
+	{
+		auto device = GraphicsContext::GetDevice();
+		const auto& capabilities = device->GetPhysicalDevice()->GetCapabilities();
+
+		if (!capabilities.supportsTimestamps || !capabilities.supportsHostQueryReset)
+		{
+			LP_CORE_WARN("GPU profiling disabled, the graphics queue doesn't support timestamps or host query resets");
+			return;
+		}
+
+		s_timestampPeriod = (double)capabilities.timestampPeriod;
+		s_timestampMask = capabilities.timestampValidBits >= 64 ? UINT64_MAX : (1ull << capabilities.timestampValidBits) - 1;
+
+		s_frames.resize(framesInFlight);
+		for (auto& frame : s_frames)
+		{
+			VkQueryPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			poolInfo.queryCount = s_maxQueriesPerFrame;
+
+			LP_VK_CHECK(vkCreateQueryPool(device->GetHandle(), &poolInfo, nullptr, &frame.queryPool));
+			vkResetQueryPool(device->GetHandle(), frame.queryPool, 0, s_maxQueriesPerFrame);
+		}
+
+#ifdef LP_ENABLE_PROFILING
+		s_storage = Optick::RegisterStorage("GPU", uint64_t(-1), Optick::ThreadMask::GPU);
+#endif
+
+		s_isEnabled = true;
+	}
+
+	void GPUProfiler::Shutdown()
+	{
+		if (!s_isEnabled)
+		{
+			return;
+		}
+
+		auto device = GraphicsContext::GetDevice();
+		for (auto& frame : s_frames)
+		{
+			vkDestroyQueryPool(device->GetHandle(), frame.queryPool, nullptr);
+		}
+
+		s_frames.clear();
+		s_results.clear();
+		s_isEnabled = false;
+	}
+
+	void GPUProfiler::BeginFrame(uint32_t frameIndex)
+	{
+		LP_PROFILE_FUNCTION();
+
+		if (!s_isEnabled)
+		{
+			return;
+		}
+
+		std::scoped_lock lock{ s_mutex };
+
+		s_currentFrame = frameIndex;
+		auto& frame = s_frames[frameIndex];
+
+		// The frame's commands may still be executing, skip profiling it instead of waiting.
+		// A scope that was recorded but never submitted never becomes available, after a few tries its results are dropped.
+		if (!ReadResults(frame))
+		{
+			if (++frame.busyFrames < s_maxBusyFrames)
+			{
+				frame.isBusy = true;
+				return;
+			}
+
+			LP_CORE_WARN("GPU profiler results of frame {0} were not available after {1} tries, dropping them!", frameIndex, s_maxBusyFrames);
+		}
+
+		frame.isBusy = false;
+		frame.busyFrames = 0;
+		frame.scopes.clear();
+
+		if (frame.queryCount > 0)
+		{
+			vkResetQueryPool(GraphicsContext::GetDevice()->GetHandle(), frame.queryPool, 0, frame.queryCount);
+			frame.queryCount = 0;
+		}
+
+#ifdef LP_ENABLE_PROFILING
+		frame.cpuStart = Optick::GetHighPrecisionTime();
+#endif
+	}
+
+	uint32_t GPUProfiler::BeginScope(VkCommandBuffer commandBuffer, const char* name)
+	{
+		if (!s_isEnabled)
+		{
+			return InvalidScope;
+		}
+
+		std::scoped_lock lock{ s_mutex };
+
+		auto& frame = s_frames[s_currentFrame];
+
+		// Keep a query free for the end of the scope
+		if (frame.isBusy || frame.queryCount + 2 > s_maxQueriesPerFrame)
+		{
+			return InvalidScope;
+		}
+
+		auto& scope = frame.scopes.emplace_back();
+		scope.name = name;
+		scope.depth = s_scopeDepth++;
+		scope.beginQuery = frame.queryCount++;
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, scope.beginQuery);
+
+		return (uint32_t)frame.scopes.size() - 1;
+	}
+
+	void GPUProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scopeIndex)
+	{
+		if (scopeIndex == InvalidScope)
+		{
+			return;
+		}
+
+		std::scoped_lock lock{ s_mutex };
+
+		auto& frame = s_frames[s_currentFrame];
+		auto& scope = frame.scopes.at(scopeIndex);
+		scope.endQuery = frame.queryCount++;
+		s_scopeDepth--;
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, scope.endQuery);
+	}
+
+	bool GPUProfiler::ReadResults(FrameData& frame)
+	{
+		if (frame.queryCount == 0)
+		{
+			return true;
+		}
+
+		// Value and availability per query
+		std::vector<uint64_t> queryData((size_t)frame.queryCount * 2);
+
+		const VkResult result = vkGetQueryPoolResults(GraphicsContext::GetDevice()->GetHandle(), frame.queryPool, 0, frame.queryCount, queryData.size() * sizeof(uint64_t),
+			queryData.data(), sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+		{
+			LP_VK_CHECK(result);
+			return false;
+		}
+
+		for (const auto& scope : frame.scopes)
+		{
+			if (scope.endQuery == UINT32_MAX)
+			{
+				continue;
+			}
+
+			if (queryData[scope.beginQuery * 2 + 1] == 0 || queryData[scope.endQuery * 2 + 1] == 0)
+			{
+				return false;
+			}
+		}
+
+		uint64_t frameStart = UINT64_MAX;
+		for (const auto& scope : frame.scopes)
+		{
+			if (scope.endQuery != UINT32_MAX)
+			{
+				frameStart = std::min(frameStart, queryData[scope.beginQuery * 2] & s_timestampMask);
+			}
+		}
+
+		s_results.clear();
+		for (const auto& scope : frame.scopes)
+		{
+			if (scope.endQuery == UINT32_MAX)
+			{
+				LP_CORE_WARN("GPU scope {0} was never ended!", scope.name);
+				continue;
+			}
+
+			const uint64_t begin = queryData[scope.beginQuery * 2] & s_timestampMask;
+			const uint64_t end = queryData[scope.endQuery * 2] & s_timestampMask;
+			const double durationNs = (double)((end - begin) & s_timestampMask) * s_timestampPeriod;
+
+			auto& scopeResult = s_results.emplace_back();
+			scopeResult.name = scope.name;
+			scopeResult.depth = scope.depth;
+			scopeResult.durationMs = (float)(durationNs / 1000000.0);
+
+#ifdef LP_ENABLE_PROFILING
+			// GPU time is placed relative to the start of the frame's CPU recording
+			{
+				auto it = s_eventDescriptions.find(scopeResult.name);
+				if (it == s_eventDescriptions.end())
+				{
+					it = s_eventDescriptions.emplace(scopeResult.name, Optick::EventDescription::CreateShared(scope.name)).first;
+				}
+
+				const double ticksPerNs = (double)Optick::GetHighPrecisionFrequency() / 1000000000.0;
+				const int64_t cpuBegin = frame.cpuStart + (int64_t)((double)((begin - frameStart) & s_timestampMask) * s_timestampPeriod * ticksPerNs);
+				const int64_t cpuEnd = cpuBegin + (int64_t)(durationNs * ticksPerNs);
+
+				OPTICK_STORAGE_EVENT(s_storage, it->second, cpuBegin, cpuEnd);
+			}
+#endif
+		}
+
+		return true;
+	}
+}
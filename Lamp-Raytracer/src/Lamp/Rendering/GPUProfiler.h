@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Optick
+{
+	struct EventDescription;
+	struct EventStorage;
+}
+
+namespace Lamp
+{
+	struct GPUProfilerResult
+	{
+		std::string name;
+		uint32_t depth = 0;
+		float durationMs = 0.f;
+	};
+
+	// Writes timestamp queries around scopes and reads them back once the frame has come around again, so nothing ever waits on the GPU.
+	// Each frame in flight owns a query pool, results are exported to the Optick GPU storage.
+	// Only graphics queue work is timed, uploads on the transfer queue don't show up.
+	class GPUProfiler
+	{
+	public:
+		static void Initialize(uint32_t framesInFlight);
+		static void Shutdown();
+
+		// Reads back the finished results of the frame's pool and resets it for recording
+		static void BeginFrame(uint32_t frameIndex);
+
+		// Returns the scope index to end, UINT32_MAX if nothing was written
+		static uint32_t BeginScope(VkCommandBuffer commandBuffer, const char* name);
+		static void EndScope(VkCommandBuffer commandBuffer, uint32_t scopeIndex);
+
+		// Results of the last frame that was read back
+		inline static const std::vector<GPUProfilerResult>& GetResults() { return s_results; }
+		inline static const bool IsEnabled() { return s_isEnabled; }
+
+		inline static constexpr uint32_t InvalidScope = UINT32_MAX;
+
+	private:
+		GPUProfiler() = delete;
+
+		struct Scope
+		{
+			const char* name = nullptr;
+			uint32_t depth = 0;
+
+			uint32_t beginQuery = 0;
+			uint32_t endQuery = UINT32_MAX;
+		};
+
+		struct FrameData
+		{
+			VkQueryPool queryPool = nullptr;
+			uint32_t queryCount = 0;
+
+			std::vector<Scope> scopes;
+
+			// Set when the previous results weren't available yet, the pool can't be written until they are
+			bool isBusy = false;
+			uint32_t busyFrames = 0;
+			int64_t cpuStart = 0;
+		};
+
+		static bool ReadResults(FrameData& frame);
+
+		inline static constexpr uint32_t s_maxQueriesPerFrame = 512;
+		inline static constexpr uint32_t s_maxBusyFrames = 8;
+
+		inline static std::vector<FrameData> s_frames;
+		inline static std::vector<GPUProfilerResult> s_results;
+		inline static uint32_t s_currentFrame = 0;
+
+		inline static bool s_isEnabled = false;
+		inline static double s_timestampPeriod = 1.0;
+		inline static uint64_t s_timestampMask = UINT64_MAX;
+
+#ifdef LP_ENABLE_PROFILING
+		inline static Optick::EventStorage* s_storage = nullptr;
+		inline static std::unordered_map<std::string, Optick::EventDescription*> s_eventDescriptions;
+#endif
+
+		inline static std::mutex s_mutex;
+	};
+
+	class GPUProfileScope
+	{
+	public:
+		GPUProfileScope(VkCommandBuffer commandBuffer, const char* name)
+			: m_commandBuffer(commandBuffer), m_scopeIndex(GPUProfiler::BeginScope(commandBuffer, name))
+		{}
+
+		~GPUProfileScope()
+		{
+			GPUProfiler::EndScope(m_commandBuffer, m_scopeIndex);
+		}
+
+	private:
+		VkCommandBuffer m_commandBuffer;
+		uint32_t m_scopeIndex;
+	};
+}
@@ -0,0 +1,493 @@
+#include "lppch.h"
+#include "ProgressiveRenderer.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Core/Jobs/JobSystem.h"
+#include "Lamp/Rendering/Camera/Camera.h"
+#include "Lamp/Scene/Hittable.h"
+#include "Lamp/Utility/HashUtility.h"
+#include "Lamp/Utility/ImageWriter.h"
+#include "Lamp/Utility/MappedFile.h"
+#include "Lamp/Utility/TimeUtility.h"
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		// Followed by the float sums of every pixel and then their sample counts
+		struct CheckpointHeader
+		{
+			uint32_t magic = 0;
+			uint32_t version = 0;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t nextSample = 0;
+			uint32_t padding = 0;
+
+			uint64_t viewHash = 0;
+			uint64_t payloadHash = 0;
+		};
+	}
+
+	ProgressiveRenderer::ProgressiveRenderer(const CameraKeyframe& view, const std::vector<Ref<Hittable>>& objects, const ProgressiveSettings& settings)
+		: m_view(view), m_settings(settings)
+	{
+		// The scene may keep changing while the render runs
+		m_objects.reserve(objects.size());
+		for (const auto& object : objects)
+		{
+			m_objects.emplace_back(object->Clone());
+		}
+	}
+
+	ProgressiveRenderer::~ProgressiveRenderer()
+	{
+		Cancel();
+		Wait();
+	}
+
+	void ProgressiveRenderer::Start()
+	{
+		if (m_isRunning || m_tracerThread.joinable())
+		{
+			LP_CORE_WARN("Progressive render has already been started, create a new one to resume it!");
+			return;
+		}
+
+		if (m_settings.sampleCount == 0 || m_settings.width == 0 || m_settings.height == 0)
+		{
+			LP_CORE_WARN("Progressive render has no samples or pixels to render!");
+			return;
+		}
+
+		std::error_code error;
+		for (const auto& path : { m_settings.outputPath, m_settings.checkpointPath })
+		{
+			if (path.has_parent_path())
+			{
+				std::filesystem::create_directories(path.parent_path(), error);
+			}
+		}
+
+		const size_t pixelCount = (size_t)m_settings.width * m_settings.height;
+
+		m_state.nextSample = 0;
+		m_state.accumulation.assign(pixelCount, glm::vec4{ 0.f });
+		m_state.sampleCounts.assign(pixelCount, 0);
+
+		m_checkpointState.accumulation.resize(pixelCount);
+		m_checkpointState.sampleCounts.resize(pixelCount);
+
+		if (m_settings.resume && std::filesystem::exists(m_settings.checkpointPath) && LoadCheckpoint())
+		{
+			LP_CORE_INFO("Resuming progressive render {0} at sample {1}", m_settings.outputPath.string(), m_state.nextSample);
+		}
+
+		m_firstSample = m_state.nextSample;
+		m_completedSamples = m_state.nextSample;
+		m_checkpointedSamples = m_state.nextSample;
+
+		m_isRunning = true;
+
+		m_checkpointThread = std::thread(&ProgressiveRenderer::RunCheckpointWriter, this);
+		m_tracerThread = std::thread(&ProgressiveRenderer::RunTracer, this);
+	}
+
+	void ProgressiveRenderer::Cancel()
+	{
+		m_isCancelled = true;
+	}
+
+	void ProgressiveRenderer::Wait()
+	{
+		for (auto* thread : { &m_tracerThread, &m_checkpointThread })
+		{
+			if (thread->joinable())
+			{
+				thread->join();
+			}
+		}
+	}
+
+	Ref<ProgressiveRenderer> ProgressiveRenderer::Create(const CameraKeyframe& view, const std::vector<Ref<Hittable>>& objects, const ProgressiveSettings& settings)
+	{
+		return CreateRef<ProgressiveRenderer>(view, objects, settings);
+	}
+
+	bool ProgressiveRenderer::VerifyResume(const CameraKeyframe& view, const std::vector<Ref<Hittable>>& objects, const ProgressiveSettings& settings)
+	{
+		LP_PROFILE_FUNCTION();
+
+		if (settings.sampleCount < 2)
+		{
+			LP_CORE_WARN("Resume check needs at least two samples!");
+			return false;
+		}
+
+		auto withSuffix = [](const std::filesystem::path& path, const char* suffix)
+			{
+				std::filesystem::path result = path;
+				result += suffix;
+				return result;
+			};
+
+		ProgressiveSettings straightSettings = settings;
+		straightSettings.outputPath = withSuffix(settings.outputPath, ".straight");
+		straightSettings.checkpointPath = withSuffix(settings.checkpointPath, ".straight");
+		straightSettings.checkpointInterval = 0.f;
+		straightSettings.resume = false;
+
+		ProgressiveSettings resumedSettings = straightSettings;
+		resumedSettings.outputPath = withSuffix(settings.outputPath, ".resumed");
+		resumedSettings.checkpointPath = withSuffix(settings.checkpointPath, ".resumed");
+		resumedSettings.sampleCount = settings.sampleCount / 2;
+
+		// Returns the sample the render started at, the final sums end up in its checkpoint
+		auto render = [&](const ProgressiveSettings& renderSettings)
+			{
+				ProgressiveRenderer renderer{ view, objects, renderSettings };
+				renderer.Start();
+				renderer.Wait();
+
+				return renderer.m_firstSample;
+			};
+
+		render(straightSettings);
+		render(resumedSettings);
+
+		resumedSettings.sampleCount = settings.sampleCount;
+		resumedSettings.resume = true;
+		const uint32_t resumedAt = render(resumedSettings);
+
+		bool identical = false;
+
+		{
+			Ref<MappedFile> straightFile = MappedFile::Open(straightSettings.checkpointPath);
+			Ref<MappedFile> resumedFile = MappedFile::Open(resumedSettings.checkpointPath);
+
+			identical = straightFile && resumedFile && straightFile->GetSize() == resumedFile->GetSize() &&
+				memcmp(straightFile->GetData(), resumedFile->GetData(), straightFile->GetSize()) == 0;
+		}
+
+		// A failed resume renders everything again and would compare equal without testing anything
+		const bool succeeded = resumedAt == settings.sampleCount / 2 && identical;
+
+		if (succeeded)
+		{
+			LP_CORE_INFO("Resume check: {0} samples straight and {1} + {2} resumed are bit identical", settings.sampleCount, resumedAt, settings.sampleCount - resumedAt);
+		}
+		else if (!identical)
+		{
+			LP_CORE_ERROR("Resume check: {0} samples straight and {1} + {2} resumed differ!", settings.sampleCount, resumedAt, settings.sampleCount - resumedAt);
+		}
+		else
+		{
+			LP_CORE_ERROR("Resume check: the render did not resume from its checkpoint at sample {0}!", settings.sampleCount / 2);
+		}
+
+		std::error_code error;
+		for (const auto* renderSettings : { &straightSettings, &resumedSettings })
+		{
+			std::filesystem::remove(renderSettings->outputPath, error);
+			std::filesystem::remove(renderSettings->checkpointPath, error);
+		}
+
+		return succeeded;
+	}
+
+	void ProgressiveRenderer::RunTracer()
+	{
+		LP_PROFILE_THREAD("Progressive Tracer");
+
+		const uint32_t width = m_settings.width;
+		const uint32_t height = m_settings.height;
+		const uint32_t firstSample = m_firstSample;
+		const auto start = std::chrono::steady_clock::now();
+
+		auto camera = CreateRef<Camera>(m_view.fieldOfView, (float)width / (float)height, m_settings.nearPlane, m_settings.farPlane);
+		camera->SetPosition(m_view.position);
+		camera->SetRotation(m_view.rotation);
+		camera->GenerateRayDirections(width, height);
+
+		RenderSnapshot snapshot{};
+		snapshot.camera = camera;
+		snapshot.objects = m_objects;
+		snapshot.width = width;
+		snapshot.height = height;
+
+		// The view never moves, so every sample shares the same primary hits
+		RenderThread::TracePrimary(snapshot, m_gbuffer);
+
+		auto lastCheckpoint = std::chrono::steady_clock::now();
+
+		while (m_state.nextSample < m_settings.sampleCount && !m_isCancelled)
+		{
+			const uint32_t sampleIndex = m_state.nextSample;
+			const float secondsSinceCheckpoint = std::chrono::duration<float>(std::chrono::steady_clock::now() - lastCheckpoint).count();
+
+			// Skipped while the writer is still busy with the previous checkpoint, the tracer never waits on the disk
+			const bool takeCheckpoint = m_settings.checkpointInterval > 0.f && secondsSinceCheckpoint >= m_settings.checkpointInterval && !m_checkpointPending;
+
+			JobSystem::ParallelFor(height, s_rowsPerJob, [&](uint32_t beginRow, uint32_t endRow)
+				{
+					for (uint32_t y = beginRow; y < endRow; y++)
+					{
+						for (uint32_t x = 0; x < width; x++)
+						{
+							const uint32_t index = x + y * width;
+
+							// The sky is the same in every sample, one is enough
+							if (m_state.sampleCounts[index] > 0 && m_gbuffer.positions[index].w == 0.f)
+							{
+								continue;
+							}
+
+							m_state.accumulation[index] += glm::vec4{ RenderThread::ShadeSample(snapshot, m_gbuffer, index, sampleIndex), 1.f };
+							m_state.sampleCounts[index]++;
+						}
+					}
+
+					// Copied by the worker that just traced the rows, while they are still in its cache
+					if (takeCheckpoint)
+					{
+						const size_t firstPixel = (size_t)beginRow * width;
+						const size_t pixelCount = (size_t)(endRow - beginRow) * width;
+
+						memcpy(&m_checkpointState.accumulation[firstPixel], &m_state.accumulation[firstPixel], pixelCount * sizeof(glm::vec4));
+						memcpy(&m_checkpointState.sampleCounts[firstPixel], &m_state.sampleCounts[firstPixel], pixelCount * sizeof(uint32_t));
+					}
+				});
+
+			m_state.nextSample = sampleIndex + 1;
+			m_completedSamples = m_state.nextSample;
+
+			if (takeCheckpoint)
+			{
+				m_checkpointState.nextSample = m_state.nextSample;
+				m_checkpointPending = true;
+				m_checkpointRequests.Push(&m_checkpointState);
+
+				lastCheckpoint = std::chrono::steady_clock::now();
+			}
+		}
+
+		LP_CORE_INFO("Progressive render {0}: traced samples {1} to {2} in {3} ms", m_settings.outputPath.string(), firstSample, m_state.nextSample,
+			(float)Utility::MicrosecondsSince(start) / 1000.f);
+
+		if (m_state.nextSample >= m_settings.sampleCount)
+		{
+			WriteOutput();
+		}
+
+		// Nothing touches the live state anymore, so the writer can take it directly
+		if (m_state.nextSample > firstSample)
+		{
+			m_checkpointRequests.Push(&m_state);
+		}
+
+		m_checkpointRequests.Push(nullptr);
+	}
+
+	void ProgressiveRenderer::RunCheckpointWriter()
+	{
+		LP_PROFILE_THREAD("Checkpoint Writer");
+
+		while (const AccumulationState* state = m_checkpointRequests.WaitAndPop())
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			if (WriteCheckpoint(*state))
+			{
+				m_checkpointedSamples = state->nextSample;
+				m_checkpointCount++;
+			}
+
+			m_checkpointMicroseconds += Utility::MicrosecondsSince(start);
+			m_checkpointPending = false;
+		}
+
+		LP_CORE_INFO("Progressive render {0}: {1}/{2} samples, {3} checkpoints written in {4} ms", m_settings.outputPath.string(), m_checkpointedSamples.load(), m_settings.sampleCount,
+			m_checkpointCount.load(), (float)m_checkpointMicroseconds.load() / 1000.f);
+
+		m_isRunning = false;
+	}
+
+	bool ProgressiveRenderer::LoadCheckpoint()
+	{
+		LP_PROFILE_FUNCTION();
+
+		const std::string pathString = m_settings.checkpointPath.string();
+
+		Ref<MappedFile> file = MappedFile::Open(m_settings.checkpointPath);
+		if (!file || file->GetSize() < sizeof(Utility::CheckpointHeader))
+		{
+			LP_CORE_WARN("Unable to read checkpoint {0}, starting over!", pathString);
+			return false;
+		}
+
+		const uint8_t* data = (const uint8_t*)file->GetData();
+
+		Utility::CheckpointHeader header{};
+		memcpy(&header, data, sizeof(Utility::CheckpointHeader));
+
+		if (header.magic != s_checkpointMagic || header.version != s_checkpointVersion)
+		{
+			LP_CORE_WARN("{0} is not a checkpoint of this version, starting over!", pathString);
+			return false;
+		}
+
+		if (header.width != m_settings.width || header.height != m_settings.height || header.viewHash != GetViewHash())
+		{
+			LP_CORE_WARN("Checkpoint {0} was written for another view, starting over!", pathString);
+			return false;
+		}
+
+		const size_t pixelCount = (size_t)m_settings.width * m_settings.height;
+		const size_t accumulationSize = pixelCount * sizeof(glm::vec4);
+		const size_t sampleCountsSize = pixelCount * sizeof(uint32_t);
+
+		const uint8_t* payload = data + sizeof(Utility::CheckpointHeader);
+		if (file->GetSize() != sizeof(Utility::CheckpointHeader) + accumulationSize + sampleCountsSize || Utility::HashBytes(payload, accumulationSize + sampleCountsSize) != header.payloadHash)
+		{
+			LP_CORE_WARN("Checkpoint {0} is corrupted, starting over!", pathString);
+			return false;
+		}
+
+		memcpy(m_state.accumulation.data(), payload, accumulationSize);
+		memcpy(m_state.sampleCounts.data(), payload + accumulationSize, sampleCountsSize);
+		m_state.nextSample = header.nextSample;
+
+		return true;
+	}
+
+	bool ProgressiveRenderer::WriteCheckpoint(const AccumulationState& state) const
+	{
+		LP_PROFILE_FUNCTION();
+
+		const size_t accumulationSize = state.accumulation.size() * sizeof(glm::vec4);
+		const size_t sampleCountsSize = state.sampleCounts.size() * sizeof(uint32_t);
+
+		Utility::CheckpointHeader header{};
+		header.magic = s_checkpointMagic;
+		header.version = s_checkpointVersion;
+		header.width = m_settings.width;
+		header.height = m_settings.height;
+		header.nextSample = state.nextSample;
+		header.viewHash = GetViewHash();
+		header.payloadHash = Utility::HashBytes(state.sampleCounts.data(), sampleCountsSize, Utility::HashBytes(state.accumulation.data(), accumulationSize));
+
+		std::filesystem::path tempPath = m_settings.checkpointPath;
+		tempPath += ".tmp";
+
+		bool succeeded = false;
+
+		{
+			Ref<MappedFile> file = MappedFile::Create(tempPath, sizeof(Utility::CheckpointHeader) + accumulationSize + sampleCountsSize);
+			if (file)
+			{
+				uint8_t* data = (uint8_t*)file->GetData();
+
+				memcpy(data, &header, sizeof(Utility::CheckpointHeader));
+				memcpy(data + sizeof(Utility::CheckpointHeader), state.accumulation.data(), accumulationSize);
+				memcpy(data + sizeof(Utility::CheckpointHeader) + accumulationSize, state.sampleCounts.data(), sampleCountsSize);
+
+				succeeded = file->Flush();
+			}
+		}
+
+		// The previous checkpoint is only replaced once the new one is completely on disk
+		if (succeeded)
+		{
+			succeeded = MappedFile::Replace(tempPath, m_settings.checkpointPath);
+		}
+
+		if (!succeeded)
+		{
+			LP_CORE_ERROR("Failed to write checkpoint {0}!", m_settings.checkpointPath.string());
+
+			std::error_code error;
+			std::filesystem::remove(tempPath, error);
+		}
+
+		return succeeded;
+	}
+
+	bool ProgressiveRenderer::WriteOutput() const
+	{
+		LP_PROFILE_FUNCTION();
+
+		const size_t pixelCount = m_state.accumulation.size();
+
+		std::vector<float> hdrPixels(pixelCount * 4);
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			const glm::vec4 color = m_state.sampleCounts[i] > 0 ? m_state.accumulation[i] / (float)m_state.sampleCounts[i] : glm::vec4{ 0.f };
+			memcpy(&hdrPixels[i * 4], &color, sizeof(glm::vec4));
+		}
+
+		std::filesystem::path tempPath = m_settings.outputPath;
+		tempPath += ".tmp";
+
+		bool succeeded = false;
+		if (m_settings.format == CaptureFormat::PNG)
+		{
+			std::vector<uint8_t> pixels(hdrPixels.size());
+			for (size_t i = 0; i < hdrPixels.size(); i++)
+			{
+				pixels[i] = (uint8_t)std::lround(glm::clamp(hdrPixels[i], 0.f, 1.f) * 255.f);
+			}
+
+			succeeded = ImageWriter::WritePNG(tempPath, m_settings.width, m_settings.height, pixels.data());
+		}
+		else
+		{
+			// Samples are shaded display encoded, EXR stores linear color
+			for (size_t i = 0; i < pixelCount; i++)
+			{
+				for (size_t channel = 0; channel < 3; channel++)
+				{
+					hdrPixels[i * 4 + channel] = ImageWriter::SRGBToLinear(hdrPixels[i * 4 + channel]);
+				}
+			}
+
+			succeeded = ImageWriter::WriteEXR(tempPath, m_settings.width, m_settings.height, hdrPixels.data());
+		}
+
+		std::error_code error;
+		if (succeeded)
+		{
+			std::filesystem::rename(tempPath, m_settings.outputPath, error);
+			succeeded = !error;
+		}
+
+		if (!succeeded)
+		{
+			LP_CORE_ERROR("Failed to write progressive render {0}!", m_settings.outputPath.string());
+			std::filesystem::remove(tempPath, error);
+		}
+
+		return succeeded;
+	}
+
+	uint64_t ProgressiveRenderer::GetViewHash() const
+	{
+		const uint64_t objectCount = (uint64_t)m_objects.size();
+
+		uint64_t hash = Utility::HashBytes(&m_view.position, sizeof(glm::vec3));
+		hash = Utility::HashBytes(&m_view.rotation, sizeof(glm::vec3), hash);
+		hash = Utility::HashBytes(&m_view.fieldOfView, sizeof(float), hash);
+		hash = Utility::HashBytes(&m_settings.nearPlane, sizeof(float), hash);
+		hash = Utility::HashBytes(&m_settings.farPlane, sizeof(float), hash);
+		hash = Utility::HashBytes(&objectCount, sizeof(uint64_t), hash);
+
+		// Moving, resizing or reordering an object invalidates the checkpoint
+		for (const auto& object : m_objects)
+		{
+			const uint64_t contentHash = object->GetContentHash();
+			hash = Utility::HashBytes(&contentHash, sizeof(uint64_t), hash);
+		}
+
+		return hash;
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include "Lamp/Rendering/Camera/CameraPath.h"
+#include "Lamp/Rendering/FrameCapture.h"
+#include "Lamp/Rendering/RenderThread.h"
+#include "Lamp/Utility/ThreadSafeQueue.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+namespace Lamp
+{
+	class Hittable;
+
+	struct ProgressiveSettings
+	{
+		std::filesystem::path outputPath = "Renders/Render.exr";
+		std::filesystem::path checkpointPath = "Renders/Render.checkpoint";
+		CaptureFormat format = CaptureFormat::EXR;
+
+		uint32_t sampleCount = 4096;
+		uint32_t width = 1280;
+		uint32_t height = 720;
+
+		float nearPlane = 0.1f;
+		float farPlane = 100.f;
+
+		// Seconds between checkpoints, zero only writes one when the render stops
+		float checkpointInterval = 60.f;
+
+		// Continues from the checkpoint when it was written for the same view and size, a higher sample count keeps refining it
+		bool resume = true;
+	};
+
+	// Accumulates samples of a still view until the sample count is reached. The sums, the per pixel sample counts and the index of
+	// the next sample are checkpointed to a memory mapped file on a writer thread, the tracer only copies its rows out while tracing them.
+	// Samples are counter based and summed in the same order, so a resumed render ends up bit identical to an uninterrupted one.
+	class ProgressiveRenderer
+	{
+	public:
+		ProgressiveRenderer(const CameraKeyframe& view, const std::vector<Ref<Hittable>>& objects, const ProgressiveSettings& settings);
+		~ProgressiveRenderer();
+
+		void Start();
+		void Cancel();
+
+		// Blocks until the render has finished or was cancelled and its last checkpoint is on disk
+		void Wait();
+
+		inline const bool IsRunning() const { return m_isRunning.load(); }
+		inline const uint32_t GetCompletedSamples() const { return m_completedSamples.load(); }
+		inline const uint32_t GetCheckpointedSamples() const { return m_checkpointedSamples.load(); }
+		inline const uint32_t GetSampleCount() const { return m_settings.sampleCount; }
+
+		static Ref<ProgressiveRenderer> Create(const CameraKeyframe& view, const std::vector<Ref<Hittable>>& objects, const ProgressiveSettings& settings);
+
+		// Renders the sample count straight through, then half of it and resumes from that checkpoint for the rest.
+		// Returns true if both final checkpoints are byte identical, the files go next to the given paths and are removed again.
+		static bool VerifyResume(const CameraKeyframe& view, const std::vector<Ref<Hittable>>& objects, const ProgressiveSettings& settings);
+
+	private:
+		struct AccumulationState
+		{
+			uint32_t nextSample = 0; // The sampler is counter based, this is all of its state
+
+			std::vector<glm::vec4> accumulation;
+			std::vector<uint32_t> sampleCounts;
+		};
+
+		void RunTracer();
+		void RunCheckpointWriter();
+
+		bool LoadCheckpoint();
+		bool WriteCheckpoint(const AccumulationState& state) const;
+		bool WriteOutput() const;
+
+		uint64_t GetViewHash() const;
+
+		CameraKeyframe m_view;
+		std::vector<Ref<const Hittable>> m_objects;
+		ProgressiveSettings m_settings;
+
+		AccumulationState m_state;
+		AccumulationState m_checkpointState;
+		GBufferFrame m_gbuffer;
+
+		// A null state stops the writer
+		ThreadSafeQueue<const AccumulationState*> m_checkpointRequests;
+
+		std::thread m_tracerThread;
+		std::thread m_checkpointThread;
+
+		std::atomic<bool> m_isRunning = false;
+		std::atomic<bool> m_isCancelled = false;
+		std::atomic<bool> m_checkpointPending = false;
+
+		uint32_t m_firstSample = 0;
+
+		std::atomic<uint32_t> m_completedSamples = 0;
+		std::atomic<uint32_t> m_checkpointedSamples = 0;
+		std::atomic<uint32_t> m_checkpointCount = 0;
+		std::atomic<uint64_t> m_checkpointMicroseconds = 0;
+
+		inline static constexpr uint32_t s_rowsPerJob = 8;
+		inline static constexpr uint32_t s_checkpointMagic = 0x4b43504c; // "LPCK"
+		inline static constexpr uint32_t s_checkpointVersion = 1;
+	};
+}
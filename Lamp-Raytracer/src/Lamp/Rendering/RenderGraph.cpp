@@ -0,0 +1,644 @@
+#include "lppch.h"
+#include "RenderGraph.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+#include "Lamp/Core/Graphics/VulkanAllocator.h"
+
+#include "Lamp/Rendering/Renderer.h"
+#include "Lamp/Rendering/Texture/Image2D.h"
+#include "Lamp/Rendering/Texture/ImageTransitionBatcher.h"
+
+#include "Lamp/Utility/ImageUtility.h"
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		struct RenderGraphUsageInfo
+		{
+			VkImageLayout layout;
+			VkPipelineStageFlags stages;
+			VkAccessFlags access;
+			VkImageUsageFlags imageUsage;
+			bool isWrite;
+		};
+
+		static RenderGraphUsageInfo GetUsageInfo(RenderGraphResourceUsage usage)
+		{
+			switch (usage)
+			{
+				case RenderGraphResourceUsage::ColorAttachment:
+					return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true };
+
+				case RenderGraphResourceUsage::DepthAttachment:
+					return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true };
+
+				case RenderGraphResourceUsage::DepthRead:
+					return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT, false };
+
+				case RenderGraphResourceUsage::SampledFragment:
+					return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT, false };
+
+				case RenderGraphResourceUsage::SampledCompute:
+					return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT, false };
+
+				case RenderGraphResourceUsage::StorageRead:
+					return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_STORAGE_BIT, false };
+
+				case RenderGraphResourceUsage::StorageWrite:
+					return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_USAGE_STORAGE_BIT, true };
+
+				case RenderGraphResourceUsage::TransferSrc:
+					return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false };
+
+				case RenderGraphResourceUsage::TransferDst:
+					return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true };
+			}
+
+			LP_CORE_ASSERT(false, "Resource usage not supported!");
+			return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, 0, true };
+		}
+
+		static VkAttachmentLoadOp RenderGraphLoadOp(ClearMode clearMode)
+		{
+			switch (clearMode)
+			{
+				case ClearMode::Clear: return VK_ATTACHMENT_LOAD_OP_CLEAR;
+				case ClearMode::Load: return VK_ATTACHMENT_LOAD_OP_LOAD;
+				case ClearMode::DontCare: return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			}
+
+			return VK_ATTACHMENT_LOAD_OP_LOAD;
+		}
+
+		static constexpr VkAccessFlags s_writeAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	}
+
+	RenderGraph::PassBuilder::PassBuilder(RenderGraph& graph, uint32_t passIndex)
+		: m_graph(graph), m_passIndex(passIndex)
+	{
+	}
+
+	void RenderGraph::PassBuilder::Read(RenderGraphImageHandle image, RenderGraphResourceUsage usage)
+	{
+		LP_CORE_ASSERT(!Utility::GetUsageInfo(usage).isWrite, "Usage is not a read!");
+		m_graph.AddAccess(m_passIndex, image, usage);
+	}
+
+	void RenderGraph::PassBuilder::Write(RenderGraphImageHandle image, RenderGraphResourceUsage usage)
+	{
+		LP_CORE_ASSERT(Utility::GetUsageInfo(usage).isWrite, "Usage is not a write!");
+		m_graph.AddAccess(m_passIndex, image, usage);
+	}
+
+	void RenderGraph::PassBuilder::WriteColorAttachment(RenderGraphImageHandle image, ClearMode clearMode, const glm::vec4& clearColor)
+	{
+		m_graph.AddAccess(m_passIndex, image, RenderGraphResourceUsage::ColorAttachment);
+
+		auto& attachment = m_graph.m_passes[m_passIndex].colorAttachments.emplace_back();
+		attachment.image = image;
+		attachment.clearMode = clearMode;
+		attachment.clearColor = clearColor;
+	}
+
+	void RenderGraph::PassBuilder::WriteDepthAttachment(RenderGraphImageHandle image, ClearMode clearMode)
+	{
+		m_graph.AddAccess(m_passIndex, image, RenderGraphResourceUsage::DepthAttachment);
+
+		auto& attachment = m_graph.m_passes[m_passIndex].depthAttachment;
+		attachment.image = image;
+		attachment.clearMode = clearMode;
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		Release();
+	}
+
+	RenderGraphImageHandle RenderGraph::CreateTransientImage(const RenderGraphImageSpecification& specification)
+	{
+		LP_CORE_ASSERT(!m_isCompiled, "Unable to add images to a compiled graph!");
+
+		auto& resource = m_images.emplace_back();
+		resource.specification = specification;
+		resource.aspectMask = Utility::IsDepthFormat(specification.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+
+		return (RenderGraphImageHandle)m_images.size() - 1;
+	}
+
+	RenderGraphImageHandle RenderGraph::ImportImage(Ref<Image2D> image)
+	{
+		LP_CORE_ASSERT(!m_isCompiled, "Unable to add images to a compiled graph!");
+
+		auto& resource = m_images.emplace_back();
+		resource.importedImage = image;
+		resource.specification.format = image->GetFormat();
+		resource.specification.width = image->GetWidth();
+		resource.specification.height = image->GetHeight();
+		resource.aspectMask = Utility::IsDepthFormat(image->GetFormat()) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+
+		return (RenderGraphImageHandle)m_images.size() - 1;
+	}
+
+	void RenderGraph::SetFinalUsage(RenderGraphImageHandle image, RenderGraphResourceUsage usage)
+	{
+		LP_CORE_ASSERT(m_images.at(image).importedImage, "Only imported images outlive the graph!");
+
+		m_images.at(image).hasFinalUsage = true;
+		m_images.at(image).finalUsage = usage;
+	}
+
+	void RenderGraph::AddPass(const std::string& name, SetupFunction&& setup, ExecuteFunction&& execute)
+	{
+		LP_CORE_ASSERT(!m_isCompiled, "Unable to add passes to a compiled graph!");
+
+		auto& pass = m_passes.emplace_back();
+		pass.name = name;
+		pass.execute = std::move(execute);
+
+		PassBuilder builder{ *this, (uint32_t)m_passes.size() - 1 };
+		setup(builder);
+	}
+
+	void RenderGraph::AddParallelPass(const std::string& name, uint32_t taskCount, SetupFunction&& setup, ParallelExecuteFunction&& execute)
+	{
+		LP_CORE_ASSERT(!m_isCompiled, "Unable to add passes to a compiled graph!");
+
+		auto& pass = m_passes.emplace_back();
+		pass.name = name;
+		pass.taskCount = taskCount;
+		pass.parallelExecute = std::move(execute);
+
+		PassBuilder builder{ *this, (uint32_t)m_passes.size() - 1 };
+		setup(builder);
+	}
+
+	void RenderGraph::Compile()
+	{
+		LP_PROFILE_FUNCTION();
+
+		Release();
+
+		auto device = GraphicsContext::GetDevice();
+
+		m_stats = {};
+		m_stats.passCount = (uint32_t)m_passes.size();
+
+		for (auto& resource : m_images)
+		{
+			if (resource.importedImage || resource.firstPass == UINT32_MAX)
+			{
+				continue;
+			}
+
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.usage = resource.usage;
+			imageInfo.extent.width = resource.specification.width;
+			imageInfo.extent.height = resource.specification.height;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.format = Utility::LampToVulkanFormat(resource.specification.format);
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			LP_VK_CHECK(vkCreateImage(device->GetHandle(), &imageInfo, nullptr, &resource.image));
+			vkGetImageMemoryRequirements(device->GetHandle(), resource.image, &resource.memoryRequirements);
+
+			m_stats.transientImageCount++;
+			m_stats.unaliasedTransientMemory += resource.memoryRequirements.size;
+		}
+
+		AssignMemorySlots();
+
+		VulkanAllocator allocator{ MemoryTag::RenderGraph };
+		for (auto& slot : m_memorySlots)
+		{
+			slot.allocation = allocator.AllocateMemory(slot.requirements, VMA_MEMORY_USAGE_GPU_ONLY);
+			m_stats.transientMemory += slot.requirements.size;
+		}
+
+		m_stats.memorySlotCount = (uint32_t)m_memorySlots.size();
+
+		for (auto& resource : m_images)
+		{
+			if (!resource.image)
+			{
+				continue;
+			}
+
+			allocator.BindImageMemory(m_memorySlots[resource.memorySlot].allocation, resource.image);
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = Utility::LampToVulkanFormat(resource.specification.format);
+			viewInfo.image = resource.image;
+			viewInfo.subresourceRange = { resource.aspectMask, 0, 1, 0, 1 };
+
+			LP_VK_CHECK(vkCreateImageView(device->GetHandle(), &viewInfo, nullptr, &resource.view));
+		}
+
+		m_isCompiled = true;
+
+		LP_CORE_INFO("Render graph compiled {0} passes, {1} transient images in {2} bytes ({3} bytes without aliasing)", m_stats.passCount, m_stats.transientImageCount, m_stats.transientMemory, m_stats.unaliasedTransientMemory);
+	}
+
+	void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+	{
+		LP_PROFILE_FUNCTION();
+		LP_CORE_ASSERT(m_isCompiled, "The graph has to be compiled before it is executed!");
+
+		m_stats.imageBarrierCount = 0;
+		m_stats.barrierBatchCount = 0;
+
+		// Transient contents never survive a frame, their first access waits on whatever last used the memory
+		for (auto& resource : m_images)
+		{
+			resource.state = {};
+
+			if (resource.importedImage)
+			{
+				ImageTransitionBatcher::Record(commandBuffer, resource.importedImage->GetHandle());
+
+				resource.state.layout = resource.importedImage->GetLayout();
+				resource.state.writeStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+				resource.state.writeAccess = VK_ACCESS_MEMORY_WRITE_BIT;
+			}
+			else if (resource.memorySlot != UINT32_MAX)
+			{
+				const auto& slot = m_memorySlots[resource.memorySlot];
+				resource.state.writeStages = slot.stages;
+				resource.state.writeAccess = slot.writeAccess;
+			}
+		}
+
+		std::vector<VkImageMemoryBarrier> barriers;
+
+		for (const auto& pass : m_passes)
+		{
+			VkPipelineStageFlags srcStages = 0;
+			VkPipelineStageFlags dstStages = 0;
+
+			for (const auto& access : pass.accesses)
+			{
+				TransitionImage(m_images[access.image], access.usage, barriers, srcStages, dstStages);
+			}
+
+			FlushBarriers(commandBuffer, barriers, srcStages, dstStages);
+
+			const bool hasAttachments = !pass.colorAttachments.empty() || pass.depthAttachment.image != InvalidHandle;
+			if (hasAttachments)
+			{
+				BeginRendering(commandBuffer, pass, pass.parallelExecute ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0);
+			}
+
+			if (pass.parallelExecute)
+			{
+				ExecuteParallel(commandBuffer, pass, hasAttachments);
+			}
+			else
+			{
+				pass.execute(commandBuffer, *this);
+			}
+
+			if (hasAttachments)
+			{
+				vkCmdEndRendering(commandBuffer);
+			}
+		}
+
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+
+		for (auto& resource : m_images)
+		{
+			if (resource.importedImage && resource.hasFinalUsage)
+			{
+				TransitionImage(resource, resource.finalUsage, barriers, srcStages, dstStages);
+			}
+		}
+
+		FlushBarriers(commandBuffer, barriers, srcStages, dstStages);
+
+		for (auto& resource : m_images)
+		{
+			if (resource.importedImage)
+			{
+				resource.importedImage->m_imageLayout = resource.state.layout;
+			}
+		}
+	}
+
+	VkImage RenderGraph::GetImage(RenderGraphImageHandle image) const
+	{
+		const auto& resource = m_images.at(image);
+		return resource.importedImage ? resource.importedImage->GetHandle() : resource.image;
+	}
+
+	VkImageView RenderGraph::GetView(RenderGraphImageHandle image) const
+	{
+		const auto& resource = m_images.at(image);
+		return resource.importedImage ? resource.importedImage->GetView() : resource.view;
+	}
+
+	Ref<RenderGraph> RenderGraph::Create()
+	{
+		return CreateRef<RenderGraph>();
+	}
+
+	void RenderGraph::AddAccess(uint32_t passIndex, RenderGraphImageHandle image, RenderGraphResourceUsage usage)
+	{
+		LP_CORE_ASSERT(image < m_images.size(), "Invalid image handle!");
+
+		m_passes[passIndex].accesses.emplace_back(ImageAccess{ image, usage });
+
+		auto& resource = m_images[image];
+		resource.firstPass = std::min(resource.firstPass, passIndex);
+		resource.lastPass = std::max(resource.lastPass, passIndex);
+		resource.usage |= Utility::GetUsageInfo(usage).imageUsage;
+	}
+
+	void RenderGraph::AssignMemorySlots()
+	{
+		std::vector<uint32_t> transientImages;
+		for (uint32_t i = 0; i < (uint32_t)m_images.size(); i++)
+		{
+			if (m_images[i].image)
+			{
+				transientImages.emplace_back(i);
+			}
+		}
+
+		// Placing the largest images first keeps the slots from growing as later residents move in
+		std::sort(transientImages.begin(), transientImages.end(), [&](uint32_t lhs, uint32_t rhs)
+			{
+				if (m_images[lhs].firstPass != m_images[rhs].firstPass)
+				{
+					return m_images[lhs].firstPass < m_images[rhs].firstPass;
+				}
+
+				return m_images[lhs].memoryRequirements.size > m_images[rhs].memoryRequirements.size;
+			});
+
+		for (const uint32_t index : transientImages)
+		{
+			auto& resource = m_images[index];
+			const auto& requirements = resource.memoryRequirements;
+
+			// Best fit among the slots whose residents are all done before this image is first used
+			uint32_t bestSlot = UINT32_MAX;
+			for (uint32_t i = 0; i < (uint32_t)m_memorySlots.size(); i++)
+			{
+				const auto& slot = m_memorySlots[i];
+				if (slot.lastPass >= resource.firstPass || (slot.requirements.memoryTypeBits & requirements.memoryTypeBits) == 0)
+				{
+					continue;
+				}
+
+				if (bestSlot == UINT32_MAX)
+				{
+					bestSlot = i;
+					continue;
+				}
+
+				const VkDeviceSize bestSize = m_memorySlots[bestSlot].requirements.size;
+				const bool fits = slot.requirements.size >= requirements.size;
+				const bool bestFits = bestSize >= requirements.size;
+
+				if ((fits && (!bestFits || slot.requirements.size < bestSize)) || (!fits && !bestFits && slot.requirements.size > bestSize))
+				{
+					bestSlot = i;
+				}
+			}
+
+			if (bestSlot == UINT32_MAX)
+			{
+				bestSlot = (uint32_t)m_memorySlots.size();
+				auto& slot = m_memorySlots.emplace_back();
+				slot.requirements = requirements;
+			}
+
+			auto& slot = m_memorySlots[bestSlot];
+			slot.requirements.size = std::max(slot.requirements.size, requirements.size);
+			slot.requirements.alignment = std::max(slot.requirements.alignment, requirements.alignment);
+			slot.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+			slot.lastPass = resource.lastPass;
+
+			for (const auto& pass : m_passes)
+			{
+				for (const auto& access : pass.accesses)
+				{
+					if (access.image == index)
+					{
+						const auto usageInfo = Utility::GetUsageInfo(access.usage);
+						slot.stages |= usageInfo.stages;
+						slot.writeAccess |= usageInfo.access & Utility::s_writeAccessMask;
+					}
+				}
+			}
+
+			resource.memorySlot = bestSlot;
+		}
+	}
+
+	void RenderGraph::Release()
+	{
+		if (!m_isCompiled)
+		{
+			return;
+		}
+
+		std::vector<std::pair<VkImage, VkImageView>> images;
+		std::vector<uint64_t> viewHandles;
+
+		for (auto& resource : m_images)
+		{
+			if (resource.image)
+			{
+				images.emplace_back(resource.image, resource.view);
+				viewHandles.emplace_back((uint64_t)resource.view);
+			}
+
+			resource.image = nullptr;
+			resource.view = nullptr;
+			resource.memorySlot = UINT32_MAX;
+		}
+
+		std::vector<VmaAllocation> allocations;
+		for (const auto& slot : m_memorySlots)
+		{
+			allocations.emplace_back(slot.allocation);
+		}
+
+		Renderer::SubmitResourceFree(viewHandles, [images, allocations]()
+			{
+				auto device = GraphicsContext::GetDevice();
+
+				for (const auto& [image, view] : images)
+				{
+					vkDestroyImageView(device->GetHandle(), view, nullptr);
+					vkDestroyImage(device->GetHandle(), image, nullptr);
+				}
+
+				VulkanAllocator allocator{ MemoryTag::RenderGraph };
+				for (const auto& allocation : allocations)
+				{
+					allocator.Free(allocation);
+				}
+			});
+
+		m_memorySlots.clear();
+		m_isCompiled = false;
+	}
+
+	void RenderGraph::TransitionImage(ImageResource& resource, RenderGraphResourceUsage usage, std::vector<VkImageMemoryBarrier>& outBarriers, VkPipelineStageFlags& outSrcStages, VkPipelineStageFlags& outDstStages)
+	{
+		auto usageInfo = Utility::GetUsageInfo(usage);
+		auto& state = resource.state;
+
+		if (usage == RenderGraphResourceUsage::DepthAttachment && resource.specification.format == ImageFormat::DEPTH32F)
+		{
+			usageInfo.layout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+		}
+
+		const bool hasPreviousAccess = state.writeStages != 0 || state.readStages != 0;
+		const bool layoutChanged = state.layout != usageInfo.layout;
+		const bool writeHazard = usageInfo.isWrite && hasPreviousAccess;
+		const bool notVisible = state.writeAccess != 0 && (usageInfo.stages & ~state.visibleStages) != 0;
+
+		if (!layoutChanged && !writeHazard && !notVisible)
+		{
+			state.readStages |= usageInfo.stages;
+			return;
+		}
+
+		VkImageMemoryBarrier& barrier = outBarriers.emplace_back();
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.srcAccessMask = state.writeAccess;
+		barrier.dstAccessMask = usageInfo.access;
+		barrier.oldLayout = state.layout;
+		barrier.newLayout = usageInfo.layout;
+		barrier.image = resource.importedImage ? resource.importedImage->GetHandle() : resource.image;
+		barrier.subresourceRange = { resource.aspectMask, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+		if (resource.specification.format == ImageFormat::DEPTH24STENCIL8)
+		{
+			barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+
+		const VkPipelineStageFlags srcStages = state.writeStages | state.readStages;
+		outSrcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		outDstStages |= usageInfo.stages;
+
+		state.layout = usageInfo.layout;
+		state.visibleStages = usageInfo.stages;
+
+		if (usageInfo.isWrite)
+		{
+			state.writeStages = usageInfo.stages;
+			state.writeAccess = usageInfo.access & Utility::s_writeAccessMask;
+			state.readStages = 0;
+		}
+		else
+		{
+			state.readStages = usageInfo.stages;
+		}
+	}
+
+	void RenderGraph::FlushBarriers(VkCommandBuffer commandBuffer, std::vector<VkImageMemoryBarrier>& barriers, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages)
+	{
+		if (barriers.empty())
+		{
+			return;
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, (uint32_t)barriers.size(), barriers.data());
+
+		m_stats.imageBarrierCount += (uint32_t)barriers.size();
+		m_stats.barrierBatchCount++;
+
+		barriers.clear();
+	}
+
+	void RenderGraph::BeginRendering(VkCommandBuffer commandBuffer, const Pass& pass, VkRenderingFlags flags)
+	{
+		std::vector<VkRenderingAttachmentInfo> colorAttachments;
+		VkExtent2D extent{ 0, 0 };
+
+		for (const auto& attachment : pass.colorAttachments)
+		{
+			const auto& resource = m_images[attachment.image];
+			extent = { resource.specification.width, resource.specification.height };
+
+			VkRenderingAttachmentInfo& info = colorAttachments.emplace_back();
+			info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			info.imageView = GetView(attachment.image);
+			info.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			info.loadOp = Utility::RenderGraphLoadOp(attachment.clearMode);
+			info.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			info.clearValue.color = { attachment.clearColor.x, attachment.clearColor.y, attachment.clearColor.z, attachment.clearColor.w };
+		}
+
+		VkRenderingAttachmentInfo depthAttachment{};
+		if (pass.depthAttachment.image != InvalidHandle)
+		{
+			const auto& resource = m_images[pass.depthAttachment.image];
+			extent = { resource.specification.width, resource.specification.height };
+
+			depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			depthAttachment.imageView = GetView(pass.depthAttachment.image);
+			depthAttachment.imageLayout = resource.state.layout;
+			depthAttachment.loadOp = Utility::RenderGraphLoadOp(pass.depthAttachment.clearMode);
+			depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			depthAttachment.clearValue.depthStencil = { 1.f, 0 };
+		}
+
+		VkRenderingInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		renderingInfo.flags = flags;
+		renderingInfo.renderArea = { { 0, 0 }, extent };
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = (uint32_t)colorAttachments.size();
+		renderingInfo.pColorAttachments = colorAttachments.data();
+		renderingInfo.pDepthAttachment = pass.depthAttachment.image != InvalidHandle ? &depthAttachment : nullptr;
+
+		vkCmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+
+	void RenderGraph::ExecuteParallel(VkCommandBuffer commandBuffer, const Pass& pass, bool hasAttachments)
+	{
+		LP_PROFILE_SCOPE(pass.name.c_str());
+
+		std::vector<VkFormat> colorFormats;
+		for (const auto& attachment : pass.colorAttachments)
+		{
+			colorFormats.emplace_back(Utility::LampToVulkanFormat(m_images[attachment.image].specification.format));
+		}
+
+		VkCommandBufferInheritanceRenderingInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+		renderingInfo.colorAttachmentCount = (uint32_t)colorFormats.size();
+		renderingInfo.pColorAttachmentFormats = colorFormats.data();
+		renderingInfo.depthAttachmentFormat = pass.depthAttachment.image != InvalidHandle ? Utility::LampToVulkanFormat(m_images[pass.depthAttachment.image].specification.format) : VK_FORMAT_UNDEFINED;
+		renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.pNext = hasAttachments ? &renderingInfo : nullptr;
+
+		Renderer::RecordSecondary(commandBuffer, pass.taskCount, inheritanceInfo, [&](VkCommandBuffer secondaryCommandBuffer, uint32_t taskIndex)
+			{
+				pass.parallelExecute(secondaryCommandBuffer, taskIndex, *this);
+			});
+	}
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include "Lamp/Rendering/Framebuffer.h"
+#include "Lamp/Rendering/Texture/ImageCommon.h"
+
+#include <vma/VulkanMemoryAllocator.h>
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Lamp
+{
+	class Image2D;
+
+	using RenderGraphImageHandle = uint32_t;
+
+	enum class RenderGraphResourceUsage : uint32_t
+	{
+		ColorAttachment = 0,
+		DepthAttachment,
+		DepthRead,
+		SampledFragment,
+		SampledCompute,
+		StorageRead,
+		StorageWrite,
+		TransferSrc,
+		TransferDst
+	};
+
+	struct RenderGraphImageSpecification
+	{
+		ImageFormat format = ImageFormat::RGBA;
+		uint32_t width = 1280;
+		uint32_t height = 720;
+
+		std::string debugName;
+	};
+
+	struct RenderGraphStats
+	{
+		uint32_t passCount = 0;
+		uint32_t transientImageCount = 0;
+		uint32_t memorySlotCount = 0;
+
+		uint32_t imageBarrierCount = 0;
+		uint32_t barrierBatchCount = 0;
+
+		uint64_t transientMemory = 0;
+		uint64_t unaliasedTransientMemory = 0;
+	};
+
+	// Passes declare the images they read and write, the graph inserts the barriers between them.
+	// Transient images only live inside the graph, and share memory when their pass ranges don't overlap.
+	// The only graph built so far is the hybrid G-buffer pass in GBufferPass. Framebuffer, ImageBarrier and Utility::TransitionImageLayout
+	// still manage their own layouts and aren't tracked by any graph.
+	class RenderGraph
+	{
+	public:
+		class PassBuilder
+		{
+		public:
+			void Read(RenderGraphImageHandle image, RenderGraphResourceUsage usage);
+			void Write(RenderGraphImageHandle image, RenderGraphResourceUsage usage);
+
+			// Attachments are bound with dynamic rendering before the pass is executed
+			void WriteColorAttachment(RenderGraphImageHandle image, ClearMode clearMode = ClearMode::Clear, const glm::vec4& clearColor = { 0.f, 0.f, 0.f, 0.f });
+			void WriteDepthAttachment(RenderGraphImageHandle image, ClearMode clearMode = ClearMode::Clear);
+
+		private:
+			friend class RenderGraph;
+
+			PassBuilder(RenderGraph& graph, uint32_t passIndex);
+
+			RenderGraph& m_graph;
+			uint32_t m_passIndex;
+		};
+
+		using SetupFunction = std::function<void(PassBuilder&)>;
+		using ExecuteFunction = std::function<void(VkCommandBuffer, const RenderGraph&)>;
+		using ParallelExecuteFunction = std::function<void(VkCommandBuffer, uint32_t taskIndex, const RenderGraph&)>;
+
+		RenderGraph() = default;
+		~RenderGraph();
+
+		RenderGraphImageHandle CreateTransientImage(const RenderGraphImageSpecification& specification);
+		RenderGraphImageHandle ImportImage(Ref<Image2D> image);
+
+		// Imported images are left in this usage after the last pass, e.g. SampledFragment for displaying
+		void SetFinalUsage(RenderGraphImageHandle image, RenderGraphResourceUsage usage);
+
+		void AddPass(const std::string& name, SetupFunction&& setup, ExecuteFunction&& execute);
+
+		// The tasks are recorded into secondary command buffers on the job workers, and executed in task order
+		void AddParallelPass(const std::string& name, uint32_t taskCount, SetupFunction&& setup, ParallelExecuteFunction&& execute);
+
+		// Creates the transient images and assigns their memory. The graph can then be executed every frame.
+		void Compile();
+		void Execute(VkCommandBuffer commandBuffer);
+
+		VkImage GetImage(RenderGraphImageHandle image) const;
+		VkImageView GetView(RenderGraphImageHandle image) const;
+
+		inline const RenderGraphStats& GetStats() const { return m_stats; }
+		inline const bool IsCompiled() const { return m_isCompiled; }
+
+		static Ref<RenderGraph> Create();
+
+		inline static constexpr RenderGraphImageHandle InvalidHandle = UINT32_MAX;
+
+	private:
+		struct ImageAccess
+		{
+			RenderGraphImageHandle image = InvalidHandle;
+			RenderGraphResourceUsage usage = RenderGraphResourceUsage::SampledFragment;
+		};
+
+		struct AttachmentInfo
+		{
+			RenderGraphImageHandle image = InvalidHandle;
+			ClearMode clearMode = ClearMode::Clear;
+			glm::vec4 clearColor = { 0.f, 0.f, 0.f, 0.f };
+		};
+
+		struct Pass
+		{
+			std::string name;
+
+			std::vector<ImageAccess> accesses;
+			std::vector<AttachmentInfo> colorAttachments;
+			AttachmentInfo depthAttachment;
+
+			ExecuteFunction execute;
+
+			uint32_t taskCount = 0;
+			ParallelExecuteFunction parallelExecute;
+		};
+
+		struct ImageState
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			VkPipelineStageFlags writeStages = 0;
+			VkAccessFlags writeAccess = 0;
+
+			VkPipelineStageFlags readStages = 0;
+			VkPipelineStageFlags visibleStages = 0;
+		};
+
+		struct ImageResource
+		{
+			RenderGraphImageSpecification specification;
+			Ref<Image2D> importedImage;
+
+			VkImage image = nullptr;
+			VkImageView view = nullptr;
+			VkImageUsageFlags usage = 0;
+			VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			VkMemoryRequirements memoryRequirements{};
+
+			uint32_t firstPass = UINT32_MAX;
+			uint32_t lastPass = 0;
+			uint32_t memorySlot = UINT32_MAX;
+
+			bool hasFinalUsage = false;
+			RenderGraphResourceUsage finalUsage = RenderGraphResourceUsage::SampledFragment;
+
+			ImageState state;
+		};
+
+		struct MemorySlot
+		{
+			VkMemoryRequirements requirements{};
+			uint32_t lastPass = 0;
+
+			// Everything the residents do to the memory, the first access of a resident has to wait for all of it
+			VkPipelineStageFlags stages = 0;
+			VkAccessFlags writeAccess = 0;
+
+			VmaAllocation allocation = nullptr;
+		};
+
+		void AddAccess(uint32_t passIndex, RenderGraphImageHandle image, RenderGraphResourceUsage usage);
+		void AssignMemorySlots();
+		void Release();
+
+		void TransitionImage(ImageResource& resource, RenderGraphResourceUsage usage, std::vector<VkImageMemoryBarrier>& outBarriers, VkPipelineStageFlags& outSrcStages, VkPipelineStageFlags& outDstStages);
+		void FlushBarriers(VkCommandBuffer commandBuffer, std::vector<VkImageMemoryBarrier>& barriers, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages);
+		void BeginRendering(VkCommandBuffer commandBuffer, const Pass& pass, VkRenderingFlags flags);
+		void ExecuteParallel(VkCommandBuffer commandBuffer, const Pass& pass, bool hasAttachments);
+
+		std::vector<Pass> m_passes;
+		std::vector<ImageResource> m_images;
+		std::vector<MemorySlot> m_memorySlots;
+
+		RenderGraphStats m_stats;
+		bool m_isCompiled = false;
+	};
+}
@@ -0,0 +1,178 @@
+#include "lppch.h"
+#include "RenderPipelineCompute.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+
+#include "Lamp/Rendering/BindlessRegistry.h"
+#include "Lamp/Rendering/Renderer.h"
+#include "Lamp/Rendering/Shader/Shader.h"
+
+namespace Lamp
+{
+	RenderPipelineCompute::RenderPipelineCompute(const std::string& shaderName)
+		: m_shaderName(shaderName), m_shaderHandle(ShaderRegistry::Get(shaderName))
+	{
+		LP_CORE_ASSERT(m_shaderHandle, "Compute shader is not registered!");
+	}
+
+	RenderPipelineCompute::~RenderPipelineCompute()
+	{
+		Release();
+	}
+
+	void RenderPipelineCompute::SetUniformBuffer(uint32_t set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		m_bufferInfos[set][binding] = { buffer, offset, range };
+	}
+
+	void RenderPipelineCompute::SetStorageBuffer(uint32_t set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		m_bufferInfos[set][binding] = { buffer, offset, range };
+	}
+
+	void RenderPipelineCompute::SetImage(uint32_t set, uint32_t binding, VkImageView view, VkSampler sampler, VkImageLayout layout)
+	{
+		m_imageInfos[set][binding] = { sampler, view, layout };
+	}
+
+	void RenderPipelineCompute::SetStorageImage(uint32_t set, uint32_t binding, VkImageView view, VkImageLayout layout)
+	{
+		m_imageInfos[set][binding] = { nullptr, view, layout };
+	}
+
+	bool RenderPipelineCompute::Bind(VkCommandBuffer commandBuffer)
+	{
+		LP_PROFILE_FUNCTION();
+
+		Ref<Shader> shader = m_shaderHandle.Get();
+		if (!shader || !shader->IsValid())
+		{
+			return false;
+		}
+
+		if (shader != m_shader)
+		{
+			Invalidate(shader);
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+
+		const auto& resources = m_shader->GetResources();
+		for (const auto& [set, bindings] : resources.writeDescriptors)
+		{
+			std::vector<VkWriteDescriptorSet> writes;
+			writes.reserve(bindings.size());
+
+			for (const auto& [binding, writeTemplate] : bindings)
+			{
+				VkWriteDescriptorSet& write = writes.emplace_back(writeTemplate);
+
+				switch (write.descriptorType)
+				{
+					case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+					case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+					case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+					case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+					{
+						LP_CORE_ASSERT(m_bufferInfos[set].find(binding) != m_bufferInfos[set].end(), "No buffer set for binding!");
+						write.pBufferInfo = &m_bufferInfos[set][binding];
+						break;
+					}
+
+					default:
+					{
+						LP_CORE_ASSERT(m_imageInfos[set].find(binding) != m_imageInfos[set].end(), "No image set for binding!");
+						write.pImageInfo = &m_imageInfos[set][binding];
+						break;
+					}
+				}
+			}
+
+			VkDescriptorSet descriptorSet = Renderer::GetDescriptorSet(resources.paddedSetLayouts[set], writes);
+
+			// Dynamic buffers are bound at their start, the offset is baked into the buffer info instead
+			std::vector<uint32_t> dynamicOffsets;
+			if (auto it = resources.dynamicBufferOffsets.find(set); it != resources.dynamicBufferOffsets.end())
+			{
+				dynamicOffsets.resize(it->second.size(), 0);
+			}
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, set, 1, &descriptorSet, (uint32_t)dynamicOffsets.size(), dynamicOffsets.data());
+		}
+
+		// The bindless set is owned by the registry and never written here
+		if (resources.usesBindless)
+		{
+			BindlessRegistry::Bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout);
+		}
+
+		return true;
+	}
+
+	void RenderPipelineCompute::PushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size)
+	{
+		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, size, data);
+	}
+
+	void RenderPipelineCompute::Dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+	{
+		vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+	}
+
+	Ref<RenderPipelineCompute> RenderPipelineCompute::Create(const std::string& shaderName)
+	{
+		return CreateRef<RenderPipelineCompute>(shaderName);
+	}
+
+	void RenderPipelineCompute::Invalidate(Ref<Shader> shader)
+	{
+		LP_PROFILE_FUNCTION();
+
+		Release();
+		m_shader = shader;
+
+		auto device = GraphicsContext::GetDevice();
+		const auto& resources = m_shader->GetResources();
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = (uint32_t)resources.paddedSetLayouts.size();
+		layoutInfo.pSetLayouts = resources.paddedSetLayouts.data();
+		layoutInfo.pushConstantRangeCount = (uint32_t)resources.pushConstantRanges.size();
+		layoutInfo.pPushConstantRanges = resources.pushConstantRanges.data();
+
+		LP_VK_CHECK(vkCreatePipelineLayout(device->GetHandle(), &layoutInfo, nullptr, &m_pipelineLayout));
+
+		LP_CORE_ASSERT(m_shader->GetStageInfos().size() == 1 && m_shader->GetStageInfos().front().stage == VK_SHADER_STAGE_COMPUTE_BIT, "Shader is not a compute shader!");
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = m_shader->GetStageInfos().front();
+		pipelineInfo.layout = m_pipelineLayout;
+
+		LP_VK_CHECK(vkCreateComputePipelines(device->GetHandle(), device->GetPipelineCache(), 1, &pipelineInfo, nullptr, &m_pipeline));
+	}
+
+	void RenderPipelineCompute::Release()
+	{
+		if (!m_pipeline)
+		{
+			return;
+		}
+
+		// Frames in flight may still be using the old pipeline
+		Renderer::SubmitResourceFree([pipeline = m_pipeline, pipelineLayout = m_pipelineLayout]()
+			{
+				auto device = GraphicsContext::GetDevice();
+				vkDestroyPipeline(device->GetHandle(), pipeline, nullptr);
+				vkDestroyPipelineLayout(device->GetHandle(), pipelineLayout, nullptr);
+			});
+
+		m_pipeline = nullptr;
+		m_pipelineLayout = nullptr;
+		m_shader = nullptr;
+	}
+}
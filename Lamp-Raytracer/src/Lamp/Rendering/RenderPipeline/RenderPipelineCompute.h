@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include "Lamp/Rendering/Shader/ShaderRegistry.h"
+
+#include <vulkan/vulkan.h>
+
+#include <map>
+#include <string>
+
+namespace Lamp
+{
+	class Shader;
+
+	// Compute pipeline created from a registered shader. The pipeline is recreated when the shader is hot reloaded,
+	// descriptor sets are fetched from the frame's descriptor cache on every bind.
+	class RenderPipelineCompute
+	{
+	public:
+		RenderPipelineCompute(const std::string& shaderName);
+		~RenderPipelineCompute();
+
+		void SetUniformBuffer(uint32_t set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		void SetStorageBuffer(uint32_t set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		void SetImage(uint32_t set, uint32_t binding, VkImageView view, VkSampler sampler, VkImageLayout layout);
+		void SetStorageImage(uint32_t set, uint32_t binding, VkImageView view, VkImageLayout layout);
+
+		// Returns false while the shader is still loading, nothing is recorded then
+		bool Bind(VkCommandBuffer commandBuffer);
+		void PushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size);
+		void Dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+
+		inline const std::string& GetShaderName() const { return m_shaderName; }
+
+		static Ref<RenderPipelineCompute> Create(const std::string& shaderName);
+
+	private:
+		void Invalidate(Ref<Shader> shader);
+		void Release();
+
+		std::string m_shaderName;
+		ShaderHandle m_shaderHandle;
+		Ref<Shader> m_shader;
+
+		VkPipeline m_pipeline = nullptr;
+		VkPipelineLayout m_pipelineLayout = nullptr;
+
+		std::map<uint32_t, std::map<uint32_t, VkDescriptorBufferInfo>> m_bufferInfos; // set -> binding -> info
+		std::map<uint32_t, std::map<uint32_t, VkDescriptorImageInfo>> m_imageInfos; // set -> binding -> info
+	};
+}
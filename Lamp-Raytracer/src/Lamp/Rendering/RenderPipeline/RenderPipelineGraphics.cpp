@@ -0,0 +1,292 @@
+#include "lppch.h"
+#include "RenderPipelineGraphics.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+
+#include "Lamp/Rendering/BindlessRegistry.h"
+#include "Lamp/Rendering/Renderer.h"
+#include "Lamp/Rendering/Shader/Shader.h"
+
+#include "Lamp/Utility/ImageUtility.h"
+
+#include <array>
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		static uint32_t VertexFormatSize(VkFormat format)
+		{
+			switch (format)
+			{
+				case VK_FORMAT_R32_SFLOAT: return 4;
+				case VK_FORMAT_R32G32_SFLOAT: return 8;
+				case VK_FORMAT_R32G32B32_SFLOAT: return 12;
+				case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+				case VK_FORMAT_R32_UINT: return 4;
+				case VK_FORMAT_R32G32B32A32_UINT: return 16;
+			}
+
+			LP_CORE_ASSERT(false, "Vertex format not supported!");
+			return 0;
+		}
+	}
+
+	RenderPipelineGraphics::RenderPipelineGraphics(const RenderPipelineGraphicsSpecification& specification)
+		: m_specification(specification), m_shaderHandle(ShaderRegistry::Get(specification.shaderName))
+	{
+		LP_CORE_ASSERT(m_shaderHandle, "Graphics shader is not registered!");
+	}
+
+	RenderPipelineGraphics::~RenderPipelineGraphics()
+	{
+		Release();
+	}
+
+	void RenderPipelineGraphics::SetUniformBuffer(uint32_t set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		m_bufferInfos[set][binding] = { buffer, offset, range };
+	}
+
+	void RenderPipelineGraphics::SetStorageBuffer(uint32_t set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		m_bufferInfos[set][binding] = { buffer, offset, range };
+	}
+
+	void RenderPipelineGraphics::SetImage(uint32_t set, uint32_t binding, VkImageView view, VkSampler sampler, VkImageLayout layout)
+	{
+		m_imageInfos[set][binding] = { sampler, view, layout };
+	}
+
+	bool RenderPipelineGraphics::Bind(VkCommandBuffer commandBuffer)
+	{
+		LP_PROFILE_FUNCTION();
+
+		if (!Prepare())
+		{
+			return false;
+		}
+
+		BindPrepared(commandBuffer);
+		return true;
+	}
+
+	bool RenderPipelineGraphics::Prepare()
+	{
+		LP_PROFILE_FUNCTION();
+
+		Ref<Shader> shader = m_shaderHandle.Get();
+		if (!shader || !shader->IsValid())
+		{
+			return false;
+		}
+
+		if (shader != m_shader)
+		{
+			Invalidate(shader);
+		}
+
+		m_preparedSets.clear();
+
+		const auto& resources = m_shader->GetResources();
+		for (const auto& [set, bindings] : resources.writeDescriptors)
+		{
+			std::vector<VkWriteDescriptorSet> writes;
+			writes.reserve(bindings.size());
+
+			for (const auto& [binding, writeTemplate] : bindings)
+			{
+				VkWriteDescriptorSet& write = writes.emplace_back(writeTemplate);
+
+				switch (write.descriptorType)
+				{
+					case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+					case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+					case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+					case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+					{
+						LP_CORE_ASSERT(m_bufferInfos[set].find(binding) != m_bufferInfos[set].end(), "No buffer set for binding!");
+						write.pBufferInfo = &m_bufferInfos[set][binding];
+						break;
+					}
+
+					default:
+					{
+						LP_CORE_ASSERT(m_imageInfos[set].find(binding) != m_imageInfos[set].end(), "No image set for binding!");
+						write.pImageInfo = &m_imageInfos[set][binding];
+						break;
+					}
+				}
+			}
+
+			PreparedSet& preparedSet = m_preparedSets.emplace_back();
+			preparedSet.set = set;
+			preparedSet.descriptorSet = Renderer::GetDescriptorSet(resources.paddedSetLayouts[set], writes);
+
+			if (auto it = resources.dynamicBufferOffsets.find(set); it != resources.dynamicBufferOffsets.end())
+			{
+				preparedSet.dynamicOffsetCount = (uint32_t)it->second.size();
+			}
+		}
+
+		return true;
+	}
+
+	void RenderPipelineGraphics::BindPrepared(VkCommandBuffer commandBuffer) const
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+
+		for (const auto& preparedSet : m_preparedSets)
+		{
+			// Dynamic buffers are bound at their start, the offset is baked into the buffer info instead
+			const std::vector<uint32_t> dynamicOffsets(preparedSet.dynamicOffsetCount, 0);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, preparedSet.set, 1, &preparedSet.descriptorSet, (uint32_t)dynamicOffsets.size(), dynamicOffsets.data());
+		}
+
+		if (m_shader->GetResources().usesBindless)
+		{
+			BindlessRegistry::Bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout);
+		}
+	}
+
+	Ref<RenderPipelineGraphics> RenderPipelineGraphics::Create(const RenderPipelineGraphicsSpecification& specification)
+	{
+		return CreateRef<RenderPipelineGraphics>(specification);
+	}
+
+	void RenderPipelineGraphics::Invalidate(Ref<Shader> shader)
+	{
+		LP_PROFILE_FUNCTION();
+
+		Release();
+		m_shader = shader;
+
+		auto device = GraphicsContext::GetDevice();
+		const auto& resources = m_shader->GetResources();
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = (uint32_t)resources.paddedSetLayouts.size();
+		layoutInfo.pSetLayouts = resources.paddedSetLayouts.data();
+		layoutInfo.pushConstantRangeCount = (uint32_t)resources.pushConstantRanges.size();
+		layoutInfo.pPushConstantRanges = resources.pushConstantRanges.data();
+
+		LP_VK_CHECK(vkCreatePipelineLayout(device->GetHandle(), &layoutInfo, nullptr, &m_pipelineLayout));
+
+		std::vector<VkVertexInputAttributeDescription> attributes;
+		uint32_t stride = 0;
+
+		for (uint32_t location = 0; location < (uint32_t)m_specification.vertexAttributes.size(); location++)
+		{
+			const VkFormat format = m_specification.vertexAttributes[location];
+			attributes.emplace_back(VkVertexInputAttributeDescription{ location, 0, format, stride });
+
+			stride += Utility::VertexFormatSize(format);
+		}
+
+		const VkVertexInputBindingDescription binding{ 0, stride, VK_VERTEX_INPUT_RATE_VERTEX };
+
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexBindingDescriptionCount = attributes.empty() ? 0 : 1;
+		vertexInputInfo.pVertexBindingDescriptions = &binding;
+		vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributes.size();
+		vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo{};
+		inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkPipelineViewportStateCreateInfo viewportInfo{};
+		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportInfo.viewportCount = 1;
+		viewportInfo.scissorCount = 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterizationInfo{};
+		rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizationInfo.cullMode = m_specification.cullMode;
+		rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		rasterizationInfo.lineWidth = 1.f;
+
+		VkPipelineMultisampleStateCreateInfo multisampleInfo{};
+		multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineDepthStencilStateCreateInfo depthStencilInfo{};
+		depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencilInfo.depthTestEnable = m_specification.depthTest ? VK_TRUE : VK_FALSE;
+		depthStencilInfo.depthWriteEnable = m_specification.depthWrite ? VK_TRUE : VK_FALSE;
+		depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(m_specification.colorFormats.size());
+		std::vector<VkFormat> colorFormats;
+
+		for (uint32_t i = 0; i < (uint32_t)m_specification.colorFormats.size(); i++)
+		{
+			blendAttachments[i].blendEnable = VK_FALSE;
+			blendAttachments[i].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+			colorFormats.emplace_back(Utility::LampToVulkanFormat(m_specification.colorFormats[i]));
+		}
+
+		VkPipelineColorBlendStateCreateInfo colorBlendInfo{};
+		colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlendInfo.attachmentCount = (uint32_t)blendAttachments.size();
+		colorBlendInfo.pAttachments = blendAttachments.data();
+
+		const std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicStateInfo{};
+		dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicStateInfo.dynamicStateCount = (uint32_t)dynamicStates.size();
+		dynamicStateInfo.pDynamicStates = dynamicStates.data();
+
+		// Dynamic rendering, the attachment formats replace the render pass
+		VkPipelineRenderingCreateInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+		renderingInfo.colorAttachmentCount = (uint32_t)colorFormats.size();
+		renderingInfo.pColorAttachmentFormats = colorFormats.data();
+		renderingInfo.depthAttachmentFormat = m_specification.depthFormat != ImageFormat::None ? Utility::LampToVulkanFormat(m_specification.depthFormat) : VK_FORMAT_UNDEFINED;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = &renderingInfo;
+		pipelineInfo.stageCount = (uint32_t)m_shader->GetStageInfos().size();
+		pipelineInfo.pStages = m_shader->GetStageInfos().data();
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
+		pipelineInfo.pViewportState = &viewportInfo;
+		pipelineInfo.pRasterizationState = &rasterizationInfo;
+		pipelineInfo.pMultisampleState = &multisampleInfo;
+		pipelineInfo.pDepthStencilState = &depthStencilInfo;
+		pipelineInfo.pColorBlendState = &colorBlendInfo;
+		pipelineInfo.pDynamicState = &dynamicStateInfo;
+		pipelineInfo.layout = m_pipelineLayout;
+
+		LP_VK_CHECK(vkCreateGraphicsPipelines(device->GetHandle(), device->GetPipelineCache(), 1, &pipelineInfo, nullptr, &m_pipeline));
+	}
+
+	void RenderPipelineGraphics::Release()
+	{
+		if (!m_pipeline)
+		{
+			return;
+		}
+
+		// Frames in flight may still be using the old pipeline
+		Renderer::SubmitResourceFree([pipeline = m_pipeline, pipelineLayout = m_pipelineLayout]()
+			{
+				auto device = GraphicsContext::GetDevice();
+				vkDestroyPipeline(device->GetHandle(), pipeline, nullptr);
+				vkDestroyPipelineLayout(device->GetHandle(), pipelineLayout, nullptr);
+			});
+
+		m_pipeline = nullptr;
+		m_pipelineLayout = nullptr;
+		m_shader = nullptr;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include "Lamp/Rendering/Shader/ShaderRegistry.h"
+#include "Lamp/Rendering/Texture/ImageCommon.h"
+
+#include <vulkan/vulkan.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Lamp
+{
+	class Shader;
+
+	struct RenderPipelineGraphicsSpecification
+	{
+		std::string shaderName;
+
+		std::vector<ImageFormat> colorFormats;
+		ImageFormat depthFormat = ImageFormat::None;
+
+		// Attributes are tightly packed into one vertex binding, in location order
+		std::vector<VkFormat> vertexAttributes;
+
+		VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+		bool depthTest = true;
+		bool depthWrite = true;
+	};
+
+	// Graphics pipeline created from a registered shader for dynamic rendering. Like RenderPipelineCompute the pipeline is recreated
+	// when the shader is hot reloaded, and descriptor sets are fetched from the frame's descriptor cache on every bind.
+	// Viewport and scissor are dynamic state.
+	class RenderPipelineGraphics
+	{
+	public:
+		RenderPipelineGraphics(const RenderPipelineGraphicsSpecification& specification);
+		~RenderPipelineGraphics();
+
+		void SetUniformBuffer(uint32_t set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		void SetStorageBuffer(uint32_t set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		void SetImage(uint32_t set, uint32_t binding, VkImageView view, VkSampler sampler, VkImageLayout layout);
+
+		// Returns false while the shader is still loading, nothing is recorded then
+		bool Bind(VkCommandBuffer commandBuffer);
+
+		// Bind in two steps: Prepare fetches the descriptor sets on the calling thread, BindPrepared only records
+		// and may run on the job workers, e.g. once for every secondary command buffer of a parallel pass
+		bool Prepare();
+		void BindPrepared(VkCommandBuffer commandBuffer) const;
+
+		inline const RenderPipelineGraphicsSpecification& GetSpecification() const { return m_specification; }
+
+		static Ref<RenderPipelineGraphics> Create(const RenderPipelineGraphicsSpecification& specification);
+
+	private:
+		struct PreparedSet
+		{
+			uint32_t set = 0;
+			VkDescriptorSet descriptorSet = nullptr;
+			uint32_t dynamicOffsetCount = 0;
+		};
+
+		void Invalidate(Ref<Shader> shader);
+		void Release();
+
+		RenderPipelineGraphicsSpecification m_specification;
+		ShaderHandle m_shaderHandle;
+		Ref<Shader> m_shader;
+
+		VkPipeline m_pipeline = nullptr;
+		VkPipelineLayout m_pipelineLayout = nullptr;
+
+		std::map<uint32_t, std::map<uint32_t, VkDescriptorBufferInfo>> m_bufferInfos; // set -> binding -> info
+		std::map<uint32_t, std::map<uint32_t, VkDescriptorImageInfo>> m_imageInfos; // set -> binding -> info
+
+		std::vector<PreparedSet> m_preparedSets;
+	};
+}
@@ -0,0 +1,338 @@
+#include "lppch.h"
+#include "RenderThread.h"
+
+#include "Lamp/Core/Jobs/JobSystem.h"
+#include "Lamp/Rendering/Camera/Camera.h"
+
+#include "Lamp/Scene/Hittable.h"
+#include "Lamp/Math/Ray.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <chrono>
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		const uint32_t ColorToRGBA(const glm::vec4& color)
+		{
+			const uint8_t r = static_cast<uint8_t>(color.r * 255.f);
+			const uint8_t g = static_cast<uint8_t>(color.g * 255.f);
+			const uint8_t b = static_cast<uint8_t>(color.b * 255.f);
+			const uint8_t a = static_cast<uint8_t>(color.a * 255.f);
+
+			const uint32_t col = (a << 24) | (b << 16) | (g << 8) | r;
+			return col;
+		}
+
+		inline glm::vec3 SkyColor(const glm::vec3& direction)
+		{
+			const float t = 0.5f * (direction.y + 1.f);
+			return glm::mix(glm::vec3{ 0.5f, 0.7f, 1.f }, glm::vec3{ 0.f }, t);
+		}
+
+		inline bool TraceClosest(const std::vector<Ref<const Hittable>>& objects, const Ray& ray, float minT, float maxT, RaycastHit& outHit)
+		{
+			bool hasHit = false;
+			for (const auto& obj : objects)
+			{
+				RaycastHit hit{};
+				if (obj->HitTest(ray, minT, maxT, hit))
+				{
+					maxT = hit.distance;
+					outHit = hit;
+					hasHit = true;
+				}
+			}
+
+			return hasHit;
+		}
+
+		inline bool TraceAny(const std::vector<Ref<const Hittable>>& objects, const Ray& ray, float minT, float maxT)
+		{
+			RaycastHit hit{};
+			for (const auto& obj : objects)
+			{
+				if (obj->HitTest(ray, minT, maxT, hit))
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		// PCG hash, keeps the bounce direction of a pixel stable between frames
+		inline uint32_t HashUInt(uint32_t value)
+		{
+			const uint32_t state = value * 747796405u + 2891336453u;
+			const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+			return (word >> 22u) ^ word;
+		}
+
+		inline glm::vec3 CosineSampleHemisphere(const glm::vec3& normal, uint32_t seed)
+		{
+			const uint32_t hashA = HashUInt(seed);
+			const uint32_t hashB = HashUInt(hashA);
+
+			const float u1 = (float)hashA / 4294967296.f;
+			const float u2 = (float)hashB / 4294967296.f;
+
+			const float r = std::sqrt(u1);
+			const float phi = 2.f * glm::pi<float>() * u2;
+
+			const glm::vec3 tangent = glm::normalize(std::abs(normal.x) > 0.9f ? glm::cross(normal, glm::vec3{ 0.f, 1.f, 0.f }) : glm::cross(normal, glm::vec3{ 1.f, 0.f, 0.f }));
+			const glm::vec3 bitangent = glm::cross(normal, tangent);
+
+			return glm::normalize(tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * std::sqrt(std::max(0.f, 1.f - u1)));
+		}
+	}
+
+	RenderThread::RenderThread()
+	{
+		m_thread = std::thread(&RenderThread::Run, this);
+	}
+
+	RenderThread::~RenderThread()
+	{
+		m_running = false;
+
+		m_snapshotVersion.fetch_add(1);
+		m_snapshotVersion.notify_one();
+
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+	void RenderThread::SubmitSnapshot(Ref<const RenderSnapshot> snapshot)
+	{
+		m_snapshot.store(snapshot);
+
+		m_snapshotVersion.fetch_add(1);
+		m_snapshotVersion.notify_one();
+	}
+
+	const TracedFrame* RenderThread::AcquireLatestFrame()
+	{
+		if (!m_frames.Consume())
+		{
+			return nullptr;
+		}
+
+		return &m_frames.GetReadBuffer();
+	}
+
+	Ref<RenderThread> RenderThread::Create()
+	{
+		return CreateRef<RenderThread>();
+	}
+
+	void RenderThread::Run()
+	{
+		LP_PROFILE_THREAD("Render Thread");
+
+		uint64_t tracedVersion = 0;
+
+		while (m_running)
+		{
+			// Sleep until a newer snapshot than the one last traced arrives
+			m_snapshotVersion.wait(tracedVersion);
+			tracedVersion = m_snapshotVersion.load();
+
+			if (!m_running)
+			{
+				break;
+			}
+
+			// Intermediate snapshots submitted while tracing are skipped, only the latest is traced
+			Ref<const RenderSnapshot> snapshot = m_snapshot.load();
+			if (!snapshot)
+			{
+				continue;
+			}
+
+			Trace(*snapshot, m_tracedGBuffer, m_frames.GetWriteBuffer());
+			m_frames.Publish();
+		}
+	}
+
+	void RenderThread::Trace(const RenderSnapshot& snapshot, GBufferFrame& scratchGBuffer, TracedFrame& frame)
+	{
+		LP_PROFILE_FUNCTION();
+
+		frame.width = snapshot.width;
+		frame.height = snapshot.height;
+		frame.pixels.resize((size_t)snapshot.width * snapshot.height);
+		frame.timings = {};
+
+		const auto start = std::chrono::steady_clock::now();
+
+		if (!snapshot.traceSecondary)
+		{
+			TraceNormals(snapshot, frame);
+			frame.timings.primaryMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return;
+		}
+
+		frame.timings.tracedSecondary = true;
+
+		// A G-buffer of another size belongs to an older frame, the primary rays are traced instead
+		const GBufferFrame* gbuffer = snapshot.gbuffer.get();
+		if (!gbuffer || gbuffer->width != snapshot.width || gbuffer->height != snapshot.height)
+		{
+			TracePrimary(snapshot, scratchGBuffer);
+			gbuffer = &scratchGBuffer;
+		}
+		else
+		{
+			frame.timings.usedGBuffer = true;
+		}
+
+		const auto primaryEnd = std::chrono::steady_clock::now();
+
+		TraceSecondary(snapshot, *gbuffer, frame);
+
+		const auto end = std::chrono::steady_clock::now();
+
+		frame.timings.primaryMs = std::chrono::duration<float, std::milli>(primaryEnd - start).count();
+		frame.timings.secondaryMs = std::chrono::duration<float, std::milli>(end - primaryEnd).count();
+	}
+
+	void RenderThread::TracePrimary(const RenderSnapshot& snapshot, GBufferFrame& gbuffer)
+	{
+		LP_PROFILE_FUNCTION();
+
+		const uint32_t width = snapshot.width;
+		const uint32_t height = snapshot.height;
+
+		gbuffer.width = width;
+		gbuffer.height = height;
+		gbuffer.positions.resize((size_t)width * height);
+		gbuffer.normals.resize((size_t)width * height);
+
+		const glm::vec3 origin = snapshot.camera->GetPosition();
+
+		// Rows are traced in batches across the job workers, this thread helps out while waiting
+		JobSystem::ParallelFor(height, s_rowsPerJob, [&](uint32_t beginRow, uint32_t endRow)
+			{
+				for (uint32_t y = beginRow; y < endRow; y++)
+				{
+					for (uint32_t x = 0; x < width; x++)
+					{
+						const uint32_t index = x + y * width;
+						const Ray ray = { origin, snapshot.camera->GetRayDirectionAt(index) };
+
+						RaycastHit hit{};
+						if (Utility::TraceClosest(snapshot.objects, ray, 0.f, s_maxDistance, hit))
+						{
+							gbuffer.positions[index] = { hit.position, 1.f };
+							gbuffer.normals[index] = { hit.normal, 0.f };
+						}
+						else
+						{
+							gbuffer.positions[index] = { 0.f, 0.f, 0.f, 0.f };
+							gbuffer.normals[index] = { 0.f, 0.f, 0.f, 0.f };
+						}
+					}
+				}
+			});
+	}
+
+	void RenderThread::TraceNormals(const RenderSnapshot& snapshot, TracedFrame& frame)
+	{
+		LP_PROFILE_FUNCTION();
+
+		const uint32_t width = snapshot.width;
+		const uint32_t height = snapshot.height;
+
+		const glm::vec3 origin = snapshot.camera->GetPosition();
+
+		JobSystem::ParallelFor(height, s_rowsPerJob, [&](uint32_t beginRow, uint32_t endRow)
+			{
+				for (uint32_t y = beginRow; y < endRow; y++)
+				{
+					for (uint32_t x = 0; x < width; x++)
+					{
+						const uint32_t index = x + y * width;
+						const glm::vec3& rayDir = snapshot.camera->GetRayDirectionAt(index);
+
+						glm::vec3 color;
+						RaycastHit hit{};
+						if (Utility::TraceClosest(snapshot.objects, Ray{ origin, rayDir }, 0.f, s_maxDistance, hit))
+						{
+							color = 0.5f * (hit.normal + 1.f);
+						}
+						else
+						{
+							color = Utility::SkyColor(rayDir);
+						}
+
+						frame.pixels[index] = Utility::ColorToRGBA({ color, 1.f });
+					}
+				}
+			});
+	}
+
+	void RenderThread::TraceSecondary(const RenderSnapshot& snapshot, const GBufferFrame& gbuffer, TracedFrame& frame)
+	{
+		LP_PROFILE_FUNCTION();
+
+		const uint32_t width = snapshot.width;
+		const uint32_t height = snapshot.height;
+
+		JobSystem::ParallelFor(height, s_rowsPerJob, [&](uint32_t beginRow, uint32_t endRow)
+			{
+				for (uint32_t y = beginRow; y < endRow; y++)
+				{
+					for (uint32_t x = 0; x < width; x++)
+					{
+						const uint32_t index = x + y * width;
+
+						const glm::vec3 color = glm::clamp(ShadeSample(snapshot, gbuffer, index, 0), 0.f, 1.f);
+						frame.pixels[index] = Utility::ColorToRGBA({ color, 1.f });
+					}
+				}
+			});
+	}
+
+	glm::vec3 RenderThread::ShadeSample(const RenderSnapshot& snapshot, const GBufferFrame& gbuffer, uint32_t index, uint32_t sampleIndex)
+	{
+		if (gbuffer.positions[index].w == 0.f)
+		{
+			return Utility::SkyColor(snapshot.camera->GetRayDirectionAt(index));
+		}
+
+		const glm::vec3 position = glm::vec3(gbuffer.positions[index]);
+		const glm::vec3 normal = glm::normalize(glm::vec3(gbuffer.normals[index]));
+		const glm::vec3 albedo = 0.5f * (normal + 1.f);
+
+		// Offset along the normal so the rays don't hit the surface they start on
+		const glm::vec3 origin = position + normal * s_rayOffset;
+
+		float direct = 0.f;
+		const float NdotL = glm::dot(normal, s_lightDirection);
+		if (NdotL > 0.f && !Utility::TraceAny(snapshot.objects, Ray{ origin, s_lightDirection }, 0.f, s_maxDistance))
+		{
+			direct = NdotL;
+		}
+
+		// Every sample index permutes the pixel seeds differently, so each pass gets a new direction per pixel
+		const glm::vec3 bounceDirection = Utility::CosineSampleHemisphere(normal, index ^ Utility::HashUInt(sampleIndex));
+
+		glm::vec3 indirect;
+		RaycastHit bounceHit{};
+		if (Utility::TraceClosest(snapshot.objects, Ray{ origin, bounceDirection }, 0.f, s_maxDistance, bounceHit))
+		{
+			indirect = 0.5f * (bounceHit.normal + 1.f) * s_bounceAlbedo;
+		}
+		else
+		{
+			indirect = Utility::SkyColor(bounceDirection);
+		}
+
+		return albedo * (direct * s_directIntensity + indirect * s_indirectIntensity);
+	}
+}
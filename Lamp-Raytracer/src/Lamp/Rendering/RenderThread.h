@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include "Lamp/Utility/Mailbox.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace Lamp
+{
+	class Camera;
+	class Hittable;
+
+	// First hits of the camera rays, either traced on the CPU or read back from a raster G-buffer
+	struct GBufferFrame
+	{
+		std::vector<glm::vec4> positions; // World position, w is 1 where a surface was hit
+		std::vector<glm::vec4> normals;
+
+		uint32_t width = 0;
+		uint32_t height = 0;
+
+		uint64_t version = 0; // Inputs a raster G-buffer was rendered from, see GBufferPass
+	};
+
+	// Immutable view of everything needed to trace one frame
+	struct RenderSnapshot
+	{
+		Ref<const Camera> camera;
+		std::vector<Ref<const Hittable>> objects;
+
+		// When set, primary rays are skipped and only shadow and bounce rays are traced from its surfaces
+		Ref<const GBufferFrame> gbuffer;
+
+		// Hybrid shading traces shadow and bounce rays from the first hits, otherwise a single ray per pixel is shaded by its normal
+		bool traceSecondary = false;
+
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	struct TraceTimings
+	{
+		float primaryMs = 0.f;
+		float secondaryMs = 0.f;
+		bool usedGBuffer = false;
+		bool tracedSecondary = false;
+	};
+
+	struct TracedFrame
+	{
+		std::vector<uint32_t> pixels;
+		TraceTimings timings;
+
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	class RenderThread
+	{
+	public:
+		RenderThread();
+		~RenderThread();
+
+		void SubmitSnapshot(Ref<const RenderSnapshot> snapshot);
+		const TracedFrame* AcquireLatestFrame();
+
+		// Traces on the calling thread and the job workers. The scratch G-buffer holds the primary hits when the snapshot has none.
+		static void Trace(const RenderSnapshot& snapshot, GBufferFrame& scratchGBuffer, TracedFrame& frame);
+		static void TracePrimary(const RenderSnapshot& snapshot, GBufferFrame& gbuffer);
+
+		// Unclamped color of one sample of a pixel. The sample index picks the bounce direction, the same index always gives the same color.
+		static glm::vec3 ShadeSample(const RenderSnapshot& snapshot, const GBufferFrame& gbuffer, uint32_t index, uint32_t sampleIndex);
+
+		static Ref<RenderThread> Create();
+
+	private:
+		void Run();
+
+		static void TraceNormals(const RenderSnapshot& snapshot, TracedFrame& frame);
+		static void TraceSecondary(const RenderSnapshot& snapshot, const GBufferFrame& gbuffer, TracedFrame& frame);
+
+		std::thread m_thread;
+		std::atomic<bool> m_running = true;
+
+		std::atomic<Ref<const RenderSnapshot>> m_snapshot;
+		std::atomic<uint64_t> m_snapshotVersion = 0;
+
+		Mailbox<TracedFrame> m_frames;
+		GBufferFrame m_tracedGBuffer;
+
+		inline static constexpr uint32_t s_rowsPerJob = 8;
+		inline static constexpr float s_maxDistance = 1000.f;
+		inline static constexpr float s_rayOffset = 0.001f;
+
+		inline static constexpr float s_directIntensity = 0.8f;
+		inline static constexpr float s_indirectIntensity = 0.4f;
+		inline static constexpr float s_bounceAlbedo = 0.5f;
+		inline static const glm::vec3 s_lightDirection = glm::normalize(glm::vec3{ -0.4f, 1.f, 0.6f });
+	};
+}
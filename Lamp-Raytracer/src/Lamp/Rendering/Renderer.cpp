@@ -7,17 +7,25 @@
 #include "Lamp/Core/Graphics/Swapchain.h"
 #include "Lamp/Core/Graphics/GraphicsContext.h"
 #include "Lamp/Core/Graphics/GraphicsDevice.h"
+#include "Lamp/Core/Graphics/VulkanAllocator.h"
 
 #include "Lamp/Log/Log.h"
 
 #include "Lamp/Rendering/Buffer/CommandBuffer.h"
 #include "Lamp/Rendering/Camera/Camera.h"
 
+#include "Lamp/Rendering/Texture/ImageTransitionBatcher.h"
 #include "Lamp/Rendering/Texture/SamplerLibrary.h"
 #include "Lamp/Rendering/Texture/Texture2D.h"
 
+#include "Lamp/Rendering/BindlessRegistry.h"
+#include "Lamp/Rendering/FrameCapture.h"
 #include "Lamp/Rendering/Framebuffer.h"
+#include "Lamp/Rendering/GBufferPass.h"
+#include "Lamp/Rendering/GPUProfiler.h"
+#include "Lamp/Rendering/RenderThread.h"
 #include "Lamp/Rendering/Shader/ShaderRegistry.h"
+#include "Lamp/Rendering/UploadService.h"
 
 #include "Lamp/Scene/Hittable.h"
 
@@ -30,15 +38,21 @@ namespace Lamp
 {
 	namespace Utility
 	{
-		const uint32_t ColorToRGBA(const glm::vec4& color)
+		const uint64_t HashImageRegion(const uint32_t* pixels, uint32_t rowLength, const ImageRegion& region)
 		{
-			const uint8_t r = static_cast<uint8_t>(color.r * 255.f);
-			const uint8_t g = static_cast<uint8_t>(color.g * 255.f);
-			const uint8_t b = static_cast<uint8_t>(color.b * 255.f);
-			const uint8_t a = static_cast<uint8_t>(color.a * 255.f);
+			// FNV-1a
+			uint64_t hash = 14695981039346656037ull;
 
-			const uint32_t col = (a << 24) | (b << 16) | (g << 8) | r;
-			return col;
+			for (uint32_t y = region.y; y < region.y + region.height; y++)
+			{
+				for (uint32_t x = region.x; x < region.x + region.width; x++)
+				{
+					hash ^= pixels[x + y * rowLength];
+					hash *= 1099511628211ull;
+				}
+			}
+
+			return hash;
 		}
 	}
 
@@ -51,26 +65,63 @@ namespace Lamp
 		s_invalidationQueues.resize(framesInFlight);
 
 		s_rendererData->commandBuffer = CommandBuffer::Create(framesInFlight, false);
+		s_rendererData->stagingBuffer = StagingBufferRing::Create(framesInFlight, 1280 * 720 * 4);
+		s_rendererData->secondaryRecorder = SecondaryCommandRecorder::Create(framesInFlight);
 
-		s_rendererData->imageBuffer = new uint32_t[1280 * 720];
+		s_rendererData->renderThread = RenderThread::Create();
 		s_rendererData->camera = CreateRef<Camera>(60.f, 16.f / 9.f, 0.1f, 100.f);
 		s_rendererData->camera->GenerateRayDirections(1280, 720);
 
-		CreateDescriptorPools();
+		CreateDescriptorCaches();
 		CreateSamplers();
+		GPUProfiler::Initialize(framesInFlight);
+		UploadService::Initialize();
+		FrameCapture::Initialize();
+
+		if (Application::Get().GetInfo().enableBindless)
+		{
+			BindlessRegistry::Initialize();
+		}
+
+		ShaderRegistry::Initialize();
 	}
 
 	void Renderer::Shutdowm()
 	{
-		for (auto& descriptorPool : s_rendererData->descriptorPools)
+		s_rendererData->renderThread = nullptr;
+		s_rendererData->gbufferPass = nullptr;
+		ShaderRegistry::Shutdown();
+		UploadService::Shutdown();
+		FrameCapture::Shutdown();
+
+		DescriptorCacheStats setStats{};
+		for (const auto& descriptorSetCache : s_rendererData->descriptorSetCaches)
+		{
+			setStats.hits += descriptorSetCache->GetTotalStats().hits;
+			setStats.misses += descriptorSetCache->GetTotalStats().misses;
+		}
+
+		LP_CORE_INFO("Descriptor set cache hit rate: {0}%, layout cache hit rate: {1}%", setStats.GetHitRate() * 100.f, DescriptorSetLayoutCache::GetStats().GetHitRate() * 100.f);
+
+		const auto& traceStats = s_rendererData->traceStatistics;
+		LP_CORE_INFO("Traced frames: {0} full at {1} ms ({2} ms primary rays), {3} hybrid at {4} ms", traceStats.fullFrames, traceStats.fullFrameMs, traceStats.fullPrimaryMs, traceStats.hybridFrames, traceStats.hybridFrameMs);
+
+		if (traceStats.fullFrames > 0 && traceStats.hybridFrames > 0)
 		{
-			vkDestroyDescriptorPool(GraphicsContext::GetDevice()->GetHandle(), descriptorPool, nullptr);
+			LP_CORE_INFO("Hybrid tracing saved {0} ms per frame", traceStats.fullFrameMs - traceStats.hybridFrameMs);
 		}
 
-		delete[] s_rendererData->imageBuffer;
+		const auto transitionStats = ImageTransitionBatcher::GetStats();
+		LP_CORE_INFO("Image transitions: {0} submitted, {1} barriers recorded in {2} batches", transitionStats.submittedTransitions, transitionStats.recordedBarriers, transitionStats.batches);
+
+		s_rendererData->descriptorSetCaches.clear();
 		s_rendererData = nullptr;
 
+		DescriptorSetLayoutCache::Shutdown();
+
 		FlushResources(true);
+		GPUProfiler::Shutdown();
+		BindlessRegistry::Shutdown();
 		SamplerLibrary::Shutdown();
 	}
 
@@ -79,22 +130,74 @@ namespace Lamp
 		LP_PROFILE_FUNCTION();
 
 		const uint32_t currentFrame = Application::Get().GetWindow()->GetSwapchain().GetCurrentFrame();
-		LP_VK_CHECK(vkResetDescriptorPool(GraphicsContext::GetDevice()->GetHandle(), s_rendererData->descriptorPools[currentFrame], 0));
+		s_rendererData->descriptorSetCaches[currentFrame]->BeginFrame();
+		VulkanAllocator::UpdateBudgets(currentFrame);
 
 		s_rendererData->currentFramebuffer = framebuffer;
 		s_rendererData->commandBuffer->Begin();
+		FrameCapture::Update();
+		s_rendererData->frameScope = GPUProfiler::BeginScope(s_rendererData->commandBuffer->GetCurrentCommandBuffer(), "Renderer");
+
+		{
+			LP_PROFILE_GPU_EVENT(s_rendererData->commandBuffer->GetCurrentCommandBuffer(), "Image Transitions");
+			ImageTransitionBatcher::Record(s_rendererData->commandBuffer->GetCurrentCommandBuffer());
+		}
+
+		// Uploads recorded during the last frame go out now, finished ones are handed over to this frame
+		UploadService::Submit();
+		if (const uint64_t uploadValue = UploadService::AcquireCompleted(s_rendererData->commandBuffer->GetCurrentCommandBuffer()))
+		{
+			s_rendererData->commandBuffer->AddTimelineWait(UploadService::GetTimelineSemaphore(), uploadValue, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		}
+		s_rendererData->stagingBuffer->Begin(s_rendererData->commandBuffer->GetCurrentIndex());
+		s_rendererData->secondaryRecorder->Begin(s_rendererData->commandBuffer->GetCurrentIndex());
 		FlushResources();
 
-		LP_PROFILE_GPU_EVENT("Rendering Begin");
+		// The G-buffer is rasterized before the framebuffer starts rendering, the objects were submitted before Begin
+		s_rendererData->hasRasterScene = false;
+		if (s_rendererData->hybridTracing)
+		{
+			if (!s_rendererData->gbufferPass)
+			{
+				s_rendererData->gbufferPass = GBufferPass::Create(Application::Get().GetWindow()->GetSwapchain().GetFramesInFlight());
+			}
+
+			s_rendererData->hasRasterScene = s_rendererData->gbufferPass->SetObjects(s_rendererData->renderCommands);
+			if (s_rendererData->hasRasterScene)
+			{
+				VkCommandBuffer commandBuffer = s_rendererData->commandBuffer->GetCurrentCommandBuffer();
+				VkFence submitFence = s_rendererData->commandBuffer->GetSubmitFence(s_rendererData->commandBuffer->GetCurrentIndex());
+
+				s_rendererData->gbufferPass->Record(commandBuffer, submitFence, s_rendererData->commandBuffer->GetCurrentIndex(), *s_rendererData->camera, framebuffer->GetWidth(), framebuffer->GetHeight());
+			}
+		}
+
 		s_rendererData->currentFramebuffer->Bind(s_rendererData->commandBuffer->GetCurrentCommandBuffer());
 	}
 
 	void Renderer::End()
 	{
 		LP_PROFILE_FUNCTION();
-		LP_PROFILE_GPU_EVENT("Rendering End");
 
 		s_rendererData->currentFramebuffer->Unbind(s_rendererData->commandBuffer->GetCurrentCommandBuffer());
+
+		// Copies can't be recorded while rendering, so requests are held until the framebuffer is unbound
+		if (!s_rendererData->pendingCaptures.empty())
+		{
+			VkCommandBuffer commandBuffer = s_rendererData->commandBuffer->GetCurrentCommandBuffer();
+			VkFence submitFence = s_rendererData->commandBuffer->GetSubmitFence(s_rendererData->commandBuffer->GetCurrentIndex());
+			auto colorAttachment = s_rendererData->currentFramebuffer->GetColorAttachment(0);
+
+			LP_PROFILE_GPU_EVENT(commandBuffer, "Frame Capture");
+			for (auto& capture : s_rendererData->pendingCaptures)
+			{
+				FrameCapture::Capture(commandBuffer, submitFence, colorAttachment, capture.path, capture.format, capture.callback);
+			}
+
+			s_rendererData->pendingCaptures.clear();
+		}
+
+		GPUProfiler::EndScope(s_rendererData->commandBuffer->GetCurrentCommandBuffer(), s_rendererData->frameScope);
 		s_rendererData->commandBuffer->End();
 
 		s_rendererData->renderCommands.clear();
@@ -112,39 +215,89 @@ namespace Lamp
 		const uint32_t width = s_rendererData->currentFramebuffer->GetWidth();
 		const uint32_t height = s_rendererData->currentFramebuffer->GetHeight();
 
-		const glm::vec3 origin = { 0.f, 0.f, 0.f };
-
-		for (uint32_t y = 0; y < height; y++)
+		// Hand the render thread its own copy of the scene, so edits made after this point can't race with tracing
 		{
-			for (uint32_t x = 0; x < width; x++)
-			{
-				const glm::vec3 rayDir = s_rendererData->camera->GetRayDirectionAt(x + y * width);
-				const Ray ray = { origin, rayDir };
-				
-				glm::vec3 color{ 0.f };
-				bool hasHit = false;
+			auto snapshot = CreateRef<RenderSnapshot>();
+			snapshot->camera = s_rendererData->camera;
+			snapshot->width = width;
+			snapshot->height = height;
+			snapshot->traceSecondary = s_rendererData->hybridTracing;
 
-				for (const auto& obj : s_rendererData->renderCommands)
-				{
-					RaycastHit hit{};
-					if (obj->HitTest(ray, -1000.f, 1000.f, hit))
-					{
-						color = 0.5f * (hit.normal + 1.f);
-						hasHit = true;
-					}
-				}
+			if (s_rendererData->hybridTracing && s_rendererData->hasRasterScene)
+			{
+				// Every so often the primary rays are traced anyway, which keeps the full frame statistics current
+				const bool traceFullFrame = s_rendererData->hybridFrameIndex++ % s_fullFrameInterval == 0;
 
-				if (!hasHit)
+				Ref<const GBufferFrame> gbuffer = s_rendererData->gbuffer.load();
+				if (!traceFullFrame && gbuffer && gbuffer->version == s_rendererData->gbufferPass->GetVersion())
 				{
-					const float t = 0.5f * (rayDir.y + 1.f);
-					color = glm::mix(glm::vec3{ 0.5f, 0.7f, 1.f }, glm::vec3{ 0.f }, t);
+					snapshot->gbuffer = gbuffer;
 				}
+			}
 
-				s_rendererData->imageBuffer[x + y * width] = Utility::ColorToRGBA({ color.x, color.y, color.z, 1.f });
+			snapshot->objects.reserve(s_rendererData->renderCommands.size());
+			for (const auto& obj : s_rendererData->renderCommands)
+			{
+				snapshot->objects.emplace_back(obj->Clone());
 			}
+
+			s_rendererData->renderThread->SubmitSnapshot(snapshot);
 		}
 
-		s_rendererData->currentFramebuffer->GetColorAttachment(0)->SetData(s_rendererData->imageBuffer, (uint32_t)width * height * 4);
+		// Upload the latest finished frame, if any; otherwise the attachment keeps showing the previous one
+		const TracedFrame* frame = s_rendererData->renderThread->AcquireLatestFrame();
+		if (frame)
+		{
+			UpdateTraceStatistics(*frame);
+		}
+
+		if (!frame || frame->width != width || frame->height != height)
+		{
+			return;
+		}
+
+		auto colorAttachment = s_rendererData->currentFramebuffer->GetColorAttachment(0);
+		VkCommandBuffer commandBuffer = s_rendererData->commandBuffer->GetCurrentCommandBuffer();
+		LP_PROFILE_GPU_EVENT(commandBuffer, "Frame Upload");
+
+		if (UpdateDirtyTiles(colorAttachment, frame->pixels.data()))
+		{
+			colorAttachment->SetData(commandBuffer, frame->pixels.data(), (uint32_t)width * height * 4);
+		}
+		else
+		{
+			colorAttachment->SetData(commandBuffer, frame->pixels.data(), s_rendererData->dirtyTiles);
+		}
+	}
+
+	void Renderer::RecordSecondary(VkCommandBuffer primaryCommandBuffer, uint32_t taskCount, const VkCommandBufferInheritanceInfo& inheritanceInfo, const SecondaryCommandRecorder::RecordFunction& function)
+	{
+		s_rendererData->secondaryRecorder->Record(primaryCommandBuffer, taskCount, inheritanceInfo, function);
+	}
+
+	void Renderer::CaptureFrame(const std::filesystem::path& path, CaptureFormat format, CaptureCallback callback)
+	{
+		s_rendererData->pendingCaptures.emplace_back(PendingCapture{ path, format, callback });
+	}
+
+	void Renderer::SetHybridTracing(bool enabled)
+	{
+		s_rendererData->hybridTracing = enabled;
+	}
+
+	const bool Renderer::IsHybridTracing()
+	{
+		return s_rendererData->hybridTracing;
+	}
+
+	void Renderer::SubmitGBuffer(Ref<const GBufferFrame> gbuffer)
+	{
+		s_rendererData->gbuffer.store(gbuffer);
+	}
+
+	const TraceStatistics& Renderer::GetTraceStatistics()
+	{
+		return s_rendererData->traceStatistics;
 	}
 
 	void Renderer::FlushResources(bool flushAll)
@@ -173,6 +326,12 @@ namespace Lamp
 		s_frameDeletionQueues[currentFrame].Push(function);
 	}
 
+	void Renderer::SubmitResourceFree(const std::vector<uint64_t>& descriptorHandles, std::function<void()>&& function)
+	{
+		DescriptorSetCache::InvalidateResources(descriptorHandles);
+		SubmitResourceFree(std::move(function));
+	}
+
 	void Renderer::SubmitInvalidation(std::function<void()>&& function)
 	{
 		const uint32_t currentFrame = Application::Get().GetWindow()->GetSwapchain().GetCurrentFrame();
@@ -183,15 +342,30 @@ namespace Lamp
 	{
 		LP_PROFILE_FUNCTION();
 
-		auto device = GraphicsContext::GetDevice();
-		uint32_t currentFrame = Application::Get().GetWindow()->GetSwapchain().GetCurrentFrame();
+		const uint32_t currentFrame = Application::Get().GetWindow()->GetSwapchain().GetCurrentFrame();
+		return s_rendererData->descriptorSetCaches[currentFrame]->Allocate(allocInfo);
+	}
+
+	VkDescriptorSet Renderer::GetDescriptorSet(VkDescriptorSetLayout layout, std::vector<VkWriteDescriptorSet>& writes)
+	{
+		const uint32_t currentFrame = Application::Get().GetWindow()->GetSwapchain().GetCurrentFrame();
+		return s_rendererData->descriptorSetCaches[currentFrame]->Get(layout, writes);
+	}
 
-		allocInfo.descriptorPool = s_rendererData->descriptorPools[currentFrame];
+	const DescriptorCacheStats& Renderer::GetDescriptorSetStats()
+	{
+		const uint32_t currentFrame = Application::Get().GetWindow()->GetSwapchain().GetCurrentFrame();
+		return s_rendererData->descriptorSetCaches[currentFrame]->GetFrameStats();
+	}
 
-		VkDescriptorSet descriptorSet;
-		LP_VK_CHECK(vkAllocateDescriptorSets(device->GetHandle(), &allocInfo, &descriptorSet));
+	StagingAllocation Renderer::AllocateStagingMemory(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		return s_rendererData->stagingBuffer->Allocate(size, alignment);
+	}
 
-		return descriptorSet;
+	const std::vector<ImageRegion>& Renderer::GetDirtyTiles()
+	{
+		return s_rendererData->dirtyTiles;
 	}
 
 	void Renderer::CreateSamplers()
@@ -213,38 +387,86 @@ namespace Lamp
 		SamplerLibrary::Add(TextureFilter::Linear, TextureFilter::Linear, TextureFilter::Nearest, TextureWrap::Clamp, CompareOperator::None, AniostopyLevel::None);
 	}
 
-	void Renderer::CreateDescriptorPools()
+	void Renderer::CreateDescriptorCaches()
 	{
-		VkDescriptorPoolSize poolSizes[] =
+		const uint32_t framesInFlight = Application::Get().GetWindow()->GetSwapchain().GetFramesInFlight();
+
+		for (uint32_t i = 0; i < framesInFlight; i++)
 		{
-			{ VK_DESCRIPTOR_TYPE_SAMPLER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000 },
-			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000 }
-		};
+			s_rendererData->descriptorSetCaches.emplace_back(DescriptorSetCache::Create());
+		}
+	}
+
+	bool Renderer::UpdateDirtyTiles(Ref<Image2D> image, const uint32_t* imageBuffer)
+	{
+		LP_PROFILE_FUNCTION();
 
-		VkDescriptorPoolCreateInfo poolInfo{};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-		poolInfo.maxSets = 10000;
-		poolInfo.poolSizeCount = (uint32_t)ARRAYSIZE(poolSizes);
-		poolInfo.pPoolSizes = poolSizes;
+		const uint32_t width = image->GetWidth();
+		const uint32_t height = image->GetHeight();
 
-		const uint32_t framesInFlight = Application::Get().GetWindow()->GetSwapchain().GetFramesInFlight();
+		const uint32_t tileCountX = (width + s_tileSize - 1) / s_tileSize;
+		const uint32_t tileCountY = (height + s_tileSize - 1) / s_tileSize;
+
+		// A new or resized image has no valid contents, so every tile has to be uploaded
+		const bool fullUpload = image->GetHandle() != s_rendererData->lastUploadedImage || s_rendererData->tileHashes.size() != (size_t)tileCountX * tileCountY;
+		if (fullUpload)
+		{
+			s_rendererData->tileHashes.assign((size_t)tileCountX * tileCountY, 0);
+			s_rendererData->lastUploadedImage = image->GetHandle();
+		}
+
+		s_rendererData->dirtyTiles.clear();
+
+		for (uint32_t tileY = 0; tileY < tileCountY; tileY++)
+		{
+			for (uint32_t tileX = 0; tileX < tileCountX; tileX++)
+			{
+				ImageRegion region{};
+				region.x = tileX * s_tileSize;
+				region.y = tileY * s_tileSize;
+				region.width = std::min(s_tileSize, width - region.x);
+				region.height = std::min(s_tileSize, height - region.y);
 
-		s_rendererData->descriptorPools.resize(framesInFlight);
-		auto device = GraphicsContext::GetDevice();
+				const uint64_t hash = Utility::HashImageRegion(imageBuffer, width, region);
+				uint64_t& tileHash = s_rendererData->tileHashes[tileX + tileY * tileCountX];
 
-		for (auto& descriptorPool : s_rendererData->descriptorPools)
+				if (fullUpload || hash != tileHash)
+				{
+					tileHash = hash;
+					s_rendererData->dirtyTiles.emplace_back(region);
+				}
+			}
+		}
+
+		return fullUpload;
+	}
+
+	void Renderer::UpdateTraceStatistics(const TracedFrame& frame)
+	{
+		// The first frame seeds the average, later frames are blended in
+		auto blend = [](float average, float value, uint64_t count)
+		{
+			return count == 0 ? value : glm::mix(average, value, s_traceStatisticsBlend);
+		};
+
+		if (!frame.timings.tracedSecondary)
+		{
+			return;
+		}
+
+		auto& stats = s_rendererData->traceStatistics;
+		const float frameMs = frame.timings.primaryMs + frame.timings.secondaryMs;
+
+		if (frame.timings.usedGBuffer)
+		{
+			stats.hybridFrameMs = blend(stats.hybridFrameMs, frameMs, stats.hybridFrames);
+			stats.hybridFrames++;
+		}
+		else
 		{
-			LP_VK_CHECK(vkCreateDescriptorPool(device->GetHandle(), &poolInfo, nullptr, &descriptorPool));
+			stats.fullFrameMs = blend(stats.fullFrameMs, frameMs, stats.fullFrames);
+			stats.fullPrimaryMs = blend(stats.fullPrimaryMs, frame.timings.primaryMs, stats.fullFrames);
+			stats.fullFrames++;
 		}
 	}
 
@@ -2,9 +2,16 @@
 
 #include "Lamp/Core/Base.h"
 
+#include "Lamp/Rendering/DescriptorCache.h"
+#include "Lamp/Rendering/FrameCapture.h"
 #include "Lamp/Rendering/FunctionQueue.hpp"
+#include "Lamp/Rendering/Buffer/SecondaryCommandRecorder.h"
+#include "Lamp/Rendering/Buffer/StagingBufferRing.h"
+#include "Lamp/Rendering/Texture/ImageCommon.h"
 
 #include <vulkan/vulkan.h>
+
+#include <atomic>
 #include <functional>
 
 namespace Lamp
@@ -12,7 +19,25 @@ namespace Lamp
 	class Camera;
 	class CommandBuffer;
 	class Framebuffer;
+	class GBufferPass;
 	class Hittable;
+	class Image2D;
+	class RenderThread;
+
+	struct GBufferFrame;
+	struct TracedFrame;
+
+	// Moving averages of the frames traced with shadow and bounce rays. Hybrid frames started from a read back G-buffer instead of tracing primary rays,
+	// full frames traced the primary rays on the CPU. Frames shaded by their normals alone aren't counted.
+	struct TraceStatistics
+	{
+		float fullFrameMs = 0.f;
+		float fullPrimaryMs = 0.f;
+		float hybridFrameMs = 0.f;
+
+		uint64_t fullFrames = 0;
+		uint64_t hybridFrames = 0;
+	};
 
 	class Renderer
 	{
@@ -26,31 +51,85 @@ namespace Lamp
 		static void Submit(Ref<Hittable> object);
 		static void Render();
 
+		// Captures the framebuffer's first color attachment at the end of the current frame, the file is written in the background
+		static void CaptureFrame(const std::filesystem::path& path, CaptureFormat format = CaptureFormat::PNG, CaptureCallback callback = nullptr);
+
+		// Hybrid tracing rasterizes the first hits and only traces shadow and bounce rays from them on the CPU.
+		// Scenes with objects that can't be rasterized trace the primary rays as well.
+		static void SetHybridTracing(bool enabled);
+		static const bool IsHybridTracing();
+
+		// Called from the capture encoder thread with the read back G-buffer, it is used while its version matches the GBufferPass
+		static void SubmitGBuffer(Ref<const GBufferFrame> gbuffer);
+		static const TraceStatistics& GetTraceStatistics();
+
+		// Records the tasks on the job workers and executes them into the primary in task order
+		static void RecordSecondary(VkCommandBuffer primaryCommandBuffer, uint32_t taskCount, const VkCommandBufferInheritanceInfo& inheritanceInfo, const SecondaryCommandRecorder::RecordFunction& function);
+
 		static void FlushResources(bool flushAll = false);
 
 		static void SubmitResourceFree(std::function<void()>&& function);
+
+		// Buffers, image views and samplers the function destroys, cached descriptor sets pointing at them are dropped
+		static void SubmitResourceFree(const std::vector<uint64_t>& descriptorHandles, std::function<void()>&& function);
+
 		static void SubmitInvalidation(std::function<void()>&& function);
 
 		static VkDescriptorSet AllocateDescriptorSet(VkDescriptorSetAllocateInfo& allocInfo);
+		static VkDescriptorSet GetDescriptorSet(VkDescriptorSetLayout layout, std::vector<VkWriteDescriptorSet>& writes);
+		static const DescriptorCacheStats& GetDescriptorSetStats();
+		static StagingAllocation AllocateStagingMemory(VkDeviceSize size, VkDeviceSize alignment = 16);
+		static const std::vector<ImageRegion>& GetDirtyTiles();
 
 	private:
 		Renderer() = delete;
 		
 		static void CreateSamplers();
-		static void CreateDescriptorPools();
+		static void CreateDescriptorCaches();
+		static bool UpdateDirtyTiles(Ref<Image2D> image, const uint32_t* imageBuffer);
+		static void UpdateTraceStatistics(const TracedFrame& frame);
+
+		struct PendingCapture
+		{
+			std::filesystem::path path;
+			CaptureFormat format;
+			CaptureCallback callback;
+		};
 
 		struct RendererData
 		{
 			Ref<CommandBuffer> commandBuffer;
 			Ref<Framebuffer> currentFramebuffer;
+			Ref<StagingBufferRing> stagingBuffer;
+			Ref<SecondaryCommandRecorder> secondaryRecorder;
 
 			Ref<Camera> camera;
-			std::vector<VkDescriptorPool> descriptorPools;
+			std::vector<Ref<DescriptorSetCache>> descriptorSetCaches;
 
-			uint32_t* imageBuffer = nullptr;
+			Ref<RenderThread> renderThread;
 			std::vector<Ref<Hittable>> renderCommands;
+
+			Ref<GBufferPass> gbufferPass;
+			std::atomic<Ref<const GBufferFrame>> gbuffer;
+			TraceStatistics traceStatistics;
+
+			bool hybridTracing = false;
+			bool hasRasterScene = false;
+			uint64_t hybridFrameIndex = 0;
+
+			std::vector<PendingCapture> pendingCaptures;
+
+			std::vector<uint64_t> tileHashes;
+			std::vector<ImageRegion> dirtyTiles;
+			VkImage lastUploadedImage = nullptr;
+
+			uint32_t frameScope = UINT32_MAX;
 		};
 
+		inline static constexpr uint32_t s_tileSize = 32;
+		inline static constexpr float s_traceStatisticsBlend = 0.1f;
+		inline static constexpr uint64_t s_fullFrameInterval = 30; // Hybrid tracing still traces every n:th frame in full, to keep the comparison current
+
 		inline static Scope<RendererData> s_rendererData;
 		inline static std::vector<FunctionQueue> s_frameDeletionQueues;
 		inline static std::vector<FunctionQueue> s_invalidationQueues;
@@ -0,0 +1,255 @@
+#include "lppch.h"
+#include "SequenceRenderer.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Rendering/Camera/Camera.h"
+#include "Lamp/Scene/Hittable.h"
+#include "Lamp/Utility/ImageWriter.h"
+#include "Lamp/Utility/TimeUtility.h"
+
+#include <chrono>
+#include <format>
+
+namespace Lamp
+{
+	SequenceRenderer::SequenceRenderer(const CameraPath& path, const std::vector<Ref<Hittable>>& objects, const SequenceSettings& settings)
+		: m_path(path), m_settings(settings)
+	{
+		// The scene may keep changing while the sequence renders
+		m_objects.reserve(objects.size());
+		for (const auto& object : objects)
+		{
+			m_objects.emplace_back(object->Clone());
+		}
+	}
+
+	SequenceRenderer::~SequenceRenderer()
+	{
+		Cancel();
+
+		for (auto* thread : { &m_tracerThread, &m_converterThread, &m_encoderThread })
+		{
+			if (thread->joinable())
+			{
+				thread->join();
+			}
+		}
+	}
+
+	void SequenceRenderer::Start()
+	{
+		if (m_isRunning || m_tracerThread.joinable())
+		{
+			LP_CORE_WARN("Sequence has already been started, create a new one to resume it!");
+			return;
+		}
+
+		if (m_path.IsEmpty() || m_settings.frameCount == 0 || m_settings.width == 0 || m_settings.height == 0)
+		{
+			LP_CORE_WARN("Sequence has no keyframes or frames to render!");
+			return;
+		}
+
+		std::error_code error;
+		std::filesystem::create_directories(m_settings.outputDirectory, error);
+
+		const uint32_t firstFrame = m_settings.resume ? FindFirstMissingFrame() : 0;
+		m_completedFrames = firstFrame;
+
+		if (firstFrame >= m_settings.frameCount)
+		{
+			LP_CORE_INFO("Sequence {0} is already complete", m_settings.outputDirectory.string());
+			return;
+		}
+
+		if (firstFrame > 0)
+		{
+			LP_CORE_INFO("Resuming sequence {0} at frame {1}", m_settings.outputDirectory.string(), firstFrame);
+		}
+
+		for (auto& frame : m_frames)
+		{
+			m_freeFrames.Push(&frame);
+		}
+
+		m_isRunning = true;
+		m_startTime = std::chrono::steady_clock::now();
+
+		m_encoderThread = std::thread(&SequenceRenderer::RunEncoder, this);
+		m_converterThread = std::thread(&SequenceRenderer::RunConverter, this);
+		m_tracerThread = std::thread(&SequenceRenderer::RunTracer, this, firstFrame);
+	}
+
+	void SequenceRenderer::Cancel()
+	{
+		m_isCancelled = true;
+	}
+
+	const SequenceTimings SequenceRenderer::GetTimings() const
+	{
+		SequenceTimings timings{};
+		timings.traceMs = (float)m_traceMicroseconds.load() / 1000.f;
+		timings.convertMs = (float)m_convertMicroseconds.load() / 1000.f;
+		timings.encodeMs = (float)m_encodeMicroseconds.load() / 1000.f;
+		timings.wallMs = (float)m_wallMicroseconds.load() / 1000.f;
+
+		return timings;
+	}
+
+	std::filesystem::path SequenceRenderer::GetFramePath(uint32_t frameIndex) const
+	{
+		const char* extension = m_settings.format == CaptureFormat::PNG ? "png" : "exr";
+		return m_settings.outputDirectory / std::format("{0}_{1:04}.{2}", m_settings.fileName, frameIndex, extension);
+	}
+
+	Ref<SequenceRenderer> SequenceRenderer::Create(const CameraPath& path, const std::vector<Ref<Hittable>>& objects, const SequenceSettings& settings)
+	{
+		return CreateRef<SequenceRenderer>(path, objects, settings);
+	}
+
+	void SequenceRenderer::RunTracer(uint32_t firstFrame)
+	{
+		LP_PROFILE_THREAD("Sequence Tracer");
+
+		const float aspectRatio = (float)m_settings.width / (float)m_settings.height;
+
+		for (uint32_t frameIndex = firstFrame; frameIndex < m_settings.frameCount && !m_isCancelled; frameIndex++)
+		{
+			// Blocks while every buffer is still being converted or encoded
+			SequenceFrame* frame = m_freeFrames.WaitAndPop();
+			if (m_isCancelled)
+			{
+				break;
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+
+			auto camera = CreateRef<Camera>(60.f, aspectRatio, m_settings.nearPlane, m_settings.farPlane);
+			m_path.Apply(*camera, GetFrameTime(frameIndex));
+			camera->GenerateRayDirections(m_settings.width, m_settings.height);
+
+			RenderSnapshot snapshot{};
+			snapshot.camera = camera;
+			snapshot.objects = m_objects;
+			snapshot.width = m_settings.width;
+			snapshot.height = m_settings.height;
+			snapshot.traceSecondary = true; // Offline frames always get the shadow and bounce rays
+
+			frame->index = frameIndex;
+			RenderThread::Trace(snapshot, m_scratchGBuffer, frame->traced);
+
+			m_traceMicroseconds += Utility::MicrosecondsSince(start);
+			m_tracedFrames.Push(frame);
+		}
+
+		m_tracedFrames.Push(nullptr);
+	}
+
+	void SequenceRenderer::RunConverter()
+	{
+		LP_PROFILE_THREAD("Sequence Converter");
+
+		while (SequenceFrame* frame = m_tracedFrames.WaitAndPop())
+		{
+			const auto start = std::chrono::steady_clock::now();
+			const size_t pixelCount = frame->traced.pixels.size();
+
+			if (m_settings.format == CaptureFormat::PNG)
+			{
+				// Packed with red in the low byte, which is already RGBA in memory
+				frame->pixels.resize(pixelCount * 4);
+				memcpy(frame->pixels.data(), frame->traced.pixels.data(), pixelCount * 4);
+			}
+			else
+			{
+				// Traced pixels are display encoded, EXRs are linear like FrameCapture's
+				frame->hdrPixels.resize(pixelCount * 4);
+				for (size_t i = 0; i < pixelCount; i++)
+				{
+					const uint32_t pixel = frame->traced.pixels[i];
+					for (uint32_t channel = 0; channel < 3; channel++)
+					{
+						frame->hdrPixels[i * 4 + channel] = ImageWriter::SRGBToLinear((float)((pixel >> (channel * 8)) & 0xff) / 255.f);
+					}
+
+					frame->hdrPixels[i * 4 + 3] = (float)(pixel >> 24) / 255.f;
+				}
+			}
+
+			m_convertMicroseconds += Utility::MicrosecondsSince(start);
+			m_convertedFrames.Push(frame);
+		}
+
+		m_convertedFrames.Push(nullptr);
+	}
+
+	void SequenceRenderer::RunEncoder()
+	{
+		LP_PROFILE_THREAD("Sequence Encoder");
+
+		while (SequenceFrame* frame = m_convertedFrames.WaitAndPop())
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			const std::filesystem::path path = GetFramePath(frame->index);
+			std::filesystem::path tempPath = path;
+			tempPath += ".tmp";
+
+			bool succeeded = m_settings.format == CaptureFormat::PNG
+				? ImageWriter::WritePNG(tempPath, frame->traced.width, frame->traced.height, frame->pixels.data())
+				: ImageWriter::WriteEXR(tempPath, frame->traced.width, frame->traced.height, frame->hdrPixels.data());
+
+			std::error_code error;
+			if (succeeded)
+			{
+				std::filesystem::rename(tempPath, path, error);
+				succeeded = !error;
+			}
+
+			if (succeeded)
+			{
+				// Frames arrive in order, so everything before this one is on disk too
+				m_completedFrames = frame->index + 1;
+			}
+			else
+			{
+				LP_CORE_ERROR("Failed to write sequence frame {0}, stopping the sequence!", path.string());
+				std::filesystem::remove(tempPath, error);
+				m_isCancelled = true;
+			}
+
+			m_encodeMicroseconds += Utility::MicrosecondsSince(start);
+			m_freeFrames.Push(frame);
+		}
+
+		m_wallMicroseconds = Utility::MicrosecondsSince(m_startTime);
+
+		const auto timings = GetTimings();
+		LP_CORE_INFO("Sequence {0}: {1}/{2} frames in {3} ms (trace {4} ms, convert {5} ms, encode {6} ms)", m_settings.outputDirectory.string(), m_completedFrames.load(), m_settings.frameCount,
+			timings.wallMs, timings.traceMs, timings.convertMs, timings.encodeMs);
+
+		m_isRunning = false;
+	}
+
+	uint32_t SequenceRenderer::FindFirstMissingFrame() const
+	{
+		uint32_t frameIndex = 0;
+		while (frameIndex < m_settings.frameCount && std::filesystem::exists(GetFramePath(frameIndex)))
+		{
+			frameIndex++;
+		}
+
+		return frameIndex;
+	}
+
+	float SequenceRenderer::GetFrameTime(uint32_t frameIndex) const
+	{
+		if (m_settings.frameCount <= 1)
+		{
+			return m_path.GetStartTime();
+		}
+
+		return m_path.GetStartTime() + m_path.GetDuration() * (float)frameIndex / (float)(m_settings.frameCount - 1);
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include "Lamp/Rendering/Camera/CameraPath.h"
+#include "Lamp/Rendering/FrameCapture.h"
+#include "Lamp/Rendering/RenderThread.h"
+#include "Lamp/Utility/ThreadSafeQueue.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+namespace Lamp
+{
+	class Hittable;
+
+	struct SequenceSettings
+	{
+		std::filesystem::path outputDirectory = "Sequence";
+		std::string fileName = "Frame"; // Written as <fileName>_0000.png
+		CaptureFormat format = CaptureFormat::PNG;
+
+		uint32_t frameCount = 120;
+		uint32_t width = 1280;
+		uint32_t height = 720;
+
+		float nearPlane = 0.1f;
+		float farPlane = 100.f;
+
+		// Frames already on disk are skipped, files are renamed into place once complete so they are never partial
+		bool resume = true;
+	};
+
+	// Summed over every frame, the wall time should be close to the tracing time
+	struct SequenceTimings
+	{
+		float traceMs = 0.f;
+		float convertMs = 0.f;
+		float encodeMs = 0.f;
+		float wallMs = 0.f;
+	};
+
+	// Renders a camera path to numbered files. Tracing frame N + 1, converting frame N and encoding frame N - 1 run on their own threads,
+	// frames are passed along through a fixed set of buffers so a slow stage holds back the others instead of piling up memory.
+	class SequenceRenderer
+	{
+	public:
+		SequenceRenderer(const CameraPath& path, const std::vector<Ref<Hittable>>& objects, const SequenceSettings& settings);
+		~SequenceRenderer();
+
+		void Start();
+		void Cancel();
+
+		inline const bool IsRunning() const { return m_isRunning.load(); }
+		inline const uint32_t GetCompletedFrames() const { return m_completedFrames.load(); }
+		inline const uint32_t GetFrameCount() const { return m_settings.frameCount; }
+		const SequenceTimings GetTimings() const;
+
+		std::filesystem::path GetFramePath(uint32_t frameIndex) const;
+
+		static Ref<SequenceRenderer> Create(const CameraPath& path, const std::vector<Ref<Hittable>>& objects, const SequenceSettings& settings);
+
+	private:
+		struct SequenceFrame
+		{
+			uint32_t index = 0;
+			TracedFrame traced;
+
+			std::vector<uint8_t> pixels;
+			std::vector<float> hdrPixels;
+		};
+
+		void RunTracer(uint32_t firstFrame);
+		void RunConverter();
+		void RunEncoder();
+
+		uint32_t FindFirstMissingFrame() const;
+		float GetFrameTime(uint32_t frameIndex) const;
+
+		CameraPath m_path;
+		std::vector<Ref<const Hittable>> m_objects;
+		SequenceSettings m_settings;
+
+		inline static constexpr uint32_t s_pipelineDepth = 3;
+
+		std::array<SequenceFrame, s_pipelineDepth> m_frames;
+		GBufferFrame m_scratchGBuffer;
+
+		// A null frame marks the end of the sequence
+		ThreadSafeQueue<SequenceFrame*> m_freeFrames;
+		ThreadSafeQueue<SequenceFrame*> m_tracedFrames;
+		ThreadSafeQueue<SequenceFrame*> m_convertedFrames;
+
+		std::thread m_tracerThread;
+		std::thread m_converterThread;
+		std::thread m_encoderThread;
+
+		std::atomic<bool> m_isRunning = false;
+		std::atomic<bool> m_isCancelled = false;
+		std::atomic<uint32_t> m_completedFrames = 0;
+		std::chrono::steady_clock::time_point m_startTime;
+
+		std::atomic<uint64_t> m_traceMicroseconds = 0;
+		std::atomic<uint64_t> m_convertMicroseconds = 0;
+		std::atomic<uint64_t> m_encodeMicroseconds = 0;
+		std::atomic<uint64_t> m_wallMicroseconds = 0;
+	};
+}
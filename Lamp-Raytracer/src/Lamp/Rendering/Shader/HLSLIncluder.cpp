@@ -8,7 +8,7 @@ namespace Lamp
 {
 	HRESULT HLSLIncluder::LoadSource(LPCWSTR pFilename, IDxcBlob** ppIncludeSource)
 	{
-		static IDxcUtils* utils = nullptr;
+		static thread_local IDxcUtils* utils = nullptr;
 		if (!utils)
 		{
 			DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils));
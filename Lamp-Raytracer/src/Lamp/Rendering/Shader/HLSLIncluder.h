@@ -16,8 +16,10 @@ namespace Lamp
 		ULONG AddRef() override { return 0; }
 		ULONG Release() override { return 0; }
 
+		inline const std::unordered_set<std::filesystem::path>& GetIncludedFiles() const { return m_includedFiles; }
+
 	private:
-		inline static IDxcIncludeHandler* s_defaultIncludeHandler = nullptr;
+		inline static thread_local IDxcIncludeHandler* s_defaultIncludeHandler = nullptr;
 
 		std::unordered_set<std::filesystem::path> m_includedFiles;
 	};
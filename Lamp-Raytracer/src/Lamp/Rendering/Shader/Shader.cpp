@@ -10,9 +10,12 @@
 #include "Lamp/Core/Window.h"
 #include "Lamp/Core/Graphics/Swapchain.h"
 
+#include "Lamp/Rendering/BindlessRegistry.h"
+#include "Lamp/Rendering/DescriptorCache.h"
 #include "Lamp/Rendering/Shader/ShaderUtility.h"
 
 #include "ShaderCompiler.h"
+#include "ShaderCache.h"
 
 #include <shaderc/shaderc.hpp>
 #include <file_includer.h>
@@ -26,11 +29,7 @@ namespace Lamp
 	/////ShaderResources/////
 	void Shader::ShaderResources::Clear()
 	{
-		for (const auto& set : paddedSetLayouts)
-		{
-			vkDestroyDescriptorSetLayout(GraphicsContext::GetDevice()->GetHandle(), set, nullptr);
-		}
-
+		// Layouts are owned by the DescriptorSetLayoutCache
 		paddedSetLayouts.clear();
 		realSetLayouts.clear();
 		pushConstantRanges.clear();
@@ -38,6 +37,7 @@ namespace Lamp
 		storageBuffersInfos.clear();
 		imageInfos.clear();
 		writeDescriptors.clear();
+		usesBindless = false;
 	}
 	/////////////////////////
 
@@ -70,19 +70,38 @@ namespace Lamp
 		LoadShaderFromFiles();
 
 		std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>> shaderData;
+		std::unordered_map<VkShaderStageFlagBits, uint64_t> cacheKeys;
 
-		if (!CompileOrGetBinary(shaderData, forceCompile))
+		if (!CompileOrGetBinary(shaderData, cacheKeys, forceCompile))
 		{
 			return false;
 		}
 
 		Release();
 		LoadAndCreateShaders(shaderData);
-		ReflectAllStages(shaderData);
+		ReflectAllStages(shaderData, cacheKeys);
 
 		return true;
 	}
 
+	const bool Shader::DependsOn(const std::filesystem::path& file) const
+	{
+		const std::string normalizedFile = file.lexically_normal().generic_string();
+
+		for (const auto& path : m_shaderPaths)
+		{
+			const VkShaderStageFlagBits stage = Utility::GetShaderStageFromFilename(path.filename().string());
+			const auto dependencies = ShaderCache::GetDependencies(path, stage);
+
+			if (std::find(dependencies.begin(), dependencies.end(), normalizedFile) != dependencies.end())
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
 	Ref<Shader> Shader::Create(const std::string& name, std::initializer_list<std::filesystem::path> paths, bool forceCompile)
 	{
 		return CreateRef<Shader>(name, paths, forceCompile);
@@ -127,50 +146,24 @@ namespace Lamp
 		m_perStageStorageImageCount.clear();
 	}
 
-	bool Shader::CompileOrGetBinary(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, bool forceCompile)
+	bool Shader::CompileOrGetBinary(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, std::unordered_map<VkShaderStageFlagBits, uint64_t>& outCacheKeys, bool forceCompile)
 	{
-		auto cacheDirectory = Utility::GetShaderCacheDirectory();
-
-		uint32_t index = 0;
+		// Cached binaries are validated against the current sources by the compiler
+		return ShaderCompiler::TryCompile(outShaderData, outCacheKeys, m_shaderPaths, forceCompile);
+	}
 
-		for (const auto& [stage, source] : m_shaderSources)
+	const std::filesystem::path& Shader::GetStagePath(VkShaderStageFlagBits stage) const
+	{
+		for (const auto& path : m_shaderPaths)
 		{
-			auto extension = Utility::GetShaderStageCachedFileExtension(stage);
-			auto& data = outShaderData[stage];
-
-			std::filesystem::path currentStagePath;
-			for (const auto& shaderPath : m_shaderPaths)
+			if (stage == Utility::GetShaderStageFromFilename(path.filename().string()))
 			{
-				if (stage == Utility::GetShaderStageFromFilename(shaderPath.filename().string()))
-				{
-					currentStagePath = shaderPath;
-					break;
-				}
-			}
-
-			auto cachedPath = cacheDirectory / (currentStagePath.filename().string() + extension);
-			if (!forceCompile)
-			{
-				std::ifstream file(cachedPath.string(), std::ios::binary | std::ios::in | std::ios::ate);
-				if (file.is_open())
-				{
-					uint64_t size = file.tellg();
-
-					data.resize(size / sizeof(uint32_t));
-
-					file.seekg(0, std::ios::beg);
-					file.read((char*)data.data(), size);
-					file.close();
-				}
-			}
-
-			if (data.empty())
-			{
-				return ShaderCompiler::TryCompile(outShaderData, m_shaderPaths);
+				return path;
 			}
 		}
 
-		return true;
+		LP_CORE_ASSERT(false, "No file found for stage!");
+		return m_shaderPaths.front();
 	}
 
 	void Shader::LoadAndCreateShaders(const std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& shaderData)
@@ -196,7 +189,7 @@ namespace Lamp
 		}
 	}
 
-	void Shader::ReflectAllStages(const std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& shaderData)
+	void Shader::ReflectAllStages(const std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& shaderData, const std::unordered_map<VkShaderStageFlagBits, uint64_t>& cacheKeys)
 	{
 		m_resources.Clear();
 		std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> setLayoutBindings; // set -> bindings
@@ -204,17 +197,28 @@ namespace Lamp
 		LP_CORE_INFO("Shader - Reflecting {0}", m_name.c_str());
 		for (const auto& [stage, data] : shaderData)
 		{
-			ReflectStage(stage, data, setLayoutBindings);
+			const std::filesystem::path& stagePath = GetStagePath(stage);
+			const uint64_t cacheKey = cacheKeys.at(stage);
+
+			// Reflection cached with the same key as the binary is valid for it, only run spirv_cross on a miss
+			std::vector<ReflectedResource> reflectedResources;
+			if (!ShaderCache::TryLoadReflection(stagePath, stage, cacheKey, reflectedResources))
+			{
+				reflectedResources = ExtractReflection(data);
+				ShaderCache::StoreReflection(stagePath, stage, cacheKey, reflectedResources);
+			}
+
+			ReflectStage(stage, reflectedResources, setLayoutBindings);
 		}
 
 		SetupDescriptors(setLayoutBindings);
 	}
 
-	void Shader::ReflectStage(VkShaderStageFlagBits stage, const std::vector<uint32_t>& data, std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>>& outSetLayoutBindings)
+	std::vector<ReflectedResource> Shader::ExtractReflection(const std::vector<uint32_t>& data)
 	{
-		auto device = GraphicsContext::GetDevice();
+		LP_PROFILE_FUNCTION();
 
-		LP_CORE_INFO("	Reflecting stage {0}", Utility::StageToString(stage).c_str());
+		std::vector<ReflectedResource> reflectedResources;
 
 		spirv_cross::Compiler compiler(data);
 		const auto resources = compiler.get_shader_resources();
@@ -223,222 +227,225 @@ namespace Lamp
 		{
 			auto& bufferType = compiler.get_type(ubo.base_type_id);
 
-			uint32_t binding = compiler.get_decoration(ubo.id, spv::DecorationBinding);
-			uint32_t set = compiler.get_decoration(ubo.id, spv::DecorationDescriptorSet);
-			uint32_t size = (uint32_t)compiler.get_declared_struct_size(bufferType);
+			ReflectedResource& resource = reflectedResources.emplace_back();
+			resource.type = ReflectedResourceType::UniformBuffer;
+			resource.binding = compiler.get_decoration(ubo.id, spv::DecorationBinding);
+			resource.set = compiler.get_decoration(ubo.id, spv::DecorationDescriptorSet);
+			resource.size = (uint32_t)compiler.get_declared_struct_size(bufferType);
+		}
 
-			auto it = std::find_if(outSetLayoutBindings[set].begin(), outSetLayoutBindings[set].end(), [binding](const VkDescriptorSetLayoutBinding& layoutBinding) { return layoutBinding.binding == binding; });
-			if (it == outSetLayoutBindings[set].end())
-			{
-				VkDescriptorSetLayoutBinding& layoutBinding = outSetLayoutBindings[set].emplace_back();
-				layoutBinding.binding = binding;
-				layoutBinding.descriptorCount = 1;
-				layoutBinding.descriptorType = set == 1 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-				layoutBinding.stageFlags = stage;
-
-				UniformBuffer& bufferInfo = m_resources.uniformBuffersInfos[set][binding];
-				bufferInfo.info.offset = 0;
-				bufferInfo.info.range = size;
-				bufferInfo.isDynamic = set == 1;
-
-				if (bufferInfo.isDynamic)
-				{
-					const uint64_t minUBOAlignment = GraphicsContext::GetDevice()->GetPhysicalDevice()->GetCapabilities().minUBOOffsetAlignment;
-					uint32_t dynamicAlignment = size;
+		for (const auto& ssbo : resources.storage_buffers)
+		{
+			auto& bufferType = compiler.get_type(ssbo.base_type_id);
 
-					if (minUBOAlignment > 0)
-					{
-						dynamicAlignment = (uint32_t)Utility::GetAlignedSize((uint64_t)dynamicAlignment, minUBOAlignment);
-					}
+			ReflectedResource& resource = reflectedResources.emplace_back();
+			resource.type = ReflectedResourceType::StorageBuffer;
+			resource.binding = compiler.get_decoration(ssbo.id, spv::DecorationBinding);
+			resource.set = compiler.get_decoration(ssbo.id, spv::DecorationDescriptorSet);
+			resource.writeable = !compiler.get_decoration(ssbo.id, spv::DecorationNonWritable);
+			resource.size = (uint32_t)compiler.get_declared_struct_size(bufferType);
+		}
 
-					bufferInfo.info.range = dynamicAlignment;
-					m_resources.dynamicBufferOffsets[set].emplace_back(DynamicOffset{ dynamicAlignment, binding });
-				}
+		for (const auto& pushConst : resources.push_constant_buffers)
+		{
+			auto& bufferType = compiler.get_type(pushConst.base_type_id);
 
-				VkWriteDescriptorSet& writeDescriptor = m_resources.writeDescriptors[set][binding];
-				writeDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeDescriptor.pNext = nullptr;
-				writeDescriptor.dstBinding = binding;
-				writeDescriptor.descriptorCount = 1;
-				writeDescriptor.descriptorType = set == 1 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			ReflectedResource& resource = reflectedResources.emplace_back();
+			resource.type = ReflectedResourceType::PushConstant;
+			resource.size = (uint32_t)compiler.get_declared_struct_size(bufferType);
+			resource.offset = compiler.get_decoration(pushConst.id, spv::DecorationOffset);
+		}
 
-				if (bufferInfo.isDynamic)
-				{
-					m_perStageDynamicUBOCount[stage].count++;
-				}
-				else
-				{
-					m_perStageUBOCount[stage].count++;
-				}
-			}
-			else
+		for (const auto& image : resources.storage_images)
+		{
+			ReflectedResource& resource = reflectedResources.emplace_back();
+			resource.type = ReflectedResourceType::StorageImage;
+			resource.binding = compiler.get_decoration(image.id, spv::DecorationBinding);
+			resource.set = compiler.get_decoration(image.id, spv::DecorationDescriptorSet);
+			resource.writeable = !compiler.get_decoration(image.id, spv::DecorationNonWritable);
+		}
+
+		for (const auto& image : resources.sampled_images)
+		{
+			ReflectedResource& resource = reflectedResources.emplace_back();
+			resource.type = ReflectedResourceType::SampledImage;
+			resource.binding = compiler.get_decoration(image.id, spv::DecorationBinding);
+			resource.set = compiler.get_decoration(image.id, spv::DecorationDescriptorSet);
+
+			const auto& type = compiler.get_type(image.type_id);
+
+			switch (type.image.dim)
 			{
-				it->stageFlags |= stage;
+				case spv::Dim::Dim1D: resource.dimension = ImageDimension::Dim1D; break;
+				case spv::Dim::Dim2D: resource.dimension = ImageDimension::Dim2D; break;
+				case spv::Dim::Dim3D: resource.dimension = ImageDimension::Dim3D; break;
+				case spv::Dim::DimCube: resource.dimension = ImageDimension::DimCube; break;
+
+				default: resource.dimension = ImageDimension::Dim2D; break;
 			}
 		}
 
-		for (const auto& ssbo : resources.storage_buffers)
-		{
-			auto& bufferType = compiler.get_type(ssbo.base_type_id);
+		return reflectedResources;
+	}
 
-			uint32_t binding = compiler.get_decoration(ssbo.id, spv::DecorationBinding);
-			uint32_t set = compiler.get_decoration(ssbo.id, spv::DecorationDescriptorSet);
-			uint32_t nonWritable = compiler.get_decoration(ssbo.id, spv::DecorationNonWritable);
+	void Shader::ReflectStage(VkShaderStageFlagBits stage, const std::vector<ReflectedResource>& reflectedResources, std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>>& outSetLayoutBindings)
+	{
+		auto device = GraphicsContext::GetDevice();
 
-			uint32_t size = (uint32_t)compiler.get_declared_struct_size(bufferType);
+		LP_CORE_INFO("	Reflecting stage {0}", Utility::StageToString(stage).c_str());
 
-			auto it = std::find_if(outSetLayoutBindings[set].begin(), outSetLayoutBindings[set].end(), [binding](const VkDescriptorSetLayoutBinding& layoutBinding) { return layoutBinding.binding == binding; });
-			if (it == outSetLayoutBindings[set].end())
+		for (const auto& resource : reflectedResources)
+		{
+			const uint32_t set = resource.set;
+			const uint32_t binding = resource.binding;
+			const uint32_t size = resource.size;
+
+			if (resource.type == ReflectedResourceType::PushConstant)
 			{
-				VkDescriptorSetLayoutBinding& layoutBinding = outSetLayoutBindings[set].emplace_back();
-				layoutBinding.binding = binding;
-				layoutBinding.descriptorCount = 1;
-				layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-				layoutBinding.stageFlags = stage;
-
-				ShaderStorageBuffer& bufferInfo = m_resources.storageBuffersInfos[set][binding];
-				bufferInfo.info.offset = 0;
-				bufferInfo.info.range = size;
-				bufferInfo.writeable = !(bool)nonWritable;
-				bufferInfo.isDynamic = set == 4;
-
-				if (bufferInfo.isDynamic)
-				{
-					const uint64_t minSSBOAlignment = GraphicsContext::GetDevice()->GetPhysicalDevice()->GetCapabilities().minSSBOOffsetAlignment;
-					uint32_t dynamicAlignment = size;
+				const uint32_t offset = resource.offset;
 
-					if (minSSBOAlignment > 0)
+				auto it = std::find_if(m_resources.pushConstantRanges.begin(), m_resources.pushConstantRanges.end(), [size, offset](const VkPushConstantRange& range)
 					{
-						dynamicAlignment = (uint32_t)Utility::GetAlignedSize((uint64_t)dynamicAlignment, minSSBOAlignment);
-					}
-
-					bufferInfo.info.range = dynamicAlignment;
-					m_resources.dynamicBufferOffsets[set].emplace_back(DynamicOffset{ dynamicAlignment, binding });
-				}
+						return range.size == size && range.offset == offset;
+					});
 
-				VkWriteDescriptorSet& writeDescriptor = m_resources.writeDescriptors[set][binding];
-				writeDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeDescriptor.pNext = nullptr;
-				writeDescriptor.dstBinding = binding;
-				writeDescriptor.descriptorCount = 1;
-				writeDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-
-				if (bufferInfo.isDynamic)
+				if (it == m_resources.pushConstantRanges.end())
 				{
-					m_perStageDynamicSSBOCount[stage].count++;
+					auto& pushConstantRange = m_resources.pushConstantRanges.emplace_back();
+					pushConstantRange.offset = offset;
+					pushConstantRange.size = size;
+					pushConstantRange.stageFlags = stage;
 				}
 				else
 				{
-					m_perStageSSBOCount[stage].count++;
+					(*it).stageFlags |= stage;
 				}
-			}
-			else
-			{
-				it->stageFlags |= stage;
-			}
-		}
 
-		for (const auto& pushConst : resources.push_constant_buffers)
-		{
-			auto& bufferType = compiler.get_type(pushConst.base_type_id);
-			uint32_t size = (uint32_t)compiler.get_declared_struct_size(bufferType);
-			uint32_t offset = compiler.get_decoration(pushConst.id, spv::DecorationOffset);
+				continue;
+			}
 
-			auto it = std::find_if(m_resources.pushConstantRanges.begin(), m_resources.pushConstantRanges.end(), [size, offset](const VkPushConstantRange& range)
+			// The bindless set layout comes from the registry, not from reflection
+			if (set == (uint32_t)DescriptorSetType::Bindless)
+			{
+				if (!BindlessRegistry::IsEnabled())
 				{
-					return range.size == size && range.offset == offset;
-				});
+					LP_CORE_ERROR("Shader {0} uses the bindless set, but bindless mode is not enabled!", m_name.c_str());
+				}
 
-			if (it == m_resources.pushConstantRanges.end())
-			{
-				auto& pushConstantRange = m_resources.pushConstantRanges.emplace_back();
-				pushConstantRange.offset = offset;
-				pushConstantRange.size = size;
-				pushConstantRange.stageFlags = stage;
-			}
-			else
-			{
-				(*it).stageFlags |= stage;
+				m_resources.usesBindless = true;
+				continue;
 			}
-		}
-
-		for (const auto& image : resources.storage_images)
-		{
-			uint32_t binding = compiler.get_decoration(image.id, spv::DecorationBinding);
-			uint32_t set = compiler.get_decoration(image.id, spv::DecorationDescriptorSet);
-			uint32_t nonWritable = compiler.get_decoration(image.id, spv::DecorationNonWritable);
 
 			auto it = std::find_if(outSetLayoutBindings[set].begin(), outSetLayoutBindings[set].end(), [binding](const VkDescriptorSetLayoutBinding& layoutBinding) { return layoutBinding.binding == binding; });
-			if (it == outSetLayoutBindings[set].end())
-			{
-				VkDescriptorSetLayoutBinding& layoutBinding = outSetLayoutBindings[set].emplace_back();
-				layoutBinding.binding = binding;
-				layoutBinding.descriptorCount = 1;
-				layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-				layoutBinding.stageFlags = stage;
-
-				StorageImage& imageInfo = m_resources.storageImagesInfos[set][binding];
-				imageInfo.info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-				imageInfo.writeable = !(bool)nonWritable;
-
-				VkWriteDescriptorSet& writeDescriptor = m_resources.writeDescriptors[set][binding];
-				writeDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeDescriptor.pNext = nullptr;
-				writeDescriptor.dstBinding = binding;
-				writeDescriptor.descriptorCount = 1;
-				writeDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-
-				m_perStageStorageImageCount[stage].count++;
-			}
-			else
+			if (it != outSetLayoutBindings[set].end())
 			{
 				it->stageFlags |= stage;
+				continue;
 			}
-		}
 
-		for (const auto& image : resources.sampled_images)
-		{
-			uint32_t binding = compiler.get_decoration(image.id, spv::DecorationBinding);
-			uint32_t set = compiler.get_decoration(image.id, spv::DecorationDescriptorSet);
+			VkDescriptorSetLayoutBinding& layoutBinding = outSetLayoutBindings[set].emplace_back();
+			layoutBinding.binding = binding;
+			layoutBinding.descriptorCount = 1;
+			layoutBinding.stageFlags = stage;
 
-			auto it = std::find_if(outSetLayoutBindings[set].begin(), outSetLayoutBindings[set].end(), [binding](const VkDescriptorSetLayoutBinding& layoutBinding) { return layoutBinding.binding == binding; });
-			if (it == outSetLayoutBindings[set].end())
+			VkWriteDescriptorSet& writeDescriptor = m_resources.writeDescriptors[set][binding];
+			writeDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDescriptor.pNext = nullptr;
+			writeDescriptor.dstBinding = binding;
+			writeDescriptor.descriptorCount = 1;
+
+			switch (resource.type)
 			{
-				VkDescriptorSetLayoutBinding& layoutBinding = outSetLayoutBindings[set].emplace_back();
-				layoutBinding.binding = binding;
-				layoutBinding.descriptorCount = 1;
-				layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				layoutBinding.stageFlags = stage;
+				case ReflectedResourceType::UniformBuffer:
+				{
+					layoutBinding.descriptorType = set == 1 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+					writeDescriptor.descriptorType = layoutBinding.descriptorType;
 
-				SampledImage& imageInfo = m_resources.imageInfos[set][binding];
+					UniformBuffer& bufferInfo = m_resources.uniformBuffersInfos[set][binding];
+					bufferInfo.info.offset = 0;
+					bufferInfo.info.range = size;
+					bufferInfo.isDynamic = set == 1;
+
+					if (bufferInfo.isDynamic)
+					{
+						const uint64_t minUBOAlignment = device->GetPhysicalDevice()->GetCapabilities().minUBOOffsetAlignment;
+						uint32_t dynamicAlignment = size;
 
-				const auto& type = compiler.get_type(image.type_id);
+						if (minUBOAlignment > 0)
+						{
+							dynamicAlignment = (uint32_t)Utility::GetAlignedSize((uint64_t)dynamicAlignment, minUBOAlignment);
+						}
 
-				switch (type.image.dim)
+						bufferInfo.info.range = dynamicAlignment;
+						m_resources.dynamicBufferOffsets[set].emplace_back(DynamicOffset{ dynamicAlignment, binding });
+						m_perStageDynamicUBOCount[stage].count++;
+					}
+					else
+					{
+						m_perStageUBOCount[stage].count++;
+					}
+
+					break;
+				}
+
+				case ReflectedResourceType::StorageBuffer:
 				{
-					case spv::Dim::Dim1D: imageInfo.dimension = ImageDimension::Dim1D; break;
-					case spv::Dim::Dim2D: imageInfo.dimension = ImageDimension::Dim2D; break;
-					case spv::Dim::Dim3D: imageInfo.dimension = ImageDimension::Dim3D; break;
-					case spv::Dim::DimCube: imageInfo.dimension = ImageDimension::DimCube; break;
+					layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+					writeDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+					ShaderStorageBuffer& bufferInfo = m_resources.storageBuffersInfos[set][binding];
+					bufferInfo.info.offset = 0;
+					bufferInfo.info.range = size;
+					bufferInfo.writeable = (bool)resource.writeable;
+					bufferInfo.isDynamic = set == 4;
+
+					if (bufferInfo.isDynamic)
+					{
+						const uint64_t minSSBOAlignment = device->GetPhysicalDevice()->GetCapabilities().minSSBOOffsetAlignment;
+						uint32_t dynamicAlignment = size;
 
-					default: imageInfo.dimension = ImageDimension::Dim2D; break;
+						if (minSSBOAlignment > 0)
+						{
+							dynamicAlignment = (uint32_t)Utility::GetAlignedSize((uint64_t)dynamicAlignment, minSSBOAlignment);
+						}
+
+						bufferInfo.info.range = dynamicAlignment;
+						m_resources.dynamicBufferOffsets[set].emplace_back(DynamicOffset{ dynamicAlignment, binding });
+						m_perStageDynamicSSBOCount[stage].count++;
+					}
+					else
+					{
+						m_perStageSSBOCount[stage].count++;
+					}
+
+					break;
 				}
 
-				VkDescriptorImageInfo& descriptorInfo = imageInfo.info;
-				descriptorInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				case ReflectedResourceType::StorageImage:
+				{
+					layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+					writeDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
 
-				VkWriteDescriptorSet& writeDescriptor = m_resources.writeDescriptors[set][binding];
-				writeDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeDescriptor.pNext = nullptr;
-				writeDescriptor.dstBinding = binding;
-				writeDescriptor.descriptorCount = 1;
-				writeDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					StorageImage& imageInfo = m_resources.storageImagesInfos[set][binding];
+					imageInfo.info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+					imageInfo.writeable = (bool)resource.writeable;
 
-				m_perStageImageCount[stage].count++;
-			}
-			else
-			{
-				it->stageFlags |= stage;
+					m_perStageStorageImageCount[stage].count++;
+					break;
+				}
+
+				case ReflectedResourceType::SampledImage:
+				{
+					layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					writeDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+					SampledImage& imageInfo = m_resources.imageInfos[set][binding];
+					imageInfo.dimension = resource.dimension;
+					imageInfo.info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+					m_perStageImageCount[stage].count++;
+					break;
+				}
 			}
 		}
 
@@ -466,27 +473,27 @@ namespace Lamp
 		{
 			while ((int32_t)set > lastSet + 1)
 			{
-				VkDescriptorSetLayoutCreateInfo layoutInfo{};
-				layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-				layoutInfo.pNext = nullptr;
-				layoutInfo.bindingCount = 0;
-				layoutInfo.pBindings = nullptr;
-
-				vkCreateDescriptorSetLayout(GraphicsContext::GetDevice()->GetHandle(), &layoutInfo, nullptr, &m_resources.paddedSetLayouts.emplace_back());
+				m_resources.paddedSetLayouts.emplace_back(DescriptorSetLayoutCache::Get({}));
 				lastSet++;
 			}
 
-			VkDescriptorSetLayoutCreateInfo layoutInfo{};
-			layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			layoutInfo.pNext = nullptr;
-			layoutInfo.bindingCount = (uint32_t)bindings.size();
-			layoutInfo.pBindings = bindings.data();
-
-			vkCreateDescriptorSetLayout(GraphicsContext::GetDevice()->GetHandle(), &layoutInfo, nullptr, &m_resources.paddedSetLayouts.emplace_back());
+			m_resources.paddedSetLayouts.emplace_back(DescriptorSetLayoutCache::Get(bindings));
 			m_resources.realSetLayouts.emplace_back(m_resources.paddedSetLayouts.back());
 			lastSet = set;
 		}
 
+		if (m_resources.usesBindless && BindlessRegistry::IsEnabled())
+		{
+			while ((int32_t)DescriptorSetType::Bindless > lastSet + 1)
+			{
+				m_resources.paddedSetLayouts.emplace_back(DescriptorSetLayoutCache::Get({}));
+				lastSet++;
+			}
+
+			// Bound once per command buffer through the registry, so it is not part of the allocated sets
+			m_resources.paddedSetLayouts.emplace_back(BindlessRegistry::GetDescriptorSetLayout());
+		}
+
 		VkDescriptorSetAllocateInfo& allocInfo = m_resources.setAllocInfo;
 		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 		allocInfo.descriptorSetCount = (uint32_t)m_resources.realSetLayouts.size();
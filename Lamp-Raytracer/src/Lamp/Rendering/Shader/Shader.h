@@ -17,15 +17,19 @@ namespace Lamp
 	// 2 - Per object -- Unused for now
 	// 3 - Per material -- All textures for now
 	// 4 - Mesh data -- Shader Buffers are dynamic
+	// 5 - Bindless -- Owned by the BindlessRegistry, only when bindless mode is enabled
 
 	enum class DescriptorSetType : uint32_t
 	{
 		PerFrame = 0,
 		PerPass = 1,
 		PerObject = 2,
-		PerMaterial = 3
+		PerMaterial = 3,
+		Bindless = 5
 	};
 
+	struct ReflectedResource;
+
 	class Shader
 	{
 	public:
@@ -86,6 +90,7 @@ namespace Lamp
 			std::map<uint32_t, std::vector<DynamicOffset>> dynamicBufferOffsets; // set -> offsets
 
 			VkDescriptorSetAllocateInfo setAllocInfo{};
+			bool usesBindless = false;
 			
 			void Clear();
 		};
@@ -96,10 +101,13 @@ namespace Lamp
 		~Shader();
 
 		bool Reload(bool forceCompile);
+		const bool DependsOn(const std::filesystem::path& file) const;
 	
 		inline const std::vector<VkPipelineShaderStageCreateInfo>& GetStageInfos() const { return m_pipelineShaderStageInfos; }
 		inline const ShaderResources& GetResources() const { return m_resources; }
 		inline const std::string& GetName() const { return m_name; }
+		inline const std::vector<std::filesystem::path>& GetShaderPaths() const { return m_shaderPaths; }
+		inline const bool IsValid() const { return !m_pipelineShaderStageInfos.empty(); }
 		inline const size_t GetHash() const { return m_hash; }
 
 		static Ref<Shader> Create(const std::string& name, std::initializer_list<std::filesystem::path> paths, bool forceCompile = false);
@@ -115,10 +123,13 @@ namespace Lamp
 		void LoadShaderFromFiles();
 		void Release();
 
-		bool CompileOrGetBinary(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, bool forceCompile);
+		bool CompileOrGetBinary(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, std::unordered_map<VkShaderStageFlagBits, uint64_t>& outCacheKeys, bool forceCompile);
 		void LoadAndCreateShaders(const std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& shaderData);
-		void ReflectAllStages(const std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& shaderData);
-		void ReflectStage(VkShaderStageFlagBits stage, const std::vector<uint32_t>& data, std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>>& outSetLayoutBindings);
+		void ReflectAllStages(const std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& shaderData, const std::unordered_map<VkShaderStageFlagBits, uint64_t>& cacheKeys);
+		void ReflectStage(VkShaderStageFlagBits stage, const std::vector<ReflectedResource>& reflectedResources, std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>>& outSetLayoutBindings);
+		
+		static std::vector<ReflectedResource> ExtractReflection(const std::vector<uint32_t>& data);
+		const std::filesystem::path& GetStagePath(VkShaderStageFlagBits stage) const;
 		
 		void SetupDescriptors(const std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>>& setLayoutBindings);
 
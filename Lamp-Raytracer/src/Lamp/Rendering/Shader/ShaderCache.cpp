@@ -0,0 +1,265 @@
+#include "lppch.h"
+#include "ShaderCache.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Rendering/Shader/ShaderUtility.h"
+
+#include "Lamp/Utility/FileSystem.h"
+#include "Lamp/Utility/SerializationMacros.h"
+
+#include <yaml-cpp/yaml.h>
+
+#include <format>
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		bool HashFile(const std::filesystem::path& path, uint64_t& outHash)
+		{
+			std::ifstream file(path, std::ios::in | std::ios::binary);
+			if (!file.is_open())
+			{
+				return false;
+			}
+
+			std::stringstream buffer;
+			buffer << file.rdbuf();
+
+			const std::string data = buffer.str();
+			outHash = HashData(data.data(), data.size());
+
+			return true;
+		}
+	}
+
+	const uint64_t ShaderCache::ComputeKey(const std::string& preprocessedSource, VkShaderStageFlagBits stage, const uint64_t optionsHash)
+	{
+		uint64_t key = Utility::HashData(preprocessedSource.data(), preprocessedSource.size());
+		key = Utility::HashData(&stage, sizeof(stage), key);
+		key = Utility::HashData(&optionsHash, sizeof(optionsHash), key);
+
+		return key;
+	}
+
+	bool ShaderCache::TryLoadFromManifest(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t optionsHash, std::vector<uint32_t>& outData, uint64_t& outKey)
+	{
+		const std::filesystem::path manifestPath = GetManifestPath(path, stage);
+		if (!std::filesystem::exists(manifestPath))
+		{
+			return false;
+		}
+
+		YAML::Node root;
+
+		try
+		{
+			root = YAML::LoadFile(manifestPath.string());
+		}
+		catch (const YAML::Exception&)
+		{
+			return false;
+		}
+
+		uint64_t key = 0;
+		uint64_t manifestOptions = 0;
+
+		LP_DESERIALIZE_PROPERTY(key, key, root, uint64_t(0));
+		LP_DESERIALIZE_PROPERTY(options, manifestOptions, root, uint64_t(0));
+
+		if (manifestOptions != optionsHash || !root["dependencies"])
+		{
+			return false;
+		}
+
+		for (const auto& dependency : root["dependencies"])
+		{
+			std::string dependencyPath;
+			uint64_t dependencyHash = 0;
+
+			LP_DESERIALIZE_PROPERTY(path, dependencyPath, dependency, std::string());
+			LP_DESERIALIZE_PROPERTY(hash, dependencyHash, dependency, uint64_t(0));
+
+			uint64_t currentHash = 0;
+			if (!Utility::HashFile(dependencyPath, currentHash) || currentHash != dependencyHash)
+			{
+				return false;
+			}
+		}
+
+		if (!TryLoad(path, stage, key, outData))
+		{
+			return false;
+		}
+
+		outKey = key;
+		return true;
+	}
+
+	bool ShaderCache::TryLoad(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key, std::vector<uint32_t>& outData)
+	{
+		std::ifstream file(GetBinaryPath(path, stage, key), std::ios::binary | std::ios::in | std::ios::ate);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		const uint64_t size = file.tellg();
+		if (size == 0 || size % sizeof(uint32_t) != 0)
+		{
+			return false;
+		}
+
+		outData.resize(size / sizeof(uint32_t));
+
+		file.seekg(0, std::ios::beg);
+		file.read((char*)outData.data(), size);
+
+		return file.good();
+	}
+
+	void ShaderCache::Store(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key, const std::vector<uint32_t>& data)
+	{
+		WriteCacheFile(GetBinaryPath(path, stage, key), data.data(), data.size() * sizeof(uint32_t));
+	}
+
+	void ShaderCache::WriteManifest(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key, const uint64_t optionsHash, const std::vector<std::filesystem::path>& includes)
+	{
+		// The shader file itself is the first dependency, includes follow in sorted order
+		std::vector<std::string> dependencies;
+		for (const auto& include : includes)
+		{
+			dependencies.emplace_back(include.lexically_normal().generic_string());
+		}
+
+		std::sort(dependencies.begin(), dependencies.end());
+		dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+		dependencies.insert(dependencies.begin(), path.lexically_normal().generic_string());
+
+		YAML::Emitter out;
+		out << YAML::BeginMap;
+		LP_SERIALIZE_PROPERTY(key, key, out);
+		LP_SERIALIZE_PROPERTY(options, optionsHash, out);
+
+		out << YAML::Key << "dependencies" << YAML::Value << YAML::BeginSeq;
+		for (const auto& dependency : dependencies)
+		{
+			uint64_t hash = 0;
+			if (!Utility::HashFile(dependency, hash))
+			{
+				LP_CORE_ERROR("Unable to hash shader dependency {0}!", dependency.c_str());
+				return;
+			}
+
+			out << YAML::BeginMap;
+			LP_SERIALIZE_PROPERTY(path, dependency, out);
+			LP_SERIALIZE_PROPERTY(hash, hash, out);
+			out << YAML::EndMap;
+		}
+		out << YAML::EndSeq;
+		out << YAML::EndMap;
+
+		WriteCacheFile(GetManifestPath(path, stage), out.c_str(), out.size());
+	}
+
+	std::vector<std::string> ShaderCache::GetDependencies(const std::filesystem::path& path, VkShaderStageFlagBits stage)
+	{
+		std::vector<std::string> dependencies;
+
+		try
+		{
+			const YAML::Node root = YAML::LoadFile(GetManifestPath(path, stage).string());
+			for (const auto& dependency : root["dependencies"])
+			{
+				std::string dependencyPath;
+				LP_DESERIALIZE_PROPERTY(path, dependencyPath, dependency, std::string());
+
+				dependencies.emplace_back(dependencyPath);
+			}
+		}
+		catch (const YAML::Exception&)
+		{
+			dependencies.clear();
+		}
+
+		if (dependencies.empty())
+		{
+			dependencies.emplace_back(path.lexically_normal().generic_string());
+		}
+
+		return dependencies;
+	}
+
+	bool ShaderCache::TryLoadReflection(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key, std::vector<ReflectedResource>& outResources)
+	{
+		std::ifstream file(GetReflectionPath(path, stage, key), std::ios::binary | std::ios::in);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		ReflectionHeader header{};
+		file.read((char*)&header, sizeof(ReflectionHeader));
+
+		if (!file.good() || header.magic != s_reflectionMagic || header.version != s_reflectionVersion || header.key != key)
+		{
+			return false;
+		}
+
+		outResources.resize(header.resourceCount);
+		file.read((char*)outResources.data(), header.resourceCount * sizeof(ReflectedResource));
+
+		return file.good();
+	}
+
+	void ShaderCache::StoreReflection(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key, const std::vector<ReflectedResource>& resources)
+	{
+		ReflectionHeader header{};
+		header.magic = s_reflectionMagic;
+		header.version = s_reflectionVersion;
+		header.key = key;
+		header.resourceCount = (uint32_t)resources.size();
+
+		std::vector<uint8_t> data(sizeof(ReflectionHeader) + resources.size() * sizeof(ReflectedResource));
+		memcpy_s(data.data(), data.size(), &header, sizeof(ReflectionHeader));
+
+		if (!resources.empty())
+		{
+			memcpy_s(data.data() + sizeof(ReflectionHeader), data.size() - sizeof(ReflectionHeader), resources.data(), resources.size() * sizeof(ReflectedResource));
+		}
+
+		WriteCacheFile(GetReflectionPath(path, stage, key), data.data(), data.size());
+	}
+
+	void ShaderCache::WriteCacheFile(const std::filesystem::path& path, const void* data, size_t size)
+	{
+		// Several shaders can share a file and write it concurrently
+		if (!FileSystem::WriteFileAtomic(path, data, size))
+		{
+			LP_CORE_ERROR("Failed to write shader cache file {0}!", path.string().c_str());
+		}
+	}
+
+	std::filesystem::path ShaderCache::GetBinaryPath(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key)
+	{
+		return Utility::GetShaderCacheDirectory() / std::format("{}.{:016x}{}", path.filename().string(), key, Utility::GetShaderStageCachedFileExtension(stage));
+	}
+
+	std::filesystem::path ShaderCache::GetReflectionPath(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key)
+	{
+		std::filesystem::path reflectionPath = GetBinaryPath(path, stage, key);
+		reflectionPath.replace_extension(".reflection");
+
+		return reflectionPath;
+	}
+
+	std::filesystem::path ShaderCache::GetManifestPath(const std::filesystem::path& path, VkShaderStageFlagBits stage)
+	{
+		// Files with the same name in different folders must not share a manifest
+		const std::string fullPath = path.lexically_normal().generic_string();
+		const uint64_t pathHash = Utility::HashData(fullPath.data(), fullPath.size());
+
+		return Utility::GetShaderCacheDirectory() / std::format("{}.{:016x}{}.manifest", path.filename().string(), pathHash, Utility::GetShaderStageCachedFileExtension(stage));
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+#include "Lamp/Rendering/Texture/ImageCommon.h"
+
+#include <vulkan/vulkan.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace Lamp
+{
+	enum class ReflectedResourceType : uint32_t
+	{
+		UniformBuffer,
+		StorageBuffer,
+		PushConstant,
+		StorageImage,
+		SampledImage
+	};
+
+	// Everything Shader needs from spirv_cross for one resource, stored as is in the reflection cache
+	struct ReflectedResource
+	{
+		ReflectedResourceType type = ReflectedResourceType::UniformBuffer;
+
+		uint32_t set = 0;
+		uint32_t binding = 0;
+		uint32_t size = 0;
+		uint32_t offset = 0;
+		uint32_t writeable = 0;
+
+		ImageDimension dimension = ImageDimension::Dim2D;
+	};
+
+	// Content addressed SPIR-V cache. Binaries are keyed by a hash of the preprocessed source, the stage and the compile options.
+	// A manifest per shader file records the key and every file it includes, so unchanged shaders can skip preprocessing.
+	class ShaderCache
+	{
+	public:
+		static const uint64_t ComputeKey(const std::string& preprocessedSource, VkShaderStageFlagBits stage, const uint64_t optionsHash);
+
+		// Succeeds if the manifest was written with the same options and neither the file nor any of its includes changed since
+		static bool TryLoadFromManifest(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t optionsHash, std::vector<uint32_t>& outData, uint64_t& outKey);
+		static bool TryLoad(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key, std::vector<uint32_t>& outData);
+
+		static void Store(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key, const std::vector<uint32_t>& data);
+		static void WriteManifest(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key, const uint64_t optionsHash, const std::vector<std::filesystem::path>& includes);
+
+		// Normalized paths of the file and everything it included when it was last compiled
+		static std::vector<std::string> GetDependencies(const std::filesystem::path& path, VkShaderStageFlagBits stage);
+
+		// Reflection is stored next to the binary with the same key
+		static bool TryLoadReflection(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key, std::vector<ReflectedResource>& outResources);
+		static void StoreReflection(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key, const std::vector<ReflectedResource>& resources);
+
+	private:
+		ShaderCache() = delete;
+
+		struct ReflectionHeader
+		{
+			uint32_t magic = 0;
+			uint32_t version = 0;
+			uint64_t key = 0;
+			uint32_t resourceCount = 0;
+		};
+
+		inline static constexpr uint32_t s_reflectionMagic = 0x4652504c; // LPRF
+		inline static constexpr uint32_t s_reflectionVersion = 1;
+
+		static void WriteCacheFile(const std::filesystem::path& path, const void* data, size_t size);
+
+		static std::filesystem::path GetBinaryPath(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key);
+		static std::filesystem::path GetReflectionPath(const std::filesystem::path& path, VkShaderStageFlagBits stage, const uint64_t key);
+		static std::filesystem::path GetManifestPath(const std::filesystem::path& path, VkShaderStageFlagBits stage);
+	};
+}
@@ -2,8 +2,11 @@
 #include "ShaderCompiler.h"
 
 #include "ShaderUtility.h"
+#include "ShaderCache.h"
 #include "HLSLIncluder.h"
 
+#include "Lamp/Core/Jobs/JobSystem.h"
+
 #include <shaderc/shaderc.hpp>
 #include <dxc/dxcapi.h>
 
@@ -12,6 +15,8 @@
 
 #include <combaseapi.h>
 
+#include <array>
+
 namespace Lamp
 {
 	namespace Utils
@@ -29,16 +34,128 @@ namespace Lamp
 
 			return Shader::Language::Invalid;
 		}
+
+		struct GLSLCompilerInstance
+		{
+			GLSLCompilerInstance()
+			{
+				fileFinder.search_path().emplace_back("Engine/Shaders/GLSL/");
+				fileFinder.search_path().emplace_back("Engine/Shaders/Includes/");
+			}
+
+			shaderc::Compiler compiler;
+			shaderc_util::FileFinder fileFinder;
+		};
+
+		// Everything apart from the preprocessed source that changes the generated SPIR-V. The shaderc options and the cache key are both built from this.
+		struct GLSLCompileSettings
+		{
+			shaderc_target_env targetEnvironment = shaderc_target_env_vulkan;
+			shaderc_env_version environmentVersion = shaderc_env_version_vulkan_1_3;
+			shaderc_optimization_level optimizationLevel = shaderc_optimization_level_performance;
+			bool warningsAsErrors = true;
+
+#ifdef LP_ENABLE_SHADER_DEBUG
+			bool generateDebugInfo = true;
+#else
+			bool generateDebugInfo = false;
+#endif
+		};
+
+		inline shaderc::CompileOptions CreateGLSLCompileOptions(const GLSLCompileSettings& settings)
+		{
+			shaderc::CompileOptions compileOptions;
+			compileOptions.SetTargetEnvironment(settings.targetEnvironment, settings.environmentVersion);
+			compileOptions.SetOptimizationLevel(settings.optimizationLevel);
+
+			if (settings.warningsAsErrors)
+			{
+				compileOptions.SetWarningsAsErrors();
+			}
+
+			if (settings.generateDebugInfo)
+			{
+				compileOptions.SetGenerateDebugInfo();
+			}
+
+			return compileOptions;
+		}
+
+		// Everything apart from the file path passed to DXC when compiling
+		inline std::vector<const wchar_t*> GetHLSLCompileArguments(VkShaderStageFlagBits stage)
+		{
+			std::vector<const wchar_t*> arguments
+			{
+				L"-E",
+				L"main",
+				L"-T",
+				Utility::HLSLShaderProfile(stage),
+				L"-spirv",
+				L"-fspv-target-env=vulkan1.3",
+				L"-fvk-support-nonzero-base-instance",
+				DXC_ARG_PACK_MATRIX_COLUMN_MAJOR,
+				DXC_ARG_WARNINGS_ARE_ERRORS
+			};
+
+#ifdef LP_ENABLE_SHADER_DEBUG
+			arguments.emplace_back(L"-Qembed_debug");
+			arguments.emplace_back(DXC_ARG_DEBUG);
+#endif
+
+			if (stage & (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_GEOMETRY_BIT))
+			{
+				arguments.emplace_back(L"-fvk-invert-y");
+			}
+
+			return arguments;
+		}
+
+		inline const uint64_t GetCompileOptionsHash(Shader::Language language, VkShaderStageFlagBits stage)
+		{
+			if (language == Shader::Language::GLSL)
+			{
+				const GLSLCompileSettings settings{};
+				const std::array<uint32_t, 6> values
+				{
+					(uint32_t)language,
+					(uint32_t)settings.targetEnvironment,
+					(uint32_t)settings.environmentVersion,
+					(uint32_t)settings.optimizationLevel,
+					(uint32_t)settings.warningsAsErrors,
+					(uint32_t)settings.generateDebugInfo
+				};
+
+				return Utility::HashData(values.data(), values.size() * sizeof(uint32_t));
+			}
+
+			const uint32_t languageValue = (uint32_t)language;
+			uint64_t hash = Utility::HashData(&languageValue, sizeof(uint32_t));
+
+			for (const wchar_t* argument : GetHLSLCompileArguments(stage))
+			{
+				// The terminator is included so that split arguments don't hash like joined ones
+				hash = Utility::HashData(argument, (wcslen(argument) + 1) * sizeof(wchar_t), hash);
+			}
+
+			return hash;
+		}
+
+		inline GLSLCompilerInstance& GetGLSLCompilerInstance()
+		{
+			// Created once per thread and reused for every stage compiled on it
+			static thread_local GLSLCompilerInstance instance;
+			return instance;
+		}
 	}
 
-	bool ShaderCompiler::TryCompile(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, std::vector<std::filesystem::path> shaderFiles)
+	bool ShaderCompiler::TryCompile(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, std::unordered_map<VkShaderStageFlagBits, uint64_t>& outCacheKeys, std::vector<std::filesystem::path> shaderFiles, bool forceCompile)
 	{
 		std::unordered_map<VkShaderStageFlagBits, std::string> shaderSources;
 
 		std::vector<Shader::Language> shaderLanguages = GetLanguages(shaderFiles);
 		LoadShaderFromFiles(shaderSources, shaderFiles);
 
-		return CompileAll(outShaderData, shaderSources, shaderFiles, shaderLanguages);
+		return CompileAll(outShaderData, outCacheKeys, shaderSources, shaderFiles, shaderLanguages, forceCompile);
 	}
 
 	void ShaderCompiler::LoadShaderFromFiles(std::unordered_map<VkShaderStageFlagBits, std::string>& shaderSources, const std::vector<std::filesystem::path>& shaderFiles)
@@ -70,99 +187,138 @@ namespace Lamp
 		return languages;
 	}
 
-	bool ShaderCompiler::CompileAll(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, const std::unordered_map<VkShaderStageFlagBits,
-		std::string>& shaderSources, const std::vector<std::filesystem::path>& shaderFiles, const std::vector<Shader::Language>& languages)
+	bool ShaderCompiler::CompileAll(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, std::unordered_map<VkShaderStageFlagBits, uint64_t>& outCacheKeys, 
+		const std::unordered_map<VkShaderStageFlagBits, std::string>& shaderSources, const std::vector<std::filesystem::path>& shaderFiles, const std::vector<Shader::Language>& languages, bool forceCompile)
 	{
-		uint32_t index = 0;
+		LP_PROFILE_FUNCTION();
+
+		struct StageResult
+		{
+			VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+			std::vector<uint32_t> data;
+			std::string error;
+			uint64_t key = 0;
+
+			bool scheduled = false;
+			bool compiled = false;
+		};
+
+		std::vector<StageResult> results(shaderFiles.size());
+		std::set<VkShaderStageFlagBits> scheduledStages;
 
-		for (const auto& [stage, source] : shaderSources)
+		JobCounter counter;
+
+		// Stages are paired with their file by index, each stage is compiled on its own job
+		for (size_t index = 0; index < shaderFiles.size(); index++)
 		{
-			const Shader::Language lang = languages[index];
+			const auto& path = shaderFiles[index];
+			const VkShaderStageFlagBits stage = Utility::GetShaderStageFromFilename(path.filename().string());
 
-			if (lang == Shader::Language::GLSL)
+			auto sourceIt = shaderSources.find(stage);
+			if (sourceIt == shaderSources.end() || !scheduledStages.emplace(stage).second)
 			{
-				if (!CompileGLSL(stage, source, shaderFiles[index], outShaderData[stage]))
+				continue;
+			}
+
+			results[index].stage = stage;
+			results[index].scheduled = true;
+
+			JobSystem::Schedule([&result = results[index], &source = sourceIt->second, &path, stage, lang = languages[index], forceCompile]()
 				{
-					return false;
-				}
+					LP_PROFILE_SCOPE("Compile Shader Stage");
+
+					// Unchanged files and includes skip preprocessing entirely
+					if (!forceCompile && lang != Shader::Language::Invalid && ShaderCache::TryLoadFromManifest(path, stage, Utils::GetCompileOptionsHash(lang, stage), result.data, result.key))
+					{
+						result.compiled = true;
+					}
+					else if (lang == Shader::Language::GLSL)
+					{
+						result.compiled = CompileGLSL(stage, source, path, forceCompile, result.data, result.key, result.error);
+					}
+					else if (lang == Shader::Language::HLSL)
+					{
+						result.compiled = CompileHLSL(stage, source, path, forceCompile, result.data, result.key, result.error);
+					}
+					else
+					{
+						result.error = std::format("Unable to determine language of shader {0}!", path.string());
+					}
+				}, &counter);
+		}
+
+		JobSystem::Wait(counter);
+
+		// Errors are reported in file order, independent of which stage finished first
+		bool succeeded = true;
+		for (auto& result : results)
+		{
+			if (!result.scheduled)
+			{
+				continue;
 			}
-			else if (lang == Shader::Language::HLSL)
+
+			if (!result.compiled)
 			{
-				if (!CompileHLSL(stage, source, shaderFiles[index], outShaderData[stage]))
-				{
-					return false;
-				}
+				LP_CORE_ERROR("{0}", result.error.c_str());
+				succeeded = false;
+				continue;
 			}
 
-			index++;
+			outShaderData[result.stage] = std::move(result.data);
+			outCacheKeys[result.stage] = result.key;
 		}
 
-		return true;
+		return succeeded;
 	}
 
-	bool ShaderCompiler::CompileGLSL(const VkShaderStageFlagBits stage, const std::string& src, const std::filesystem::path& path, std::vector<uint32_t>& outShaderData)
+	bool ShaderCompiler::CompileGLSL(const VkShaderStageFlagBits stage, const std::string& src, const std::filesystem::path& path, bool forceCompile, std::vector<uint32_t>& outShaderData, uint64_t& outKey, std::string& outError)
 	{
-		auto cacheDirectory = Utility::GetShaderCacheDirectory();
-		auto extension = Utility::GetShaderStageCachedFileExtension(stage);
+		auto& [compiler, fileFinder] = Utils::GetGLSLCompilerInstance();
+		shaderc::CompileOptions compileOptions = Utils::CreateGLSLCompileOptions(Utils::GLSLCompileSettings{});
 
-		auto cachedPath = cacheDirectory / (path.filename().string() + extension);
+		auto includer = std::make_unique<glslc::FileIncluder>(&fileFinder);
+		const glslc::FileIncluder* fileIncluder = includer.get();
 
-		shaderc::Compiler compiler;
-		shaderc::CompileOptions compileOptions;
+		compileOptions.SetIncluder(std::move(includer));
 
-		shaderc_util::FileFinder fileFinder;
-		fileFinder.search_path().emplace_back("Engine/Shaders/GLSL/");
-		fileFinder.search_path().emplace_back("Engine/Shaders/Includes/");
+		std::string proccessedSource = src;
+		if (!PreprocessGLSL(stage, path, proccessedSource, compiler, compileOptions, outError))
+		{
+			return false;
+		}
 
-		compileOptions.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
-		compileOptions.SetWarningsAsErrors();
-		compileOptions.SetIncluder(std::make_unique<glslc::FileIncluder>(&fileFinder));
-		compileOptions.SetOptimizationLevel(shaderc_optimization_level_performance);
+		const uint64_t optionsHash = Utils::GetCompileOptionsHash(Shader::Language::GLSL, stage);
+		const uint64_t key = ShaderCache::ComputeKey(proccessedSource, stage, optionsHash);
+		outKey = key;
 
-#ifdef LP_ENABLE_SHADER_DEBUG
-		compileOptions.SetGenerateDebugInfo();
-#endif
+		const std::vector<std::filesystem::path> includes{ fileIncluder->file_path_trace().begin(), fileIncluder->file_path_trace().end() };
 
-		std::string proccessedSource = src;
-		if (!PreprocessGLSL(stage, path, proccessedSource, compiler, compileOptions))
+		if (!forceCompile && ShaderCache::TryLoad(path, stage, key, outShaderData))
 		{
-			return false;
+			ShaderCache::WriteManifest(path, stage, key, optionsHash, includes);
+			return true;
 		}
 
 		// Compile shader
 		{
-			shaderc::SpvCompilationResult compileResult = compiler.CompileGlslToSpv(proccessedSource, Utility::VulkanToShaderCStage(stage), path.string().c_str());
+			shaderc::SpvCompilationResult compileResult = compiler.CompileGlslToSpv(proccessedSource, Utility::VulkanToShaderCStage(stage), path.string().c_str(), compileOptions);
 			if (compileResult.GetCompilationStatus() != shaderc_compilation_status_success)
 			{
-				LP_CORE_ERROR("Failed to compile shader {0}!", path.string().c_str());
-				LP_CORE_ERROR(compileResult.GetErrorMessage().c_str());
-
+				outError = std::format("Failed to compile shader {0}!\n{1}", path.string(), compileResult.GetErrorMessage());
 				return false;
 			}
 
-			const auto* begin = (const uint8_t*)compileResult.cbegin();
-			const auto* end = (const uint8_t*)compileResult.cend();
-			const ptrdiff_t size = end - begin;
-
 			outShaderData = std::vector<uint32_t>(compileResult.cbegin(), compileResult.cend());
 		}
 
-		// Cache shader
-		{
-			std::ofstream output(cachedPath, std::ios::binary | std::ios::out);
-			if (!output.is_open())
-			{
-				LP_CORE_ERROR("Failed to open file {0} for writing!", cachedPath.string().c_str());
-			}
-
-			output.write((const char*)outShaderData.data(), outShaderData.size() * sizeof(uint32_t));
-			output.close();
-		}
+		ShaderCache::Store(path, stage, key, outShaderData);
+		ShaderCache::WriteManifest(path, stage, key, optionsHash, includes);
 
 		return true;
 	}
 
-	bool ShaderCompiler::CompileHLSL(const VkShaderStageFlagBits stage, const std::string& src, const std::filesystem::path& path, std::vector<uint32_t>& outShaderData)
+	bool ShaderCompiler::CompileHLSL(const VkShaderStageFlagBits stage, const std::string& src, const std::filesystem::path& path, bool forceCompile, std::vector<uint32_t>& outShaderData, uint64_t& outKey, std::string& outError)
 	{
 		if (!DXCInstances::compiler)
 		{
@@ -171,35 +327,26 @@ namespace Lamp
 		}
 
 		std::string proccessedSource = src;
-		if (!PreprocessHLSL(stage, path, proccessedSource))
+		std::vector<std::filesystem::path> includes;
+
+		if (!PreprocessHLSL(stage, path, proccessedSource, includes, outError))
 		{
 			return false;
 		}
 
-		std::vector<const wchar_t*> arguments
-		{ 
-			path.c_str(), 
-			L"-E", 
-			L"main", 
-			L"-T", 
-			Utility::HLSLShaderProfile(stage), 
-			L"-spirv", 
-			L"-fspv-target-env=vulkan1.3",
-			L"-fvk-support-nonzero-base-instance",
-			DXC_ARG_PACK_MATRIX_COLUMN_MAJOR, 
-			DXC_ARG_WARNINGS_ARE_ERRORS 
-		};
-
-#ifdef LP_ENABLE_SHADER_DEBUG
-		arguments.emplace_back(L"-Qembed_debug");
-		arguments.emplace_back(DXC_ARG_DEBUG);
-#endif
+		const uint64_t optionsHash = Utils::GetCompileOptionsHash(Shader::Language::HLSL, stage);
+		const uint64_t key = ShaderCache::ComputeKey(proccessedSource, stage, optionsHash);
+		outKey = key;
 
-		if (stage & (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_GEOMETRY_BIT))
+		if (!forceCompile && ShaderCache::TryLoad(path, stage, key, outShaderData))
 		{
-			arguments.emplace_back(L"-fvk-invert-y");
+			ShaderCache::WriteManifest(path, stage, key, optionsHash, includes);
+			return true;
 		}
 
+		std::vector<const wchar_t*> arguments = Utils::GetHLSLCompileArguments(stage);
+		arguments.insert(arguments.begin(), path.c_str());
+
 		IDxcBlobEncoding* sourcePtr;
 		DXCInstances::utils->CreateBlob(proccessedSource.c_str(), (uint32_t)proccessedSource.size(), CP_UTF8, &sourcePtr);
 
@@ -234,38 +381,31 @@ namespace Lamp
 			memcpy_s(outShaderData.data(), size, result->GetBufferPointer(), size);
 			result->Release();
 		}
-
-		// Cache shader
+		else
 		{
-			const auto cacheDirectory = Utility::GetShaderCacheDirectory();
-			const auto extension = Utility::GetShaderStageCachedFileExtension(stage);
-
-			const auto cachedPath = cacheDirectory / (path.filename().string() + extension);
+			outError = error;
 
-			std::ofstream output(cachedPath, std::ios::binary | std::ios::out);
-			if (!output.is_open())
-			{
-				LP_CORE_ERROR("Failed to open file {0} for writing!", cachedPath.string().c_str());
-			}
+			compileResult->Release();
+			sourcePtr->Release();
 
-			output.write((const char*)outShaderData.data(), outShaderData.size() * sizeof(uint32_t));
-			output.close();
+			return false;
 		}
 
+		ShaderCache::Store(path, stage, key, outShaderData);
+		ShaderCache::WriteManifest(path, stage, key, optionsHash, includes);
+
 		compileResult->Release();
 		sourcePtr->Release();
 
 		return true;
 	}
 
-	bool ShaderCompiler::PreprocessGLSL(const VkShaderStageFlagBits stage, const std::filesystem::path& path, std::string& source, shaderc::Compiler& compiler, const shaderc::CompileOptions& compileOptions)
+	bool ShaderCompiler::PreprocessGLSL(const VkShaderStageFlagBits stage, const std::filesystem::path& path, std::string& source, shaderc::Compiler& compiler, const shaderc::CompileOptions& compileOptions, std::string& outError)
 	{
 		shaderc::PreprocessedSourceCompilationResult preProcessResult = compiler.PreprocessGlsl(source, Utility::VulkanToShaderCStage(stage), path.string().c_str(), compileOptions);
 		if (preProcessResult.GetCompilationStatus() != shaderc_compilation_status_success)
 		{
-			LP_CORE_ERROR("Failed to preprocess shader {0}!", path.string().c_str());
-			LP_CORE_ERROR("{0}", preProcessResult.GetErrorMessage().c_str());
-
+			outError = std::format("Failed to preprocess shader {0}!\n{1}", path.string(), preProcessResult.GetErrorMessage());
 			return false;
 		}
 
@@ -273,7 +413,7 @@ namespace Lamp
 		return true;
 	}
 
-	bool ShaderCompiler::PreprocessHLSL(const VkShaderStageFlagBits stage, const std::filesystem::path& path, std::string& source)
+	bool ShaderCompiler::PreprocessHLSL(const VkShaderStageFlagBits stage, const std::filesystem::path& path, std::string& source, std::vector<std::filesystem::path>& outIncludes, std::string& outError)
 	{
 		std::vector<const wchar_t*> arguments
 		{
@@ -317,11 +457,18 @@ namespace Lamp
 
 			source = (const char*)result->GetBufferPointer();
 			result->Release();
+
+			outIncludes.assign(includer->GetIncludedFiles().begin(), includer->GetIncludedFiles().end());
+		}
+
+		else
+		{
+			outError = error;
 		}
 
 		sourcePtr->Release();
 		compileResult->Release();
 
-		return true;
+		return error.empty();
 	}
 }
\ No newline at end of file
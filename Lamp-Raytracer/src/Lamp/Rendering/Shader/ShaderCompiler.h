@@ -19,25 +19,27 @@ namespace Lamp
 	class ShaderCompiler
 	{
 	public:
-		static bool TryCompile(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, std::vector<std::filesystem::path> shaderFiles);
+		static bool TryCompile(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, std::unordered_map<VkShaderStageFlagBits, uint64_t>& outCacheKeys, std::vector<std::filesystem::path> shaderFiles, bool forceCompile = false);
 
 	private:
 		struct DXCInstances
 		{
-			inline static IDxcCompiler3* compiler = nullptr;
-			inline static IDxcUtils* utils = nullptr;
+			// DXC instances are not safe to share between threads, every compiling thread gets its own
+			inline static thread_local IDxcCompiler3* compiler = nullptr;
+			inline static thread_local IDxcUtils* utils = nullptr;
 		};
 
 		static void LoadShaderFromFiles(std::unordered_map<VkShaderStageFlagBits, std::string>& shaderSources, const std::vector<std::filesystem::path>& shaderFiles);
 		static std::vector<Shader::Language> GetLanguages(const std::vector<std::filesystem::path>& path);
 
-		static bool CompileAll(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, const std::unordered_map<VkShaderStageFlagBits, std::string>& shaderSources, 
-			const std::vector<std::filesystem::path>& shaderFiles, const std::vector<Shader::Language>& languages);
+		static bool CompileAll(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderData, std::unordered_map<VkShaderStageFlagBits, uint64_t>& outCacheKeys, const std::unordered_map<VkShaderStageFlagBits, std::string>& shaderSources, 
+			const std::vector<std::filesystem::path>& shaderFiles, const std::vector<Shader::Language>& languages, bool forceCompile);
 	
-		static bool CompileGLSL(const VkShaderStageFlagBits stage, const std::string& src, const std::filesystem::path& path, std::vector<uint32_t>& outShaderData);
-		static bool CompileHLSL(const VkShaderStageFlagBits stage, const std::string& src, const std::filesystem::path& path, std::vector<uint32_t>& outShaderData);
+		// Compile functions run on job workers. Errors are returned instead of logged so they can be reported in order.
+		static bool CompileGLSL(const VkShaderStageFlagBits stage, const std::string& src, const std::filesystem::path& path, bool forceCompile, std::vector<uint32_t>& outShaderData, uint64_t& outKey, std::string& outError);
+		static bool CompileHLSL(const VkShaderStageFlagBits stage, const std::string& src, const std::filesystem::path& path, bool forceCompile, std::vector<uint32_t>& outShaderData, uint64_t& outKey, std::string& outError);
 
-		static bool PreprocessGLSL(const VkShaderStageFlagBits stage, const std::filesystem::path& path, std::string& source, shaderc::Compiler& compiler, const shaderc::CompileOptions& compileOptions);
-		static bool PreprocessHLSL(const VkShaderStageFlagBits stage, const std::filesystem::path& path, std::string& source);
+		static bool PreprocessGLSL(const VkShaderStageFlagBits stage, const std::filesystem::path& path, std::string& source, shaderc::Compiler& compiler, const shaderc::CompileOptions& compileOptions, std::string& outError);
+		static bool PreprocessHLSL(const VkShaderStageFlagBits stage, const std::filesystem::path& path, std::string& source, std::vector<std::filesystem::path>& outIncludes, std::string& outError);
 	};
 }
\ No newline at end of file
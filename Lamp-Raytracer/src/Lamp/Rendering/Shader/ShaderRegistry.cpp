@@ -3,31 +3,170 @@
 
 #include "Lamp/Log/Log.h"
 
+#include "Lamp/Core/Jobs/JobSystem.h"
+
+#include "Lamp/Rendering/Renderer.h"
 #include "Lamp/Rendering/Shader/Shader.h"
+#include "Lamp/Rendering/Shader/ShaderUtility.h"
 
 #include "Lamp/Utility/FileSystem.h"
+#include "Lamp/Utility/FileWatcher.h"
 #include "Lamp/Utility/StringUtility.h"
 
+#include <yaml-cpp/yaml.h>
+
 namespace Lamp
 {
+	namespace Utility
+	{
+		struct ShaderDefinition
+		{
+			std::string name;
+			std::vector<std::filesystem::path> paths;
+		};
+
+		inline bool LoadShaderDefinition(const std::filesystem::path& path, ShaderDefinition& outDefinition)
+		{
+			YAML::Node root;
+
+			try
+			{
+				root = YAML::LoadFile(path.string());
+			}
+			catch (const YAML::Exception& e)
+			{
+				LP_CORE_ERROR("Failed to parse shader definition {0}: {1}", path.string().c_str(), e.what());
+				return false;
+			}
+
+			if (!root["name"] || !root["paths"])
+			{
+				LP_CORE_ERROR("Shader definition {0} is missing a name or paths!", path.string().c_str());
+				return false;
+			}
+
+			outDefinition.name = root["name"].as<std::string>();
+			for (const auto& shaderPath : root["paths"])
+			{
+				outDefinition.paths.emplace_back(shaderPath.as<std::string>());
+			}
+
+			return true;
+		}
+	}
+
+	ShaderHandle::ShaderHandle(Ref<LoadState> state)
+		: m_state(state)
+	{
+	}
+
+	const bool ShaderHandle::IsReady() const
+	{
+		return m_state && m_state->counter.IsDone();
+	}
+
+	Ref<Shader> ShaderHandle::Get() const
+	{
+		return IsReady() ? m_state->shader.load() : nullptr;
+	}
+
+	Ref<Shader> ShaderHandle::Wait() const
+	{
+		if (!m_state)
+		{
+			return nullptr;
+		}
+
+		JobSystem::Wait(m_state->counter);
+		return m_state->shader.load();
+	}
+
 	void ShaderRegistry::Initialize()
 	{
 		LoadAllShaders();
+		s_fileWatcher = FileWatcher::Create(FileSystem::GetShadersPath(), { Utility::GetShaderCacheDirectory() });
 	}
 
 	void ShaderRegistry::Shutdown()
 	{
-		s_registry.clear();
+		s_fileWatcher = nullptr;
+
+		for (const auto& pendingReload : s_pendingReloads)
+		{
+			JobSystem::Wait(pendingReload.reload->counter);
+		}
+
+		s_pendingReloads.clear();
+
+		std::map<std::string, ShaderHandle> registry;
+
+		{
+			std::scoped_lock lock(s_registryMutex);
+			registry.swap(s_registry);
+		}
+
+		// Loads still in flight create device objects, let them finish before the device goes away
+		for (const auto& [name, handle] : registry)
+		{
+			handle.Wait();
+		}
+	}
+
+	void ShaderRegistry::Update()
+	{
+		LP_PROFILE_FUNCTION();
+
+		if (!s_fileWatcher)
+		{
+			return;
+		}
+
+		SwapFinishedReloads();
+
+		const std::vector<std::filesystem::path> changes = s_fileWatcher->ConsumeChanges();
+		if (changes.empty())
+		{
+			return;
+		}
+
+		std::scoped_lock lock(s_registryMutex);
+
+		for (const auto& [name, handle] : s_registry)
+		{
+			Ref<Shader> shader = handle.Get();
+			if (!shader)
+			{
+				continue;
+			}
+
+			const bool isAffected = std::any_of(changes.begin(), changes.end(), [&shader](const std::filesystem::path& change) { return shader->DependsOn(change); });
+			if (!isAffected)
+			{
+				continue;
+			}
+
+			// A shader is only reloaded once at a time, changes arriving meanwhile start another reload once the current one is done
+			auto pendingIt = std::find_if(s_pendingReloads.begin(), s_pendingReloads.end(), [&handle](const PendingReload& pendingReload) { return pendingReload.target == handle.m_state; });
+			if (pendingIt != s_pendingReloads.end())
+			{
+				pendingIt->changedDuringReload = true;
+				continue;
+			}
+
+			s_pendingReloads.emplace_back(PendingReload{ name, handle.m_state, ScheduleReload(shader) });
+		}
 	}
 
-	Ref<Shader> ShaderRegistry::Get(const std::string& name)
+	ShaderHandle ShaderRegistry::Get(const std::string& name)
 	{
+		std::scoped_lock lock(s_registryMutex);
+
 		std::string lowName = Utility::ToLower(name);
 		auto it = s_registry.find(lowName);
 		if (it == s_registry.end())
 		{
 			LP_CORE_ERROR("Unable to find shader {0}!", name.c_str());
-			return nullptr;
+			return {};
 		}
 
 		return it->second;
@@ -35,23 +174,143 @@ namespace Lamp
 
 	void ShaderRegistry::Register(const std::string& name, Ref<Shader> shader)
 	{
-		auto it = s_registry.find(name);
+		Ref<ShaderHandle::LoadState> state = CreateRef<ShaderHandle::LoadState>();
+		state->shader.store(shader);
+
+		RegisterHandle(name, ShaderHandle{ state });
+	}
+
+	std::map<std::string, Ref<Shader>> ShaderRegistry::GetAllShaders()
+	{
+		std::scoped_lock lock(s_registryMutex);
+
+		std::map<std::string, Ref<Shader>> shaders;
+		for (const auto& [name, handle] : s_registry)
+		{
+			if (Ref<Shader> shader = handle.Get())
+			{
+				shaders.emplace(name, shader);
+			}
+		}
+
+		return shaders;
+	}
+
+	void ShaderRegistry::RegisterHandle(const std::string& name, ShaderHandle handle)
+	{
+		std::scoped_lock lock(s_registryMutex);
+
+		std::string lowName = Utility::ToLower(name);
+		auto it = s_registry.find(lowName);
 		if (it != s_registry.end())
 		{
 			LP_CORE_ERROR("Shader with that name has already been registered!");
 			return;
 		}
 
-		std::string lowName = Utility::ToLower(name);
-		s_registry[lowName] = shader;
+		s_registry[lowName] = handle;
 	}
 
-	std::map<std::string, Ref<Shader>> ShaderRegistry::GetAllShaders()
+	void ShaderRegistry::SwapFinishedReloads()
 	{
-		return s_registry;
+		for (auto it = s_pendingReloads.begin(); it != s_pendingReloads.end(); )
+		{
+			if (!it->reload->counter.IsDone())
+			{
+				it++;
+				continue;
+			}
+
+			JobSystem::Wait(it->reload->counter);
+
+			Ref<Shader> newShader = it->reload->shader.load();
+			if (newShader && newShader->IsValid())
+			{
+				Ref<Shader> oldShader = it->target->shader.exchange(newShader);
+
+				// Frames in flight may still use the old modules
+				Renderer::SubmitResourceFree([oldShader]() mutable
+					{
+						oldShader = nullptr;
+					});
+
+				LP_CORE_INFO("Reloaded shader {0}", it->name.c_str());
+			}
+			else
+			{
+				LP_CORE_ERROR("Failed to reload shader {0}, keeping the previous version!", it->name.c_str());
+			}
+
+			if (it->changedDuringReload)
+			{
+				it->reload = ScheduleReload(it->target->shader.load());
+				it->changedDuringReload = false;
+				it++;
+			}
+			else
+			{
+				it = s_pendingReloads.erase(it);
+			}
+		}
+	}
+
+	Ref<ShaderHandle::LoadState> ShaderRegistry::ScheduleReload(const Ref<Shader>& shader)
+	{
+		// Stages whose sources and includes are unchanged load from the cache, only the affected ones are recompiled
+		Ref<ShaderHandle::LoadState> reload = CreateRef<ShaderHandle::LoadState>();
+
+		JobSystem::Schedule([reload, name = shader->GetName(), paths = shader->GetShaderPaths()]()
+			{
+				LP_PROFILE_SCOPE("Reload Shader");
+				reload->shader.store(Shader::Create(name, paths));
+			}, &reload->counter);
+
+		return reload;
 	}
 
 	void ShaderRegistry::LoadAllShaders()
 	{
+		LP_PROFILE_FUNCTION();
+
+		Utility::CreateCacheDirectoryIfNeeded();
+		Utility::CreateShaderDefDirectoryIfNeeded();
+
+		std::vector<std::filesystem::path> definitionPaths;
+		for (const auto& entry : std::filesystem::directory_iterator(Utility::GetShaderDefinitionsDirectory()))
+		{
+			if (entry.path().extension() == ".lpsdef")
+			{
+				definitionPaths.emplace_back(entry.path());
+			}
+		}
+
+		// Directory iteration order is unspecified, sort to keep the load order stable
+		std::sort(definitionPaths.begin(), definitionPaths.end());
+
+		std::vector<Utility::ShaderDefinition> definitions;
+		for (const auto& path : definitionPaths)
+		{
+			Utility::ShaderDefinition definition;
+			if (Utility::LoadShaderDefinition(path, definition))
+			{
+				definitions.emplace_back(std::move(definition));
+			}
+		}
+
+		// Shaders load in the background, handles are registered up front and resolve once their shader is ready
+		for (const auto& definition : definitions)
+		{
+			Ref<ShaderHandle::LoadState> state = CreateRef<ShaderHandle::LoadState>();
+
+			JobSystem::Schedule([state, definition]()
+				{
+					LP_PROFILE_SCOPE("Load Shader");
+					state->shader.store(Shader::Create(definition.name, definition.paths));
+				}, &state->counter);
+
+			RegisterHandle(definition.name, ShaderHandle{ state });
+		}
+
+		LP_CORE_INFO("Started loading {0} shaders", definitions.size());
 	}
 }
\ No newline at end of file
@@ -1,28 +1,83 @@
 #pragma once
 
 #include "Lamp/Core/Base.h"
+#include "Lamp/Core/Jobs/JobSystem.h"
 
+#include <atomic>
+#include <mutex>
 #include <unordered_map>
 
 namespace Lamp
 {
 	class Shader;
+	class FileWatcher;
+
+	// Refers to a shader that may still be loading in the background
+	class ShaderHandle
+	{
+	public:
+		ShaderHandle() = default;
+
+		const bool IsReady() const;
+
+		// Returns nullptr while the shader is loading
+		Ref<Shader> Get() const;
+
+		// Blocks until the shader has loaded, running other jobs in the meantime
+		Ref<Shader> Wait() const;
+
+		inline explicit operator bool() const { return m_state != nullptr; }
+
+	private:
+		friend class ShaderRegistry;
+
+		struct LoadState
+		{
+			JobCounter counter;
+			std::atomic<Ref<Shader>> shader;
+		};
+
+		ShaderHandle(Ref<LoadState> state);
+
+		Ref<LoadState> m_state;
+	};
+
 	class ShaderRegistry
 	{
 	public:
 		static void Initialize();
 		static void Shutdown();
 
-		static Ref<Shader> Get(const std::string& name);
+		// Swaps in hot reloaded shaders and starts reloads for changed files, called once per frame at the frame boundary
+		static void Update();
+
+		static ShaderHandle Get(const std::string& name);
 		static void Register(const std::string& name, Ref<Shader> shader);
 
+		// Only contains shaders that have finished loading
 		static std::map<std::string, Ref<Shader>> GetAllShaders();
 
 	private:
 		ShaderRegistry() = delete;
 
 		static void LoadAllShaders();
+		static void RegisterHandle(const std::string& name, ShaderHandle handle);
+		static void SwapFinishedReloads();
+		static Ref<ShaderHandle::LoadState> ScheduleReload(const Ref<Shader>& shader);
+
+		struct PendingReload
+		{
+			std::string name;
+			Ref<ShaderHandle::LoadState> target;
+			Ref<ShaderHandle::LoadState> reload;
+
+			bool changedDuringReload = false;
+		};
+
+		inline static std::map<std::string, ShaderHandle> s_registry;
+		inline static std::mutex s_registryMutex;
 
-		inline static std::map<std::string, Ref<Shader>> s_registry;
+		inline static Ref<FileWatcher> s_fileWatcher;
+		inline static std::vector<PendingReload> s_pendingReloads;
 	};
-}
\ No newline at end of file
+}
@@ -92,8 +92,8 @@ namespace Lamp
 				case VK_SHADER_STAGE_VERTEX_BIT: return ".vertex.cached";
 				case VK_SHADER_STAGE_FRAGMENT_BIT: return ".fragment.cached";
 				case VK_SHADER_STAGE_COMPUTE_BIT: return ".compute.cached";
-				case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT: return "tessControl.cached";
-				case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: return "tessEvaluation.cached";
+				case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT: return ".tessControl.cached";
+				case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: return ".tessEvaluation.cached";
 			}
 
 			LP_CORE_ASSERT(false, "Stage not supported!");
@@ -148,6 +148,21 @@ namespace Lamp
 			return lhs ^ (rhs + 0x9e3779b9 + (lhs << 6) + (lhs >> 2));
 		}
 
+		inline uint64_t HashData(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+		{
+			// FNV-1a
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+
+			uint64_t hash = seed;
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+
+			return hash;
+		}
+
 		inline uint64_t GetAlignedSize(uint64_t size, uint64_t alignment)
 		{
 			return (size + alignment - 1) & ~(alignment - 1);
@@ -6,17 +6,21 @@
 #include "Lamp/Core/Graphics/GraphicsContext.h"
 #include "Lamp/Core/Graphics/GraphicsDevice.h"
 
+#include "Lamp/ImGui/ImGuiTextureCache.h"
+
+#include "Lamp/Rendering/Texture/ImageTransitionBatcher.h"
 #include "Lamp/Rendering/Texture/SamplerLibrary.h"
+#include "Lamp/Rendering/BindlessRegistry.h"
 #include "Lamp/Rendering/Renderer.h"
 
 #include "Lamp/Utility/ImageUtility.h"
 
 namespace Lamp
 {
-	Image2D::Image2D(const ImageSpecification& specification, const void* data)
+	Image2D::Image2D(const ImageSpecification& specification)
 		: m_specification(specification)
 	{
-		Invalidate(data);
+		Invalidate();
 	}
 
 	Image2D::~Image2D()
@@ -28,7 +32,7 @@ namespace Lamp
 	{
 		Release();
 
-		VulkanAllocator allocator{ "Image2D - Create" };
+		VulkanAllocator allocator{ MemoryTag::Image2D };
 		auto device = GraphicsContext::GetDevice();
 
 		VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT;
@@ -96,30 +100,7 @@ namespace Lamp
 		}
 
 		m_bufferAllocation = allocator.AllocateImage(imageInfo, VMA_MEMORY_USAGE_GPU_ONLY, m_image);
-
-		if (data)
-		{
-			auto device = GraphicsContext::GetDevice();
-
-			if (!m_stagingBuffer)
-			{
-				CreateStagingBuffer();
-			}
-
-			{
-				const VkDeviceSize bufferSize = m_specification.width * m_specification.height * Utility::PerPixelSizeFromFormat(m_specification.format);
-
-				auto* mappedData = allocator.MapMemory<void>(m_stagingAllocation);
-				memcpy_s(mappedData, bufferSize, data, bufferSize);
-				allocator.UnmapMemory(m_stagingAllocation);
-
-				Utility::TransitionImageLayout(m_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-				Utility::CopyBufferToImage(m_stagingBuffer, m_image, m_specification.width, m_specification.height);
-				Utility::TransitionImageLayout(m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-				allocator.DestroyBuffer(m_stagingBuffer, m_stagingAllocation);
-			}
-		}
+		m_imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
 		VkImageViewCreateInfo imageViewInfo{};
 		imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -151,6 +132,22 @@ namespace Lamp
 		LP_VK_CHECK(vkCreateImageView(device->GetHandle(), &imageViewInfo, nullptr, &m_imageViews[0]));
 
 		m_sampler = SamplerLibrary::Get(m_specification.filter, m_specification.filter, m_specification.filter, m_specification.wrap, m_specification.compareOp, m_specification.anisoLevel);
+
+		// The bindless array is a sampler2D[], so only single layer views that are sampled in the read only layout go in
+		const bool isStorage = m_specification.usage == ImageUsage::Storage || m_specification.usage == ImageUsage::AttachmentStorage;
+		if (!isStorage && !m_specification.isCubeMap && m_specification.layers == 1 && !Utility::IsDepthFormat(m_specification.format))
+		{
+			m_bindlessIndex = BindlessRegistry::RegisterImage(m_imageViews.at(0), m_sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+
+		if (data)
+		{
+			SetData(data, (uint32_t)(m_specification.width * m_specification.height * Utility::PerPixelSizeFromFormat(m_specification.format)));
+		}
+		else if (m_specification.usage == ImageUsage::Storage)
+		{
+			TransitionToLayout(VK_IMAGE_LAYOUT_GENERAL);
+		}
 	}
 
 	void Image2D::Release()
@@ -160,7 +157,20 @@ namespace Lamp
 			return;
 		}
 
-		Renderer::SubmitResourceFree([imageViews = m_imageViews, image = m_image, bufferAllocation = m_bufferAllocation, stagingBuffer = m_stagingBuffer, stagingAllocation = m_stagingAllocation]()
+		ImageTransitionBatcher::Cancel(m_image);
+
+		BindlessRegistry::UnregisterImage(m_bindlessIndex);
+		m_bindlessIndex = BindlessRegistry::InvalidIndex;
+
+		// Drop the ImGui texture IDs now, the views may be recreated with the same handles
+		std::vector<uint64_t> viewHandles;
+		for (const auto& [mip, imageView] : m_imageViews)
+		{
+			ImGuiTextureCache::Invalidate(imageView);
+			viewHandles.emplace_back((uint64_t)imageView);
+		}
+
+		Renderer::SubmitResourceFree(viewHandles, [imageViews = m_imageViews, image = m_image, bufferAllocation = m_bufferAllocation]()
 			{
 				auto device = GraphicsContext::GetDevice();
 
@@ -169,13 +179,8 @@ namespace Lamp
 					vkDestroyImageView(device->GetHandle(), imageView.second, nullptr);
 				}
 
-				VulkanAllocator allocator{ "Image2D - Destroy" };
+				VulkanAllocator allocator{ MemoryTag::Image2D };
 				allocator.DestroyImage(image, bufferAllocation);
-
-				if (stagingBuffer)
-				{
-					allocator.DestroyBuffer(stagingBuffer, stagingAllocation);
-				}
 			});
 
 		m_imageViews.clear();
@@ -185,28 +190,69 @@ namespace Lamp
 
 	void Image2D::SetData(const void* data, uint32_t size)
 	{
-		auto device = GraphicsContext::GetDevice();
-		VulkanAllocator allocator{ "Image2D - SetData" };
+		// Callers expect the data to be there once this returns, e.g. textures created with data are bound right away
+		UploadService::UploadImageAndWait(*this, data, size, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	void Image2D::SetData(VkCommandBuffer commandBuffer, const void* data, uint32_t size)
+	{
+		LP_PROFILE_FUNCTION();
+
+		const StagingAllocation staging = Renderer::AllocateStagingMemory(size);
+		memcpy_s(staging.mappedData, size, data, size);
+
+		// Return to the layout the image was recorded in, so surrounding passes (e.g. a bound framebuffer) stay valid
+		const VkImageLayout previousLayout = m_imageLayout == VK_IMAGE_LAYOUT_UNDEFINED ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : m_imageLayout;
 
-		const VkDeviceSize bufferSize = m_specification.width * m_specification.height * Utility::PerPixelSizeFromFormat(m_specification.format);
-		if (!m_stagingBuffer)
+		TransitionToLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		Utility::CopyBufferToImage(commandBuffer, staging.buffer, staging.offset, m_image, m_specification.width, m_specification.height);
+		TransitionToLayout(commandBuffer, previousLayout);
+	}
+
+	void Image2D::SetData(VkCommandBuffer commandBuffer, const void* data, const std::vector<ImageRegion>& regions)
+	{
+		LP_PROFILE_FUNCTION();
+
+		if (regions.empty())
 		{
-			CreateStagingBuffer();
+			return;
 		}
 
-		auto* mappedData = allocator.MapMemory<void>(m_stagingAllocation);
-		memcpy_s(mappedData, bufferSize, data, bufferSize);
-		allocator.UnmapMemory(m_stagingAllocation);
+		LP_CORE_ASSERT(m_imageLayout != VK_IMAGE_LAYOUT_UNDEFINED, "Region uploads require the image contents to be defined!");
+
+		const uint32_t pixelSize = Utility::PerPixelSizeFromFormat(m_specification.format);
+		const uint32_t srcRowPitch = m_specification.width * pixelSize;
+		const VkImageLayout previousLayout = m_imageLayout;
+
+		TransitionToLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+		for (const auto& region : regions)
+		{
+			LP_CORE_ASSERT(region.x + region.width <= m_specification.width && region.y + region.height <= m_specification.height, "Region is outside of image!");
+
+			const uint32_t dstRowPitch = region.width * pixelSize;
+			const StagingAllocation staging = Renderer::AllocateStagingMemory((VkDeviceSize)dstRowPitch * region.height);
 
-		Utility::TransitionImageLayout(m_image, m_imageLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		Utility::CopyBufferToImage(m_stagingBuffer, m_image, m_specification.width, m_specification.height);
-		Utility::TransitionImageLayout(m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			// Pack the region's rows tightly in the staging memory
+			const uint8_t* srcData = static_cast<const uint8_t*>(data) + (size_t)region.y * srcRowPitch + (size_t)region.x * pixelSize;
+			uint8_t* dstData = static_cast<uint8_t*>(staging.mappedData);
 
-		m_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			for (uint32_t row = 0; row < region.height; row++)
+			{
+				memcpy_s(dstData + (size_t)row * dstRowPitch, dstRowPitch, srcData + (size_t)row * srcRowPitch, dstRowPitch);
+			}
+
+			Utility::CopyBufferToImage(commandBuffer, staging.buffer, staging.offset, m_image, VkOffset2D{ (int32_t)region.x, (int32_t)region.y }, VkExtent2D{ region.width, region.height });
+		}
+
+		TransitionToLayout(commandBuffer, previousLayout);
 	}
 
 	void Image2D::TransitionToLayout(VkCommandBuffer commandBuffer, VkImageLayout targetLayout)
 	{
+		// A deferred transition queued after this frame's batch was recorded hasn't happened yet, it has to go first
+		ImageTransitionBatcher::Record(commandBuffer, m_image);
+
 		if (m_imageLayout == targetLayout)
 		{
 			return;
@@ -225,6 +271,25 @@ namespace Lamp
 		m_imageLayout = targetLayout;
 	}
 
+	void Image2D::TransitionToLayout(VkImageLayout targetLayout)
+	{
+		if (m_imageLayout == targetLayout)
+		{
+			return;
+		}
+
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = Utility::IsDepthFormat(m_specification.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.layerCount = m_specification.layers;
+		subresourceRange.levelCount = m_specification.mips;
+
+		// Tracked as done, the barrier is recorded at the start of the next frame or in front of the next immediate transition of the image
+		ImageTransitionBatcher::Submit(m_image, m_imageLayout, targetLayout, subresourceRange);
+		m_imageLayout = targetLayout;
+	}
+
 	void Image2D::GenerateMips(bool readOnly, VkCommandBuffer commandBuffer)
 	{
 		auto device = GraphicsContext::GetDevice();
@@ -233,10 +298,12 @@ namespace Lamp
 		if (!commandBuffer)
 		{
 			cmdBuffer = device->GetThreadSafeCommandBuffer(true);
+			ImageTransitionBatcher::Record(cmdBuffer);
 		}
 		else
 		{
 			cmdBuffer = commandBuffer;
+			ImageTransitionBatcher::Record(cmdBuffer, m_image);
 		}
 
 		VkImageMemoryBarrier barrier{};
@@ -371,20 +438,12 @@ namespace Lamp
 
 	Ref<Image2D> Image2D::Create(const ImageSpecification& specification, const void* data)
 	{
-		return CreateRef<Image2D>(specification, data);
-	}
-
-	void Image2D::CreateStagingBuffer()
-	{
-		VulkanAllocator allocator{ "Image2D - Staging Buffer Create" };
-
-		VkDeviceSize bufferSize = m_specification.width * m_specification.height * Utility::PerPixelSizeFromFormat(m_specification.format);
-		VkBufferCreateInfo bufferInfo{};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.size = bufferSize;
-		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		Ref<Image2D> image = CreateRef<Image2D>(specification);
+		if (data)
+		{
+			image->SetData(data, (uint32_t)(specification.width * specification.height * Utility::PerPixelSizeFromFormat(specification.format)));
+		}
 
-		m_stagingAllocation = allocator.AllocateBuffer(bufferInfo, VMA_MEMORY_USAGE_CPU_ONLY, m_stagingBuffer);
+		return image;
 	}
-}
\ No newline at end of file
+}
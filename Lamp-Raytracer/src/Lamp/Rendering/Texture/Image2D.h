@@ -2,6 +2,7 @@
 
 #include "Lamp/Core/Graphics/VulkanAllocator.h"
 #include "Lamp/Rendering/Texture/ImageCommon.h"
+#include "Lamp/Rendering/UploadService.h"
 
 #include <map>
 
@@ -10,15 +11,19 @@ namespace Lamp
 	class Image2D
 	{
 	public:
-		Image2D(const ImageSpecification& specification, const void* data = nullptr);
+		Image2D(const ImageSpecification& specification);
 		~Image2D();
 
 		void Invalidate(const void* data = nullptr);
 		void Release();
 
+		// Uploaded on the transfer queue and waited for, the image can be used as soon as this returns
 		void SetData(const void* data, uint32_t size);
+		void SetData(VkCommandBuffer commandBuffer, const void* data, uint32_t size);
+		void SetData(VkCommandBuffer commandBuffer, const void* data, const std::vector<ImageRegion>& regions);
 
 		void TransitionToLayout(VkCommandBuffer commandBuffer, VkImageLayout targetLayout);
+		void TransitionToLayout(VkImageLayout targetLayout); // Deferred to the ImageTransitionBatcher
 		void GenerateMips(bool readOnly, VkCommandBuffer commandBuffer = nullptr);
 		VkImageView CreateMipView(uint32_t mip);
 
@@ -33,28 +38,31 @@ namespace Lamp
 		inline const VkImageView GetView(uint32_t index = 0) const { return m_imageViews.at(index); }
 		inline const VkSampler GetSampler() const { return m_sampler; }
 		inline const VkImageLayout GetLayout() const { return m_imageLayout; }
+		inline const uint32_t GetBindlessIndex() const { return m_bindlessIndex; }
+		inline const bool IsUploadReady() const { return UploadService::IsReady(m_uploadToken); }
 
 		static Ref<Image2D> Create(const ImageSpecification& specification, const void* data = nullptr);
 
 	private:
-		void CreateStagingBuffer();
-
 		friend class RenderPipelineCompute;
 		friend class ImageBarrier;
+		friend class Framebuffer;
+		friend class RenderGraph;
+		friend class UploadService;
 
 		ImageSpecification m_specification;
 
 		VmaAllocation m_bufferAllocation = nullptr;
 		VkImage m_image = nullptr;
 
-		VmaAllocation m_stagingAllocation = nullptr;
-		VkBuffer m_stagingBuffer = nullptr;
-
 		VkFormat m_format = VK_FORMAT_R8G8B8A8_UNORM;
 		VkImageLayout m_imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		VkSampler m_sampler;
 
 		std::map<uint32_t, VkImageView> m_imageViews;
 		bool m_hasGeneratedMips = false;
+
+		uint32_t m_bindlessIndex = UINT32_MAX;
+		UploadToken m_uploadToken;
 	};
 }
\ No newline at end of file
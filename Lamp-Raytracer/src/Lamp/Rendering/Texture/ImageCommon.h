@@ -117,4 +117,12 @@ namespace Lamp
 		bool copyable = false;
 		bool isCubeMap = false;
 	};
+
+	struct ImageRegion
+	{
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "lppch.h"
+#include "ImageTransitionBatcher.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+
+#include "Lamp/Utility/ImageUtility.h"
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		static bool IsSameSubresource(const VkImageSubresourceRange& lhs, const VkImageSubresourceRange& rhs)
+		{
+			return lhs.aspectMask == rhs.aspectMask && lhs.baseMipLevel == rhs.baseMipLevel && lhs.levelCount == rhs.levelCount &&
+				lhs.baseArrayLayer == rhs.baseArrayLayer && lhs.layerCount == rhs.layerCount;
+		}
+	}
+
+	void ImageTransitionBatcher::Submit(VkImage image, VkImageLayout currentLayout, VkImageLayout targetLayout, const VkImageSubresourceRange& subresource)
+	{
+		if (currentLayout == targetLayout)
+		{
+			return;
+		}
+
+		std::scoped_lock lock(s_mutex);
+		s_stats.submittedTransitions++;
+
+		// A chain of transitions on the same range collapses into one, from the first layout to the last
+		for (auto& barrier : s_pendingBarriers)
+		{
+			if (barrier.image == image && Utility::IsSameSubresource(barrier.subresourceRange, subresource))
+			{
+				barrier.newLayout = targetLayout;
+				Utility::AccessMasksFromLayouts(barrier.oldLayout, barrier.newLayout, barrier);
+
+				return;
+			}
+		}
+
+		VkImageMemoryBarrier& barrier = s_pendingBarriers.emplace_back();
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.oldLayout = currentLayout;
+		barrier.newLayout = targetLayout;
+		barrier.image = image;
+		barrier.subresourceRange = subresource;
+
+		Utility::AccessMasksFromLayouts(currentLayout, targetLayout, barrier);
+	}
+
+	void ImageTransitionBatcher::Cancel(VkImage image)
+	{
+		std::scoped_lock lock(s_mutex);
+
+		s_pendingBarriers.erase(std::remove_if(s_pendingBarriers.begin(), s_pendingBarriers.end(), [image](const VkImageMemoryBarrier& barrier) { return barrier.image == image; }), s_pendingBarriers.end());
+	}
+
+	void ImageTransitionBatcher::Record(VkCommandBuffer commandBuffer)
+	{
+		LP_PROFILE_FUNCTION();
+
+		std::scoped_lock lock(s_mutex);
+		if (s_pendingBarriers.empty()) [[likely]]
+		{
+			return;
+		}
+
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+
+		for (const auto& barrier : s_pendingBarriers)
+		{
+			const auto [sourceStage, destStage] = Utility::GetStageFlagsFromLayouts(barrier.oldLayout, barrier.newLayout);
+			srcStages |= sourceStage;
+			dstStages |= destStage;
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, (uint32_t)s_pendingBarriers.size(), s_pendingBarriers.data());
+
+		s_stats.recordedBarriers += s_pendingBarriers.size();
+		s_stats.batches++;
+
+		s_pendingBarriers.clear();
+	}
+
+	void ImageTransitionBatcher::Record(VkCommandBuffer commandBuffer, VkImage image)
+	{
+		std::scoped_lock lock(s_mutex);
+
+		auto it = std::stable_partition(s_pendingBarriers.begin(), s_pendingBarriers.end(), [image](const VkImageMemoryBarrier& barrier) { return barrier.image != image; });
+		if (it == s_pendingBarriers.end()) [[likely]]
+		{
+			return;
+		}
+
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+
+		for (auto barrierIt = it; barrierIt != s_pendingBarriers.end(); ++barrierIt)
+		{
+			const auto [sourceStage, destStage] = Utility::GetStageFlagsFromLayouts(barrierIt->oldLayout, barrierIt->newLayout);
+			srcStages |= sourceStage;
+			dstStages |= destStage;
+		}
+
+		const uint32_t barrierCount = (uint32_t)std::distance(it, s_pendingBarriers.end());
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, barrierCount, &*it);
+
+		s_stats.recordedBarriers += barrierCount;
+		s_stats.batches++;
+
+		s_pendingBarriers.erase(it, s_pendingBarriers.end());
+	}
+
+	void ImageTransitionBatcher::Flush()
+	{
+		if (!HasPending())
+		{
+			return;
+		}
+
+		auto device = GraphicsContext::GetDevice();
+		VkCommandBuffer commandBuffer = device->GetThreadSafeCommandBuffer(true);
+
+		Record(commandBuffer);
+
+		device->FlushThreadSafeCommandBuffer(commandBuffer);
+	}
+
+	const bool ImageTransitionBatcher::HasPending()
+	{
+		std::scoped_lock lock(s_mutex);
+		return !s_pendingBarriers.empty();
+	}
+
+	const ImageTransitionStats ImageTransitionBatcher::GetStats()
+	{
+		std::scoped_lock lock(s_mutex);
+		return s_stats;
+	}
+}
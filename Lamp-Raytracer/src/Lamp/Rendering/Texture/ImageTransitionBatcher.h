@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <vector>
+
+namespace Lamp
+{
+	struct ImageTransitionStats
+	{
+		uint64_t submittedTransitions = 0;
+		uint64_t recordedBarriers = 0;
+		uint64_t batches = 0;
+	};
+
+	// Collects layout transitions that don't need their own command buffer. They are recorded as one
+	// pipeline barrier at the start of the next frame, or in front of the next one time submit.
+	class ImageTransitionBatcher
+	{
+	public:
+		static void Submit(VkImage image, VkImageLayout currentLayout, VkImageLayout targetLayout, const VkImageSubresourceRange& subresource);
+		static void Cancel(VkImage image);
+
+		static void Record(VkCommandBuffer commandBuffer);
+
+		// Records only the transitions of one image, for when it is transitioned in a command buffer of the current frame
+		static void Record(VkCommandBuffer commandBuffer, VkImage image);
+
+		// Submits everything pending in a single command buffer, for when no frame is being recorded
+		static void Flush();
+
+		static const bool HasPending();
+		static const ImageTransitionStats GetStats();
+
+	private:
+		ImageTransitionBatcher() = delete;
+
+		inline static std::vector<VkImageMemoryBarrier> s_pendingBarriers;
+		inline static ImageTransitionStats s_stats;
+		inline static std::mutex s_mutex;
+	};
+}
@@ -0,0 +1,481 @@
+#include "lppch.h"
+#include "UploadService.h"
+
+#include "Lamp/Log/Log.h"
+
+#include "Lamp/Core/Graphics/GraphicsContext.h"
+#include "Lamp/Core/Graphics/GraphicsDevice.h"
+#include "Lamp/Core/Graphics/VulkanAllocator.h"
+
+#include "Lamp/Rendering/Texture/Image2D.h"
+#include "Lamp/Rendering/Texture/ImageTransitionBatcher.h"
+
+#include "Lamp/Utility/ImageUtility.h"
+
+#include <numeric>
+
+namespace Lamp
+{
+	void UploadService::Initialize()
+	{
+		auto device = GraphicsContext::GetDevice();
+		const auto& queueIndices = device->GetPhysicalDevice()->GetQueueIndices();
+
+		s_transferFamily = (uint32_t)queueIndices.transferQueueIndex;
+		s_graphicsFamily = (uint32_t)queueIndices.graphicsQueueIndex;
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = s_transferFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		LP_VK_CHECK(vkCreateCommandPool(device->GetHandle(), &poolInfo, nullptr, &s_commandPool));
+
+		VkSemaphoreTypeCreateInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timelineInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &timelineInfo;
+
+		LP_VK_CHECK(vkCreateSemaphore(device->GetHandle(), &semaphoreInfo, nullptr, &s_timelineSemaphore));
+		LP_VK_CHECK(vkCreateSemaphore(device->GetHandle(), &semaphoreInfo, nullptr, &s_graphicsSemaphore));
+
+		// Written sequentially by the CPU and read once by the copies, so it doesn't need to be cached
+		{
+			VulkanAllocator allocator{ MemoryTag::UploadStaging };
+
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = s_stagingRingSize;
+			bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			s_stagingRing = {};
+			s_stagingRing.allocation = allocator.AllocateBuffer(bufferInfo, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT, s_stagingRing.buffer);
+			s_stagingRing.mappedData = (uint8_t*)allocator.GetMappedData(s_stagingRing.allocation);
+			s_stagingRing.size = s_stagingRingSize;
+		}
+
+		s_submittedValue = 0;
+		s_acquiredValue = 0;
+		s_graphicsValue = 0;
+
+		if (s_transferFamily == s_graphicsFamily)
+		{
+			LP_CORE_INFO("No dedicated transfer queue family, uploads share the graphics family");
+		}
+	}
+
+	void UploadService::Shutdown()
+	{
+		if (!IsInitialized())
+		{
+			return;
+		}
+
+		Submit();
+		Wait({ s_submittedValue });
+
+		std::scoped_lock lock(s_mutex);
+
+		for (auto& batch : s_submittedBatches)
+		{
+			ReleaseBatch(batch);
+		}
+
+		s_submittedBatches.clear();
+
+		{
+			VulkanAllocator allocator{ MemoryTag::UploadStaging };
+			allocator.DestroyBuffer(s_stagingRing.buffer, s_stagingRing.allocation);
+			s_stagingRing = {};
+		}
+
+		auto device = GraphicsContext::GetDevice();
+		vkDestroySemaphore(device->GetHandle(), s_timelineSemaphore, nullptr);
+		vkDestroySemaphore(device->GetHandle(), s_graphicsSemaphore, nullptr);
+		vkDestroyCommandPool(device->GetHandle(), s_commandPool, nullptr);
+
+		s_timelineSemaphore = nullptr;
+		s_graphicsSemaphore = nullptr;
+		s_commandPool = nullptr;
+	}
+
+	UploadToken UploadService::UploadImage(Ref<Image2D> image, const void* data, VkDeviceSize size, VkImageLayout finalLayout)
+	{
+		LP_PROFILE_FUNCTION();
+		LP_CORE_ASSERT(IsInitialized(), "Upload service has not been initialized!");
+
+		std::scoped_lock lock(s_mutex);
+
+		const UploadToken token = RecordImageUpload(*image, data, size, finalLayout);
+		s_recordingBatch.images.push_back({ image, finalLayout });
+
+		return token;
+	}
+
+	void UploadService::UploadImageAndWait(Image2D& image, const void* data, VkDeviceSize size, VkImageLayout finalLayout)
+	{
+		LP_PROFILE_FUNCTION();
+		LP_CORE_ASSERT(IsInitialized(), "Upload service has not been initialized!");
+
+		UploadToken token;
+		{
+			std::scoped_lock lock(s_mutex);
+			token = RecordImageUpload(image, data, size, finalLayout);
+		}
+
+		Submit();
+		Wait(token);
+
+		// Acquired right away instead of by the next frame, so commands recorded after this call can use the image
+		auto device = GraphicsContext::GetDevice();
+		VkCommandBuffer commandBuffer = device->GetThreadSafeCommandBuffer(true);
+		AcquireCompleted(commandBuffer);
+		device->FlushThreadSafeCommandBuffer(commandBuffer);
+
+		image.m_imageLayout = finalLayout;
+	}
+
+	UploadToken UploadService::RecordImageUpload(Image2D& image, const void* data, VkDeviceSize size, VkImageLayout finalLayout)
+	{
+		BeginBatch();
+
+		const auto& specification = image.GetSpecification();
+
+		auto& batch = s_recordingBatch;
+
+		// Copy offsets have to be a multiple of the texel size and of 4
+		const StagingBuffer staging = AllocateStaging(data, size, std::lcm<VkDeviceSize>(Utility::PerPixelSizeFromFormat(specification.format), 4));
+
+		VkImageSubresourceRange subresource{};
+		subresource.aspectMask = Utility::IsDepthFormat(specification.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		subresource.baseMipLevel = 0;
+		subresource.levelCount = specification.mips;
+		subresource.baseArrayLayer = 0;
+		subresource.layerCount = specification.layers;
+
+		// A frame may still be sampling the image, the transition and copy wait until the graphics queue is done with it
+		if (image.m_imageLayout != VK_IMAGE_LAYOUT_UNDEFINED || image.m_uploadToken.value != 0)
+		{
+			batch.waitsOnGraphics = true;
+		}
+
+		// The previous contents are discarded, so the transfer queue can take the image without an ownership transfer
+		Utility::InsertImageMemoryBarrier(batch.commandBuffer, image.GetHandle(), 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresource);
+
+		Utility::CopyBufferToImage(batch.commandBuffer, staging.buffer, staging.offset, image.GetHandle(), specification.width, specification.height);
+
+		VkImageMemoryBarrier release{};
+		release.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		release.dstAccessMask = 0;
+		release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		release.newLayout = finalLayout;
+		release.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		release.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		release.image = image.GetHandle();
+		release.subresourceRange = subresource;
+
+		if (s_transferFamily != s_graphicsFamily)
+		{
+			release.srcQueueFamilyIndex = s_transferFamily;
+			release.dstQueueFamilyIndex = s_graphicsFamily;
+
+			// The acquire has to repeat the layout transition and queue families of the release exactly
+			VkImageMemoryBarrier& acquire = batch.imageAcquires.emplace_back(release);
+			acquire.srcAccessMask = 0;
+			acquire.dstAccessMask = finalLayout == VK_IMAGE_LAYOUT_GENERAL ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+		}
+
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &release);
+
+		// The final layout is only tracked once AcquireCompleted has handed the image to the graphics queue
+		ImageTransitionBatcher::Cancel(image.GetHandle());
+		image.m_imageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		image.m_uploadToken = { s_submittedValue + 1 };
+
+		return image.m_uploadToken;
+	}
+
+	UploadToken UploadService::UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, bool isInUse)
+	{
+		LP_PROFILE_FUNCTION();
+		LP_CORE_ASSERT(IsInitialized(), "Upload service has not been initialized!");
+
+		std::scoped_lock lock(s_mutex);
+		BeginBatch();
+
+		auto& batch = s_recordingBatch;
+		batch.waitsOnGraphics |= isInUse;
+		const StagingBuffer staging = AllocateStaging(data, size, 16);
+
+		VkBufferCopy region{};
+		region.srcOffset = staging.offset;
+		region.dstOffset = offset;
+		region.size = size;
+
+		vkCmdCopyBuffer(batch.commandBuffer, staging.buffer, buffer, 1, &region);
+
+		if (s_transferFamily != s_graphicsFamily)
+		{
+			VkBufferMemoryBarrier release{};
+			release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			release.dstAccessMask = 0;
+			release.srcQueueFamilyIndex = s_transferFamily;
+			release.dstQueueFamilyIndex = s_graphicsFamily;
+			release.buffer = buffer;
+			release.offset = offset;
+			release.size = size;
+
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &release, 0, nullptr);
+
+			VkBufferMemoryBarrier& acquire = batch.bufferAcquires.emplace_back(release);
+			acquire.srcAccessMask = 0;
+			acquire.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		}
+
+		return { s_submittedValue + 1 };
+	}
+
+	void UploadService::Submit()
+	{
+		LP_PROFILE_FUNCTION();
+
+		std::scoped_lock lock(s_mutex);
+		if (!s_recordingBatch.commandBuffer) [[likely]]
+		{
+			return;
+		}
+
+		auto device = GraphicsContext::GetDevice();
+
+		auto& batch = s_recordingBatch;
+		LP_VK_CHECK(vkEndCommandBuffer(batch.commandBuffer));
+
+		batch.timelineValue = ++s_submittedValue;
+
+		// An empty submit signals once everything submitted to the graphics queue before it has finished
+		uint64_t graphicsValue = 0;
+		if (batch.waitsOnGraphics)
+		{
+			graphicsValue = ++s_graphicsValue;
+
+			VkTimelineSemaphoreSubmitInfo markerTimelineInfo{};
+			markerTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			markerTimelineInfo.signalSemaphoreValueCount = 1;
+			markerTimelineInfo.pSignalSemaphoreValues = &graphicsValue;
+
+			VkSubmitInfo markerInfo{};
+			markerInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			markerInfo.pNext = &markerTimelineInfo;
+			markerInfo.signalSemaphoreCount = 1;
+			markerInfo.pSignalSemaphores = &s_graphicsSemaphore;
+
+			LP_VK_CHECK(vkQueueSubmit(device->GetGraphicsQueue(), 1, &markerInfo, nullptr));
+		}
+
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = batch.waitsOnGraphics ? 1 : 0;
+		timelineInfo.pWaitSemaphoreValues = &graphicsValue;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &batch.timelineValue;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.waitSemaphoreCount = batch.waitsOnGraphics ? 1 : 0;
+		submitInfo.pWaitSemaphores = &s_graphicsSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &s_timelineSemaphore;
+
+		LP_VK_CHECK(vkQueueSubmit(device->GetTransferQueue(), 1, &submitInfo, nullptr));
+
+		s_submittedBatches.emplace_back(std::move(batch));
+		s_recordingBatch = {};
+	}
+
+	uint64_t UploadService::AcquireCompleted(VkCommandBuffer commandBuffer)
+	{
+		LP_PROFILE_FUNCTION();
+
+		if (!IsInitialized())
+		{
+			return 0;
+		}
+
+		std::scoped_lock lock(s_mutex);
+		if (s_submittedBatches.empty()) [[likely]]
+		{
+			return 0;
+		}
+
+		uint64_t completedValue = 0;
+		LP_VK_CHECK(vkGetSemaphoreCounterValue(GraphicsContext::GetDevice()->GetHandle(), s_timelineSemaphore, &completedValue));
+
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		uint64_t waitValue = 0;
+
+		// Batches are submitted in order, so the finished ones are always at the front
+		auto it = s_submittedBatches.begin();
+		for (; it != s_submittedBatches.end() && it->timelineValue <= completedValue; ++it)
+		{
+			imageAcquires.insert(imageAcquires.end(), it->imageAcquires.begin(), it->imageAcquires.end());
+			bufferAcquires.insert(bufferAcquires.end(), it->bufferAcquires.begin(), it->bufferAcquires.end());
+			waitValue = it->timelineValue;
+
+			// A later upload into the same image is still in flight, its batch sets the layout
+			for (const auto& pending : it->images)
+			{
+				if (pending.image->m_uploadToken.value == it->timelineValue)
+				{
+					pending.image->m_imageLayout = pending.finalLayout;
+				}
+			}
+
+			ReleaseBatch(*it);
+		}
+
+		s_submittedBatches.erase(s_submittedBatches.begin(), it);
+
+		if (!imageAcquires.empty() || !bufferAcquires.empty())
+		{
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+				(uint32_t)bufferAcquires.size(), bufferAcquires.data(), (uint32_t)imageAcquires.size(), imageAcquires.data());
+		}
+
+		s_acquiredValue = std::max(s_acquiredValue, waitValue);
+		return waitValue;
+	}
+
+	const bool UploadService::IsReady(UploadToken token)
+	{
+		std::scoped_lock lock(s_mutex);
+		return token.value <= s_acquiredValue;
+	}
+
+	void UploadService::Wait(UploadToken token)
+	{
+		LP_PROFILE_FUNCTION();
+
+		{
+			std::scoped_lock lock(s_mutex);
+			if (token.value > s_submittedValue)
+			{
+				LP_CORE_ASSERT(false, "Waiting on an upload that has not been submitted!");
+				return;
+			}
+		}
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &s_timelineSemaphore;
+		waitInfo.pValues = &token.value;
+
+		LP_VK_CHECK(vkWaitSemaphores(GraphicsContext::GetDevice()->GetHandle(), &waitInfo, UINT64_MAX));
+	}
+
+	void UploadService::BeginBatch()
+	{
+		if (s_recordingBatch.commandBuffer)
+		{
+			return;
+		}
+
+		auto device = GraphicsContext::GetDevice();
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = s_commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		LP_VK_CHECK(vkAllocateCommandBuffers(device->GetHandle(), &allocInfo, &s_recordingBatch.commandBuffer));
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		LP_VK_CHECK(vkBeginCommandBuffer(s_recordingBatch.commandBuffer, &beginInfo));
+	}
+
+	UploadService::StagingBuffer UploadService::AllocateStaging(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+	{
+		auto& ring = s_stagingRing;
+
+		VkDeviceSize offset = (ring.head + alignment - 1) / alignment * alignment;
+		if (offset + size > ring.size)
+		{
+			offset = 0;
+		}
+
+		// Skipped bytes at the end of the ring or in front of the alignment stay in use until the batch is done
+		const VkDeviceSize consumedSize = (offset >= ring.head ? offset - ring.head : ring.size - ring.head) + size;
+		if (size > ring.size || ring.usedSize + consumedSize > ring.size)
+		{
+			return s_recordingBatch.stagingBuffers.emplace_back(CreateStagingBuffer(data, size));
+		}
+
+		memcpy_s(ring.mappedData + offset, size, data, size);
+
+		ring.head = offset + size;
+		ring.usedSize += consumedSize;
+		s_recordingBatch.ringSize += consumedSize;
+
+		StagingBuffer staging{};
+		staging.buffer = ring.buffer;
+		staging.offset = offset;
+
+		return staging;
+	}
+
+	UploadService::StagingBuffer UploadService::CreateStagingBuffer(const void* data, VkDeviceSize size)
+	{
+		VulkanAllocator allocator{ MemoryTag::UploadStaging };
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		StagingBuffer staging{};
+		staging.allocation = allocator.AllocateBuffer(bufferInfo, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT, staging.buffer);
+
+		memcpy_s(allocator.GetMappedData(staging.allocation), size, data, size);
+
+		return staging;
+	}
+
+	void UploadService::ReleaseBatch(Batch& batch)
+	{
+		VulkanAllocator allocator{ MemoryTag::UploadStaging };
+		for (const auto& staging : batch.stagingBuffers)
+		{
+			allocator.DestroyBuffer(staging.buffer, staging.allocation);
+		}
+
+		vkFreeCommandBuffers(GraphicsContext::GetDevice()->GetHandle(), s_commandPool, 1, &batch.commandBuffer);
+
+		s_stagingRing.usedSize -= batch.ringSize;
+		batch.ringSize = 0;
+
+		batch.stagingBuffers.clear();
+		batch.images.clear();
+		batch.commandBuffer = nullptr;
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <vulkan/vulkan.h>
+#include <vma/VulkanMemoryAllocator.h>
+
+#include <mutex>
+#include <vector>
+
+namespace Lamp
+{
+	class Image2D;
+
+	// Timeline value of the transfer submit an upload was recorded in
+	struct UploadToken
+	{
+		uint64_t value = 0;
+	};
+
+	// Records copies on the transfer queue and hands the resources over to the graphics queue once they are done.
+	// Uploads are submitted once per frame, and acquired by the first frame that begins after the copies finished.
+	// Copies into resources the graphics queue has already used wait for all graphics work submitted before them.
+	class UploadService
+	{
+	public:
+		static void Initialize();
+		static void Shutdown();
+
+		// The previous contents are discarded. The image is tracked in TRANSFER_DST until it is acquired, it must not be used before IsUploadReady().
+		static UploadToken UploadImage(Ref<Image2D> image, const void* data, VkDeviceSize size, VkImageLayout finalLayout);
+
+		// Submits the upload, waits for the copies and acquires the image right away. Commands recorded afterwards can use it.
+		static void UploadImageAndWait(Image2D& image, const void* data, VkDeviceSize size, VkImageLayout finalLayout);
+
+		// Set isInUse when graphics work may still read the buffer, the copy then waits for that work to finish
+		static UploadToken UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, bool isInUse = false);
+
+		// Submits everything recorded since the last call. Has to be called from the thread that submits graphics work,
+		// copies into resources in use put a marker on the graphics queue to wait on.
+		static void Submit();
+
+		// Records the acquire barriers of every finished upload and frees their staging memory.
+		// Returns the timeline value the graphics submit has to wait on, 0 if nothing was acquired.
+		static uint64_t AcquireCompleted(VkCommandBuffer commandBuffer);
+
+		// True once the upload has been acquired, commands recorded after that may use the resource
+		static const bool IsReady(UploadToken token);
+
+		// Blocks until the copies are done on the GPU. The resource is usable after the next acquire.
+		static void Wait(UploadToken token);
+
+		inline static VkSemaphore GetTimelineSemaphore() { return s_timelineSemaphore; }
+		inline static const bool IsInitialized() { return s_timelineSemaphore != nullptr; }
+
+	private:
+		UploadService() = delete;
+
+		struct StagingBuffer
+		{
+			VkBuffer buffer = nullptr;
+			VmaAllocation allocation = nullptr;
+			VkDeviceSize offset = 0;
+		};
+
+		// Staging memory is taken from the front of the ring and handed back from its back as batches finish.
+		// Batches finish in submit order, so only the amount in use has to be tracked.
+		struct StagingRing
+		{
+			VkBuffer buffer = nullptr;
+			VmaAllocation allocation = nullptr;
+			uint8_t* mappedData = nullptr;
+
+			VkDeviceSize size = 0;
+			VkDeviceSize head = 0;
+			VkDeviceSize usedSize = 0;
+		};
+
+		struct PendingImage
+		{
+			Ref<Image2D> image; // Kept alive until the graphics queue owns it
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		};
+
+		struct Batch
+		{
+			VkCommandBuffer commandBuffer = nullptr;
+			uint64_t timelineValue = 0;
+			bool waitsOnGraphics = false;
+
+			// Dedicated buffers are only created for uploads that don't fit in the ring
+			std::vector<StagingBuffer> stagingBuffers;
+			VkDeviceSize ringSize = 0;
+			std::vector<VkImageMemoryBarrier> imageAcquires;
+			std::vector<VkBufferMemoryBarrier> bufferAcquires;
+			std::vector<PendingImage> images;
+		};
+
+		// Expects the mutex to be held, the caller decides when the image's layout is tracked as final
+		static UploadToken RecordImageUpload(Image2D& image, const void* data, VkDeviceSize size, VkImageLayout finalLayout);
+
+		static void BeginBatch();
+		static StagingBuffer AllocateStaging(const void* data, VkDeviceSize size, VkDeviceSize alignment);
+		static StagingBuffer CreateStagingBuffer(const void* data, VkDeviceSize size);
+		static void ReleaseBatch(Batch& batch);
+
+		inline static constexpr VkDeviceSize s_stagingRingSize = 32ull * 1024 * 1024;
+
+		inline static VkCommandPool s_commandPool = nullptr;
+		inline static StagingRing s_stagingRing;
+		inline static VkSemaphore s_timelineSemaphore = nullptr;
+		inline static VkSemaphore s_graphicsSemaphore = nullptr; // Signaled by the markers on the graphics queue
+
+		inline static Batch s_recordingBatch;
+		inline static std::vector<Batch> s_submittedBatches;
+
+		inline static uint64_t s_submittedValue = 0;
+		inline static uint64_t s_acquiredValue = 0;
+		inline static uint64_t s_graphicsValue = 0;
+
+		inline static uint32_t s_transferFamily = 0;
+		inline static uint32_t s_graphicsFamily = 0;
+
+		inline static std::mutex s_mutex;
+	};
+}
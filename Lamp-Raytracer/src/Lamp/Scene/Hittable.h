@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Lamp/Core/Base.h"
 #include "Lamp/Math/Ray.h"
 
 namespace Lamp
@@ -7,6 +8,15 @@ namespace Lamp
 	class Hittable
 	{
 	public:
+		virtual ~Hittable() = default;
+
+		virtual Ref<Hittable> Clone() const = 0;
 		virtual bool HitTest(const Ray& ray, const float minT, const float maxT, RaycastHit& hit) const = 0;
+
+		// Identifies the object's geometry for progressive render checkpoints, 0 when the object can't describe itself
+		virtual uint64_t GetContentHash() const { return 0; }
+
+		// World space center and radius when the object can be rasterized as a sphere into the hybrid G-buffer
+		virtual bool GetRasterSphere(glm::vec4& outSphere) const { return false; }
 	};
 }
\ No newline at end of file
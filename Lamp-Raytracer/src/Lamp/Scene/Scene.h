@@ -15,6 +15,8 @@ namespace Lamp
 		void OnRender();
 		void AddObject(Ref<Hittable> object);
 
+		inline const std::vector<Ref<Hittable>>& GetObjects() const { return m_objects; }
+
 	private:
 		std::vector<Ref<Hittable>> m_objects;
 	};
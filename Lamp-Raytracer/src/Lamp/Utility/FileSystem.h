@@ -3,6 +3,9 @@
 #include <windows.h>
 #include <commdlg.h>
 #include <filesystem>
+#include <fstream>
+#include <format>
+#include <thread>
 
 #include <shellapi.h>
 #include <shlobj.h>
@@ -107,6 +110,40 @@ public:
 		return true;
 	}
 
+	// Writes to a temporary file next to the destination and renames it into place, readers never see a partial file
+	static bool WriteFileAtomic(const std::filesystem::path& aPath, const void* aData, size_t aSize)
+	{
+		const size_t threadHash = std::hash<std::thread::id>()(std::this_thread::get_id());
+		const std::filesystem::path tempPath = aPath.string() + std::format(".{:x}.tmp", threadHash);
+
+		{
+			std::ofstream output(tempPath, std::ios::binary | std::ios::out);
+			if (!output.is_open())
+			{
+				return false;
+			}
+
+			output.write((const char*)aData, aSize);
+			if (!output.good())
+			{
+				output.close();
+				std::filesystem::remove(tempPath);
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, aPath, error);
+
+		if (error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+
+		return true;
+	}
+
 	static bool CreateFolder(const std::filesystem::path& folder)
 	{
 		if (Exists(folder))
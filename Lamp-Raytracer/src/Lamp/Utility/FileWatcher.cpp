@@ -0,0 +1,279 @@
+#include "lppch.h"
+#include "FileWatcher.h"
+
+#include "Lamp/Log/Log.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		std::string NormalizeWatchPath(const std::filesystem::path& path)
+		{
+			std::string result = path.lexically_normal().generic_string();
+			while (result.size() > 1 && result.back() == '/')
+			{
+				result.pop_back();
+			}
+
+			return result;
+		}
+	}
+
+	FileWatcher::FileWatcher(const std::filesystem::path& directory, const std::vector<std::filesystem::path>& excludedDirectories)
+		: m_directory(directory)
+	{
+		for (const auto& excluded : excludedDirectories)
+		{
+			m_excludedDirectories.emplace_back(Utility::NormalizeWatchPath(excluded));
+		}
+
+		m_thread = std::thread(&FileWatcher::Run, this);
+	}
+
+	FileWatcher::~FileWatcher()
+	{
+		{
+			std::scoped_lock lock(m_wakeMutex);
+			m_running = false;
+		}
+
+		m_wakeCondition.notify_all();
+
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+	std::vector<std::filesystem::path> FileWatcher::ConsumeChanges()
+	{
+		std::scoped_lock lock(m_changesMutex);
+
+		std::vector<std::filesystem::path> changes{ m_changes.begin(), m_changes.end() };
+		m_changes.clear();
+
+		return changes;
+	}
+
+	Ref<FileWatcher> FileWatcher::Create(const std::filesystem::path& directory, const std::vector<std::filesystem::path>& excludedDirectories)
+	{
+		return CreateRef<FileWatcher>(directory, excludedDirectories);
+	}
+
+	void FileWatcher::Run()
+	{
+		LP_PROFILE_THREAD("File Watcher");
+
+		if (!RunNotify())
+		{
+			RunPolling();
+		}
+	}
+
+	bool FileWatcher::RunNotify()
+	{
+#ifdef __linux__
+		const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd < 0)
+		{
+			LP_CORE_ERROR("Unable to initialize inotify, falling back to polling {0}", m_directory.string().c_str());
+			return false;
+		}
+
+		constexpr uint32_t watchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+		std::unordered_map<int, std::filesystem::path> watches;
+
+		const auto addWatchRecursive = [&](const std::filesystem::path& root)
+		{
+			const int rootWatch = inotify_add_watch(fd, root.string().c_str(), watchMask);
+			if (rootWatch >= 0)
+			{
+				watches[rootWatch] = root;
+			}
+
+			std::error_code error;
+			for (auto it = std::filesystem::recursive_directory_iterator(root, std::filesystem::directory_options::skip_permission_denied, error);
+				it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+			{
+				if (error || !it->is_directory())
+				{
+					continue;
+				}
+
+				if (IsExcluded(it->path()))
+				{
+					it.disable_recursion_pending();
+					continue;
+				}
+
+				const int watch = inotify_add_watch(fd, it->path().string().c_str(), watchMask);
+				if (watch >= 0)
+				{
+					watches[watch] = it->path();
+				}
+			}
+		};
+
+		addWatchRecursive(m_directory);
+
+		alignas(inotify_event) char buffer[4096];
+
+		while (m_running)
+		{
+			pollfd pollDescriptor{ fd, POLLIN, 0 };
+			if (poll(&pollDescriptor, 1, 200) <= 0)
+			{
+				continue;
+			}
+
+			ssize_t length = 0;
+			while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+			{
+				for (const char* ptr = buffer; ptr < buffer + length; )
+				{
+					const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+					ptr += sizeof(inotify_event) + event->len;
+
+					auto it = watches.find(event->wd);
+					if (it == watches.end() || event->len == 0)
+					{
+						continue;
+					}
+
+					const std::filesystem::path path = it->second / event->name;
+					if (IsExcluded(path))
+					{
+						continue;
+					}
+
+					if (event->mask & IN_ISDIR)
+					{
+						if (event->mask & (IN_CREATE | IN_MOVED_TO))
+						{
+							addWatchRecursive(path);
+						}
+
+						continue;
+					}
+
+					// Created files are reported once they have been written and closed
+					if (event->mask & IN_CREATE)
+					{
+						continue;
+					}
+
+					AddChange(path);
+				}
+			}
+		}
+
+		close(fd);
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void FileWatcher::RunPolling()
+	{
+		ScanWriteTimes(false);
+
+		while (m_running)
+		{
+			{
+				std::unique_lock lock(m_wakeMutex);
+				m_wakeCondition.wait_for(lock, s_pollInterval, [this]() { return !m_running; });
+			}
+
+			if (!m_running)
+			{
+				break;
+			}
+
+			ScanWriteTimes(true);
+		}
+	}
+
+	void FileWatcher::ScanWriteTimes(bool reportChanges)
+	{
+		std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+
+		std::error_code error;
+		for (auto it = std::filesystem::recursive_directory_iterator(m_directory, std::filesystem::directory_options::skip_permission_denied, error);
+			it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+		{
+			if (error)
+			{
+				continue;
+			}
+
+			if (it->is_directory())
+			{
+				if (IsExcluded(it->path()))
+				{
+					it.disable_recursion_pending();
+				}
+
+				continue;
+			}
+
+			const auto writeTime = it->last_write_time(error);
+			if (error)
+			{
+				continue;
+			}
+
+			const std::string path = it->path().string();
+			writeTimes[path] = writeTime;
+
+			if (reportChanges)
+			{
+				auto previous = m_writeTimes.find(path);
+				if (previous == m_writeTimes.end() || previous->second != writeTime)
+				{
+					AddChange(it->path());
+				}
+			}
+		}
+
+		if (reportChanges)
+		{
+			for (const auto& [path, writeTime] : m_writeTimes)
+			{
+				if (!writeTimes.contains(path))
+				{
+					AddChange(path);
+				}
+			}
+		}
+
+		m_writeTimes = std::move(writeTimes);
+	}
+
+	void FileWatcher::AddChange(const std::filesystem::path& path)
+	{
+		std::scoped_lock lock(m_changesMutex);
+		m_changes.emplace(path);
+	}
+
+	bool FileWatcher::IsExcluded(const std::filesystem::path& path) const
+	{
+		const std::string normalizedPath = Utility::NormalizeWatchPath(path);
+
+		for (const auto& excluded : m_excludedDirectories)
+		{
+			if (normalizedPath == excluded || (normalizedPath.starts_with(excluded) && normalizedPath[excluded.size()] == '/'))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
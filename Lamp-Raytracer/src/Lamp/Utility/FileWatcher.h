@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Lamp
+{
+	// Watches a directory tree on a background thread and collects the files that changed.
+	// Uses inotify where available and falls back to polling write times.
+	class FileWatcher
+	{
+	public:
+		FileWatcher(const std::filesystem::path& directory, const std::vector<std::filesystem::path>& excludedDirectories = {});
+		~FileWatcher();
+
+		// Returns every file that was written, created or removed since the last call
+		std::vector<std::filesystem::path> ConsumeChanges();
+
+		static Ref<FileWatcher> Create(const std::filesystem::path& directory, const std::vector<std::filesystem::path>& excludedDirectories = {});
+
+	private:
+		void Run();
+		bool RunNotify();
+		void RunPolling();
+
+		void ScanWriteTimes(bool reportChanges);
+		void AddChange(const std::filesystem::path& path);
+		bool IsExcluded(const std::filesystem::path& path) const;
+
+		std::filesystem::path m_directory;
+		std::vector<std::string> m_excludedDirectories;
+
+		std::thread m_thread;
+		std::atomic<bool> m_running = true;
+
+		std::mutex m_wakeMutex;
+		std::condition_variable m_wakeCondition;
+
+		std::mutex m_changesMutex;
+		std::set<std::filesystem::path> m_changes;
+
+		std::unordered_map<std::string, std::filesystem::file_time_type> m_writeTimes;
+
+		inline static constexpr std::chrono::milliseconds s_pollInterval{ 500 };
+	};
+}
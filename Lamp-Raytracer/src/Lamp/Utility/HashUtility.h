@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		// FNV-1a, chaining calls gives the same hash as one call over the joined bytes.
+		// The result is stable across runs, checkpoints store it.
+		inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+		{
+			const uint8_t* bytes = (const uint8_t*)data;
+			for (size_t i = 0; i < size; i++)
+			{
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+
+			return hash;
+		}
+	}
+}
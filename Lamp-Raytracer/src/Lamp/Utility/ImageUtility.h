@@ -5,6 +5,7 @@
 #include "Lamp/Log/Log.h"
 
 #include "Lamp/Rendering/Texture/Image2D.h"
+#include "Lamp/Rendering/Texture/ImageTransitionBatcher.h"
 
 namespace Lamp
 {
@@ -184,6 +185,21 @@ namespace Lamp
 				sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 				destStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 			}
+			else if (currentLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL && targetLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+			{
+				sourceStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+				destStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			}
+			else if (currentLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && targetLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+			{
+				sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+				destStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			}
+			else if (currentLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && targetLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+			{
+				sourceStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+				destStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			}
 			else if (currentLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && targetLayout == VK_IMAGE_LAYOUT_GENERAL)
 			{
 				sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
@@ -269,10 +285,9 @@ namespace Lamp
 			vkCmdPipelineBarrier(commandBuffer, sourceStage, destStage, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 		}
 
+		// Deferred, the transition is batched with the others and recorded at the start of the next frame or submit
 		inline void TransitionImageLayout(VkImage image, VkImageLayout currentLayout, VkImageLayout targetLayout)
 		{
-			auto device = GraphicsContext::GetDevice();
-			
 			VkImageSubresourceRange subresource{};
 			subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			subresource.baseMipLevel = 0;
@@ -280,11 +295,30 @@ namespace Lamp
 			subresource.baseArrayLayer = 0;
 			subresource.layerCount = VK_REMAINING_ARRAY_LAYERS;
 
-			auto commandBuffer = device->GetThreadSafeCommandBuffer(true);
-			
-			TransitionImageLayout(commandBuffer, image, currentLayout, targetLayout, subresource);
-			
-			device->FlushThreadSafeCommandBuffer(commandBuffer);
+			ImageTransitionBatcher::Submit(image, currentLayout, targetLayout, subresource);
+		}
+
+		inline void CopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, VkOffset2D imageOffset, VkExtent2D imageExtent, uint32_t mipLevel = 0)
+		{
+			VkBufferImageCopy region{};
+			region.bufferOffset = bufferOffset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = mipLevel;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+
+			region.imageOffset = { imageOffset.x, imageOffset.y, 0 };
+			region.imageExtent = { imageExtent.width, imageExtent.height, 1 };
+
+			vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}
+
+		inline void CopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel = 0)
+		{
+			CopyBufferToImage(commandBuffer, buffer, bufferOffset, image, VkOffset2D{ 0, 0 }, VkExtent2D{ width, height }, mipLevel);
 		}
 
 		inline void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel = 0)
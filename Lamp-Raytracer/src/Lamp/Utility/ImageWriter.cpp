@@ -0,0 +1,471 @@
+#include "lppch.h"
+#include "ImageWriter.h"
+
+#include <array>
+#include <fstream>
+#include <vector>
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		static constexpr uint32_t s_deflateWindowSize = 32768;
+		static constexpr uint32_t s_deflateHashSize = 1 << 15;
+		static constexpr uint32_t s_deflateMinMatch = 3;
+		static constexpr uint32_t s_deflateMaxMatch = 258;
+		static constexpr uint32_t s_deflateMaxProbes = 16;
+
+		static constexpr uint16_t s_lengthBase[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static constexpr uint8_t s_lengthExtraBits[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static constexpr uint16_t s_distanceBase[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static constexpr uint8_t s_distanceExtraBits[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		// Deflate streams are packed starting at the least significant bit
+		class BitWriter
+		{
+		public:
+			BitWriter(std::vector<uint8_t>& output)
+				: m_output(output)
+			{}
+
+			void Write(uint32_t value, uint32_t bitCount)
+			{
+				m_buffer |= value << m_bitCount;
+				m_bitCount += bitCount;
+
+				while (m_bitCount >= 8)
+				{
+					m_output.push_back((uint8_t)(m_buffer & 0xff));
+					m_buffer >>= 8;
+					m_bitCount -= 8;
+				}
+			}
+
+			// Huffman codes are stored starting at the most significant bit
+			void WriteCode(uint32_t code, uint32_t bitCount)
+			{
+				uint32_t reversed = 0;
+				for (uint32_t i = 0; i < bitCount; i++)
+				{
+					reversed = (reversed << 1) | (code & 1);
+					code >>= 1;
+				}
+
+				Write(reversed, bitCount);
+			}
+
+			void Flush()
+			{
+				if (m_bitCount > 0)
+				{
+					m_output.push_back((uint8_t)(m_buffer & 0xff));
+				}
+
+				m_buffer = 0;
+				m_bitCount = 0;
+			}
+
+		private:
+			std::vector<uint8_t>& m_output;
+
+			uint32_t m_buffer = 0;
+			uint32_t m_bitCount = 0;
+		};
+
+		inline void WriteSymbol(BitWriter& writer, uint32_t symbol)
+		{
+			// Fixed Huffman code lengths, RFC 1951 3.2.6
+			if (symbol <= 143)
+			{
+				writer.WriteCode(0x30 + symbol, 8);
+			}
+			else if (symbol <= 255)
+			{
+				writer.WriteCode(0x190 + symbol - 144, 9);
+			}
+			else if (symbol <= 279)
+			{
+				writer.WriteCode(symbol - 256, 7);
+			}
+			else
+			{
+				writer.WriteCode(0xc0 + symbol - 280, 8);
+			}
+		}
+
+		inline void WriteMatch(BitWriter& writer, uint32_t length, uint32_t distance)
+		{
+			uint32_t lengthCode = 0;
+			while (lengthCode + 1 < std::size(s_lengthBase) && s_lengthBase[lengthCode + 1] <= length)
+			{
+				lengthCode++;
+			}
+
+			WriteSymbol(writer, 257 + lengthCode);
+			writer.Write(length - s_lengthBase[lengthCode], s_lengthExtraBits[lengthCode]);
+
+			uint32_t distanceCode = 0;
+			while (distanceCode + 1 < std::size(s_distanceBase) && s_distanceBase[distanceCode + 1] <= distance)
+			{
+				distanceCode++;
+			}
+
+			writer.WriteCode(distanceCode, 5);
+			writer.Write(distance - s_distanceBase[distanceCode], s_distanceExtraBits[distanceCode]);
+		}
+
+		inline uint32_t HashTriplet(const uint8_t* data)
+		{
+			const uint32_t value = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16);
+			return (value * 2654435761u) >> (32 - 15);
+		}
+
+		inline uint32_t Adler32(const std::vector<uint8_t>& data)
+		{
+			uint32_t a = 1;
+			uint32_t b = 0;
+
+			for (const uint8_t byte : data)
+			{
+				a = (a + byte) % 65521;
+				b = (b + a) % 65521;
+			}
+
+			return (b << 16) | a;
+		}
+
+		// Single fixed Huffman block with hash chained LZ77 matches, wrapped in a zlib stream
+		std::vector<uint8_t> Deflate(const std::vector<uint8_t>& data)
+		{
+			std::vector<uint8_t> output;
+			output.reserve(data.size() / 2 + 64);
+
+			output.push_back(0x78);
+			output.push_back(0x01);
+
+			BitWriter writer{ output };
+			writer.Write(1, 1);
+			writer.Write(1, 2);
+
+			std::vector<int32_t> head(s_deflateHashSize, -1);
+			std::vector<int32_t> previous(s_deflateWindowSize, -1);
+
+			const size_t size = data.size();
+			size_t position = 0;
+
+			while (position < size)
+			{
+				uint32_t bestLength = 0;
+				uint32_t bestDistance = 0;
+
+				if (position + s_deflateMinMatch <= size)
+				{
+					const size_t maxLength = std::min<size_t>(s_deflateMaxMatch, size - position);
+
+					int32_t candidate = head[HashTriplet(&data[position])];
+					uint32_t probes = 0;
+
+					while (candidate >= 0 && (size_t)candidate < position && position - candidate <= s_deflateWindowSize && probes++ < s_deflateMaxProbes)
+					{
+						uint32_t length = 0;
+						while (length < maxLength && data[candidate + length] == data[position + length])
+						{
+							length++;
+						}
+
+						if (length > bestLength)
+						{
+							bestLength = length;
+							bestDistance = (uint32_t)(position - candidate);
+
+							if (length == maxLength)
+							{
+								break;
+							}
+						}
+
+						const int32_t next = previous[candidate & (s_deflateWindowSize - 1)];
+						if (next >= candidate)
+						{
+							break;
+						}
+
+						candidate = next;
+					}
+				}
+
+				size_t advance = 1;
+				if (bestLength >= s_deflateMinMatch)
+				{
+					WriteMatch(writer, bestLength, bestDistance);
+					advance = bestLength;
+				}
+				else
+				{
+					WriteSymbol(writer, data[position]);
+				}
+
+				for (size_t i = position; i < position + advance; i++)
+				{
+					if (i + s_deflateMinMatch <= size)
+					{
+						const uint32_t hash = HashTriplet(&data[i]);
+						previous[i & (s_deflateWindowSize - 1)] = head[hash];
+						head[hash] = (int32_t)i;
+					}
+				}
+
+				position += advance;
+			}
+
+			WriteSymbol(writer, 256);
+			writer.Flush();
+
+			const uint32_t adler = Adler32(data);
+			output.push_back((uint8_t)(adler >> 24));
+			output.push_back((uint8_t)(adler >> 16));
+			output.push_back((uint8_t)(adler >> 8));
+			output.push_back((uint8_t)adler);
+
+			return output;
+		}
+
+		inline uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0xffffffff)
+		{
+			static const std::array<uint32_t, 256> table = []()
+			{
+				std::array<uint32_t, 256> result{};
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					uint32_t value = i;
+					for (uint32_t bit = 0; bit < 8; bit++)
+					{
+						value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+					}
+
+					result[i] = value;
+				}
+
+				return result;
+			}();
+
+			for (size_t i = 0; i < size; i++)
+			{
+				crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+			}
+
+			return crc;
+		}
+
+		inline void WriteBigEndian(std::ofstream& stream, uint32_t value)
+		{
+			const uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+			stream.write((const char*)bytes, sizeof(bytes));
+		}
+
+		inline void WritePNGChunk(std::ofstream& stream, const char* type, const std::vector<uint8_t>& data)
+		{
+			WriteBigEndian(stream, (uint32_t)data.size());
+			stream.write(type, 4);
+			stream.write((const char*)data.data(), data.size());
+
+			const uint32_t crc = Crc32(data.data(), data.size(), Crc32((const uint8_t*)type, 4));
+			WriteBigEndian(stream, crc ^ 0xffffffff);
+		}
+
+		inline uint8_t PaethPredictor(int32_t a, int32_t b, int32_t c)
+		{
+			const int32_t p = a + b - c;
+			const int32_t pa = std::abs(p - a);
+			const int32_t pb = std::abs(p - b);
+			const int32_t pc = std::abs(p - c);
+
+			if (pa <= pb && pa <= pc)
+			{
+				return (uint8_t)a;
+			}
+
+			return (uint8_t)(pb <= pc ? b : c);
+		}
+
+		// Picks the filter with the smallest sum of absolute residuals per row, same heuristic as libpng
+		std::vector<uint8_t> FilterScanlines(uint32_t width, uint32_t height, const uint8_t* pixels)
+		{
+			constexpr uint32_t bytesPerPixel = 4;
+			const size_t stride = (size_t)width * bytesPerPixel;
+
+			std::vector<uint8_t> result((stride + 1) * height);
+			std::vector<uint8_t> candidate(stride);
+
+			for (uint32_t y = 0; y < height; y++)
+			{
+				const uint8_t* row = pixels + stride * y;
+				const uint8_t* previousRow = y > 0 ? row - stride : nullptr;
+				uint8_t* outRow = &result[(stride + 1) * y];
+
+				uint64_t bestScore = UINT64_MAX;
+
+				for (uint8_t filter = 0; filter < 5; filter++)
+				{
+					uint64_t score = 0;
+					for (size_t i = 0; i < stride; i++)
+					{
+						const int32_t a = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+						const int32_t b = previousRow ? previousRow[i] : 0;
+						const int32_t c = (previousRow && i >= bytesPerPixel) ? previousRow[i - bytesPerPixel] : 0;
+
+						uint8_t value = row[i];
+						switch (filter)
+						{
+							case 1: value -= (uint8_t)a; break;
+							case 2: value -= (uint8_t)b; break;
+							case 3: value -= (uint8_t)((a + b) >> 1); break;
+							case 4: value -= PaethPredictor(a, b, c); break;
+						}
+
+						candidate[i] = value;
+						score += (uint64_t)std::abs((int32_t)(int8_t)value);
+					}
+
+					if (score < bestScore)
+					{
+						bestScore = score;
+						outRow[0] = filter;
+						memcpy(outRow + 1, candidate.data(), stride);
+					}
+				}
+			}
+
+			return result;
+		}
+
+		template<typename T>
+		inline void WriteLittleEndian(std::ofstream& stream, const T& value)
+		{
+			stream.write((const char*)&value, sizeof(T));
+		}
+
+		inline void WriteEXRAttribute(std::ofstream& stream, const char* name, const char* type, const void* data, uint32_t size)
+		{
+			stream.write(name, strlen(name) + 1);
+			stream.write(type, strlen(type) + 1);
+			WriteLittleEndian(stream, size);
+			stream.write((const char*)data, size);
+		}
+	}
+
+	bool ImageWriter::WritePNG(const std::filesystem::path& path, uint32_t width, uint32_t height, const uint8_t* pixels)
+	{
+		LP_PROFILE_FUNCTION();
+
+		std::ofstream stream{ path, std::ios::binary };
+		if (!stream.is_open())
+		{
+			return false;
+		}
+
+		const std::vector<uint8_t> compressed = Utility::Deflate(Utility::FilterScanlines(width, height, pixels));
+
+		const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		stream.write((const char*)signature, sizeof(signature));
+
+		std::vector<uint8_t> header(13, 0);
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			header[i] = (uint8_t)(width >> (24 - i * 8));
+			header[4 + i] = (uint8_t)(height >> (24 - i * 8));
+		}
+
+		header[8] = 8; // Bit depth
+		header[9] = 6; // RGBA
+
+		Utility::WritePNGChunk(stream, "IHDR", header);
+		Utility::WritePNGChunk(stream, "IDAT", compressed);
+		Utility::WritePNGChunk(stream, "IEND", {});
+
+		return stream.good();
+	}
+
+	bool ImageWriter::WriteEXR(const std::filesystem::path& path, uint32_t width, uint32_t height, const float* pixels)
+	{
+		LP_PROFILE_FUNCTION();
+
+		std::ofstream stream{ path, std::ios::binary };
+		if (!stream.is_open())
+		{
+			return false;
+		}
+
+		constexpr uint32_t magic = 20000630;
+		constexpr uint32_t version = 2; // Single part scanline file
+		Utility::WriteLittleEndian(stream, magic);
+		Utility::WriteLittleEndian(stream, version);
+
+		// Channels have to be sorted by name, the offsets are into the interleaved RGBA source
+		constexpr std::array<std::pair<char, uint32_t>, 4> channels = { { { 'A', 3 }, { 'B', 2 }, { 'G', 1 }, { 'R', 0 } } };
+
+		std::vector<uint8_t> channelList;
+		for (const auto& [name, offset] : channels)
+		{
+			const int32_t pixelType = 2; // FLOAT
+			const int32_t sampling = 1;
+
+			channelList.push_back((uint8_t)name);
+			channelList.push_back(0);
+
+			channelList.insert(channelList.end(), (const uint8_t*)&pixelType, (const uint8_t*)&pixelType + 4);
+			channelList.insert(channelList.end(), 4, 0); // pLinear and reserved
+			channelList.insert(channelList.end(), (const uint8_t*)&sampling, (const uint8_t*)&sampling + 4);
+			channelList.insert(channelList.end(), (const uint8_t*)&sampling, (const uint8_t*)&sampling + 4);
+		}
+		channelList.push_back(0);
+
+		const uint8_t compression = 0;
+		const uint8_t lineOrder = 0;
+		const int32_t window[4] = { 0, 0, (int32_t)width - 1, (int32_t)height - 1 };
+		const float pixelAspectRatio = 1.f;
+		const float screenWindowCenter[2] = { 0.f, 0.f };
+		const float screenWindowWidth = 1.f;
+
+		Utility::WriteEXRAttribute(stream, "channels", "chlist", channelList.data(), (uint32_t)channelList.size());
+		Utility::WriteEXRAttribute(stream, "compression", "compression", &compression, sizeof(compression));
+		Utility::WriteEXRAttribute(stream, "dataWindow", "box2i", window, sizeof(window));
+		Utility::WriteEXRAttribute(stream, "displayWindow", "box2i", window, sizeof(window));
+		Utility::WriteEXRAttribute(stream, "lineOrder", "lineOrder", &lineOrder, sizeof(lineOrder));
+		Utility::WriteEXRAttribute(stream, "pixelAspectRatio", "float", &pixelAspectRatio, sizeof(pixelAspectRatio));
+		Utility::WriteEXRAttribute(stream, "screenWindowCenter", "v2f", screenWindowCenter, sizeof(screenWindowCenter));
+		Utility::WriteEXRAttribute(stream, "screenWindowWidth", "float", &screenWindowWidth, sizeof(screenWindowWidth));
+		stream.put(0);
+
+		// One scanline per chunk: y, byte count, then every channel's samples
+		const uint32_t lineDataSize = width * (uint32_t)channels.size() * sizeof(float);
+		const uint64_t lineChunkSize = sizeof(int32_t) * 2 + lineDataSize;
+
+		uint64_t offset = (uint64_t)stream.tellp() + sizeof(uint64_t) * height;
+		for (uint32_t y = 0; y < height; y++)
+		{
+			Utility::WriteLittleEndian(stream, offset);
+			offset += lineChunkSize;
+		}
+
+		std::vector<float> line((size_t)width * channels.size());
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const float* row = pixels + (size_t)width * 4 * y;
+
+			for (size_t channel = 0; channel < channels.size(); channel++)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					line[channel * width + x] = row[x * 4 + channels[channel].second];
+				}
+			}
+
+			Utility::WriteLittleEndian(stream, (int32_t)y);
+			Utility::WriteLittleEndian(stream, lineDataSize);
+			stream.write((const char*)line.data(), lineDataSize);
+		}
+
+		return stream.good();
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <stdint.h>
+
+namespace Lamp
+{
+	// Encoders for captured frames, pixels are tightly packed RGBA rows starting at the top.
+	// 8 bit pixels are display (sRGB) encoded and float pixels are linear, the conversions below go between the two.
+	class ImageWriter
+	{
+	public:
+		// 8 bit sRGB encoded RGBA, deflated with fixed Huffman codes
+		static bool WritePNG(const std::filesystem::path& path, uint32_t width, uint32_t height, const uint8_t* pixels);
+
+		// 32 bit linear float RGBA, uncompressed scanlines
+		static bool WriteEXR(const std::filesystem::path& path, uint32_t width, uint32_t height, const float* pixels);
+
+		static inline float LinearToSRGB(float value)
+		{
+			value = std::clamp(value, 0.f, 1.f);
+			return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+		}
+
+		static inline float SRGBToLinear(float value)
+		{
+			return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+	private:
+		ImageWriter() = delete;
+	};
+}
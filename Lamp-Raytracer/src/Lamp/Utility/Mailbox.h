@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+namespace Lamp
+{
+	// Single producer, single consumer triple buffer.
+	// The producer always has a buffer to write into and the consumer always sees the latest published one, without either side blocking.
+	template<typename T>
+	class Mailbox
+	{
+	public:
+		Mailbox() = default;
+
+		Mailbox(const Mailbox&) = delete;
+		Mailbox& operator=(const Mailbox&) = delete;
+
+		// Producer side
+		T& GetWriteBuffer()
+		{
+			return m_buffers[m_writeIndex];
+		}
+
+		void Publish()
+		{
+			m_writeIndex = m_sharedIndex.exchange(m_writeIndex | s_newDataBit, std::memory_order_acq_rel) & s_indexMask;
+		}
+
+		// Consumer side, returns false if nothing new has been published since the last call
+		bool Consume()
+		{
+			if ((m_sharedIndex.load(std::memory_order_relaxed) & s_newDataBit) == 0)
+			{
+				return false;
+			}
+
+			m_readIndex = m_sharedIndex.exchange(m_readIndex, std::memory_order_acq_rel) & s_indexMask;
+			return true;
+		}
+
+		const T& GetReadBuffer() const
+		{
+			return m_buffers[m_readIndex];
+		}
+
+	private:
+		inline static constexpr uint32_t s_newDataBit = 4;
+		inline static constexpr uint32_t s_indexMask = 3;
+
+		std::array<T, 3> m_buffers;
+
+		uint32_t m_writeIndex = 0;
+		uint32_t m_readIndex = 1;
+		std::atomic<uint32_t> m_sharedIndex = 2;
+	};
+}
@@ -0,0 +1,174 @@
+#include "lppch.h"
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Lamp
+{
+	MappedFile::MappedFile(const std::filesystem::path& path, size_t size, bool writable)
+		: m_writable(writable)
+	{
+#ifdef _WIN32
+		const DWORD access = writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+		const DWORD disposition = writable ? CREATE_ALWAYS : OPEN_EXISTING;
+
+		HANDLE file = CreateFileW(path.c_str(), access, FILE_SHARE_READ, nullptr, disposition, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+
+		m_fileHandle = file;
+
+		if (!writable)
+		{
+			LARGE_INTEGER fileSize{};
+			if (!GetFileSizeEx(file, &fileSize))
+			{
+				return;
+			}
+
+			size = (size_t)fileSize.QuadPart;
+		}
+
+		// Empty files can't be mapped
+		if (size == 0)
+		{
+			return;
+		}
+
+		// Mapping a writable file with a size grows it to that size
+		const uint64_t mappingSize = (uint64_t)size;
+		HANDLE mapping = CreateFileMappingW(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)(mappingSize >> 32), (DWORD)(mappingSize & 0xffffffff), nullptr);
+		if (!mapping)
+		{
+			return;
+		}
+
+		m_mappingHandle = mapping;
+		m_data = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+#else
+		const int file = writable ? open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) : open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return;
+		}
+
+		m_fileDescriptor = file;
+
+		if (writable)
+		{
+			if (ftruncate(file, (off_t)size) != 0)
+			{
+				return;
+			}
+		}
+		else
+		{
+			struct stat fileStatus{};
+			if (fstat(file, &fileStatus) != 0)
+			{
+				return;
+			}
+
+			size = (size_t)fileStatus.st_size;
+		}
+
+		if (size == 0)
+		{
+			return;
+		}
+
+		void* data = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+		m_data = data != MAP_FAILED ? data : nullptr;
+#endif
+
+		m_size = m_data ? size : 0;
+	}
+
+	MappedFile::~MappedFile()
+	{
+#ifdef _WIN32
+		if (m_data)
+		{
+			UnmapViewOfFile(m_data);
+		}
+
+		if (m_mappingHandle)
+		{
+			CloseHandle(m_mappingHandle);
+		}
+
+		if (m_fileHandle)
+		{
+			CloseHandle(m_fileHandle);
+		}
+#else
+		if (m_data)
+		{
+			munmap(m_data, m_size);
+		}
+
+		if (m_fileDescriptor >= 0)
+		{
+			close(m_fileDescriptor);
+		}
+#endif
+	}
+
+	bool MappedFile::Flush()
+	{
+		if (!m_data || !m_writable)
+		{
+			return false;
+		}
+
+#ifdef _WIN32
+		return FlushViewOfFile(m_data, 0) && FlushFileBuffers(m_fileHandle);
+#else
+		return msync(m_data, m_size, MS_SYNC) == 0 && fsync(m_fileDescriptor) == 0;
+#endif
+	}
+
+	Ref<MappedFile> MappedFile::Create(const std::filesystem::path& path, size_t size)
+	{
+		Ref<MappedFile> file = CreateRef<MappedFile>(path, size, true);
+		return file->IsValid() ? file : nullptr;
+	}
+
+	Ref<MappedFile> MappedFile::Open(const std::filesystem::path& path)
+	{
+		Ref<MappedFile> file = CreateRef<MappedFile>(path, 0, false);
+		return file->IsValid() ? file : nullptr;
+	}
+
+	bool MappedFile::Replace(const std::filesystem::path& source, const std::filesystem::path& destination)
+	{
+#ifdef _WIN32
+		return MoveFileExW(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		std::error_code error;
+		std::filesystem::rename(source, destination, error);
+		if (error)
+		{
+			return false;
+		}
+
+		// The rename itself is only durable once the directory is synced
+		const std::filesystem::path directory = destination.has_parent_path() ? destination.parent_path() : std::filesystem::path(".");
+		const int directoryFile = open(directory.c_str(), O_RDONLY);
+		if (directoryFile >= 0)
+		{
+			fsync(directoryFile);
+			close(directoryFile);
+		}
+
+		return true;
+#endif
+	}
+}
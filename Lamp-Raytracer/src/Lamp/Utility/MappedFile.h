@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Lamp/Core/Base.h"
+
+#include <filesystem>
+
+namespace Lamp
+{
+	// A file mapped into memory, either created with a fixed size to be written or opened read only
+	class MappedFile
+	{
+	public:
+		MappedFile(const std::filesystem::path& path, size_t size, bool writable);
+		~MappedFile();
+
+		// Writes the dirty pages and the file metadata to disk, the contents survive a crash once this returns true
+		bool Flush();
+
+		inline void* GetData() const { return m_data; }
+		inline const size_t GetSize() const { return m_size; }
+		inline const bool IsValid() const { return m_data != nullptr; }
+
+		// Creates or truncates the file, returns null if it could not be mapped
+		static Ref<MappedFile> Create(const std::filesystem::path& path, size_t size);
+		static Ref<MappedFile> Open(const std::filesystem::path& path);
+
+		// Renames a flushed file over the destination, the destination is either the old or the new file after a crash
+		static bool Replace(const std::filesystem::path& source, const std::filesystem::path& destination);
+
+	private:
+		void* m_data = nullptr;
+		size_t m_size = 0;
+		bool m_writable = false;
+
+#ifdef _WIN32
+		void* m_fileHandle = nullptr;
+		void* m_mappingHandle = nullptr;
+#else
+		int m_fileDescriptor = -1;
+#endif
+	};
+}
@@ -11,32 +11,35 @@ public:
 	ThreadSafeQueue() {}
 	ThreadSafeQueue(const ThreadSafeQueue& copy)
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
+		std::lock_guard<std::mutex> lock(copy.m_mutex);
 		m_queue = copy.m_queue;
 	}
 
 	void Push(T val)
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_queue.push(val);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push(std::move(val));
+		}
+
 		m_conditionVariable.notify_one();
 	}
 
 	void WaitAndPop(T& val)
 	{
 		std::unique_lock<std::mutex> lock(m_mutex);
-		m_conditionVariable.wait([&m_queue]() { return !m_queue.empty(); });
+		m_conditionVariable.wait(lock, [this]() { return !m_queue.empty(); });
 
-		val = m_queue.front();
+		val = std::move(m_queue.front());
 		m_queue.pop();
 	}
 
 	T WaitAndPop()
 	{
 		std::unique_lock<std::mutex> lock(m_mutex);
-		m_conditionVariable.wait([&m_queue]() { return !m_queue.empty(); });
+		m_conditionVariable.wait(lock, [this]() { return !m_queue.empty(); });
 
-		T val = m_queue.front();
+		T val = std::move(m_queue.front());
 		m_queue.pop();
 
 		return val;
@@ -50,7 +53,7 @@ public:
 			return false;
 		}
 
-		val = m_queue.front();
+		val = std::move(m_queue.front());
 		m_queue.pop();
 
 		return true;
@@ -64,7 +67,7 @@ public:
 			return T();
 		}
 
-		T val = m_queue.front();
+		T val = std::move(m_queue.front());
 		m_queue.pop();
 
 		return val;
@@ -83,7 +86,7 @@ public:
 	}
 
 private:
-	std::mutex m_mutex;
+	mutable std::mutex m_mutex;
 	std::queue<T> m_queue;
 	std::condition_variable m_conditionVariable;
 };
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+
+namespace Lamp
+{
+	namespace Utility
+	{
+		inline uint64_t MicrosecondsSince(const std::chrono::steady_clock::time_point& start)
+		{
+			return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+}
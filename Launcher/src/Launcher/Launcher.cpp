@@ -8,11 +8,16 @@
 #include <Lamp/Rendering/Texture/Image2D.h>
 #include <Lamp/Rendering/Renderer.h>
 #include <Lamp/Rendering/Framebuffer.h>
+#include <Lamp/Rendering/SequenceRenderer.h>
+#include <Lamp/Rendering/ProgressiveRenderer.h>
+#include <Lamp/Rendering/Camera/CameraPath.h>
 
 #include <Lamp/Scene/Scene.h>
 
 #include <imgui.h>
 
+#include <format>
+
 namespace Launcher
 {
 	void LauncherLayer::OnAttach()
@@ -23,6 +28,9 @@ namespace Launcher
 			{ Lamp::ImageFormat::RGBA }
 		};
 
+		// Read back by frame captures
+		spec.attachments.front().copyable = true;
+
 		spec.width = 1280;
 		spec.height = 720;
 	
@@ -37,6 +45,8 @@ namespace Launcher
 
 	void LauncherLayer::OnDetach()
 	{
+		m_sequenceRenderer = nullptr;
+		m_progressiveRenderer = nullptr;
 		m_framebuffer = nullptr;
 	}
 
@@ -51,6 +61,86 @@ namespace Launcher
 	{
 		ImGui::Begin("TestWindow");
 
+		if (ImGui::Button("Capture"))
+		{
+			Lamp::Renderer::CaptureFrame(std::format("Captures/Capture_{0}.png", m_captureIndex++));
+		}
+
+		ImGui::SameLine();
+
+		if (!m_sequenceRenderer || !m_sequenceRenderer->IsRunning())
+		{
+			if (ImGui::Button("Render Turntable"))
+			{
+				Lamp::SequenceSettings settings{};
+				settings.outputDirectory = "Sequences/Turntable";
+				settings.frameCount = 120;
+
+				// Resumes where an earlier run of the same sequence stopped
+				m_sequenceRenderer = Lamp::SequenceRenderer::Create(Lamp::CameraPath::CreateTurntable({ 0.f, 0.f, -5.f }, 6.f, 2.f, 4.f), m_scene->GetObjects(), settings);
+				m_sequenceRenderer->Start();
+			}
+		}
+		else
+		{
+			ImGui::Text("Turntable %d/%d", m_sequenceRenderer->GetCompletedFrames(), m_sequenceRenderer->GetFrameCount());
+			ImGui::SameLine();
+
+			if (ImGui::Button("Cancel"))
+			{
+				m_sequenceRenderer->Cancel();
+			}
+		}
+
+		if (!m_progressiveRenderer || !m_progressiveRenderer->IsRunning())
+		{
+			if (ImGui::Button("Progressive Render"))
+			{
+				// Continues from the last checkpoint of the same view, cancelling writes one
+				m_progressiveRenderer = Lamp::ProgressiveRenderer::Create(Lamp::CameraKeyframe{}, m_scene->GetObjects(), Lamp::ProgressiveSettings{});
+				m_progressiveRenderer->Start();
+			}
+
+			ImGui::SameLine();
+
+			if (ImGui::Button("Check Resume"))
+			{
+				// Small enough to run on the spot, the result is logged
+				Lamp::ProgressiveSettings settings{};
+				settings.outputPath = "Renders/ResumeCheck.exr";
+				settings.checkpointPath = "Renders/ResumeCheck.checkpoint";
+				settings.sampleCount = 16;
+				settings.width = 320;
+				settings.height = 180;
+
+				Lamp::ProgressiveRenderer::VerifyResume(Lamp::CameraKeyframe{}, m_scene->GetObjects(), settings);
+			}
+		}
+		else
+		{
+			ImGui::Text("Samples %d/%d (checkpoint at %d)", m_progressiveRenderer->GetCompletedSamples(), m_progressiveRenderer->GetSampleCount(), m_progressiveRenderer->GetCheckpointedSamples());
+			ImGui::SameLine();
+
+			if (ImGui::Button("Stop"))
+			{
+				m_progressiveRenderer->Cancel();
+			}
+		}
+
+		bool hybridTracing = Lamp::Renderer::IsHybridTracing();
+		if (ImGui::Checkbox("Hybrid Tracing", &hybridTracing))
+		{
+			Lamp::Renderer::SetHybridTracing(hybridTracing);
+		}
+
+		if (hybridTracing)
+		{
+			const auto& traceStats = Lamp::Renderer::GetTraceStatistics();
+
+			ImGui::SameLine();
+			ImGui::Text("Full %.2f ms, hybrid %.2f ms", traceStats.fullFrameMs, traceStats.hybridFrameMs);
+		}
+
 		ImGui::Image(UI::GetTextureID(m_framebuffer->GetColorAttachment(0)), { 1280, 720 });
 
 		ImGui::End();
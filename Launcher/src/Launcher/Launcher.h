@@ -7,6 +7,8 @@ namespace Lamp
 {
 	class Scene;
 	class Framebuffer;
+	class SequenceRenderer;
+	class ProgressiveRenderer;
 }
 
 namespace Launcher
@@ -25,5 +27,9 @@ namespace Launcher
 
 		Ref<Lamp::Framebuffer> m_framebuffer;
 		Ref<Lamp::Scene> m_scene;
+		Ref<Lamp::SequenceRenderer> m_sequenceRenderer;
+		Ref<Lamp::ProgressiveRenderer> m_progressiveRenderer;
+
+		uint32_t m_captureIndex = 0;
 	};
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "Sphere.h"
 
+#include <Lamp/Utility/HashUtility.h>
+
 #include <glm/gtx/norm.hpp>
 
 namespace Launcher
@@ -8,6 +10,11 @@ namespace Launcher
 		: m_center(center), m_radius(radius)
 	{}
 
+	Ref<Lamp::Hittable> Sphere::Clone() const
+	{
+		return CreateRef<Sphere>(*this);
+	}
+
 	bool Sphere::HitTest(const Lamp::Ray& ray, const float minT, const float maxT, Lamp::RaycastHit& hit) const
 	{
 		const glm::vec3 oc = ray.origin - m_center;
@@ -44,4 +51,17 @@ namespace Launcher
 
 		return true;
 	}
+
+	bool Sphere::GetRasterSphere(glm::vec4& outSphere) const
+	{
+		outSphere = { m_center, m_radius };
+		return true;
+	}
+
+	uint64_t Sphere::GetContentHash() const
+	{
+		// Has to be stable across runs since checkpoints store it
+		const float values[4] = { m_center.x, m_center.y, m_center.z, m_radius };
+		return Lamp::Utility::HashBytes(values, sizeof(values));
+	}
 }
\ No newline at end of file
@@ -8,7 +8,11 @@ namespace Launcher
 	{
 	public:
 		Sphere(const glm::vec3& center, const float radius);
+
+		Ref<Lamp::Hittable> Clone() const override;
 		bool HitTest(const Lamp::Ray& ray, const float minT, const float maxT, Lamp::RaycastHit& hit) const override;
+		bool GetRasterSphere(glm::vec4& outSphere) const override;
+		uint64_t GetContentHash() const override;
 		
 	private:
 		glm::vec3 m_center;
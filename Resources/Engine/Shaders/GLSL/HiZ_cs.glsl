@@ -0,0 +1,21 @@
+#version 460
+
+// Reduces one level of the depth pyramid. The sampler uses max reduction, so a single
+// bilinear tap covers the 2x2 footprint of the previous level.
+
+layout(set = 0, binding = 0, r32f) uniform writeonly image2D o_output;
+layout(set = 0, binding = 1) uniform sampler2D u_input;
+
+layout(push_constant) uniform constants
+{
+	vec2 u_outputSize;
+};
+
+layout (local_size_x = 16, local_size_y = 16) in;
+void main()
+{
+	const uvec2 position = gl_GlobalInvocationID.xy;
+
+	const float depth = texture(u_input, (vec2(position) + vec2(0.5f)) / u_outputSize).x;
+	imageStore(o_output, ivec2(position), vec4(depth));
+}
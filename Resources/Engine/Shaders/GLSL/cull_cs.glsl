@@ -6,7 +6,7 @@ struct DrawCullData
 {
 	mat4 view;
 	float P00, P11, zNear, zFar;
-	float frustum[4];
+	vec4 frustum;
 	float lodBase, lodStep;
 	float pyramidWidth, pyramidHeight;
 	
@@ -24,6 +24,8 @@ struct DrawCullData
 	float aabbmax_x;
 	float aabbmax_y;
 	float aabbmax_z;
+
+	int latePass;
 };
 
 struct DrawCommand
@@ -59,13 +61,55 @@ layout(std430, set = 0, binding = 4) readonly buffer ObjectBuffer
     ObjectData objects[];
 } u_objectBuffer;
 
-layout(push_constant) uniform constants
+layout(set = 0, binding = 5) uniform sampler2D u_depthPyramid;
+
+// One per draw, set by the early pass when only the occlusion test rejected the draw
+layout(std430, set = 0, binding = 6) buffer OccludedBuffer
+{
+	uint occluded[];
+} u_occludedBuffer;
+
+layout(std140, set = 0, binding = 0) uniform CullData
 {
 	DrawCullData u_cullData;
 };
 
-bool IsVisible(uint objectId)
+// 2D Polyhedral Bounds of a Clipped, Perspective-Projected 3D Sphere. Michael Mara, Morgan McGuire. 2013
+bool ProjectSphere(vec3 center, float radius, float zNear, float P00, float P11, out vec4 aabb)
+{
+	if (center.z < radius + zNear)
+	{
+		return false;
+	}
+
+	const vec3 cr = center * radius;
+	const float czr2 = center.z * center.z - radius * radius;
+
+	const float vx = sqrt(center.x * center.x + czr2);
+	const float minX = (vx * center.x - cr.z) / (vx * center.z + cr.x);
+	const float maxX = (vx * center.x + cr.z) / (vx * center.z - cr.x);
+
+	const float vy = sqrt(center.y * center.y + czr2);
+	const float minY = (vy * center.y - cr.z) / (vy * center.z + cr.y);
+	const float maxY = (vy * center.y + cr.z) / (vy * center.z - cr.y);
+
+	// Clip space to UV space
+	aabb = vec4(minX * P00, minY * P11, maxX * P00, maxY * P11);
+	aabb = aabb.xwzy * vec4(0.5f, -0.5f, 0.5f, -0.5f) + vec4(0.5f);
+
+	return true;
+}
+
+// Depth buffer value of a view space distance, for a zero to one perspective projection
+float ViewDepthToDepth(float viewDepth)
+{
+	return u_cullData.zFar * (viewDepth - u_cullData.zNear) / (viewDepth * (u_cullData.zFar - u_cullData.zNear));
+}
+
+bool IsVisible(uint objectId, out bool occluded)
 {
+	occluded = false;
+
 	vec4 sphereBounds = u_objectBuffer.objects[objectId].sphereBounds;
 
 	vec3 center = sphereBounds.xyz;
@@ -83,6 +127,30 @@ bool IsVisible(uint objectId)
 		visible = visible && center.z + radius > u_cullData.zNear && center.z - radius < u_cullData.zFar;
 	}
 
+	// The pyramid holds the farthest depth of every region, the sphere is hidden if its nearest point is behind it
+	if (visible && u_cullData.occlusionEnabled != 0)
+	{
+		vec4 aabb;
+		if (ProjectSphere(center, radius, u_cullData.zNear, u_cullData.P00, u_cullData.P11, aabb))
+		{
+			// The padding covers the half pixel shift of the G-buffer projection
+			const vec2 texelSize = 1.f / vec2(u_cullData.pyramidWidth, u_cullData.pyramidHeight);
+			aabb += vec4(-texelSize, texelSize);
+
+			// At this level the box is at most one texel wide, so the two texels around its center cover it
+			const float width = (aabb.z - aabb.x) * u_cullData.pyramidWidth;
+			const float height = (aabb.w - aabb.y) * u_cullData.pyramidHeight;
+			const float level = ceil(log2(max(width, height)));
+
+			const float pyramidDepth = textureLod(u_depthPyramid, (aabb.xy + aabb.zw) * 0.5f, level).x;
+			const float sphereDepth = ViewDepthToDepth(center.z - radius);
+
+			occluded = sphereDepth > pyramidDepth;
+			visible = !occluded;
+		}
+	}
+
+	occluded = occluded && u_cullData.cullingEnabled != 0;
 	visible = visible || u_cullData.cullingEnabled == 0;
 	return visible;
 }
@@ -95,7 +163,20 @@ void main()
 	if (globalId < u_cullData.drawCount)
 	{	
 		const uint objectId = u_drawBuffer.draws[globalId].objectId;
-		const bool visible = IsVisible(objectId);
+
+		// The late pass only tests the draws the early pass held back, against the pyramid of this frame's depth
+		bool occluded;
+		bool visible;
+
+		if (u_cullData.latePass != 0)
+		{
+			visible = u_occludedBuffer.occluded[globalId] != 0 && IsVisible(objectId, occluded);
+		}
+		else
+		{
+			visible = IsVisible(objectId, occluded);
+			u_occludedBuffer.occluded[globalId] = occluded ? 1 : 0;
+		}
 
 		if (visible)
 		{
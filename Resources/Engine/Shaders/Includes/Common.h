@@ -26,6 +26,28 @@
 
 #endif // __HLSL__
 
+// Bindless resources, only valid when the application enables bindless mode.
+// GLSL shaders define USE_BINDLESS before including this file, and include it before any declarations.
+#define BINDLESS_SET 5
+#define BINDLESS_TEXTURE_BINDING 0
+#define BINDLESS_BUFFER_BINDING 1
+#define BINDLESS_INVALID_INDEX 0xFFFFFFFF
+
+#if defined(USE_BINDLESS) && !defined(__HLSL__)
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = BINDLESS_SET, binding = BINDLESS_TEXTURE_BINDING) uniform sampler2D u_bindlessTextures[];
+layout(std430, set = BINDLESS_SET, binding = BINDLESS_BUFFER_BINDING) readonly buffer BindlessBuffer
+{
+	uint data[];
+} u_bindlessBuffers[];
+
+#define BINDLESS_TEXTURE(index) u_bindlessTextures[nonuniformEXT(index)]
+#define BINDLESS_BUFFER(index) u_bindlessBuffers[nonuniformEXT(index)].data
+
+#endif // USE_BINDLESS
+
 struct ObjectData
 {
 	mat4 transform;
@@ -38,6 +60,14 @@ struct DirectionalLight
 	vec4 colorIntensity;
 };
 
+struct BindlessMaterial
+{
+	uint albedoTexture;
+	uint normalTexture;
+	uint materialTexture;
+	uint materialBuffer;
+};
+
 struct CameraData
 {
 	mat4 view;